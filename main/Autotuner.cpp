@@ -0,0 +1,305 @@
+#include "Autotuner.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+RelayAutotuner::RelayAutotuner(const RelayAutotunerConfig& cfg, double outputMin, double outputMax)
+    : _cfg(cfg), _outputMin(outputMin), _outputMax(outputMax)
+{
+    if (checkInputs(cfg) != PBRet::SUCCESS) {
+        return;
+    }
+
+    if ((outputMax - outputMin) < 2.0 * cfg.relayAmplitude) {
+        ESP_LOGE(RelayAutotuner::Name, "Relay amplitude (%.1f) doesn't fit the output range [%.1f, %.1f]", cfg.relayAmplitude, outputMin, outputMax);
+        return;
+    }
+
+    _configured = true;
+}
+
+PBRet RelayAutotuner::start(double bias)
+{
+    if (_configured == false) {
+        ESP_LOGW(RelayAutotuner::Name, "Autotuner is not configured");
+        return PBRet::FAILURE;
+    }
+
+    _bias = std::min(std::max(bias, _outputMin + _cfg.relayAmplitude), _outputMax - _cfg.relayAmplitude);
+    _result = RelayTuning {};
+    _t = 0.0;
+    _dtSum = 0.0;
+    _steps = 0;
+    _high = false;
+    _rises = 0;
+    _lastRise = 0.0;
+    _peakMax = 0.0;
+    _peakMin = 0.0;
+    _cycles = 0;
+    _period = 0.0;
+    _amplitude = 0.0;
+    _periodSum = 0.0;
+    _amplitudeSum = 0.0;
+    _state = State::RUNNING;
+
+    ESP_LOGI(RelayAutotuner::Name, "Relay experiment started at %.1f +/- %.1f", _bias, _cfg.relayAmplitude);
+    return PBRet::SUCCESS;
+}
+
+void RelayAutotuner::cancel(void)
+{
+    if (_state == State::RUNNING) {
+        _fail("it was cancelled");
+    }
+}
+
+double RelayAutotuner::update(double err, double dt)
+{
+    if (_state != State::RUNNING) {
+        return _bias;
+    }
+
+    _t += dt;
+    _dtSum += dt;
+    _steps++;
+
+    if (std::fabs(err) > _cfg.maxDeviation) {
+        _fail("the error left the allowed band");
+        return _bias;
+    }
+
+    if (_t > _cfg.maxDuration) {
+        _fail("no steady oscillation was found");
+        return _bias;
+    }
+
+    _peakMax = std::max(_peakMax, err);
+    _peakMin = std::min(_peakMin, err);
+
+    // The loop is reverse acting. More output means more cooling, so the
+    // relay goes high when the head is hot
+    if ((_high == false) && (err > _cfg.hysteresis)) {
+        _high = true;
+        _rises++;
+
+        // The first full cycle still carries the start transient
+        if (_rises > 2) {
+            const double period = _t - _lastRise;
+            const double amplitude = 0.5 * (_peakMax - _peakMin);
+
+            // Start averaging again if the oscillation hasn't settled
+            const bool consistent = (_cycles > 0) &&
+                                    (std::fabs(period - _period) <= _cfg.tolerance * _period) &&
+                                    (std::fabs(amplitude - _amplitude) <= _cfg.tolerance * _amplitude);
+            if (consistent == false) {
+                _cycles = 0;
+                _periodSum = 0.0;
+                _amplitudeSum = 0.0;
+            }
+
+            _period = period;
+            _amplitude = amplitude;
+            _periodSum += period;
+            _amplitudeSum += amplitude;
+            _cycles++;
+        }
+
+        _lastRise = _t;
+        _peakMax = err;
+        _peakMin = err;
+
+        if (_cycles >= _cfg.cycles) {
+            _finish(_steps / _dtSum);
+            return _bias;
+        }
+    } else if (_high && (err < -_cfg.hysteresis)) {
+        _high = false;
+    }
+
+    return _high ? _bias + _cfg.relayAmplitude : _bias - _cfg.relayAmplitude;
+}
+
+void RelayAutotuner::_finish(double sampleFreq)
+{
+    const double period = _periodSum / _cycles;
+    const double amplitude = _amplitudeSum / _cycles;
+
+    // Describing function of a relay with hysteresis
+    if (amplitude <= _cfg.hysteresis) {
+        _fail("the oscillation was inside the hysteresis band");
+        return;
+    }
+
+    const double ultimateGain = 4.0 * _cfg.relayAmplitude / (M_PI * std::sqrt(amplitude * amplitude - _cfg.hysteresis * _cfg.hysteresis));
+    _result = computeTuning(ultimateGain, period, _cfg.rule, sampleFreq);
+    _result.amplitude = amplitude;
+    _state = State::DONE;
+
+    ESP_LOGI(RelayAutotuner::Name, "Ultimate gain %.2f, period %.1f s. Proposed P %.3f, I %.5f, D %.3f",
+             _result.ultimateGain, _result.ultimatePeriod, _result.PGain, _result.IGain, _result.DGain);
+}
+
+void RelayAutotuner::_fail(const char* reason)
+{
+    ESP_LOGW(RelayAutotuner::Name, "Relay experiment was abandoned after %.0f s because %s", _t, reason);
+    _state = State::FAILED;
+}
+
+RelayTuning RelayAutotuner::computeTuning(double ultimateGain, double ultimatePeriod, TuningRule rule, double sampleFreq)
+{
+    // Proportional gain and integral and derivative times as fractions of
+    // the ultimate gain and period
+    double kp = 0.0;
+    double ti = 0.0;
+    double td = 0.0;
+    switch (rule)
+    {
+        case (TuningRule::ZIEGLER_NICHOLS):
+            kp = 0.6;
+            ti = 0.5;
+            td = 0.125;
+            break;
+        case (TuningRule::NO_OVERSHOOT):
+            kp = 0.2;
+            ti = 0.5;
+            td = 1.0 / 3.0;
+            break;
+        case (TuningRule::TYREUS_LUYBEN):
+        default:
+            kp = 1.0 / 2.2;
+            ti = 2.2;
+            td = 1.0 / 6.3;
+            break;
+    }
+
+    RelayTuning tuning {};
+    tuning.ultimateGain = ultimateGain;
+    tuning.ultimatePeriod = ultimatePeriod;
+    tuning.PGain = kp * ultimateGain;
+    tuning.IGain = tuning.PGain / (ti * ultimatePeriod);
+    tuning.DGain = tuning.PGain * td * ultimatePeriod;
+
+    // Filter the derivative well below the sample rate
+    tuning.LPFcutoffFreq = std::min(DerivativeFilterN / (2.0 * M_PI * td * ultimatePeriod), 0.4 * sampleFreq);
+
+    return tuning;
+}
+
+PBRet RelayAutotuner::checkInputs(const RelayAutotunerConfig& cfg)
+{
+    if (cfg.relayAmplitude <= 0.0) {
+        ESP_LOGE(RelayAutotuner::Name, "Relay amplitude (%.2f) must be positive", cfg.relayAmplitude);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.hysteresis < 0.0) {
+        ESP_LOGE(RelayAutotuner::Name, "Hysteresis (%.2f) must not be negative", cfg.hysteresis);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.cycles < 1) {
+        ESP_LOGE(RelayAutotuner::Name, "Cycles (%d) must be at least 1", cfg.cycles);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.tolerance <= 0.0) {
+        ESP_LOGE(RelayAutotuner::Name, "Tolerance (%.2f) must be positive", cfg.tolerance);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.maxDuration <= 0.0) {
+        ESP_LOGE(RelayAutotuner::Name, "Max duration (%.1f) must be positive", cfg.maxDuration);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.maxDeviation <= cfg.hysteresis) {
+        ESP_LOGE(RelayAutotuner::Name, "Max deviation (%.2f) must be larger than the hysteresis", cfg.maxDeviation);
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet RelayAutotuner::loadFromJSON(RelayAutotunerConfig& cfg, const cJSON* cfgRoot)
+{
+    // Load RelayAutotunerConfig struct from JSON
+
+    if (cfgRoot == nullptr) {
+        ESP_LOGW(RelayAutotuner::Name, "cfgRoot was null");
+        return PBRet::FAILURE;
+    }
+
+    // Get relay amplitude
+    cJSON* relayAmplitudeNode = cJSON_GetObjectItem(cfgRoot, "relayAmplitude");
+    if (cJSON_IsNumber(relayAmplitudeNode)) {
+        cfg.relayAmplitude = relayAmplitudeNode->valuedouble;
+    } else {
+        ESP_LOGI(RelayAutotuner::Name, "Unable to read relay amplitude from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get hysteresis
+    cJSON* hysteresisNode = cJSON_GetObjectItem(cfgRoot, "hysteresis");
+    if (cJSON_IsNumber(hysteresisNode)) {
+        cfg.hysteresis = hysteresisNode->valuedouble;
+    } else {
+        ESP_LOGI(RelayAutotuner::Name, "Unable to read hysteresis from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get cycles
+    cJSON* cyclesNode = cJSON_GetObjectItem(cfgRoot, "cycles");
+    if (cJSON_IsNumber(cyclesNode)) {
+        cfg.cycles = cyclesNode->valueint;
+    } else {
+        ESP_LOGI(RelayAutotuner::Name, "Unable to read cycles from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get tolerance
+    cJSON* toleranceNode = cJSON_GetObjectItem(cfgRoot, "tolerance");
+    if (cJSON_IsNumber(toleranceNode)) {
+        cfg.tolerance = toleranceNode->valuedouble;
+    } else {
+        ESP_LOGI(RelayAutotuner::Name, "Unable to read tolerance from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get max duration
+    cJSON* maxDurationNode = cJSON_GetObjectItem(cfgRoot, "maxDuration");
+    if (cJSON_IsNumber(maxDurationNode)) {
+        cfg.maxDuration = maxDurationNode->valuedouble;
+    } else {
+        ESP_LOGI(RelayAutotuner::Name, "Unable to read max duration from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get max deviation
+    cJSON* maxDeviationNode = cJSON_GetObjectItem(cfgRoot, "maxDeviation");
+    if (cJSON_IsNumber(maxDeviationNode)) {
+        cfg.maxDeviation = maxDeviationNode->valuedouble;
+    } else {
+        ESP_LOGI(RelayAutotuner::Name, "Unable to read max deviation from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get tuning rule
+    cJSON* ruleNode = cJSON_GetObjectItem(cfgRoot, "tuningRule");
+    if (cJSON_IsString(ruleNode) == false) {
+        ESP_LOGI(RelayAutotuner::Name, "Unable to read tuning rule from JSON");
+        return PBRet::FAILURE;
+    }
+
+    if (strcmp(ruleNode->valuestring, "zieglerNichols") == 0) {
+        cfg.rule = TuningRule::ZIEGLER_NICHOLS;
+    } else if (strcmp(ruleNode->valuestring, "tyreusLuyben") == 0) {
+        cfg.rule = TuningRule::TYREUS_LUYBEN;
+    } else if (strcmp(ruleNode->valuestring, "noOvershoot") == 0) {
+        cfg.rule = TuningRule::NO_OVERSHOOT;
+    } else {
+        ESP_LOGI(RelayAutotuner::Name, "Tuning rule %s is unknown", ruleNode->valuestring);
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
@@ -0,0 +1,107 @@
+#ifndef MAIN_AUTOTUNER_H
+#define MAIN_AUTOTUNER_H
+
+#include "PBCommon.h"
+#include "cJSON.h"
+
+enum class TuningRule
+{
+    ZIEGLER_NICHOLS,        // Fast, around 25% overshoot
+    TYREUS_LUYBEN,          // Less aggressive, suits slow thermal plants
+    NO_OVERSHOOT
+};
+
+struct RelayAutotunerConfig
+{
+    double relayAmplitude = 0.0;    // Output step either side of the bias [pump speed]
+    double hysteresis = 0.0;        // Error band the relay switches outside of [deg C]
+    int cycles = 0;                 // Oscillations measured after the first
+    double tolerance = 0.0;         // Allowed spread in period and amplitude between cycles [fraction]
+    double maxDuration = 0.0;       // Experiment is abandoned after this long [s]
+    double maxDeviation = 0.0;      // Experiment is abandoned if the error exceeds this [deg C]
+    TuningRule rule = TuningRule::TYREUS_LUYBEN;
+};
+
+// Ultimate gain and period from the experiment and the tuning they give.
+// Gains are in the units Controller uses: output [pump speed] per deg C
+struct RelayTuning
+{
+    double ultimateGain = 0.0;      // [pump speed / deg C]
+    double ultimatePeriod = 0.0;    // [s]
+    double amplitude = 0.0;         // Half peak to peak of the oscillation [deg C]
+    double PGain = 0.0;
+    double IGain = 0.0;
+    double DGain = 0.0;
+    double LPFcutoffFreq = 0.0;     // Derivative filter cutoff [Hz]
+};
+
+// Relay feedback (Astrom-Hagglund) autotuner. The output switches between
+// bias +/- relayAmplitude each time the error crosses the hysteresis band,
+// which drives the loop into a limit cycle at its ultimate period. The
+// describing function of the relay gives the ultimate gain from the
+// amplitude of the oscillation
+class RelayAutotuner
+{
+    static constexpr const char* Name = "RelayAutotuner";
+
+    public:
+        static constexpr double DerivativeFilterN = 10.0;   // Derivative filter cutoff is N / (2 pi Td)
+
+        enum class State { IDLE, RUNNING, DONE, FAILED };
+
+        RelayAutotuner(void) = default;
+        RelayAutotuner(const RelayAutotunerConfig& cfg, double outputMin, double outputMax);
+
+        // Start around the current output. The bias is moved in from the
+        // limits so the relay stays symmetric
+        PBRet start(double bias);
+        void cancel(void);
+
+        // Step the experiment with the current error (measurement -
+        // setpoint). Returns the output to apply
+        double update(double err, double dt);
+
+        State getState(void) const { return _state; }
+        bool isRunning(void) const { return _state == State::RUNNING; }
+        const RelayTuning& getResult(void) const { return _result; }
+        double getBias(void) const { return _bias; }
+        double getElapsed(void) const { return _t; }
+        int getCycles(void) const { return _cycles; }
+
+        // Tuning from the ultimate gain and period. sampleFreq bounds the
+        // derivative filter cutoff [Hz]
+        static RelayTuning computeTuning(double ultimateGain, double ultimatePeriod, TuningRule rule, double sampleFreq);
+
+        static PBRet checkInputs(const RelayAutotunerConfig& cfg);
+        static PBRet loadFromJSON(RelayAutotunerConfig& cfg, const cJSON* cfgRoot);
+        bool isConfigured(void) const { return _configured; }
+
+    private:
+        void _finish(double sampleFreq);
+        void _fail(const char* reason);
+
+        RelayAutotunerConfig _cfg {};
+        double _outputMin = 0.0;
+        double _outputMax = 0.0;
+        State _state = State::IDLE;
+        RelayTuning _result {};
+
+        double _bias = 0.0;
+        double _t = 0.0;                    // Time since start [s]
+        double _dtSum = 0.0;                // For the mean sample rate
+        size_t _steps = 0;
+        bool _high = false;                 // Relay output is above bias
+        int _rises = 0;                     // Switches to high so far
+        double _lastRise = 0.0;             // Time of the last switch to high [s]
+        double _peakMax = 0.0;              // Extremes of the error this cycle [deg C]
+        double _peakMin = 0.0;
+        int _cycles = 0;                    // Complete oscillations measured
+        double _period = 0.0;               // Most recent [s]
+        double _amplitude = 0.0;            // Most recent [deg C]
+        double _periodSum = 0.0;
+        double _amplitudeSum = 0.0;
+
+        bool _configured = false;
+};
+
+#endif // MAIN_AUTOTUNER_H
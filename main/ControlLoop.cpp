@@ -0,0 +1,337 @@
+#include "ControlLoop.h"
+#include <cstring>
+
+ControlTimer::~ControlTimer(void)
+{
+    stop();
+}
+
+PBRet ControlTimer::start(TaskHandle_t task, double period)
+{
+    if (_timer != nullptr) {
+        ESP_LOGW(ControlTimer::Name, "Timer is already running");
+        return PBRet::FAILURE;
+    }
+
+    if ((task == NULL) || (period <= 0.0)) {
+        ESP_LOGE(ControlTimer::Name, "Cannot start timer with period %.4f", period);
+        return PBRet::FAILURE;
+    }
+
+    _task = task;
+    const esp_timer_create_args_t timerArgs = {
+        .callback = &ControlTimer::_timerCB,
+        .arg = static_cast<void*>(this),
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = ControlTimer::Name
+    };
+
+    if (esp_timer_create(&timerArgs, &_timer) != ESP_OK) {
+        ESP_LOGE(ControlTimer::Name, "Failed to create timer");
+        _timer = nullptr;
+        return PBRet::FAILURE;
+    }
+
+    if (esp_timer_start_periodic(_timer, static_cast<uint64_t>(period * 1e6)) != ESP_OK) {
+        ESP_LOGE(ControlTimer::Name, "Failed to start timer");
+        esp_timer_delete(_timer);
+        _timer = nullptr;
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet ControlTimer::stop(void)
+{
+    if (_timer == nullptr) {
+        return PBRet::SUCCESS;
+    }
+
+    esp_timer_stop(_timer);
+    if (esp_timer_delete(_timer) != ESP_OK) {
+        ESP_LOGW(ControlTimer::Name, "Failed to delete timer");
+        return PBRet::FAILURE;
+    }
+
+    _timer = nullptr;
+    return PBRet::SUCCESS;
+}
+
+uint32_t ControlTimer::wait(TickType_t timeout) const
+{
+    // Each expiry gives the task a notification. Taking them all at once
+    // counts the expiries since the last wait
+    return ulTaskNotifyTake(pdTRUE, timeout);
+}
+
+void ControlTimer::_timerCB(void* arg)
+{
+    // Runs in the esp_timer task, not an ISR
+    ControlTimer* timer = static_cast<ControlTimer*>(arg);
+    xTaskNotifyGive(timer->_task);
+}
+
+LoopTiming::LoopTiming(double period, double jitterBinWidth, double execBinWidth)
+    : _period(static_cast<int64_t>(period * 1e6)), _startJitter(jitterBinWidth), _execTime(execBinWidth)
+{}
+
+void LoopTiming::start(int64_t t)
+{
+    _scheduled = t;
+    _cycleStart = t;
+    _started = true;
+}
+
+double LoopTiming::startCycle(int64_t t, uint32_t periods)
+{
+    // Advance the ideal schedule by the periods the timer has counted and
+    // measure how late this cycle started against it
+
+    if (_started == false) {
+        start(t);
+        return getPeriod();
+    }
+
+    const double dt = (t - _cycleStart) * 1e-6;
+    _cycleStart = t;
+    _dtStats.add(dt);
+
+    // Timed out without the timer firing. There is nothing to measure
+    // against
+    if (periods == 0) {
+        return dt;
+    }
+
+    _scheduled += static_cast<int64_t>(periods) * _period;
+    _missedCycles += periods - 1;
+
+    const double jitter = std::max<int64_t>(t - _scheduled, 0) * 1e-6;
+    _startJitter.add(jitter);
+    _startJitterStats.add(jitter);
+
+    return dt;
+}
+
+void LoopTiming::endCycle(int64_t t)
+{
+    if (_started == false) {
+        return;
+    }
+
+    const double execTime = (t - _cycleStart) * 1e-6;
+    _execTime.add(execTime);
+    _execTimeStats.add(execTime);
+}
+
+void LoopTiming::reset(void)
+{
+    _startJitter.reset();
+    _execTime.reset();
+    _startJitterStats.reset();
+    _execTimeStats.reset();
+    _dtStats.reset();
+    _missedCycles = 0;
+}
+
+ControlBudget::ControlBudget(const ControlBudgetConfig& cfg, uint32_t cpuFreq)
+    : _cfg(cfg)
+{
+    if (checkInputs(cfg) != PBRet::SUCCESS) {
+        return;
+    }
+
+    // Budgets are compared in cycles so the step itself does no floating
+    // point. They must fit the 32 bit counter
+    if ((cpuFreq == 0) || (cfg.budget * cpuFreq >= UINT32_MAX)) {
+        ESP_LOGE(ControlBudget::Name, "Budget (%.3f) can't be measured at %u Hz", cfg.budget, cpuFreq);
+        return;
+    }
+
+    _secondsPerCycle = 1.0 / cpuFreq;
+    _budget = static_cast<uint32_t>(cfg.budget * cpuFreq);
+    for (size_t i = 0; i < ControlPhaseCount; i++) {
+        _phaseBudgets[i] = static_cast<uint32_t>(cfg.phaseBudgets[i] * cpuFreq);
+    }
+
+    _configured = true;
+}
+
+void ControlBudget::startCycle(uint32_t ccount)
+{
+    _cycleStart = ccount;
+    _phaseStart = ccount;
+    _phaseTime.fill(0);
+    _cycles++;
+}
+
+void ControlBudget::endPhase(ControlPhase phase, uint32_t ccount)
+{
+    // Phases run back to back, so each one ends where the next begins.
+    // Unsigned subtraction handles a single counter wrap
+    _phaseTime[static_cast<size_t>(phase)] = ccount - _phaseStart;
+    _phaseStart = ccount;
+}
+
+bool ControlBudget::endCycle(void)
+{
+    if (_configured == false) {
+        return false;
+    }
+
+    uint32_t total = 0;
+    for (size_t i = 0; i < ControlPhaseCount; i++) {
+        total += _phaseTime[i];
+        _worstCase[i] = std::max(_worstCase[i], _phaseTime[i]);
+        if (_phaseTime[i] > _phaseBudgets[i]) {
+            _overruns[i]++;
+        }
+    }
+    _worstCycle = std::max(_worstCycle, total);
+
+    const bool overrun = total > _budget;
+    if (overrun) {
+        _cycleOverruns++;
+        _consecutiveOverruns++;
+        _consecutiveGood = 0;
+    } else {
+        _consecutiveGood++;
+        _consecutiveOverruns = 0;
+    }
+
+    // Persistent overruns degrade the loop or raise the alarm. The same
+    // number of good steps in a row clears it
+    bool& state = (_cfg.action == OverrunAction::ALARM) ? _alarmed : _degraded;
+    if ((_cfg.action != OverrunAction::SKIP_BROADCAST) && (state == false) && (_consecutiveOverruns >= _cfg.degradeCycles)) {
+        state = true;
+    } else if (state && (_consecutiveGood >= _cfg.degradeCycles)) {
+        state = false;
+    }
+
+    return overrun;
+}
+
+bool ControlBudget::shouldBroadcast(uint32_t ccount) const
+{
+    if ((_configured == false) || (_cfg.action == OverrunAction::ALARM)) {
+        return true;
+    }
+
+    if (_degraded && ((_cycles % DegradedBroadcastDivider) != 0)) {
+        return false;
+    }
+
+    // Assume the broadcast takes its whole budget
+    const uint32_t elapsed = ccount - _cycleStart;
+    return (elapsed + _phaseBudgets[static_cast<size_t>(ControlPhase::BROADCAST)]) <= _budget;
+}
+
+void ControlBudget::reset(void)
+{
+    _worstCase.fill(0);
+    _overruns.fill(0);
+    _worstCycle = 0;
+    _cycleOverruns = 0;
+    _skippedBroadcasts = 0;
+}
+
+PBRet ControlBudget::checkInputs(const ControlBudgetConfig& cfg)
+{
+    if (cfg.budget <= 0.0) {
+        ESP_LOGE(ControlBudget::Name, "Budget (%.3f) must be positive", cfg.budget);
+        return PBRet::FAILURE;
+    }
+
+    for (size_t i = 0; i < ControlPhaseCount; i++) {
+        if ((cfg.phaseBudgets[i] <= 0.0) || (cfg.phaseBudgets[i] > cfg.budget)) {
+            ESP_LOGE(ControlBudget::Name, "%s budget (%.3f) must be positive and within the step budget",
+                     getPhaseName(static_cast<ControlPhase>(i)), cfg.phaseBudgets[i]);
+            return PBRet::FAILURE;
+        }
+    }
+
+    if (cfg.degradeCycles < 1) {
+        ESP_LOGE(ControlBudget::Name, "Degrade cycles (%d) must be at least 1", cfg.degradeCycles);
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet ControlBudget::loadFromJSON(ControlBudgetConfig& cfg, const cJSON* cfgRoot)
+{
+    // Load ControlBudgetConfig struct from JSON
+
+    if (cfgRoot == nullptr) {
+        ESP_LOGW(ControlBudget::Name, "cfgRoot was null");
+        return PBRet::FAILURE;
+    }
+
+    // Get step budget
+    cJSON* budgetNode = cJSON_GetObjectItem(cfgRoot, "budget");
+    if (cJSON_IsNumber(budgetNode)) {
+        cfg.budget = budgetNode->valuedouble;
+    } else {
+        ESP_LOGI(ControlBudget::Name, "Unable to read budget from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get phase budgets
+    cJSON* phaseBudgetsNode = cJSON_GetObjectItem(cfgRoot, "phaseBudgets");
+    for (size_t i = 0; i < ControlPhaseCount; i++) {
+        const char* phaseName = getPhaseName(static_cast<ControlPhase>(i));
+        cJSON* phaseNode = cJSON_GetObjectItem(phaseBudgetsNode, phaseName);
+        if (cJSON_IsNumber(phaseNode)) {
+            cfg.phaseBudgets[i] = phaseNode->valuedouble;
+        } else {
+            ESP_LOGI(ControlBudget::Name, "Unable to read %s budget from JSON", phaseName);
+            return PBRet::FAILURE;
+        }
+    }
+
+    // Get overrun action
+    cJSON* actionNode = cJSON_GetObjectItem(cfgRoot, "overrunAction");
+    if (cJSON_IsString(actionNode) == false) {
+        ESP_LOGI(ControlBudget::Name, "Unable to read overrun action from JSON");
+        return PBRet::FAILURE;
+    }
+
+    if (strcmp(actionNode->valuestring, "skipBroadcast") == 0) {
+        cfg.action = OverrunAction::SKIP_BROADCAST;
+    } else if (strcmp(actionNode->valuestring, "degrade") == 0) {
+        cfg.action = OverrunAction::DEGRADE;
+    } else if (strcmp(actionNode->valuestring, "alarm") == 0) {
+        cfg.action = OverrunAction::ALARM;
+    } else {
+        ESP_LOGI(ControlBudget::Name, "Overrun action %s is unknown", actionNode->valuestring);
+        return PBRet::FAILURE;
+    }
+
+    // Get degrade cycles
+    cJSON* degradeCyclesNode = cJSON_GetObjectItem(cfgRoot, "degradeCycles");
+    if (cJSON_IsNumber(degradeCyclesNode)) {
+        cfg.degradeCycles = degradeCyclesNode->valueint;
+    } else {
+        ESP_LOGI(ControlBudget::Name, "Unable to read degrade cycles from JSON");
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+const char* ControlBudget::getPhaseName(ControlPhase phase)
+{
+    switch (phase)
+    {
+        case (ControlPhase::CONTROL):
+            return "control";
+        case (ControlPhase::PERIPHERALS):
+            return "peripherals";
+        case (ControlPhase::PUMPS):
+            return "pumps";
+        case (ControlPhase::BROADCAST):
+            return "broadcast";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,178 @@
+#ifndef CONTROL_LOOP_H
+#define CONTROL_LOOP_H
+
+#include <array>
+#include "PBCommon.h"
+#include "Utilities.h"
+#include "cJSON.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Periodic esp_timer that wakes a task with a direct to task notification.
+// The period has microsecond resolution rather than being rounded to the
+// RTOS tick, and doesn't stretch with the time the task spends working
+class ControlTimer
+{
+    static constexpr const char* Name = "ControlTimer";
+
+    public:
+        ControlTimer(void) = default;
+        ~ControlTimer(void);
+        ControlTimer(const ControlTimer&) = delete;
+        ControlTimer& operator=(const ControlTimer&) = delete;
+
+        PBRet start(TaskHandle_t task, double period);
+        PBRet stop(void);
+
+        // Block until the timer fires. Returns the number of periods since
+        // the last call, so more than 1 means cycles were missed. Returns 0
+        // on timeout
+        uint32_t wait(TickType_t timeout) const;
+
+        bool isRunning(void) const { return _timer != nullptr; }
+
+    private:
+        static void _timerCB(void* arg);
+
+        esp_timer_handle_t _timer = nullptr;
+        TaskHandle_t _task = NULL;
+};
+
+// Timing of a periodic loop. Start jitter is how late each cycle starts
+// against the ideal schedule, execution time is how long the cycle takes.
+// Both are kept as histograms so the tail is visible, not just the mean
+class LoopTiming
+{
+    public:
+        static constexpr size_t HistogramBins = 16;
+
+        LoopTiming(void) = default;
+        LoopTiming(double period, double jitterBinWidth, double execBinWidth);
+
+        // Set the schedule from the time the timer was started
+        void start(int64_t t);
+
+        // Start a cycle woken after periods timer periods. Returns the time
+        // since the previous cycle started [s]
+        double startCycle(int64_t t, uint32_t periods);
+        void endCycle(int64_t t);
+
+        // Clear the statistics. The schedule is kept
+        void reset(void);
+
+        const Histogram<HistogramBins>& getStartJitter(void) const { return _startJitter; }
+        const Histogram<HistogramBins>& getExecTime(void) const { return _execTime; }
+        const RunningStats& getStartJitterStats(void) const { return _startJitterStats; }
+        const RunningStats& getExecTimeStats(void) const { return _execTimeStats; }
+        const RunningStats& getDtStats(void) const { return _dtStats; }
+        uint32_t getMissedCycles(void) const { return _missedCycles; }
+        double getPeriod(void) const { return _period * 1e-6; }
+
+    private:
+        int64_t _period = 0;                // [us]
+        int64_t _scheduled = 0;             // Ideal start of the current cycle [us]
+        int64_t _cycleStart = 0;            // [us]
+        bool _started = false;
+
+        Histogram<HistogramBins> _startJitter {};   // [s]
+        Histogram<HistogramBins> _execTime {};      // [s]
+        RunningStats _startJitterStats {};          // [s]
+        RunningStats _execTimeStats {};             // [s]
+        RunningStats _dtStats {};                   // [s]
+        uint32_t _missedCycles = 0;
+};
+
+// Phases of a control step, in the order they run
+enum class ControlPhase : size_t
+{
+    CONTROL,
+    PERIPHERALS,
+    PUMPS,
+    BROADCAST
+};
+
+constexpr size_t ControlPhaseCount = 4;
+
+// What the loop gives up when a step runs over budget. Control, element
+// and pump outputs always run. Every action logs the overrun
+enum class OverrunAction
+{
+    SKIP_BROADCAST,     // Skip the state broadcast once the budget is spent
+    DEGRADE,            // Also throttle broadcasts while overruns persist
+    ALARM               // Broadcast as normal and raise an alarm
+};
+
+struct ControlBudgetConfig
+{
+    double budget = 0.0;                                    // Time the phases may take together each step [s]
+    std::array<double, ControlPhaseCount> phaseBudgets {};  // [s]
+    OverrunAction action = OverrunAction::SKIP_BROADCAST;
+    int degradeCycles = 0;                                  // Consecutive overruns before degrading or alarming
+};
+
+// Execution time budget for each phase of a control step, measured with
+// the CPU cycle counter. The counter is per core and wraps every 2^32
+// cycles, so phases are only ever measured on the core the loop is
+// pinned to and must be shorter than one wrap
+class ControlBudget
+{
+    static constexpr const char* Name = "ControlBudget";
+
+    public:
+        static constexpr uint32_t DegradedBroadcastDivider = 8;     // Broadcast every nth step while degraded
+
+        ControlBudget(void) = default;
+        ControlBudget(const ControlBudgetConfig& cfg, uint32_t cpuFreq);
+
+        void startCycle(uint32_t ccount);
+        void endPhase(ControlPhase phase, uint32_t ccount);
+
+        // Returns true if the step ran over budget
+        bool endCycle(void);
+
+        // Whether the state broadcast fits in what is left of the budget
+        bool shouldBroadcast(uint32_t ccount) const;
+
+        // Clear the statistics. Degraded and alarm state are kept
+        void reset(void);
+
+        double getPhaseTime(ControlPhase phase) const { return _phaseTime[static_cast<size_t>(phase)] * _secondsPerCycle; }
+        double getWorstCase(ControlPhase phase) const { return _worstCase[static_cast<size_t>(phase)] * _secondsPerCycle; }
+        uint32_t getOverruns(ControlPhase phase) const { return _overruns[static_cast<size_t>(phase)]; }
+        double getWorstCycle(void) const { return _worstCycle * _secondsPerCycle; }
+        uint32_t getCycleOverruns(void) const { return _cycleOverruns; }
+        uint32_t getSkippedBroadcasts(void) const { return _skippedBroadcasts; }
+        bool isDegraded(void) const { return _degraded; }
+        bool isAlarmed(void) const { return _alarmed; }
+        void countSkippedBroadcast(void) { _skippedBroadcasts++; }
+
+        static PBRet checkInputs(const ControlBudgetConfig& cfg);
+        static PBRet loadFromJSON(ControlBudgetConfig& cfg, const cJSON* cfgRoot);
+        static const char* getPhaseName(ControlPhase phase);
+        bool isConfigured(void) const { return _configured; }
+
+    private:
+        ControlBudgetConfig _cfg {};
+        double _secondsPerCycle = 0.0;
+        uint32_t _budget = 0;                                       // [cycles]
+        std::array<uint32_t, ControlPhaseCount> _phaseBudgets {};   // [cycles]
+
+        uint32_t _cycleStart = 0;
+        uint32_t _phaseStart = 0;
+        std::array<uint32_t, ControlPhaseCount> _phaseTime {};      // This step [cycles]
+        std::array<uint32_t, ControlPhaseCount> _worstCase {};      // [cycles]
+        std::array<uint32_t, ControlPhaseCount> _overruns {};
+        uint32_t _worstCycle = 0;                                   // [cycles]
+        uint32_t _cycleOverruns = 0;
+        uint32_t _skippedBroadcasts = 0;
+
+        int _consecutiveOverruns = 0;
+        int _consecutiveGood = 0;
+        uint32_t _cycles = 0;
+        bool _degraded = false;
+        bool _alarmed = false;
+        bool _configured = false;
+};
+
+#endif // CONTROL_LOOP_H
@@ -1,12 +1,10 @@
 #include "esp_task_wdt.h"
+#include "esp32/clk.h"
+#include "hal/cpu_hal.h"
 #include "Controller.h"
-#include "Filesystem.h"
+#include "SettingsStore.h"
 #include "Utilities.h"
 #include "cJSON.h"
-#include <fstream>
-#include <sstream>
-#include "IO/Writable.h"
-#include "IO/Readable.h"
 
 Controller::Controller(UBaseType_t priority, UBaseType_t stackDepth, BaseType_t coreID, const ControllerConfig& cfg)
     : Task(Controller::Name, priority, stackDepth, coreID)
@@ -34,7 +32,13 @@ void Controller::taskMain(void)
         PBMessageType::ControllerTuning,
         PBMessageType::ControllerCommand,
         PBMessageType::ControllerSettings,
-        PBMessageType::ControllerDataRequest
+        PBMessageType::ControllerDataRequest,
+        PBMessageType::SensorHealth,
+        PBMessageType::AutotuneCommand,
+        PBMessageType::ControllerGainSchedule,
+        PBMessageType::ConcentrationData,
+        PBMessageType::RunBalance,
+        PBMessageType::RunPhaseCommand
     };
     Subscriber sub(Controller::Name, _GPQueue, subscriptions);
     MessageServer::registerTask(sub);
@@ -42,45 +46,114 @@ void Controller::taskMain(void)
     // Subscribe this task to the TWDT
     esp_task_wdt_add(NULL);
 
-    // Set update frequency
-    TickType_t timestep =  _cfg.dt * 1000 / portTICK_PERIOD_MS;      // TODO: Define method for converting time
-    portTickType xLastWakeTime = xTaskGetTickCount();
+    // Control steps are triggered by a hardware timer, so the period isn't
+    // rounded to the RTOS tick or stretched by the work done each step
+    if (_timer.start(xTaskGetCurrentTaskHandle(), _cfg.dt) != PBRet::SUCCESS) {
+        ESP_LOGE(Controller::Name, "Failed to start control timer. Stepping on timeout");
+    }
+    _timing.start(esp_timer_get_time());
+
+    // Elements switch on their own timer from here on
+    if (_elementDriver.start(_cfg.elementDriver, {_cfg.element1Pin, _cfg.element2Pin}) != PBRet::SUCCESS) {
+        ESP_LOGE(Controller::Name, "Failed to start element driver. Elements are off");
+    }
+    const TickType_t timeout = std::max<TickType_t>(TIMER_TIMEOUT_PERIODS * _cfg.dt * 1000 / portTICK_PERIOD_MS, 1);
 
     while (true) {
+        // Wait for the next step. The PID is fed the measured step rather
+        // than the nominal dt
+        const uint32_t periods = _timer.wait(timeout);
+        const int64_t t = esp_timer_get_time();
+        const double dt = _timing.startCycle(t, periods);
+        if (periods == 0) {
+            ESP_LOGW(Controller::Name, "Control timer did not fire");
+        } else if (periods > 1) {
+            ESP_LOGW(Controller::Name, "Control loop missed %d steps", periods - 1);
+        }
+
         // Retrieve data from the queue
         _processQueue();
 
-        // Check temperature data is valid
-        if (_checkTemperatures(_currentTemp) != PBRet::SUCCESS) {
-            ESP_LOGW(Controller::Name, "Temperatures were invalid");
-            // TODO: Implement emergency stop for cases like this
+        // Each phase of the step is timed against its budget
+        _budget.startCycle(cpu_hal_get_cycle_count());
+
+        // Step the run phase. A new phase applies its settings before the
+        // control update
+        if (_updateRunPhase(dt) != PBRet::SUCCESS) {
+            ESP_LOGW(Controller::Name, "Run phase update failed");
         }
 
-        // Update control
-        if (_doControl(_currentTemp.get_headTemp()) != PBRet::SUCCESS) {
+        // Update control. The output is held while temperatures are
+        // invalid. The safety supervisor trips the outputs independently
+        // if temperatures stay stale or too high
+        if (_stepControl(dt) != PBRet::SUCCESS) {
             ESP_LOGW(Controller::Name, "Control law update failed");
             // Send warning message to distiller controller
         }
 
+        // Publish the outcome of a relay experiment
+        if (_autotuneFinished) {
+            if (_broadcastAutotuneResult() != PBRet::SUCCESS) {
+                ESP_LOGW(Controller::Name, "Could not broadcast autotune result");
+            }
+            _autotuneFinished = false;
+        }
+        _budget.endPhase(ControlPhase::CONTROL, cpu_hal_get_cycle_count());
+
         // Update peripheral outputs
         if (_updatePeripheralState(_peripheralState) != PBRet::SUCCESS) {
             ESP_LOGW(Controller::Name, "Peripheral update failed");
         }
+        _budget.endPhase(ControlPhase::PERIPHERALS, cpu_hal_get_cycle_count());
 
         // Command pumps
         if (_updatePumps() != PBRet::SUCCESS) {
             ESP_LOGW(Controller::Name, "Pump speeds were not updated");
         }
 
-        // Broadcast controller state
-        if (_broadcastControllerState() != PBRet::SUCCESS) {
-            ESP_LOGW(Controller::Name, "Could not broadcast controller state");
+        // Report the outputs straight to the safety supervisor. It treats
+        // a gap in these as the controller having stopped
+        const bool elementsOn = (SafetySupervisor::isTripped() == false) &&
+                                ((_peripheralState.LPElementDutyCycle() > 0.0) || (_peripheralState.HPElementDutyCycle() > 0.0));
+        SafetySupervisor::reportOutputs(_refluxPump.getPumpSpeed(), _productPump.getPumpSpeed(), elementsOn, esp_timer_get_time());
+        _budget.endPhase(ControlPhase::PUMPS, cpu_hal_get_cycle_count());
+
+        // Broadcast controller state. This is the first thing dropped when
+        // the step is running late
+        if (_budget.shouldBroadcast(cpu_hal_get_cycle_count())) {
+            if (_broadcastControllerState() != PBRet::SUCCESS) {
+                ESP_LOGW(Controller::Name, "Could not broadcast controller state");
+            }
+        } else {
+            _budget.countSkippedBroadcast();
+        }
+        _budget.endPhase(ControlPhase::BROADCAST, cpu_hal_get_cycle_count());
+
+        const bool wasAlarmed = _budget.isAlarmed();
+        if (_budget.endCycle()) {
+            ESP_LOGW(Controller::Name, "Control step overran its budget (control %.1f ms, peripherals %.1f ms, pumps %.1f ms, broadcast %.1f ms)",
+                     _budget.getPhaseTime(ControlPhase::CONTROL) * 1e3, _budget.getPhaseTime(ControlPhase::PERIPHERALS) * 1e3,
+                     _budget.getPhaseTime(ControlPhase::PUMPS) * 1e3, _budget.getPhaseTime(ControlPhase::BROADCAST) * 1e3);
         }
 
         // Feed the TWDT
         esp_task_wdt_reset();
-        
-        vTaskDelayUntil(&xLastWakeTime, timestep);
+
+        // Publish timing over the last window, then start a new one. A new
+        // overrun alarm is published straight away
+        _timing.endCycle(esp_timer_get_time());
+        const bool alarmRaised = (wasAlarmed == false) && _budget.isAlarmed();
+        if (alarmRaised) {
+            ESP_LOGE(Controller::Name, "Control loop is persistently overrunning its budget");
+        }
+
+        if (_timingPublishRate.isDue(t) || alarmRaised) {
+            if (_broadcastControllerTiming() != PBRet::SUCCESS) {
+                ESP_LOGW(Controller::Name, "Could not broadcast controller timing");
+            }
+            _timing.reset();
+            _budget.reset();
+        }
     }
 }
 
@@ -90,6 +163,136 @@ PBRet Controller::_temperatureDataCB(std::shared_ptr<PBMessageWrapper> msg)
     return MessageServer::unwrap(*msg, _currentTemp); 
 }
 
+PBRet Controller::_sensorHealthCB(std::shared_ptr<PBMessageWrapper> msg)
+{
+    // A failed head sensor is replaced by its backup within the same
+    // sensor read. Only stop trusting the head temperature when no healthy
+    // sensor is left
+
+    SensorHealth health {};
+    if (MessageServer::unwrap(*msg, health) != PBRet::SUCCESS) {
+        ESP_LOGW(Controller::Name, "Failed to decode SensorHealth message");
+        return PBRet::FAILURE;
+    }
+
+    if (health.get_role() == DS18B20Role::HEAD_TEMP) {
+        _headSensorHealthy = health.get_roleHealthy();
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet Controller::_autotuneCommandCB(std::shared_ptr<PBMessageWrapper> msg)
+{
+    AutotuneCommand cmd {};
+    if (MessageServer::unwrap(*msg, cmd) != PBRet::SUCCESS) {
+        ESP_LOGW(Controller::Name, "Failed to decode autotune command");
+        return PBRet::FAILURE;
+    }
+
+    if (cmd.get_start()) {
+        return _startAutotune();
+    }
+
+    // Cancelled. The PID picks up from the relay bias on the next step
+    if (_autotuner.isRunning()) {
+        _autotuner.cancel();
+        _integral = _autotuner.getBias() - _activePGain * _prevError - _computeFeedforward();
+        _autotuneFinished = true;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet Controller::_gainScheduleCB(std::shared_ptr<PBMessageWrapper> msg)
+{
+    PBGainSchedule schedule {};
+    if (MessageServer::unwrap(*msg, schedule) != PBRet::SUCCESS) {
+        ESP_LOGW(Controller::Name, "Failed to decode gain schedule");
+        return PBRet::FAILURE;
+    }
+
+    GainScheduleConfig cfg {};
+    if ((_gainScheduleFromMessage(schedule, cfg) != PBRet::SUCCESS) || (_setGainSchedule(cfg) != PBRet::SUCCESS)) {
+        ESP_LOGW(Controller::Name, "Gain schedule was not updated");
+        return PBRet::FAILURE;
+    }
+
+    // Save gain schedule
+    if (saveGainSchedule() != PBRet::SUCCESS) {
+        ESP_LOGW(Controller::Name, "Unable to save gain schedule");
+    }
+
+    if (_broadcastGainSchedule() != PBRet::SUCCESS) {
+        ESP_LOGW(Controller::Name, "Failed to broadcast gain schedule");
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet Controller::_concentrationDataCB(std::shared_ptr<PBMessageWrapper> msg)
+{
+    // Store the concentration estimates used by the run phase transitions
+    ConcentrationData concData {};
+    if (MessageServer::unwrap(*msg, concData) != PBRet::SUCCESS) {
+        ESP_LOGW(Controller::Name, "Failed to decode ConcentrationData message");
+        return PBRet::FAILURE;
+    }
+
+    _phaseInputs.vapourABV = concData.get_vapourConcentration();
+    _phaseInputs.boilerABV = concData.get_boilerConcentration();
+
+    return PBRet::SUCCESS;
+}
+
+PBRet Controller::_runBalanceCB(std::shared_ptr<PBMessageWrapper> msg)
+{
+    // Store the product collected so far for the run phase transitions
+    RunBalance balance {};
+    if (MessageServer::unwrap(*msg, balance) != PBRet::SUCCESS) {
+        ESP_LOGW(Controller::Name, "Failed to decode RunBalance message");
+        return PBRet::FAILURE;
+    }
+
+    _phaseInputs.productVolume = balance.get_productVolume();
+
+    return PBRet::SUCCESS;
+}
+
+PBRet Controller::_runPhaseCommandCB(std::shared_ptr<PBMessageWrapper> msg)
+{
+    RunPhaseCommand cmd {};
+    if (MessageServer::unwrap(*msg, cmd) != PBRet::SUCCESS) {
+        ESP_LOGW(Controller::Name, "Failed to decode run phase command");
+        return PBRet::FAILURE;
+    }
+
+    PBRet ret = PBRet::SUCCESS;
+    switch (cmd.get_command())
+    {
+        case (RunPhaseCommandType::START):
+            // The ramp into the first phase starts from the setpoint in use
+            ret = _runPhase.start(_ctrlTuning.setpoint());
+            break;
+        case (RunPhaseCommandType::STOP):
+            _runPhase.stop();
+            break;
+        case (RunPhaseCommandType::JUMP):
+            ret = _runPhase.jumpTo(static_cast<RunPhase>(cmd.get_phase()));
+            break;
+        default:
+            ESP_LOGW(Controller::Name, "Run phase command %d is not supported", static_cast<int>(cmd.get_command()));
+            return PBRet::FAILURE;
+    }
+
+    // Settings for a new phase are applied on the next step
+    if (_broadcastRunPhaseState() != PBRet::SUCCESS) {
+        ESP_LOGW(Controller::Name, "Failed to broadcast run phase state");
+    }
+
+    return ret;
+}
+
 PBRet Controller::_controlCommandCB(std::shared_ptr<PBMessageWrapper> msg)
 {
     _peripheralState.clear();   // Reset defaults
@@ -97,13 +300,13 @@ PBRet Controller::_controlCommandCB(std::shared_ptr<PBMessageWrapper> msg)
         ESP_LOGW(Controller::Name, "Failed to decode control command message");
     }
 
-    // Update PWM drivers
-    if (_LPElementPWM.setDutyCycle(_peripheralState.LPElementDutyCycle()) != PBRet::SUCCESS) {
+    // Update element duties
+    if (_elementDriver.setDuty(Element::LP, _peripheralState.LPElementDutyCycle()) != PBRet::SUCCESS) {
         ESP_LOGW(Controller::Name, "Failed to update LPElement duty cycle");
         return PBRet::FAILURE;
     }
 
-    if (_HPElementPWM.setDutyCycle(_peripheralState.HPElementDutyCycle()) != PBRet::SUCCESS) {
+    if (_elementDriver.setDuty(Element::HP, _peripheralState.HPElementDutyCycle()) != PBRet::SUCCESS) {
         ESP_LOGW(Controller::Name, "Failed to update HPElement duty cycle");
         return PBRet::FAILURE;
     }
@@ -121,6 +324,12 @@ PBRet Controller::_controlSettingsCB(std::shared_ptr<PBMessageWrapper> msg)
 
     ESP_LOGI(Controller::Name, "Controller settings were updated");
 
+    // The relay experiment needs the reflux pump
+    if (_autotuner.isRunning() && (_ctrlSettings.get_refluxPumpMode() != PumpMode::ACTIVE_CONTROL)) {
+        _autotuner.cancel();
+        _autotuneFinished = true;
+    }
+
     return _updatePumps();
 }
 
@@ -140,13 +349,18 @@ PBRet Controller::_controlTuningCB(std::shared_ptr<PBMessageWrapper> msg)
         return PBRet::FAILURE;
     }
 
+    if ((tuning.get_controlLaw() == ControlLaw::MPC) && (_mpc.isConfigured() == false)) {
+        ESP_LOGW(Controller::Name, "MPC is not configured. Tuning was not updated");
+        return PBRet::FAILURE;
+    }
+
     // Can safely update tuning now
     _ctrlTuning = tuning;
     ESP_LOGI(Controller::Name, "Controller tuning was updated");
 
-    // Write controller tuning to file
-    if (saveTuningToFile() != PBRet::SUCCESS) {
-        ESP_LOGW(Controller::Name, "Unable to save controller tuning to file");
+    // Save controller tuning
+    if (saveTuning() != PBRet::SUCCESS) {
+        ESP_LOGW(Controller::Name, "Unable to save controller tuning");
     }
 
     if (_broadcastControllerTuning() != PBRet::SUCCESS) {
@@ -186,6 +400,16 @@ PBRet Controller::_controlDataRequestCB(std::shared_ptr<PBMessageWrapper> msg)
             ESP_LOGI(Controller::Name, "Got request for controller peripheral state");
             return _broadcastControllerPeripheralState();
         }
+        case (ControllerDataRequestType::GAIN_SCHEDULE):
+        {
+            ESP_LOGI(Controller::Name, "Got request for controller gain schedule");
+            return _broadcastGainSchedule();
+        }
+        case (ControllerDataRequestType::RUN_PHASE):
+        {
+            ESP_LOGI(Controller::Name, "Got request for run phase state");
+            return _broadcastRunPhaseState();
+        }
         case (ControllerDataRequestType::NONE):
         {
             ESP_LOGW(Controller::Name, "Cannot respond to request for data None");
@@ -209,7 +433,13 @@ PBRet Controller::_setupCBTable(void)
         {PBMessageType::ControllerCommand, std::bind(&Controller::_controlCommandCB, this, std::placeholders::_1)},
         {PBMessageType::ControllerSettings, std::bind(&Controller::_controlSettingsCB, this, std::placeholders::_1)},
         {PBMessageType::ControllerTuning, std::bind(&Controller::_controlTuningCB, this, std::placeholders::_1)},
-        {PBMessageType::ControllerDataRequest, std::bind(&Controller::_controlDataRequestCB, this, std::placeholders::_1)}
+        {PBMessageType::ControllerDataRequest, std::bind(&Controller::_controlDataRequestCB, this, std::placeholders::_1)},
+        {PBMessageType::SensorHealth, std::bind(&Controller::_sensorHealthCB, this, std::placeholders::_1)},
+        {PBMessageType::AutotuneCommand, std::bind(&Controller::_autotuneCommandCB, this, std::placeholders::_1)},
+        {PBMessageType::ControllerGainSchedule, std::bind(&Controller::_gainScheduleCB, this, std::placeholders::_1)},
+        {PBMessageType::ConcentrationData, std::bind(&Controller::_concentrationDataCB, this, std::placeholders::_1)},
+        {PBMessageType::RunBalance, std::bind(&Controller::_runBalanceCB, this, std::placeholders::_1)},
+        {PBMessageType::RunPhaseCommand, std::bind(&Controller::_runPhaseCommandCB, this, std::placeholders::_1)}
     };
 
     return PBRet::SUCCESS;
@@ -246,6 +476,7 @@ PBRet Controller::_broadcastControllerState(void) const
     state.set_propOutput(_proportional);
     state.set_integralOutput(_integral);
     state.set_derivOutput(_derivative);
+    state.set_feedforwardOutput(_feedforwardOutput);
     state.set_totalOutput(_currentOutput);
     state.set_timeStamp(esp_timer_get_time());
 
@@ -254,6 +485,41 @@ PBRet Controller::_broadcastControllerState(void) const
     return MessageServer::broadcastMessage(wrapped);
 }
 
+PBRet Controller::_broadcastControllerTiming(void) const
+{
+    // Send a ControllerTiming message to the queue
+    PBControllerTiming timing {};
+    timing.set_period(_timing.getPeriod());
+    timing.set_meanDt(_timing.getDtStats().mean());
+    timing.set_maxDt(_timing.getDtStats().max());
+    timing.set_meanStartJitter(_timing.getStartJitterStats().mean());
+    timing.set_maxStartJitter(_timing.getStartJitterStats().max());
+    timing.set_meanExecTime(_timing.getExecTimeStats().mean());
+    timing.set_maxExecTime(_timing.getExecTimeStats().max());
+    timing.set_missedCycles(_timing.getMissedCycles());
+    timing.set_startJitterBinWidth(_timing.getStartJitter().getBinWidth());
+    timing.set_execTimeBinWidth(_timing.getExecTime().getBinWidth());
+    for (size_t i = 0; i < LoopTiming::HistogramBins; i++) {
+        timing.add_startJitter(_timing.getStartJitter().at(i));
+        timing.add_execTime(_timing.getExecTime().at(i));
+    }
+    timing.set_budget(_cfg.budgetConfig.budget);
+    timing.set_maxStepTime(_budget.getWorstCycle());
+    timing.set_stepOverruns(_budget.getCycleOverruns());
+    timing.set_skippedBroadcasts(_budget.getSkippedBroadcasts());
+    timing.set_degraded(_budget.isDegraded());
+    timing.set_overrunAlarm(_budget.isAlarmed());
+    for (size_t i = 0; i < ControlPhaseCount; i++) {
+        timing.add_phaseMaxTime(_budget.getWorstCase(static_cast<ControlPhase>(i)));
+        timing.add_phaseOverruns(_budget.getOverruns(static_cast<ControlPhase>(i)));
+    }
+    timing.set_timeStamp(esp_timer_get_time());
+
+    PBMessageWrapper wrapped = MessageServer::wrap(timing, PBMessageType::ControllerTiming, _ID);
+
+    return MessageServer::broadcastMessage(wrapped);
+}
+
 PBRet Controller::_initIO(const ControllerConfig& cfg) const
 {
     esp_err_t err = ESP_OK;
@@ -330,52 +596,109 @@ PBRet Controller::_initPumps(const PumpConfig& refluxPumpConfig, const PumpConfi
     return PBRet::SUCCESS;
 }
 
-PBRet Controller::_initPWM(const SlowPWMConfig& LPElementCfg, const SlowPWMConfig& HPElementCfg)
+PBRet Controller::_stepControl(double dt)
 {
-    // Initialize SlowPWM drivers
-
-    _LPElementPWM = SlowPWM(LPElementCfg);
-    _HPElementPWM = SlowPWM(HPElementCfg);
+    // Only act on a head temperature that passes its checks. Otherwise the
+    // output and integral hold their last values, so a failed or stale
+    // sensor can't drive the pumps
 
-    if (_LPElementPWM.isConfigured() == false) {
-        ESP_LOGW(Controller::Name, "Unable to configure low power element PWM driver");
+    if (_checkTemperatures(_currentTemp) != PBRet::SUCCESS) {
+        ESP_LOGW(Controller::Name, "Temperatures were invalid. Holding control output");
+        _controlHeld = true;
         return PBRet::FAILURE;
     }
 
-    if (_HPElementPWM.isConfigured() == false) {
-        ESP_LOGW(Controller::Name, "Unable to configure high power element PWM driver");
-        return PBRet::FAILURE;
+    // Restart the error history on release, so the derivative and integral
+    // don't act on the change across the gap
+    const double temp = _currentTemp.get_headTemp();
+    if (_controlHeld) {
+        _prevError = temp - _activeSetpoint();
+        _prevTemp = temp;
+        _controlHeld = false;
     }
 
-    return PBRet::SUCCESS;
+    return _doControl(temp, dt);
 }
 
-PBRet Controller::_doControl(double temp)
+PBRet Controller::_doControl(double temp, double dt)
 {
     // Implements a basic PID controller with anti-integral windup
-    // and filtering on derivative
+    // and filtering on derivative. dt is the measured time since the last
+    // step [s]
+
+    if (dt <= 0.0) {
+        ESP_LOGW(Controller::Name, "Control step dt (%.4f) was invalid", dt);
+        return PBRet::FAILURE;
+    }
+
+    // The relay experiment drives the output while it runs
+    if (_autotuner.isRunning()) {
+        return _doAutotune(temp, dt);
+    }
+
+    // MPC replaces the PID when selected
+    if (_ctrlTuning.get_controlLaw() == ControlLaw::MPC) {
+        return _doMPC(temp);
+    }
+
+    const double err = temp - _activeSetpoint();
+
+    // Hand back from MPC without a bump. The integral takes up whatever
+    // the proportional term doesn't
+    if (_mpcActive) {
+        _integral = _currentOutput - _activePGain * err - _computeFeedforward();
+        _prevError = err;
+        _prevTemp = temp;
+        _mpcActive = false;
+    }
+
+    // Gains for this step. A schedule overrides the fixed tuning
+    double PGain = _ctrlTuning.PGain();
+    double IGain = _ctrlTuning.IGain();
+    double DGain = _ctrlTuning.DGain();
+    if (_gainSchedule.isConfigured()) {
+        const GainSchedulePoint gains = _gainSchedule.evaluate(_scheduleInput(temp));
+        PGain = gains.PGain;
+        IGain = gains.IGain;
+        DGain = gains.DGain;
+    }
 
-    const double err = temp - _ctrlTuning.setpoint();
+    // Bumpless transfer. The integral takes up the change in the
+    // proportional term so the output doesn't step with the gain, whether
+    // it comes from the schedule, new tuning or clearing the schedule
+    _integral += (_activePGain - PGain) * err;
+    _activePGain = PGain;
 
     // Proportional term
-    _proportional = _ctrlTuning.PGain() * err;
+    _proportional = PGain * err;
 
-    // Integral term (discretized via bilinear transform)
-    _integral += 0.5 * _ctrlTuning.IGain() * _cfg.dt * (err + _prevError);
+    // Integral term (discretized via bilinear transform). Held at zero
+    // through phases that disable it, so it doesn't wind up while the
+    // still comes up to temperature
+    if (_runPhase.isIntegralEnabled()) {
+        _integral += 0.5 * IGain * dt * (err + _prevError);
+    } else {
+        _integral = 0.0;
+    }
+
+    // Feedforward term
+    _feedforwardOutput = _computeFeedforward();
 
     // Dynamic integral clamping/anti windup. Limit integral signal so that
-    // PI control does not exceed pump maximum speed. 
+    // PI control does not exceed pump maximum speed. Feedforward takes up
+    // part of the range
     double intLimMin = 0.0;
     double intLimMax = 0.0;
+    const double openLoop = _proportional + _feedforwardOutput;
 
-    if (_proportional < Pump::PUMP_MAX_SPEED) {
-        intLimMax = Pump::PUMP_MAX_SPEED - _proportional;
+    if (openLoop < Pump::PUMP_MAX_SPEED) {
+        intLimMax = Pump::PUMP_MAX_SPEED - openLoop;
     } else {
         intLimMax = 0.0;
     }
 
-    if (_proportional > Pump::PUMP_IDLE_SPEED) {
-        intLimMin = Pump::PUMP_IDLE_SPEED - _proportional;
+    if (openLoop > Pump::PUMP_IDLE_SPEED) {
+        intLimMin = Pump::PUMP_IDLE_SPEED - openLoop;
     } else {
         intLimMin = 0.0;
     }
@@ -388,14 +711,14 @@ PBRet Controller::_doControl(double temp)
 
     // Derivative term filtered with biquad LPF. If filter is not configured, use 
     // raw measurements
-    const double derivRaw = _ctrlTuning.DGain() * (temp - _prevTemp) / _cfg.dt;
+    const double derivRaw = DGain * (temp - _prevTemp) / dt;
     if (_derivFilter.filter(derivRaw, _derivative) != PBRet::SUCCESS) {
         // Error message printed in filter
         _derivative = derivRaw;
     }
 
     // Compute limited output
-    const double totalOutput = _proportional + _integral + _derivative;
+    const double totalOutput = _proportional + _integral + _derivative + _feedforwardOutput;
     _currentOutput = Utilities::bound(totalOutput, Pump::PUMP_OFF, Pump::PUMP_MAX_SPEED);
     _prevError = err;
     _prevTemp = temp;
@@ -403,16 +726,242 @@ PBRet Controller::_doControl(double temp)
     return PBRet::SUCCESS;
 }
 
+PBRet Controller::_doAutotune(double temp, double dt)
+{
+    const double err = temp - _activeSetpoint();
+    _currentOutput = _autotuner.update(err, dt);
+
+    // Hand back to the PID without a bump. The integral takes up whatever
+    // the proportional term doesn't
+    if (_autotuner.isRunning() == false) {
+        _currentOutput = _autotuner.getBias();
+        _integral = _currentOutput - _activePGain * err - _computeFeedforward();
+        _autotuneFinished = true;
+    }
+
+    _prevError = err;
+    _prevTemp = temp;
+
+    return PBRet::SUCCESS;
+}
+
+PBRet Controller::_doMPC(double temp)
+{
+    // The MPC model is discretised at the nominal dt, so it doesn't take
+    // the measured step. Its output limits are the pump's active range
+
+    if (_mpc.isConfigured() == false) {
+        ESP_LOGW(Controller::Name, "MPC is not configured");
+        return PBRet::FAILURE;
+    }
+
+    if (_mpcActive == false) {
+        _mpc.reset(_currentOutput, temp);
+        _mpcActive = true;
+    }
+
+    _currentOutput = _mpc.update(temp, _activeSetpoint());
+    _proportional = 0.0;
+    _integral = 0.0;
+    _derivative = 0.0;
+    _feedforwardOutput = 0.0;
+    _prevError = temp - _activeSetpoint();
+    _prevTemp = temp;
+
+    return PBRet::SUCCESS;
+}
+
+PBRet Controller::_startAutotune(void)
+{
+    // The experiment works through the reflux pump, so it must be under
+    // active control
+    if (_ctrlSettings.get_refluxPumpMode() != PumpMode::ACTIVE_CONTROL) {
+        ESP_LOGW(Controller::Name, "Reflux pump must be in active control to autotune");
+        return PBRet::FAILURE;
+    }
+
+    if (_autotuner.isRunning()) {
+        ESP_LOGW(Controller::Name, "Autotune is already running");
+        return PBRet::FAILURE;
+    }
+
+    // The PID takes over from the relay, so MPC starts afresh afterwards
+    _mpcActive = false;
+
+    return _autotuner.start(_currentOutput);
+}
+
+PBRet Controller::_setGainSchedule(const GainScheduleConfig& cfg)
+{
+    // Replace the gain schedule. An empty schedule returns control to the
+    // fixed tuning. Either way the next step picks up the new gains
+    // without a bump
+
+    if (GainSchedule::checkInputs(cfg) != PBRet::SUCCESS) {
+        ESP_LOGW(Controller::Name, "Gain schedule was invalid");
+        return PBRet::FAILURE;
+    }
+
+    _gainScheduleCfg = cfg;
+    _gainSchedule = GainSchedule(cfg);
+    if (_gainSchedule.isConfigured()) {
+        ESP_LOGI(Controller::Name, "Scheduling gains over %d points", _gainSchedule.size());
+    } else {
+        ESP_LOGI(Controller::Name, "Gain scheduling disabled");
+    }
+
+    return PBRet::SUCCESS;
+}
+
+double Controller::_computeFeedforward(void) const
+{
+    return _feedforward.compute(_elementDriver.getDuty(Element::LP), _elementDriver.getDuty(Element::HP), _currentTemp.get_boilerTemp());
+}
+
+double Controller::_activeSetpoint(void) const
+{
+    // The run phase owns the setpoint while a run is in progress
+    return _runPhase.isRunning() ? _runPhase.getSetpoint() : _ctrlTuning.setpoint();
+}
+
+PBRet Controller::_updateRunPhase(double dt)
+{
+    if (_runPhase.isRunning() == false) {
+        return PBRet::SUCCESS;
+    }
+
+    _phaseInputs.setpoint = _ctrlTuning.setpoint();
+    _phaseInputs.headTemp = _currentTemp.get_headTemp();
+    _phaseInputs.boilerTemp = _currentTemp.get_boilerTemp();
+
+    // A new phase is published straight away
+    if (_runPhase.update(_phaseInputs, dt)) {
+        if (_applyPhaseSettings(_runPhase.getSettings()) != PBRet::SUCCESS) {
+            ESP_LOGW(Controller::Name, "Failed to apply %s phase settings", RunPhaseEngine::getPhaseName(_runPhase.getPhase()));
+            return PBRet::FAILURE;
+        }
+
+        return _broadcastRunPhaseState();
+    }
+
+    if (_runPhasePublishRate.isDue(esp_timer_get_time())) {
+        return _broadcastRunPhaseState();
+    }
+
+    return PBRet::SUCCESS;
+}
+
+static PumpMode phasePumpMode(PhasePumpMode mode, PumpMode current)
+{
+    switch (mode)
+    {
+        case (PhasePumpMode::OFF):
+            return PumpMode::PUMP_OFF;
+        case (PhasePumpMode::ACTIVE):
+            return PumpMode::ACTIVE_CONTROL;
+        case (PhasePumpMode::MANUAL):
+            return PumpMode::MANUAL_CONTROL;
+        case (PhasePumpMode::UNCHANGED):
+        default:
+            return current;
+    }
+}
+
+PBRet Controller::_applyPhaseSettings(const PhaseSettings& settings)
+{
+    // Apply the settings of a phase that has just been entered. Anything
+    // the phase leaves unset keeps its current value, and all of it can
+    // be overridden by hand until the next phase
+
+    // Pumps
+    PumpSpeeds manualSpeeds = _ctrlSettings.get_manualPumpSpeeds();
+    if (settings.refluxPumpSpeed >= 0.0) {
+        manualSpeeds.set_refluxPumpSpeed(settings.refluxPumpSpeed);
+    }
+    if (settings.productPumpSpeed >= 0.0) {
+        manualSpeeds.set_productPumpSpeed(settings.productPumpSpeed);
+    }
+    _ctrlSettings.set_manualPumpSpeeds(manualSpeeds);
+    _ctrlSettings.set_refluxPumpMode(phasePumpMode(settings.refluxPumpMode, _ctrlSettings.get_refluxPumpMode()));
+    _ctrlSettings.set_productPumpMode(phasePumpMode(settings.productPumpMode, _ctrlSettings.get_productPumpMode()));
+
+    // The relay experiment needs the reflux pump
+    if (_autotuner.isRunning() && (_ctrlSettings.get_refluxPumpMode() != PumpMode::ACTIVE_CONTROL)) {
+        _autotuner.cancel();
+        _autotuneFinished = true;
+    }
+
+    // Elements
+    if (settings.LPElementDuty >= 0.0) {
+        _peripheralState.set_LPElementDutyCycle(settings.LPElementDuty);
+        if (_elementDriver.setDuty(Element::LP, settings.LPElementDuty) != PBRet::SUCCESS) {
+            ESP_LOGW(Controller::Name, "Failed to update LPElement duty cycle");
+            return PBRet::FAILURE;
+        }
+    }
+
+    if (settings.HPElementDuty >= 0.0) {
+        _peripheralState.set_HPElementDutyCycle(settings.HPElementDuty);
+        if (_elementDriver.setDuty(Element::HP, settings.HPElementDuty) != PBRet::SUCCESS) {
+            ESP_LOGW(Controller::Name, "Failed to update HPElement duty cycle");
+            return PBRet::FAILURE;
+        }
+    }
+
+    // Fan
+    if (settings.fanState >= 0) {
+        _peripheralState.set_fanState(settings.fanState == 1);
+    }
+
+    // Let the interface know the settings changed under it
+    if (_broadcastControllerSettings() != PBRet::SUCCESS) {
+        ESP_LOGW(Controller::Name, "Failed to broadcast controller settings");
+    }
+
+    if (_broadcastControllerPeripheralState() != PBRet::SUCCESS) {
+        ESP_LOGW(Controller::Name, "Failed to broadcast controller peripheral state");
+    }
+
+    return PBRet::SUCCESS;
+}
+
+double Controller::_scheduleInput(double temp) const
+{
+    switch (_gainSchedule.getVariable())
+    {
+        case (ScheduleVariable::BOILER_ABV):
+            return GainSchedule::boilerABV(_currentTemp.get_boilerTemp());
+        case (ScheduleVariable::HEAD_TEMP):
+        default:
+            return temp;
+    }
+}
+
 PBRet Controller::_updatePumps(void)
 {
+    // Hold both pumps at flush speed while the safety supervisor is tripped.
+    // This skips the slew limit
+    if (SafetySupervisor::isTripped()) {
+        PBRet ret = PBRet::SUCCESS;
+        if (_refluxPump.forcePumpSpeed(Pump::FLUSH_SPEED) != PBRet::SUCCESS) {
+            ret = PBRet::FAILURE;
+        }
+        if (_productPump.forcePumpSpeed(Pump::FLUSH_SPEED) != PBRet::SUCCESS) {
+            ret = PBRet::FAILURE;
+        }
+        return ret;
+    }
+
     // Update reflux pump
     if (_updateRefluxPump() != PBRet::SUCCESS) {
         ESP_LOGW(Controller::Name, "Pump update failed");
         return PBRet::FAILURE;
     }
 
-    // Update product pump
-    if (_updateProductPump(_currentTemp.get_headTemp()) != PBRet::SUCCESS) {
+    // Update product pump. Under active control it follows the head
+    // temperature, so holds its speed while control is held
+    const bool holdProduct = _controlHeld && (_ctrlSettings.get_productPumpMode() == PumpMode::ACTIVE_CONTROL);
+    if ((holdProduct == false) && (_updateProductPump(_currentTemp.get_headTemp()) != PBRet::SUCCESS)) {
         ESP_LOGW(Controller::Name, "Pump update failed");
         return PBRet::FAILURE;
     }
@@ -479,6 +1028,12 @@ PBRet Controller::_checkTemperatures(const TemperatureData& currTemp) const
 {
     // Verify that the input temperatures are valid
 
+    // Check a healthy sensor is providing the head temperature
+    if (_headSensorHealthy == false) {
+        ESP_LOGW(Controller::Name, "No healthy head temperature sensor");
+        return PBRet::FAILURE;
+    }
+
     // Check head temperature is within bounds
     if ((currTemp.get_headTemp() > MAX_CONTROL_TEMP) || (currTemp.get_headTemp() < MIN_CONTROL_TEMP))
     {
@@ -497,37 +1052,118 @@ PBRet Controller::_checkTemperatures(const TemperatureData& currTemp) const
 
 PBRet Controller::_updatePeripheralState(const ControllerCommand& cmd)
 {
-    esp_err_t err = ESP_OK;
+    // Elements are switched by the element driver, which also holds them
+    // off while the safety supervisor is tripped
+    esp_err_t err = gpio_set_level(_cfg.fanPin, static_cast<uint32_t> (cmd.fanState()));
 
-    // Update PWM drivers
-    uint32_t LPElementState = 0;
-    if (_LPElementPWM.update(esp_timer_get_time()) == PBRet::SUCCESS) {
-        LPElementState = _LPElementPWM.getOutputState();
-    } else {
-        ESP_LOGW(Controller::Name, "Failed to update LPElement PWM driver");
-        err |= ESP_FAIL;
+    if (err != ESP_OK) {
+        ESP_LOGW(Controller::Name, "One or more of the auxilliary states were not updated");
+        return PBRet::FAILURE;
     }
 
-    uint32_t HPElementState = 0;
-    if (_HPElementPWM.update(esp_timer_get_time()) == PBRet::SUCCESS) {
-        HPElementState = _HPElementPWM.getOutputState();
-    } else {
-        ESP_LOGW(Controller::Name, "Failed to update HPElement PWM driver");
-        err |= ESP_FAIL;
+    return PBRet::SUCCESS;
+}
+
+PBRet Controller::_broadcastAutotuneResult(void) const
+{
+    // Send an AutotuneResult message to the queue. The proposed tuning
+    // keeps the current setpoint
+    const RelayTuning& result = _autotuner.getResult();
+
+    ControllerTuning tuning {};
+    tuning.set_setpoint(_ctrlTuning.setpoint());
+    tuning.set_PGain(result.PGain);
+    tuning.set_IGain(result.IGain);
+    tuning.set_DGain(result.DGain);
+    tuning.set_LPFsampleFreq(1.0 / _cfg.dt);
+    tuning.set_LPFcutoffFreq(result.LPFcutoffFreq);
+
+    AutotuneResult msg {};
+    msg.set_success(_autotuner.getState() == RelayAutotuner::State::DONE);
+    msg.set_ultimateGain(result.ultimateGain);
+    msg.set_ultimatePeriod(result.ultimatePeriod);
+    msg.set_amplitude(result.amplitude);
+    msg.set_duration(_autotuner.getElapsed());
+    msg.set_proposedTuning(tuning);
+    msg.set_timeStamp(esp_timer_get_time());
+
+    PBMessageWrapper wrapped = MessageServer::wrap(msg, PBMessageType::AutotuneResult, _ID);
+
+    return MessageServer::broadcastMessage(wrapped);
+}
+
+PBRet Controller::_broadcastGainSchedule(void) const
+{
+    // Send the gain schedule in use to the queue
+    const PBGainSchedule msg = _gainScheduleToMessage(_gainScheduleCfg);
+    PBMessageWrapper wrapped = MessageServer::wrap(msg, PBMessageType::ControllerGainSchedule, _ID);
+
+    return MessageServer::broadcastMessage(wrapped);
+}
+
+PBRet Controller::_broadcastRunPhaseState(void) const
+{
+    // Send a RunPhaseState message to the queue. The phase is only
+    // meaningful while running
+    RunPhaseState state {};
+    state.set_running(_runPhase.isRunning());
+    if (_runPhase.isRunning()) {
+        state.set_phase(static_cast<uint32_t>(_runPhase.getPhase()));
+        state.set_timeInPhase(_runPhase.getTimeInPhase());
     }
+    state.set_setpoint(_activeSetpoint());
+    state.set_timeStamp(esp_timer_get_time());
 
-    err |= gpio_set_level(_cfg.fanPin, static_cast<uint32_t> (cmd.fanState()));
-    err |= gpio_set_level(_cfg.element1Pin, LPElementState);
-    err |= gpio_set_level(_cfg.element2Pin, HPElementState);
+    PBMessageWrapper wrapped = MessageServer::wrap(state, PBMessageType::RunPhaseState, _ID);
 
-    if (err != ESP_OK) {
-        ESP_LOGW(Controller::Name, "One or more of the auxilliary states were not updated");
-        return PBRet::FAILURE;
+    return MessageServer::broadcastMessage(wrapped);
+}
+
+PBRet Controller::_gainScheduleFromMessage(const PBGainSchedule& msg, GainScheduleConfig& cfg)
+{
+    switch (msg.get_variable())
+    {
+        case (GainScheduleVariable::HEAD_TEMP):
+            cfg.variable = ScheduleVariable::HEAD_TEMP;
+            break;
+        case (GainScheduleVariable::BOILER_ABV):
+            cfg.variable = ScheduleVariable::BOILER_ABV;
+            break;
+        default:
+            ESP_LOGW(Controller::Name, "Scheduling variable %d is not supported", static_cast<int>(msg.get_variable()));
+            return PBRet::FAILURE;
+    }
+
+    cfg.points.clear();
+    for (size_t i = 0; i < msg.get_points().get_length(); i++) {
+        const ControllerGainSchedulePoint& pointMsg = msg.get_points()[i];
+        GainSchedulePoint point {};
+        point.x = pointMsg.get_x();
+        point.PGain = pointMsg.get_PGain();
+        point.IGain = pointMsg.get_IGain();
+        point.DGain = pointMsg.get_DGain();
+        cfg.points.push_back(point);
     }
 
     return PBRet::SUCCESS;
 }
 
+PBGainSchedule Controller::_gainScheduleToMessage(const GainScheduleConfig& cfg)
+{
+    PBGainSchedule msg {};
+    msg.set_variable((cfg.variable == ScheduleVariable::BOILER_ABV) ? GainScheduleVariable::BOILER_ABV : GainScheduleVariable::HEAD_TEMP);
+    for (const GainSchedulePoint& point : cfg.points) {
+        ControllerGainSchedulePoint pointMsg {};
+        pointMsg.set_x(point.x);
+        pointMsg.set_PGain(point.PGain);
+        pointMsg.set_IGain(point.IGain);
+        pointMsg.set_DGain(point.DGain);
+        msg.add_points(pointMsg);
+    }
+
+    return msg;
+}
+
 PBRet Controller::checkInputs(const ControllerConfig& cfg)
 {
     if (cfg.dt <= 0) {
@@ -535,6 +1171,51 @@ PBRet Controller::checkInputs(const ControllerConfig& cfg)
         return PBRet::FAILURE;
     }
 
+    if (cfg.timingPublishPeriod < cfg.dt) {
+        ESP_LOGE(Controller::Name, "Timing publish period %lf must be at least dt. Controller was not configured", cfg.timingPublishPeriod);
+        return PBRet::FAILURE;
+    }
+
+    if (ControlBudget::checkInputs(cfg.budgetConfig) != PBRet::SUCCESS) {
+        ESP_LOGE(Controller::Name, "Control budget config was invalid");
+        return PBRet::FAILURE;
+    }
+
+    if (ElementDriver::checkInputs(cfg.elementDriver) != PBRet::SUCCESS) {
+        ESP_LOGE(Controller::Name, "Element driver config was invalid");
+        return PBRet::FAILURE;
+    }
+
+    if (RelayAutotuner::checkInputs(cfg.autotuneConfig) != PBRet::SUCCESS) {
+        ESP_LOGE(Controller::Name, "Autotune config was invalid");
+        return PBRet::FAILURE;
+    }
+
+    if (GainSchedule::checkInputs(cfg.gainSchedule) != PBRet::SUCCESS) {
+        ESP_LOGE(Controller::Name, "Gain schedule was invalid");
+        return PBRet::FAILURE;
+    }
+
+    if (Feedforward::checkInputs(cfg.feedforward) != PBRet::SUCCESS) {
+        ESP_LOGE(Controller::Name, "Feedforward config was invalid");
+        return PBRet::FAILURE;
+    }
+
+    if (RunPhaseEngine::checkInputs(cfg.runPhases) != PBRet::SUCCESS) {
+        ESP_LOGE(Controller::Name, "Run phase config was invalid");
+        return PBRet::FAILURE;
+    }
+
+    if (ModelPredictiveController::checkInputs(cfg.mpc, cfg.dt) != PBRet::SUCCESS) {
+        ESP_LOGE(Controller::Name, "MPC config was invalid");
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.budgetConfig.budget > cfg.dt) {
+        ESP_LOGE(Controller::Name, "Control budget %lf must fit within dt. Controller was not configured", cfg.budgetConfig.budget);
+        return PBRet::FAILURE;
+    }
+
     if (Pump::checkInputs(cfg.refluxPumpConfig) != PBRet::SUCCESS) {
         ESP_LOGE(Controller::Name, "Reflux pump config was invalic");
         return PBRet::FAILURE;
@@ -581,6 +1262,15 @@ PBRet Controller::loadFromJSON(ControllerConfig& cfg, const cJSON* cfgRoot)
         return PBRet::FAILURE;
     }
 
+    // Get timing publish period
+    cJSON* timingPublishPeriodNode = cJSON_GetObjectItem(cfgRoot, "timingPublishPeriod");
+    if (cJSON_IsNumber(timingPublishPeriodNode)) {
+        cfg.timingPublishPeriod = timingPublishPeriodNode->valuedouble;
+    } else {
+        ESP_LOGI(Controller::Name, "Unable to read controller timing publish period from JSON");
+        return PBRet::FAILURE;
+    }
+
     // Get fan GPIO
     cJSON* GPIOFanNode = cJSON_GetObjectItem(cfgRoot, "GPIO_fan");
     if (cJSON_IsNumber(GPIOFanNode)) {
@@ -620,15 +1310,53 @@ PBRet Controller::loadFromJSON(ControllerConfig& cfg, const cJSON* cfgRoot)
         return PBRet::FAILURE;
     }
 
-    // Load LPElement PWM driver
-    cJSON* LPElementPWMNode = cJSON_GetObjectItem(cfgRoot, "slowPMWLPElement");
-    if (SlowPWM::loadFromJSON(cfg.LPElementPWM, LPElementPWMNode) != PBRet::SUCCESS) {
+    // Load element driver
+    cJSON* elementDriverNode = cJSON_GetObjectItem(cfgRoot, "elementDriver");
+    if (ElementDriver::loadFromJSON(cfg.elementDriver, elementDriverNode) != PBRet::SUCCESS) {
+        return PBRet::FAILURE;
+    }
+
+    // Load control step budget
+    cJSON* controlBudgetNode = cJSON_GetObjectItem(cfgRoot, "controlBudget");
+    if (ControlBudget::loadFromJSON(cfg.budgetConfig, controlBudgetNode) != PBRet::SUCCESS) {
         return PBRet::FAILURE;
     }
 
-    // Load HPElement PWM driver
-    cJSON* HPElementPWMNode = cJSON_GetObjectItem(cfgRoot, "slowPMWHPElement");
-    if (SlowPWM::loadFromJSON(cfg.HPElementPWM, HPElementPWMNode) != PBRet::SUCCESS) {
+    // Load autotuner
+    cJSON* autotuneNode = cJSON_GetObjectItem(cfgRoot, "autotune");
+    if (RelayAutotuner::loadFromJSON(cfg.autotuneConfig, autotuneNode) != PBRet::SUCCESS) {
+        return PBRet::FAILURE;
+    }
+
+    // Load gain schedule. This is optional, the fixed tuning is used if it
+    // is missing
+    cfg.gainSchedule = GainScheduleConfig {};
+    cJSON* gainScheduleNode = cJSON_GetObjectItem(cfgRoot, "gainSchedule");
+    if ((gainScheduleNode != nullptr) && (GainSchedule::loadFromJSON(cfg.gainSchedule, gainScheduleNode) != PBRet::SUCCESS)) {
+        return PBRet::FAILURE;
+    }
+
+    // Load feedforward. This is optional, control is pure feedback if it
+    // is missing
+    cfg.feedforward = FeedforwardConfig {};
+    cJSON* feedforwardNode = cJSON_GetObjectItem(cfgRoot, "feedforward");
+    if ((feedforwardNode != nullptr) && (Feedforward::loadFromJSON(cfg.feedforward, feedforwardNode) != PBRet::SUCCESS)) {
+        return PBRet::FAILURE;
+    }
+
+    // Load run phases. This is optional, the setpoint is fixed by the
+    // tuning if it is missing
+    cfg.runPhases = RunPhaseConfig {};
+    cJSON* runPhasesNode = cJSON_GetObjectItem(cfgRoot, "runPhases");
+    if ((runPhasesNode != nullptr) && (RunPhaseEngine::loadFromJSON(cfg.runPhases, runPhasesNode) != PBRet::SUCCESS)) {
+        return PBRet::FAILURE;
+    }
+
+    // Load MPC. This is optional, only the PID is available if it is
+    // missing
+    cfg.mpc = MPCConfig {};
+    cJSON* mpcNode = cJSON_GetObjectItem(cfgRoot, "mpc");
+    if ((mpcNode != nullptr) && (ModelPredictiveController::loadFromJSON(cfg.mpc, mpcNode) != PBRet::SUCCESS)) {
         return PBRet::FAILURE;
     }
 
@@ -652,14 +1380,9 @@ PBRet Controller::_initFromParams(const ControllerConfig& cfg)
         return PBRet::FAILURE;
     }
 
-    if (_initPWM(cfg.LPElementPWM, cfg.HPElementPWM) != PBRet::SUCCESS) {
-        ESP_LOGE(Controller::Name, "One or more PWM drivers were not configured");
-        return PBRet::FAILURE;
-    }
-
-    // Load controller tuning from file (if it exists)
-    if (loadTuningFromFile() != PBRet::SUCCESS) {
-        ESP_LOGW(Controller::Name, "Unable to load controller tuning from file");
+    // Load saved controller tuning (if it exists)
+    if (loadTuning() != PBRet::SUCCESS) {
+        ESP_LOGW(Controller::Name, "Unable to load saved controller tuning");
     }
 
     // Initialize derivative filter from loaded tuning object
@@ -667,6 +1390,14 @@ PBRet Controller::_initFromParams(const ControllerConfig& cfg)
     if (_derivFilter.isConfigured() == false) {
         ESP_LOGW(Controller::Name, "Unable to initialize derivative filter");
     }
+    _activePGain = _ctrlTuning.PGain();
+
+    // A gain schedule saved from a previous run takes precedence over the
+    // one in the config
+    if (loadGainSchedule() != PBRet::SUCCESS) {
+        ESP_LOGI(Controller::Name, "No saved gain schedule. Using gain schedule from config");
+        _setGainSchedule(cfg.gainSchedule);
+    }
 
     // Set pump manual speeds to idle
     PumpSpeeds initPumpSpeeds {};
@@ -677,84 +1408,90 @@ PBRet Controller::_initFromParams(const ControllerConfig& cfg)
     // Set pumps to active control
     _ctrlSettings.set_refluxPumpMode(PumpMode::ACTIVE_CONTROL);
     _ctrlSettings.set_refluxPumpMode(PumpMode::ACTIVE_CONTROL);
+
+    // Loop timing is published over windows of timingPublishPeriod
+    _timing = LoopTiming(cfg.dt, Controller::JITTER_BIN_WIDTH, Controller::EXEC_BIN_WIDTH);
+    _timingPublishRate = RateGroup(cfg.timingPublishPeriod);
+    _budget = ControlBudget(cfg.budgetConfig, esp_clk_cpu_freq());
+    _autotuner = RelayAutotuner(cfg.autotuneConfig, Pump::PUMP_IDLE_SPEED, Pump::PUMP_MAX_SPEED);
+    _feedforward = Feedforward(cfg.feedforward);
+    _runPhase = RunPhaseEngine(cfg.runPhases);
+    _runPhasePublishRate = RateGroup(Controller::RUN_PHASE_PUBLISH_PERIOD);
+    _mpc = ModelPredictiveController(cfg.mpc, cfg.dt, Pump::PUMP_IDLE_SPEED, Pump::PUMP_MAX_SPEED);
+
+    // A saved tuning may select MPC after it has been removed from the
+    // config
+    if ((_ctrlTuning.get_controlLaw() == ControlLaw::MPC) && (_mpc.isConfigured() == false)) {
+        ESP_LOGW(Controller::Name, "MPC is not configured. Using PID");
+        _ctrlTuning.set_controlLaw(ControlLaw::PID);
+    }
     _cfg = cfg;
 
     return PBRet::SUCCESS;
 }
 
-PBRet Controller::saveTuningToFile(void)
+PBRet Controller::saveTuning(void)
 {
-    // Save the current controller tuning to a JSON file and store
-    // in flash
+    // Save the current controller tuning. The settings store writes it to
+    // flash from its own task
 
-    // Mount filesystem
-    Filesystem F(Controller::FSBasePath, Controller::FSPartitionLabel, 5, true);
-    if (F.isOpen() == false) {
-        ESP_LOGW(Controller::Name, "Failed to mount filesystem. Controller config was not written to file");
+    if (SettingsStore::putMessage(Controller::ctrlTuningKey, _ctrlTuning) != PBRet::SUCCESS) {
+        ESP_LOGW(Controller::Name, "Controller tuning was not saved");
         return PBRet::FAILURE;
     }
 
-    std::ofstream outFile(Controller::ctrlTuningFile, std::ios::binary | std::ios::out);
-    if (outFile.is_open() == false) {
-        ESP_LOGE(Controller::Name, "Failed to open file for writing. Controller config was not written to file");
-        return PBRet::FAILURE;
-    }
+    ESP_LOGI(Controller::Name, "Controller tuning successfully saved");
+
+    return PBRet::SUCCESS;
+}
+
+PBRet Controller::loadTuning(void)
+{
+    // Load a saved controller tuning and configure controller. Returns
+    // Failure if none was saved
 
-    Writable writeBuffer {};
-    ::EmbeddedProto::Error err = _ctrlTuning.serialize(writeBuffer);
-    if (err != ::EmbeddedProto::Error::NO_ERRORS) {
-        ESP_LOGW(Controller::Name, "Failed to serialize control tuning object (err: %d)", static_cast<int>(err));
+    if (SettingsStore::getMessage(Controller::ctrlTuningKey, _ctrlTuning) != PBRet::SUCCESS) {
+        ESP_LOGW(Controller::Name, "No saved controller tuning was found");
         return PBRet::FAILURE;
     }
 
-    // Write data structure to file
-    outFile.write((char*) writeBuffer.get_buffer(), writeBuffer.get_size());
-    ESP_LOGI(Controller::Name, "Controller tuning successfully written to file");
-
-    size_t totalBytes = 0;
-    size_t usedBytes = 0;
-    F.getInfo(totalBytes, usedBytes);
-    ESP_LOGW(Controller::Name, "PBData total: %d bytes, used: %d bytes", totalBytes, usedBytes);
+    ESP_LOGI(Controller::Name, "Loaded saved tuning settings");
 
     return PBRet::SUCCESS;
 }
 
-PBRet Controller::loadTuningFromFile(void)
+PBRet Controller::saveGainSchedule(void)
 {
-    // Load a saved controller tuning from a JSON file and configure
-    // controller. Returns Failure if no file can be found
+    // Save the current gain schedule alongside the controller tuning
 
-    // Mount filesystem
-    Filesystem F(Controller::FSBasePath, Controller::FSPartitionLabel, 5, true);
-    if (F.isOpen() == false) {
-        ESP_LOGW(Controller::Name, "Failed to mount filesystem. Controller config was not read from file");
+    const PBGainSchedule schedule = _gainScheduleToMessage(_gainScheduleCfg);
+    if (SettingsStore::putMessage(Controller::gainScheduleKey, schedule) != PBRet::SUCCESS) {
+        ESP_LOGW(Controller::Name, "Gain schedule was not saved");
         return PBRet::FAILURE;
     }
 
-    std::ifstream inFile(Controller::ctrlTuningFile);
-    if (inFile.is_open() == false) {
-        ESP_LOGE(Controller::Name, "Failed to open file for reading. Controller config was not read from file");
-        return PBRet::FAILURE;
-    }
+    ESP_LOGI(Controller::Name, "Gain schedule successfully saved");
+
+    return PBRet::SUCCESS;
+}
 
-    std::vector<uint8_t> bytes(
-         (std::istreambuf_iterator<char>(inFile)),
-         (std::istreambuf_iterator<char>()));
+PBRet Controller::loadGainSchedule(void)
+{
+    // Load a saved gain schedule. Returns Failure if none was saved or the
+    // saved schedule is invalid
 
-    Readable buffer {};
-    for (uint8_t byte : bytes)
-    {
-        buffer.push(byte);
+    PBGainSchedule schedule {};
+    if (SettingsStore::getMessage(Controller::gainScheduleKey, schedule) != PBRet::SUCCESS) {
+        return PBRet::FAILURE;
     }
 
-    // Decode into ControllerTuning object
-    ::EmbeddedProto::Error err = _ctrlTuning.deserialize(buffer);
-    if (err != ::EmbeddedProto::Error::NO_ERRORS) {
-        ESP_LOGW(Controller::Name, "Failed to deserialize control tuning object (err: %d)", static_cast<int>(err));
+    GainScheduleConfig cfg {};
+    if ((_gainScheduleFromMessage(schedule, cfg) != PBRet::SUCCESS) || (_setGainSchedule(cfg) != PBRet::SUCCESS)) {
+        ESP_LOGW(Controller::Name, "Saved gain schedule was invalid");
         return PBRet::FAILURE;
     }
 
-    ESP_LOGI(Controller::Name, "Loaded tuning settings from file");
+    ESP_LOGI(Controller::Name, "Loaded saved gain schedule");
 
     return PBRet::SUCCESS;
 }
\ No newline at end of file
@@ -5,37 +5,58 @@
 #include "CppTask.h"
 #include "SensorManager.h"
 #include "Pump.h"
-#include "SlowPWM.h"
+#include "ElementDriver.h"
 #include "Filter.h"
+#include "ControlLoop.h"
+#include "Autotuner.h"
+#include "GainSchedule.h"
+#include "Feedforward.h"
+#include "RunPhase.h"
+#include "ModelPredictive.h"
+#include "SafetySupervisor.h"
 #include "Generated/MessageBase.h"
 #include "Generated/ControllerMessaging.h"
 
+using PBControllerTiming = ControllerTiming<LoopTiming::HistogramBins, LoopTiming::HistogramBins, ControlPhaseCount, ControlPhaseCount>;
+using PBGainSchedule = ControllerGainSchedule<GainSchedule::MaxPoints>;
+
 struct ControllerConfig
 {
     double dt = 0.0;
+    double timingPublishPeriod = 0.0;       // Time between ControllerTiming messages [s]
     PumpConfig refluxPumpConfig{};
     PumpConfig prodPumpConfig{};
     gpio_num_t fanPin = (gpio_num_t)GPIO_NUM_NC;
     gpio_num_t element1Pin = (gpio_num_t)GPIO_NUM_NC;
     gpio_num_t element2Pin = (gpio_num_t)GPIO_NUM_NC;
-    SlowPWMConfig LPElementPWM{};
-    SlowPWMConfig HPElementPWM{};
+    ElementDriverConfig elementDriver{};
+    ControlBudgetConfig budgetConfig{};
+    RelayAutotunerConfig autotuneConfig{};
+    GainScheduleConfig gainSchedule{};      // Replaced by the schedule saved in flash, if there is one
+    FeedforwardConfig feedforward{};
+    RunPhaseConfig runPhases{};
+    MPCConfig mpc{};                        // Selected in place of the PID by the tuning control law
 };
 
 class Controller : public Task
 {
     // Class strings
     static constexpr const char *Name = "Controller";
-    static constexpr const char *FSBasePath = "/spiffs";
-    static constexpr const char *FSPartitionLabel = "PBData";
-    static constexpr const char *ctrlTuningFile = "/spiffs/ctrlTuning.json";
+    static constexpr const char *ctrlTuningKey = "ctrlTuning";
+    static constexpr const char *gainScheduleKey = "gainSchedule";
 
     // Bounds
     static constexpr double HYSTERESIS_BOUND_UPPER = 70; // Upper hysteresis bound for product pump [deg c]
     static constexpr double HYSTERESIS_BOUND_LOWER = 68; // Lower hysteresis bound for product pump [deg c]
     static constexpr double MAX_CONTROL_TEMP = 105;      // Maximum controllable temp [deg c]
     static constexpr double MIN_CONTROL_TEMP = -5;       // Minimum controllable temp
-    static constexpr double TEMP_MESSAGE_TIMEOUT = 1e6;  // Time before temperarture message goes stale (us)
+    static constexpr double TEMP_MESSAGE_TIMEOUT = 2e6;  // Time from acquisition before temperature goes stale. Covers a 12 bit conversion and sample period (us)
+
+    // Loop timing
+    static constexpr double JITTER_BIN_WIDTH = 50e-6;   // Start jitter histogram resolution [s]
+    static constexpr double EXEC_BIN_WIDTH = 500e-6;    // Execution time histogram resolution [s]
+    static constexpr int TIMER_TIMEOUT_PERIODS = 4;     // Periods without a timer notification before stepping anyway
+    static constexpr double RUN_PHASE_PUBLISH_PERIOD = 1.0; // Time between RunPhaseState messages during a run [s]
 
 public:
     // Constructors
@@ -60,10 +81,19 @@ private:
     // Initialization
     PBRet _initIO(const ControllerConfig &cfg) const;
     PBRet _initPumps(const PumpConfig &refluxPumpConfig, const PumpConfig &prodPumpConfig);
-    PBRet _initPWM(const SlowPWMConfig &LPElementCfg, const SlowPWMConfig &HPElementCfg);
 
     // Updates
-    PBRet _doControl(double temp);
+    PBRet _stepControl(double dt);
+    PBRet _doControl(double temp, double dt);
+    PBRet _doAutotune(double temp, double dt);
+    PBRet _doMPC(double temp);
+    PBRet _startAutotune(void);
+    PBRet _setGainSchedule(const GainScheduleConfig &cfg);
+    double _scheduleInput(double temp) const;
+    double _computeFeedforward(void) const;
+    double _activeSetpoint(void) const;
+    PBRet _updateRunPhase(double dt);
+    PBRet _applyPhaseSettings(const PhaseSettings &settings);
     PBRet _updatePeripheralState(const ControllerCommand &cmd);
     PBRet _updatePumps(void);
     PBRet _updateProductPump(double temp);
@@ -78,8 +108,12 @@ private:
     void taskMain(void) override;
 
     // Config
-    PBRet saveTuningToFile(void);
-    PBRet loadTuningFromFile(void);
+    PBRet saveTuning(void);
+    PBRet loadTuning(void);
+    PBRet saveGainSchedule(void);
+    PBRet loadGainSchedule(void);
+    static PBRet _gainScheduleFromMessage(const PBGainSchedule &msg, GainScheduleConfig &cfg);
+    static PBGainSchedule _gainScheduleToMessage(const GainScheduleConfig &cfg);
 
     // Queue callbacks
     PBRet _generalMessageCB(std::shared_ptr<PBMessageWrapper> msg);
@@ -88,17 +122,29 @@ private:
     PBRet _controlSettingsCB(std::shared_ptr<PBMessageWrapper> msg);
     PBRet _controlTuningCB(std::shared_ptr<PBMessageWrapper> msg);
     PBRet _controlDataRequestCB(std::shared_ptr<PBMessageWrapper> msg);
+    PBRet _sensorHealthCB(std::shared_ptr<PBMessageWrapper> msg);
+    PBRet _autotuneCommandCB(std::shared_ptr<PBMessageWrapper> msg);
+    PBRet _gainScheduleCB(std::shared_ptr<PBMessageWrapper> msg);
+    PBRet _concentrationDataCB(std::shared_ptr<PBMessageWrapper> msg);
+    PBRet _runBalanceCB(std::shared_ptr<PBMessageWrapper> msg);
+    PBRet _runPhaseCommandCB(std::shared_ptr<PBMessageWrapper> msg);
 
     // Data broadcast
     PBRet _broadcastControllerTuning(void) const;
     PBRet _broadcastControllerSettings(void) const;
     PBRet _broadcastControllerPeripheralState(void) const;
     PBRet _broadcastControllerState(void) const;
+    PBRet _broadcastControllerTiming(void) const;
+    PBRet _broadcastAutotuneResult(void) const;
+    PBRet _broadcastGainSchedule(void) const;
+    PBRet _broadcastRunPhaseState(void) const;
 
     // Controller data
     ControllerConfig _cfg{};
     ControllerCommand _peripheralState{};
     TemperatureData _currentTemp{};
+    bool _headSensorHealthy = true;
+    bool _controlHeld = false;          // Output held while the head temperature is invalid
     ControllerTuning _ctrlTuning{};
     ControllerSettings _ctrlSettings{};
 
@@ -113,9 +159,45 @@ private:
     double _proportional = 0.0;
     double _integral = 0.0;
     double _derivative = 0.0;
+    double _feedforwardOutput = 0.0;
     double _prevTemp = 0.0;
-    SlowPWM _LPElementPWM{};
-    SlowPWM _HPElementPWM{};
+
+    // Element switching runs from its own timer. The controller only sets
+    // the duties
+    ElementDriver _elementDriver{};
+
+    // Relay autotuning. The result is published for approval and only
+    // applied when it comes back as a ControllerTuning message
+    RelayAutotuner _autotuner{};
+    bool _autotuneFinished = false;
+
+    // Gain scheduling. When configured the schedule replaces the gains in
+    // _ctrlTuning. The setpoint and derivative filter still come from there
+    GainScheduleConfig _gainScheduleCfg{};
+    GainSchedule _gainSchedule{};
+    double _activePGain = 0.0;              // Proportional gain used on the last step
+
+    // Pump speed expected for the current element duty. Added to the PID
+    // output so heater changes don't wait on the feedback loop
+    Feedforward _feedforward{};
+
+    // Run phase tracking. While a run is in progress the engine owns the
+    // setpoint, and applies each phase's pump, element and fan settings
+    // on entry
+    RunPhaseEngine _runPhase{};
+    PhaseInputs _phaseInputs{};
+    RateGroup _runPhasePublishRate{};
+
+    // Model predictive control. Runs in place of the PID when the tuning
+    // selects it. Control passes between the two from the current output
+    ModelPredictiveController _mpc{};
+    bool _mpcActive = false;                // MPC produced the last output
+
+    // Loop timing
+    ControlTimer _timer{};
+    LoopTiming _timing{};
+    RateGroup _timingPublishRate{};
+    ControlBudget _budget{};
 };
 
 #endif // MAIN_CONTROLLER_H
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include "DS18B20Pipeline.h"
+#include <cmath>
+#include <algorithm>
+
+DS18B20Pipeline::DS18B20Pipeline(double conversionTime, double samplePeriod)
+{
+    setTiming(conversionTime, samplePeriod);
+}
+
+DS18B20Pipeline::Action DS18B20Pipeline::update(int64_t t) const
+{
+    if (_state == State::IDLE) {
+        return (t >= _nextStart) ? Action::START_CONVERSION : Action::NONE;
+    }
+
+    if ((t - _conversionStart) >= _conversionTime) {
+        return Action::READ;
+    }
+
+    return Action::NONE;
+}
+
+void DS18B20Pipeline::conversionStarted(int64_t t)
+{
+    _conversionStart = t;
+    _state = State::CONVERTING;
+}
+
+void DS18B20Pipeline::samplesRead(void)
+{
+    // Sample interval is measured between conversion start times as this is
+    // when the temperature was actually sampled
+    if (_hasSample) {
+        _sampleInterval.add((_conversionStart - _lastSampleTime) * 1e-6);
+    }
+
+    _lastSampleTime = _conversionStart;
+    _nextStart = _conversionStart + _samplePeriod;
+    _hasSample = true;
+    _state = State::IDLE;
+}
+
+void DS18B20Pipeline::setTiming(double conversionTime, double samplePeriod)
+{
+    // Can't sample faster than the sensor converts
+    _conversionTime = static_cast<int64_t>(conversionTime * 1e6);
+    _samplePeriod = std::max(static_cast<int64_t>(samplePeriod * 1e6), _conversionTime);
+}
+
+double DS18B20Pipeline::getConversionTime(DS18B20_RESOLUTION res)
+{
+    // Max temperature conversion time [s] from the DS18B20 datasheet
+
+    switch (res)
+    {
+        case (DS18B20_RESOLUTION_9_BIT):
+            return 0.09375;
+        case (DS18B20_RESOLUTION_10_BIT):
+            return 0.1875;
+        case (DS18B20_RESOLUTION_11_BIT):
+            return 0.375;
+        default:
+            return 0.75;
+    }
+}
+
+AdaptiveResolution::AdaptiveResolution(const DS18B20SamplingConfig& cfg)
+    : _cfg(cfg) {}
+
+bool AdaptiveResolution::update(double T, double setpoint)
+{
+    if (_cfg.adaptive == false) {
+        return false;
+    }
+
+    const double err = std::fabs(T - setpoint);
+    const bool prevHighRes = _highRes;
+    if (_highRes && (err > _cfg.adaptiveBand + AdaptiveResolution::Hysteresis)) {
+        _highRes = false;
+    } else if ((_highRes == false) && (err <= _cfg.adaptiveBand)) {
+        _highRes = true;
+    }
+
+    return _highRes != prevHighRes;
+}
+
+DS18B20_RESOLUTION AdaptiveResolution::getResolution(void) const
+{
+    return _highRes ? _cfg.resolution : _cfg.lowResolution;
+}
+
+double AdaptiveResolution::getSamplePeriod(void) const
+{
+    // Sample as fast as possible when running at low resolution
+    return _highRes ? _cfg.samplePeriod : 0.0;
+}
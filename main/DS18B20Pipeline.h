@@ -0,0 +1,90 @@
+#ifndef DS18B20_PIPELINE_H
+#define DS18B20_PIPELINE_H
+
+#include "PBCommon.h"
+#include "Utilities.h"
+#include "ds18b20.h"
+
+// Sampling configuration for a single sensor role
+struct DS18B20SamplingConfig
+{
+    DS18B20_RESOLUTION resolution = DS18B20_RESOLUTION_INVALID;         // Resolution near the setpoint, or always if not adaptive
+    double samplePeriod = 0.0;                                          // Time between samples. 0 samples as fast as the resolution allows [s]
+    bool adaptive = false;                                              // Drop to lowResolution when far from the setpoint
+    DS18B20_RESOLUTION lowResolution = DS18B20_RESOLUTION_INVALID;      // Resolution used far from the setpoint
+    double adaptiveBand = 0.0;                                          // Distance from setpoint where full resolution is used [deg C]
+};
+
+// Sequences DS18B20 conversions for one sensor without blocking the caller.
+// A conversion is started and the caller returns immediately. On a later
+// tick, once the conversion time has elapsed, the scratchpad is read and the
+// next conversion is started when the sample period comes around. All timing
+// decisions are made on the timestamps passed in, so the state machine can
+// be driven by a mock clock on the host
+class DS18B20Pipeline
+{
+    public:
+        enum class State { IDLE, CONVERTING };
+        enum class Action { NONE, START_CONVERSION, READ };
+
+        DS18B20Pipeline(void) = default;
+        DS18B20Pipeline(double conversionTime, double samplePeriod);
+
+        // Returns the bus operation required at time t [us]
+        Action update(int64_t t) const;
+
+        // Notify the pipeline of completed bus operations
+        void conversionStarted(int64_t t);
+        void samplesRead(void);
+        void abort(void) { _state = State::IDLE; }
+
+        // Timing only takes effect from the next conversion
+        void setTiming(double conversionTime, double samplePeriod);
+
+        // Getters
+        State getState(void) const { return _state; }
+        int64_t getConversionStartTime(void) const { return _conversionStart; }
+        double getConversionTime(void) const { return _conversionTime * 1e-6; }
+        double getSamplePeriod(void) const { return _samplePeriod * 1e-6; }
+        const RunningStats& getSampleIntervalStats(void) const { return _sampleInterval; }
+        void resetStats(void) { _sampleInterval.reset(); }
+
+        static double getConversionTime(DS18B20_RESOLUTION res);
+
+    private:
+        int64_t _conversionTime = 0;        // [us]
+        int64_t _samplePeriod = 0;          // [us]
+        int64_t _conversionStart = 0;       // [us]
+        int64_t _nextStart = 0;             // [us]
+        int64_t _lastSampleTime = 0;        // [us]
+        bool _hasSample = false;
+        State _state = State::IDLE;
+
+        RunningStats _sampleInterval {};    // Time between successive samples [s]
+};
+
+// Chooses the resolution of an adaptive sensor. Full resolution is used
+// within adaptiveBand of the setpoint. Further away (e.g. during heat-up)
+// the sensor drops to lowResolution and samples as fast as that allows.
+// Hysteresis stops the sensor toggling at the edge of the band
+class AdaptiveResolution
+{
+    static constexpr double Hysteresis = 0.5;       // [deg C]
+
+    public:
+        AdaptiveResolution(void) = default;
+        explicit AdaptiveResolution(const DS18B20SamplingConfig& cfg);
+
+        // Returns true if the resolution changed
+        bool update(double T, double setpoint);
+
+        DS18B20_RESOLUTION getResolution(void) const;
+        double getSamplePeriod(void) const;
+        bool isHighResolution(void) const { return _highRes; }
+
+    private:
+        DS18B20SamplingConfig _cfg {};
+        bool _highRes = true;
+};
+
+#endif // DS18B20_PIPELINE_H
@@ -0,0 +1,112 @@
+#include "DeviceDiscovery.h"
+
+DeviceDiscovery::DeviceDiscovery(const DeviceDiscoveryConfig& cfg, size_t bus)
+    : _cfg(cfg), _bus(bus)
+{
+    _configured = checkInputs(cfg) == PBRet::SUCCESS;
+}
+
+PBRet DeviceDiscovery::checkInputs(const DeviceDiscoveryConfig& cfg)
+{
+    if (cfg.period <= 0.0) {
+        ESP_LOGE(DeviceDiscovery::Name, "Discovery period (%.2f) must be positive", cfg.period);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.missedPasses < 1) {
+        ESP_LOGE(DeviceDiscovery::Name, "Missed passes (%d) must be at least 1", cfg.missedPasses);
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+bool DeviceDiscovery::passDue(int64_t t) const
+{
+    return _configured && (_inPass == false) && (t >= _nextPass);
+}
+
+void DeviceDiscovery::beginPass(int64_t t)
+{
+    for (std::pair<const uint64_t, KnownDevice>& device : _known) {
+        device.second.seen = false;
+    }
+
+    _nextPass = t + static_cast<int64_t>(_cfg.period * 1e6);
+    _inPass = true;
+}
+
+void DeviceDiscovery::found(const OneWireBus_ROMCode& romCode)
+{
+    if (_inPass) {
+        _known[_toKey(romCode)].seen = true;
+    }
+}
+
+void DeviceDiscovery::endPass(std::vector<DiscoveryEvent>& events)
+{
+    // Compare the devices found this pass against the cache
+
+    if (_inPass == false) {
+        return;
+    }
+
+    std::unordered_map<uint64_t, KnownDevice>::iterator it = _known.begin();
+    while (it != _known.end()) {
+        DiscoveryEvent event {};
+        event.romCode = _fromKey(it->first);
+        event.bus = _bus;
+
+        if (it->second.seen) {
+            if (it->second.reported == false) {
+                event.type = DiscoveryEvent::Type::ADDED;
+                events.push_back(event);
+                it->second.reported = true;
+            }
+            it->second.missed = 0;
+            ++it;
+        } else if (++it->second.missed >= _cfg.missedPasses) {
+            event.type = DiscoveryEvent::Type::REMOVED;
+            events.push_back(event);
+            it = _known.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    _inPass = false;
+    _hasCompletedPass = true;
+}
+
+bool DeviceDiscovery::isKnown(const OneWireBus_ROMCode& romCode) const
+{
+    return _known.find(_toKey(romCode)) != _known.end();
+}
+
+void DeviceDiscovery::getKnownDevices(DeviceVector& devices) const
+{
+    devices.clear();
+    for (const std::pair<const uint64_t, KnownDevice>& device : _known) {
+        devices.push_back(_fromKey(device.first));
+    }
+}
+
+uint64_t DeviceDiscovery::_toKey(const OneWireBus_ROMCode& romCode)
+{
+    uint64_t key = 0;
+    for (size_t i = 0; i < sizeof(romCode.bytes); i++) {
+        key |= static_cast<uint64_t>(romCode.bytes[i]) << (8 * i);
+    }
+
+    return key;
+}
+
+OneWireBus_ROMCode DeviceDiscovery::_fromKey(uint64_t key)
+{
+    OneWireBus_ROMCode romCode {};
+    for (size_t i = 0; i < sizeof(romCode.bytes); i++) {
+        romCode.bytes[i] = static_cast<uint8_t>(key >> (8 * i));
+    }
+
+    return romCode;
+}
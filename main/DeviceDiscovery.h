@@ -0,0 +1,78 @@
+#ifndef DEVICE_DISCOVERY_H
+#define DEVICE_DISCOVERY_H
+
+#include <vector>
+#include <unordered_map>
+#include "PBCommon.h"
+#include "owb.h"
+
+using DeviceVector = std::vector<OneWireBus_ROMCode>;
+
+struct DeviceDiscoveryConfig
+{
+    double period = 0.0;                // Time between the start of discovery passes. 0 disables [s]
+    int missedPasses = 0;               // Passes a device must be missing for before it is removed
+};
+
+// A device appearing on or disappearing from a bus
+struct DiscoveryEvent
+{
+    enum class Type { ADDED, REMOVED };
+
+    Type type = Type::ADDED;
+    OneWireBus_ROMCode romCode {};
+    size_t bus = 0;
+};
+
+// Tracks the devices on a bus from an incremental ROM search. The search is
+// run one device per call between conversions, and each completed pass is
+// compared against the cache of known devices to produce add/remove events.
+// Devices are only removed once they have been missed for several passes, so
+// a single failed search doesn't drop a sensor. The cache answers device
+// lookups without a blocking scan once the first pass has completed
+class DeviceDiscovery
+{
+    static constexpr const char* Name = "DeviceDiscovery";
+
+    public:
+        DeviceDiscovery(void) = default;
+        DeviceDiscovery(const DeviceDiscoveryConfig& cfg, size_t bus);
+
+        // Pass sequencing. Timing is decided on the timestamps passed in so
+        // the logic can be driven by a mock clock on the host
+        bool passDue(int64_t t) const;
+        void beginPass(int64_t t);
+        void found(const OneWireBus_ROMCode& romCode);
+        void endPass(std::vector<DiscoveryEvent>& events);
+        void abortPass(void) { _inPass = false; }
+
+        // Cache
+        bool isKnown(const OneWireBus_ROMCode& romCode) const;
+        void getKnownDevices(DeviceVector& devices) const;
+        bool hasCompletedPass(void) const { return _hasCompletedPass; }
+        bool inPass(void) const { return _inPass; }
+
+        static PBRet checkInputs(const DeviceDiscoveryConfig& cfg);
+        bool isConfigured(void) const { return _configured; }
+
+    private:
+        static uint64_t _toKey(const OneWireBus_ROMCode& romCode);
+        static OneWireBus_ROMCode _fromKey(uint64_t key);
+
+        struct KnownDevice
+        {
+            int missed = 0;
+            bool seen = false;          // Found during the current pass
+            bool reported = false;      // ADDED event has been emitted
+        };
+
+        DeviceDiscoveryConfig _cfg {};
+        size_t _bus = 0;
+        std::unordered_map<uint64_t, KnownDevice> _known {};
+        int64_t _nextPass = 0;          // [us]
+        bool _inPass = false;
+        bool _hasCompletedPass = false;
+        bool _configured = false;
+};
+
+#endif // DEVICE_DISCOVERY_H
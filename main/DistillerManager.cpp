@@ -86,6 +86,25 @@ PBRet DistillerManager::_initFromParams(const DistillerConfig& cfg)
     // Connect to Wifi
     WifiManager::connect("PBLink", "pissbot1");
 
+    // Initialize SafetySupervisor. It runs above every other application
+    // task, so it is started first
+    _safetySupervisor = std::make_shared<SafetySupervisor> (20, 4096, 1, cfg.safetyConfig);
+    if (_safetySupervisor->isConfigured()) {
+        _safetySupervisor->begin();
+    } else {
+        ESP_LOGW(DistillerManager::Name, "Unable to start safety supervisor");
+    }
+
+    // Initialize SettingsStore. Saved settings are loaded when it is
+    // constructed, so it comes before the tasks that read them. Flash
+    // writes run below every other application task
+    _settingsStore = std::make_shared<SettingsStore> (2, 4096, 0, cfg.settingsConfig);
+    if (_settingsStore->isConfigured()) {
+        _settingsStore->begin();
+    } else {
+        ESP_LOGW(DistillerManager::Name, "Unable to start settings store. Settings will not be saved");
+    }
+
     // Initialize Controller
     _controller = std::make_shared<Controller> (7, 8192, 1, cfg.ctrlConfig);
     if (_controller->isConfigured()) {
@@ -147,6 +166,23 @@ PBRet DistillerManager::loadFromJSON(DistillerConfig& cfg, const cJSON* cfgRoot)
         return PBRet::FAILURE;
     }
 
+    // Load SafetySupervisor configuration. It drives the controller's
+    // outputs on a trip
+    cJSON* safetyNode = cJSON_GetObjectItem(cfgRoot, "SafetySupervisorConfig");
+    if (SafetySupervisor::loadFromJSON(cfg.safetyConfig, safetyNode) != PBRet::SUCCESS) {
+        return PBRet::FAILURE;
+    }
+    cfg.safetyConfig.element1Pin = cfg.ctrlConfig.element1Pin;
+    cfg.safetyConfig.element2Pin = cfg.ctrlConfig.element2Pin;
+    cfg.safetyConfig.refluxPumpConfig = cfg.ctrlConfig.refluxPumpConfig;
+    cfg.safetyConfig.prodPumpConfig = cfg.ctrlConfig.prodPumpConfig;
+
+    // Load SettingsStore configuration
+    cJSON* settingsNode = cJSON_GetObjectItem(cfgRoot, "SettingsStoreConfig");
+    if (SettingsStore::loadFromJSON(cfg.settingsConfig, settingsNode) != PBRet::SUCCESS) {
+        return PBRet::FAILURE;
+    }
+
     // Load Webserver configuration
     cJSON* webserverNode = cJSON_GetObjectItem(cfgRoot, "WebserverConfig");
     if (Webserver::loadFromJSON(cfg.webserverConfig, webserverNode) != PBRet::SUCCESS) {
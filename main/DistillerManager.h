@@ -7,6 +7,8 @@
 #include "WebServer.h"
 #include "driver/gpio.h"
 #include "SensorManager.h"
+#include "SafetySupervisor.h"
+#include "SettingsStore.h"
 #include "Generated/MessageBase.h"
 
 // Main system manager class. This class is a singleton and can be accessed
@@ -20,6 +22,8 @@ class DistillerConfig
         ControllerConfig ctrlConfig {};
         SensorManagerConfig sensorManagerConfig {};
         WebserverConfig webserverConfig {};
+        SafetySupervisorConfig safetyConfig {};
+        SettingsStoreConfig settingsConfig {};
 
         gpio_num_t LEDGPIO = (gpio_num_t) GPIO_NUM_NC;
 };
@@ -75,6 +79,8 @@ class DistillerManager : public Task
         std::shared_ptr<Webserver> _webserver;
         std::shared_ptr<Controller> _controller;
         std::shared_ptr<SensorManager> _sensorManager;
+        std::shared_ptr<SafetySupervisor> _safetySupervisor;
+        std::shared_ptr<SettingsStore> _settingsStore;
 };
 
 #endif // MAIN_DISTILLERMANAGER_H
\ No newline at end of file
@@ -0,0 +1,305 @@
+#include "ElementDriver.h"
+#include "SafetySupervisor.h"
+#include "hal/gpio_ll.h"
+#include "soc/soc_memory_layout.h"
+#include <cstring>
+
+// Timer ticks at 1 MHz
+static constexpr uint32_t TimerDivider = TIMER_BASE_CLK / 1000000;
+
+ElementDriver::~ElementDriver(void)
+{
+    stop();
+}
+
+PBRet ElementDriver::start(const ElementDriverConfig& cfg, const std::array<gpio_num_t, ElementCount>& pins)
+{
+    if (_running) {
+        ESP_LOGW(ElementDriver::Name, "Driver is already running");
+        return PBRet::FAILURE;
+    }
+
+    if (checkInputs(cfg) != PBRet::SUCCESS) {
+        return PBRet::FAILURE;
+    }
+
+    // The ISRs read the driver with the flash cache disabled, when external
+    // RAM can't be reached
+    if (esp_ptr_internal(this) == false) {
+        ESP_LOGE(ElementDriver::Name, "Driver must be in internal RAM");
+        return PBRet::FAILURE;
+    }
+
+    for (ElementModulator& modulator : _modulators) {
+        modulator.setMode(cfg.mode, cfg.burstSlots);
+    }
+    _pins = pins;
+    _allOff();
+
+    const double slotPeriod = 1.0 / cfg.slotFreq;
+    _zeroCrossTimeout = static_cast<uint32_t>(ZeroCrossTimeoutSlots * slotPeriod * 1e6);
+    _lastZeroCross.store(static_cast<uint32_t>(esp_timer_get_time()));
+    _zeroCrossLost.store(false);
+    if ((cfg.zeroCrossPin != GPIO_NUM_NC) && (_initZeroCross(cfg.zeroCrossPin) != PBRet::SUCCESS)) {
+        return PBRet::FAILURE;
+    }
+
+    if (_initTimer(cfg) != PBRet::SUCCESS) {
+        stop();
+        return PBRet::FAILURE;
+    }
+
+    _running = true;
+    return PBRet::SUCCESS;
+}
+
+PBRet ElementDriver::_initTimer(const ElementDriverConfig& cfg)
+{
+    const timer_config_t timerConf {
+        .alarm_en = TIMER_ALARM_EN,
+        .counter_en = TIMER_PAUSE,
+        .intr_type = TIMER_INTR_LEVEL,
+        .counter_dir = TIMER_COUNT_UP,
+        .auto_reload = TIMER_AUTORELOAD_EN,
+        .divider = TimerDivider
+    };
+    if (timer_init(cfg.timerGroup, cfg.timerIdx, &timerConf) != ESP_OK) {
+        ESP_LOGE(ElementDriver::Name, "Failed to initialize timer");
+        return PBRet::FAILURE;
+    }
+    _timerGroup = cfg.timerGroup;
+    _timerIdx = cfg.timerIdx;
+
+    // Auto reload happens in hardware at the alarm, so the slot period
+    // doesn't drift with interrupt latency
+    const uint64_t slotTicks = static_cast<uint64_t>(1e6 / cfg.slotFreq);
+    esp_err_t err = timer_set_counter_value(_timerGroup, _timerIdx, 0);
+    err |= timer_set_alarm_value(_timerGroup, _timerIdx, slotTicks);
+    err |= timer_enable_intr(_timerGroup, _timerIdx);
+    err |= timer_isr_callback_add(_timerGroup, _timerIdx, &ElementDriver::_timerISR, static_cast<void*>(this), ESP_INTR_FLAG_IRAM);
+    if (err != ESP_OK) {
+        ESP_LOGE(ElementDriver::Name, "Failed to configure timer interrupt");
+        return PBRet::FAILURE;
+    }
+
+    if (timer_start(_timerGroup, _timerIdx) != ESP_OK) {
+        ESP_LOGE(ElementDriver::Name, "Failed to start timer");
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet ElementDriver::stop(void)
+{
+    if (_zeroCrossPin != GPIO_NUM_NC) {
+        gpio_isr_handler_remove(_zeroCrossPin);
+        _zeroCrossPin = GPIO_NUM_NC;
+    }
+
+    if (_timerGroup == TIMER_GROUP_MAX) {
+        return PBRet::SUCCESS;
+    }
+
+    timer_pause(_timerGroup, _timerIdx);
+    timer_isr_callback_remove(_timerGroup, _timerIdx);
+    const esp_err_t err = timer_deinit(_timerGroup, _timerIdx);
+    _timerGroup = TIMER_GROUP_MAX;
+    _timerIdx = TIMER_MAX;
+    _running = false;
+    _allOff();
+
+    if (err != ESP_OK) {
+        ESP_LOGW(ElementDriver::Name, "Failed to release timer");
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet ElementDriver::_initZeroCross(gpio_num_t pin)
+{
+    const gpio_config_t zeroCrossConf {
+        .pin_bit_mask = (1ULL << pin),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_POSEDGE
+    };
+    if (gpio_config(&zeroCrossConf) != ESP_OK) {
+        ESP_LOGE(ElementDriver::Name, "Failed to configure zero crossing GPIO");
+        return PBRet::FAILURE;
+    }
+
+    // Every driver installs the service IRAM resident, so zero crossings
+    // keep starting slots while flash is busy
+    const esp_err_t err = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+    if ((err != ESP_OK) && (err != ESP_ERR_INVALID_STATE)) {
+        ESP_LOGE(ElementDriver::Name, "Failed to install ISR service");
+        return PBRet::FAILURE;
+    }
+
+    if (gpio_isr_handler_add(pin, ElementDriver::_zeroCrossISR, static_cast<void*>(this)) != ESP_OK) {
+        ESP_LOGE(ElementDriver::Name, "Failed to add zero crossing ISR");
+        return PBRet::FAILURE;
+    }
+
+    _zeroCrossPin = pin;
+    return PBRet::SUCCESS;
+}
+
+bool IRAM_ATTR ElementDriver::_timerISR(void* arg)
+{
+    // Runs in interrupt context with the cache possibly disabled. Only
+    // IRAM code and DRAM data from here on
+    ElementDriver* driver = static_cast<ElementDriver*>(arg);
+    if (driver->_zeroCrossPin == GPIO_NUM_NC) {
+        driver->_slot();
+        return false;
+    }
+
+    // The zero crossings start the slots. Turn the elements off if they
+    // stop, rather than leaving them in whatever state the last slot was
+    const uint32_t age = static_cast<uint32_t>(esp_timer_get_time()) - driver->_lastZeroCross.load();
+    if ((age > driver->_zeroCrossTimeout) && (driver->_zeroCrossLost.exchange(true) == false)) {
+        driver->_allOff();
+        ESP_DRAM_LOGW(DRAM_STR("ElementDriver"), "Zero crossings stopped. Elements off");
+    }
+
+    return false;
+}
+
+void IRAM_ATTR ElementDriver::_zeroCrossISR(void* arg)
+{
+    ElementDriver* driver = static_cast<ElementDriver*>(arg);
+    driver->_lastZeroCross.store(static_cast<uint32_t>(esp_timer_get_time()));
+    driver->_zeroCrossLost.store(false);
+    driver->_slot();
+}
+
+void IRAM_ATTR ElementDriver::_slot(void)
+{
+    // Modulators keep stepping through a trip so their state stays
+    // consistent, but the elements stay off
+    const bool tripped = SafetySupervisor::isTripped();
+    for (size_t i = 0; i < ElementCount; i++) {
+        const bool on = _modulators[i].step() && (tripped == false);
+        _setLevel(_pins[i], on);
+    }
+}
+
+void IRAM_ATTR ElementDriver::_allOff(void) const
+{
+    for (gpio_num_t pin : _pins) {
+        _setLevel(pin, false);
+    }
+}
+
+void IRAM_ATTR ElementDriver::_setLevel(gpio_num_t pin, bool on)
+{
+    // gpio_set_level lives in flash. Write the set/clear registers instead
+    if (pin != GPIO_NUM_NC) {
+        gpio_ll_set_level(&GPIO, pin, on ? 1 : 0);
+    }
+}
+
+PBRet ElementDriver::checkInputs(const ElementDriverConfig& cfg)
+{
+    // Check slot frequency is within bounds
+    if ((cfg.slotFreq < ElementDriverConfig::MIN_SLOT_FREQ) || (cfg.slotFreq > ElementDriverConfig::MAX_SLOT_FREQ)) {
+        ESP_LOGE(ElementDriver::Name, "Slot frequency (%.2f) was outside of the allowable bounds (%.2f, %.2f)", cfg.slotFreq, ElementDriverConfig::MIN_SLOT_FREQ, ElementDriverConfig::MAX_SLOT_FREQ);
+        return PBRet::FAILURE;
+    }
+
+    // Check timer is valid
+    if ((cfg.timerGroup < TIMER_GROUP_0) || (cfg.timerGroup >= TIMER_GROUP_MAX)) {
+        ESP_LOGE(ElementDriver::Name, "Timer group %d is invalid", cfg.timerGroup);
+        return PBRet::FAILURE;
+    }
+
+    if ((cfg.timerIdx < TIMER_0) || (cfg.timerIdx >= TIMER_MAX)) {
+        ESP_LOGE(ElementDriver::Name, "Timer index %d is invalid", cfg.timerIdx);
+        return PBRet::FAILURE;
+    }
+
+    // Check burst window is within bounds
+    if ((cfg.mode == ModulationMode::BURST) && ((cfg.burstSlots == 0) || (cfg.burstSlots > ElementModulator::MaxBurstSlots))) {
+        ESP_LOGE(ElementDriver::Name, "Burst window (%d slots) was outside of the allowable bounds (1, %d)", cfg.burstSlots, ElementModulator::MaxBurstSlots);
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet ElementDriver::loadFromJSON(ElementDriverConfig& cfg, const cJSON* cfgRoot)
+{
+    // Load ElementDriverConfig from JSON
+
+    if (cfgRoot == nullptr) {
+        ESP_LOGW(ElementDriver::Name, "cfgRoot was null");
+        return PBRet::FAILURE;
+    }
+
+    // Get slot frequency
+    cJSON* slotFreqNode = cJSON_GetObjectItem(cfgRoot, "slotFreq");
+    if (cJSON_IsNumber(slotFreqNode)) {
+        cfg.slotFreq = slotFreqNode->valuedouble;
+    } else {
+        ESP_LOGI(ElementDriver::Name, "Unable to read slot frequency from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get modulation mode
+    cJSON* modeNode = cJSON_GetObjectItem(cfgRoot, "mode");
+    if (cJSON_IsString(modeNode) == false) {
+        ESP_LOGI(ElementDriver::Name, "Unable to read modulation mode from JSON");
+        return PBRet::FAILURE;
+    }
+
+    if (strcmp(modeNode->valuestring, "sigmaDelta") == 0) {
+        cfg.mode = ModulationMode::SIGMA_DELTA;
+    } else if (strcmp(modeNode->valuestring, "burst") == 0) {
+        cfg.mode = ModulationMode::BURST;
+    } else {
+        ESP_LOGI(ElementDriver::Name, "Modulation mode %s is unknown", modeNode->valuestring);
+        return PBRet::FAILURE;
+    }
+
+    // Get burst window. This is optional, and only needed in burst mode
+    cJSON* burstSlotsNode = cJSON_GetObjectItem(cfgRoot, "burstSlots");
+    if (cJSON_IsNumber(burstSlotsNode)) {
+        cfg.burstSlots = burstSlotsNode->valueint;
+    } else if (cfg.mode == ModulationMode::BURST) {
+        ESP_LOGI(ElementDriver::Name, "Unable to read burst window from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get timer group
+    cJSON* timerGroupNode = cJSON_GetObjectItem(cfgRoot, "timerGroup");
+    if (cJSON_IsNumber(timerGroupNode)) {
+        cfg.timerGroup = static_cast<timer_group_t>(timerGroupNode->valueint);
+    } else {
+        ESP_LOGI(ElementDriver::Name, "Unable to read timer group from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get timer index
+    cJSON* timerIdxNode = cJSON_GetObjectItem(cfgRoot, "timerIndex");
+    if (cJSON_IsNumber(timerIdxNode)) {
+        cfg.timerIdx = static_cast<timer_idx_t>(timerIdxNode->valueint);
+    } else {
+        ESP_LOGI(ElementDriver::Name, "Unable to read timer index from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get zero crossing input. This is optional, the timer starts each
+    // slot if it is missing
+    cJSON* zeroCrossNode = cJSON_GetObjectItem(cfgRoot, "GPIO_zeroCross");
+    if (cJSON_IsNumber(zeroCrossNode)) {
+        cfg.zeroCrossPin = static_cast<gpio_num_t>(zeroCrossNode->valueint);
+    } else {
+        cfg.zeroCrossPin = GPIO_NUM_NC;
+    }
+
+    return PBRet::SUCCESS;
+}
@@ -0,0 +1,91 @@
+#ifndef MAIN_ELEMENT_DRIVER_H
+#define MAIN_ELEMENT_DRIVER_H
+
+#include <array>
+#include <atomic>
+#include "PBCommon.h"
+#include "ElementModulator.h"
+#include "driver/gpio.h"
+#include "driver/timer.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+
+struct ElementDriverConfig
+{
+    double slotFreq = 0.0;                                  // Modulation slots per second. Twice the mains frequency for a slot per half cycle [Hz]
+    ModulationMode mode = ModulationMode::SIGMA_DELTA;
+    uint32_t burstSlots = 0;                                // Burst window. Only used in burst mode [slots]
+    gpio_num_t zeroCrossPin = (gpio_num_t) GPIO_NUM_NC;     // Optional. Slots start on its rising edges instead of the timer
+    timer_group_t timerGroup = TIMER_GROUP_MAX;             // Hardware timer that clocks the slots
+    timer_idx_t timerIdx = TIMER_MAX;
+
+    static constexpr double MAX_SLOT_FREQ = 240.0;
+    static constexpr double MIN_SLOT_FREQ = 1.0;
+};
+
+enum class Element : size_t
+{
+    LP,
+    HP
+};
+
+static constexpr size_t ElementCount = 2;
+
+// Switches the heating elements from a hardware timer interrupt, one
+// modulation slot per alarm. The ISR is IRAM resident and writes the GPIO
+// registers directly, so edges land within interrupt latency of the alarm
+// no matter how loaded the tasks are, and keep going while flash is busy.
+// The driver must be in internal RAM for the same reason. Duties are handed
+// over through the modulators' atomics, so setDuty never blocks or
+// disables interrupts.
+//
+// With a zero crossing input each rising edge starts a slot instead and
+// the timer only watches for the edges stopping, turning the elements off
+// if they do. The zero crossing ISR is IRAM resident too, so flash writes
+// don't hold up slots. Elements are held off while the safety supervisor
+// is tripped
+class ElementDriver
+{
+    static constexpr const char* Name = "ElementDriver";
+    static constexpr uint32_t ZeroCrossTimeoutSlots = 3;   // Slots without a zero crossing before the elements are turned off
+
+    public:
+        ElementDriver(void) = default;
+        ~ElementDriver(void);
+        ElementDriver(const ElementDriver&) = delete;
+        ElementDriver& operator=(const ElementDriver&) = delete;
+
+        // Duties set before starting are kept
+        PBRet start(const ElementDriverConfig& cfg, const std::array<gpio_num_t, ElementCount>& pins);
+        PBRet stop(void);
+
+        PBRet setDuty(Element element, double duty) { return _modulators[static_cast<size_t>(element)].setDuty(duty); }
+        double getDuty(Element element) const { return _modulators[static_cast<size_t>(element)].getDuty(); }
+
+        bool isRunning(void) const { return _running; }
+        bool isZeroCrossLost(void) const { return _zeroCrossLost.load(); }
+
+        static PBRet checkInputs(const ElementDriverConfig& cfg);
+        static PBRet loadFromJSON(ElementDriverConfig& cfg, const cJSON* cfgRoot);
+
+    private:
+        PBRet _initTimer(const ElementDriverConfig& cfg);
+        PBRet _initZeroCross(gpio_num_t pin);
+        static bool IRAM_ATTR _timerISR(void* arg);
+        static void IRAM_ATTR _zeroCrossISR(void* arg);
+        void IRAM_ATTR _slot(void);
+        void IRAM_ATTR _allOff(void) const;
+        static void IRAM_ATTR _setLevel(gpio_num_t pin, bool on);
+
+        std::array<ElementModulator, ElementCount> _modulators {};
+        std::array<gpio_num_t, ElementCount> _pins {GPIO_NUM_NC, GPIO_NUM_NC};
+        gpio_num_t _zeroCrossPin = GPIO_NUM_NC;
+        uint32_t _zeroCrossTimeout = 0;                 // [us]
+        std::atomic<uint32_t> _lastZeroCross {0};       // Low 32 bits of the esp_timer time [us]
+        std::atomic<bool> _zeroCrossLost {false};
+        timer_group_t _timerGroup = TIMER_GROUP_MAX;
+        timer_idx_t _timerIdx = TIMER_MAX;
+        bool _running = false;
+};
+
+#endif // MAIN_ELEMENT_DRIVER_H
@@ -0,0 +1,51 @@
+#include "ElementModulator.h"
+#include <algorithm>
+#include <cmath>
+
+void ElementModulator::setMode(ModulationMode mode, uint32_t burstSlots)
+{
+    _mode = mode;
+    _burstSlots = std::max<uint32_t>(burstSlots, 1);
+    _error = 0;
+    _slot = 0;
+    _onSlots = 0;
+}
+
+PBRet ElementModulator::setDuty(double duty)
+{
+    if ((duty < 0.0) || (duty > 1.0)) {
+        ESP_LOGE(ElementModulator::Name, "Duty cycle (%.2f) was outside the valid range (0.0, 1.0)", duty);
+        return PBRet::FAILURE;
+    }
+
+    _duty.store(static_cast<uint32_t>(std::lround(duty * DutyOne)), std::memory_order_relaxed);
+    return PBRet::SUCCESS;
+}
+
+bool IRAM_ATTR ElementModulator::step(void)
+{
+    const uint32_t duty = _duty.load(std::memory_order_relaxed);
+
+    if (_mode == ModulationMode::SIGMA_DELTA) {
+        // First order sigma-delta. Fire whenever a whole slot of energy is
+        // owed
+        _error += duty;
+        if (_error >= DutyOne) {
+            _error -= DutyOne;
+            return true;
+        }
+        return false;
+    }
+
+    // Burst. The on slots for the window are fixed at its start, and the
+    // fraction of a slot left over is owed to the next window
+    if (_slot == 0) {
+        const uint32_t energy = duty * _burstSlots + _error;
+        _onSlots = energy / DutyOne;
+        _error = energy % DutyOne;
+    }
+
+    const bool on = _slot < _onSlots;
+    _slot = (_slot + 1 < _burstSlots) ? _slot + 1 : 0;
+    return on;
+}
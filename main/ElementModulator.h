@@ -0,0 +1,57 @@
+#ifndef MAIN_ELEMENT_MODULATOR_H
+#define MAIN_ELEMENT_MODULATOR_H
+
+#include <atomic>
+#include "PBCommon.h"
+#include "esp_attr.h"
+
+enum class ModulationMode
+{
+    SIGMA_DELTA,        // Spread on slots as evenly as possible. Least flicker
+    BURST               // On slots grouped at the start of each window. Fewest switches
+};
+
+// Integral cycle modulation of a heating element. Time is divided into
+// slots, ideally one mains half cycle each, and each slot is either fully
+// on or fully off. Duty is fixed point with DutyOne as full power, and the
+// quantisation error is carried from slot to slot (or window to window in
+// burst mode), so the long run average matches the duty to 1 / DutyOne.
+//
+// step is integer only, so it can be called from an ISR. Duty can be set
+// from any task while step is running
+class ElementModulator
+{
+    static constexpr const char* Name = "ElementModulator";
+
+    public:
+        static constexpr uint32_t DutyOne = 1u << 16;
+        static constexpr uint32_t MaxBurstSlots = 1000;
+
+        ElementModulator(void) = default;
+        ElementModulator(const ElementModulator&) = delete;
+        ElementModulator& operator=(const ElementModulator&) = delete;
+
+        // Select the modulation and clear the state. Not safe while step
+        // is being called
+        void setMode(ModulationMode mode, uint32_t burstSlots);
+
+        // Duty in [0, 1]. Burst mode picks it up at the next window
+        PBRet setDuty(double duty);
+        double getDuty(void) const { return static_cast<double>(_duty.load(std::memory_order_relaxed)) / DutyOne; }
+
+        // Advance one slot. Returns true if the element is on for it
+        bool IRAM_ATTR step(void);
+
+    private:
+        std::atomic<uint32_t> _duty {0};
+        static_assert(ATOMIC_INT_LOCK_FREE == 2, "Duty is handed to the slot ISR and must be lock free");
+        ModulationMode _mode = ModulationMode::SIGMA_DELTA;
+        uint32_t _burstSlots = 1;
+
+        // Slot state
+        uint32_t _error = 0;        // Energy owed from earlier slots [DutyOne = 1 slot]
+        uint32_t _slot = 0;         // Position in the burst window
+        uint32_t _onSlots = 0;      // On slots in the current burst window
+};
+
+#endif // MAIN_ELEMENT_MODULATOR_H
@@ -0,0 +1,131 @@
+#include "Feedforward.h"
+#include "Utilities.h"
+
+Feedforward::Feedforward(const FeedforwardConfig& cfg)
+    : _cfg(cfg)
+{
+    if (checkInputs(cfg) != PBRet::SUCCESS) {
+        return;
+    }
+
+    _configured = true;
+}
+
+double Feedforward::compute(double LPDuty, double HPDuty, double boilerTemp) const
+{
+    if (_configured == false) {
+        return 0.0;
+    }
+
+    const double output = _cfg.LPElementGain * LPDuty + _cfg.HPElementGain * HPDuty + _cfg.boilerTempGain * (boilerTemp - _cfg.boilerTempRef);
+
+    // Held at the ends of the vapour curve
+    double fraction = 1.0;
+    if (_cfg.vapourFraction.empty() == false) {
+        const double T = Utilities::bound(boilerTemp, _cfg.boilerTemp.front(), _cfg.boilerTemp.back());
+        Utilities::interpLinear(_cfg.boilerTemp, _cfg.vapourFraction, T, fraction);
+    }
+
+    return std::max(fraction * output, 0.0);
+}
+
+PBRet Feedforward::checkInputs(const FeedforwardConfig& cfg)
+{
+    if ((cfg.LPElementGain < 0.0) || (cfg.HPElementGain < 0.0)) {
+        ESP_LOGE(Feedforward::Name, "Element gains (%.2f, %.2f) must not be negative", cfg.LPElementGain, cfg.HPElementGain);
+        return PBRet::FAILURE;
+    }
+
+    // Vapour curve needs a fraction for every temperature
+    if (cfg.boilerTemp.size() != cfg.vapourFraction.size()) {
+        ESP_LOGE(Feedforward::Name, "Vapour curve has %d temperatures and %d fractions", cfg.boilerTemp.size(), cfg.vapourFraction.size());
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.vapourFraction.size() == 1) {
+        ESP_LOGE(Feedforward::Name, "Vapour curve needs at least 2 points");
+        return PBRet::FAILURE;
+    }
+
+    for (size_t i = 0; i < cfg.vapourFraction.size(); i++) {
+        if ((cfg.vapourFraction[i] < 0.0) || (cfg.vapourFraction[i] > 1.0)) {
+            ESP_LOGE(Feedforward::Name, "Vapour curve point %d must be in [0, 1]", i);
+            return PBRet::FAILURE;
+        }
+
+        if ((i > 0) && (cfg.boilerTemp[i] <= cfg.boilerTemp[i - 1])) {
+            ESP_LOGE(Feedforward::Name, "Vapour curve temperatures must be increasing");
+            return PBRet::FAILURE;
+        }
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet Feedforward::loadFromJSON(FeedforwardConfig& cfg, const cJSON* cfgRoot)
+{
+    // Load FeedforwardConfig struct from JSON
+
+    if (cfgRoot == nullptr) {
+        ESP_LOGW(Feedforward::Name, "cfgRoot was null");
+        return PBRet::FAILURE;
+    }
+
+    // Get LP element gain
+    cJSON* LPElementGainNode = cJSON_GetObjectItem(cfgRoot, "LPElementGain");
+    if (cJSON_IsNumber(LPElementGainNode)) {
+        cfg.LPElementGain = LPElementGainNode->valuedouble;
+    } else {
+        ESP_LOGI(Feedforward::Name, "Unable to read LP element gain from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get HP element gain
+    cJSON* HPElementGainNode = cJSON_GetObjectItem(cfgRoot, "HPElementGain");
+    if (cJSON_IsNumber(HPElementGainNode)) {
+        cfg.HPElementGain = HPElementGainNode->valuedouble;
+    } else {
+        ESP_LOGI(Feedforward::Name, "Unable to read HP element gain from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get boiler temperature gain
+    cJSON* boilerTempGainNode = cJSON_GetObjectItem(cfgRoot, "boilerTempGain");
+    if (cJSON_IsNumber(boilerTempGainNode)) {
+        cfg.boilerTempGain = boilerTempGainNode->valuedouble;
+    } else {
+        ESP_LOGI(Feedforward::Name, "Unable to read boiler temperature gain from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get boiler reference temperature
+    cJSON* boilerTempRefNode = cJSON_GetObjectItem(cfgRoot, "boilerTempRef");
+    if (cJSON_IsNumber(boilerTempRefNode)) {
+        cfg.boilerTempRef = boilerTempRefNode->valuedouble;
+    } else {
+        ESP_LOGI(Feedforward::Name, "Unable to read boiler reference temperature from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get vapour curve. This is optional, all of the feedforward is
+    // applied if it is missing
+    cfg.boilerTemp.clear();
+    cfg.vapourFraction.clear();
+    cJSON* vapourCurveNode = cJSON_GetObjectItem(cfgRoot, "vapourCurve");
+    if (cJSON_IsArray(vapourCurveNode)) {
+        cJSON* pointNode = nullptr;
+        cJSON_ArrayForEach(pointNode, vapourCurveNode) {
+            cJSON* boilerTempNode = cJSON_GetObjectItem(pointNode, "boilerTemp");
+            cJSON* fractionNode = cJSON_GetObjectItem(pointNode, "fraction");
+            if ((cJSON_IsNumber(boilerTempNode) == false) || (cJSON_IsNumber(fractionNode) == false)) {
+                ESP_LOGI(Feedforward::Name, "Unable to read vapour curve point from JSON");
+                return PBRet::FAILURE;
+            }
+
+            cfg.boilerTemp.push_back(boilerTempNode->valuedouble);
+            cfg.vapourFraction.push_back(fractionNode->valuedouble);
+        }
+    }
+
+    return PBRet::SUCCESS;
+}
@@ -0,0 +1,43 @@
+#ifndef MAIN_FEEDFORWARD_H
+#define MAIN_FEEDFORWARD_H
+
+#include <vector>
+#include "PBCommon.h"
+#include "cJSON.h"
+
+struct FeedforwardConfig
+{
+    double LPElementGain = 0.0;             // Pump speed at full LP element duty [pump speed]
+    double HPElementGain = 0.0;             // Pump speed at full HP element duty [pump speed]
+    double boilerTempGain = 0.0;            // Pump speed per deg C above boilerTempRef. Negative to account for boiler heat loss [pump speed / deg C]
+    double boilerTempRef = 0.0;             // [deg C]
+    std::vector<double> boilerTemp {};      // Breakpoints of the vapour curve [deg C]
+    std::vector<double> vapourFraction {};  // Fraction of the feedforward applied at each breakpoint. Empty applies all of it
+};
+
+// Reflux pump speed expected to hold the head at setpoint for the current
+// heat input. Element power that isn't lost from the boiler leaves as
+// vapour, and the reflux condenser has to take up most of it. The vapour
+// curve scales the result while the wash is coming up to the boil and
+// little of the power reaches the head
+class Feedforward
+{
+    static constexpr const char* Name = "Feedforward";
+
+    public:
+        Feedforward(void) = default;
+        explicit Feedforward(const FeedforwardConfig& cfg);
+
+        // Element duties are [0, 1]. Never negative [pump speed]
+        double compute(double LPDuty, double HPDuty, double boilerTemp) const;
+
+        static PBRet checkInputs(const FeedforwardConfig& cfg);
+        static PBRet loadFromJSON(FeedforwardConfig& cfg, const cJSON* cfgRoot);
+        bool isConfigured(void) const { return _configured; }
+
+    private:
+        FeedforwardConfig _cfg {};
+        bool _configured = false;
+};
+
+#endif // MAIN_FEEDFORWARD_H
@@ -0,0 +1,30 @@
+#ifndef FLOW_TABLES
+#define FLOW_TABLES
+
+#include <vector>
+
+// Coolant density lookup table
+// Density of air free water at p = 1 atm, from the IAPWS-95 formulation as
+// tabulated in the CRC Handbook of Chemistry and Physics
+//
+// Values outside the table are clamped to its ends
+
+namespace FlowTables
+{
+    static constexpr double MIN_TEMPERATURE = 0.0;
+    static constexpr double MAX_TEMPERATURE = 100.0;
+    static constexpr double REFERENCE_TEMPERATURE = 20.0;   // Assumed until a coolant temperature is read
+
+    static const std::vector<double> T = {
+        0.0, 5.0, 10.0, 15.0, 20.0, 25.0, 30.0, 35.0, 40.0, 45.0, 50.0,
+        55.0, 60.0, 65.0, 70.0, 75.0, 80.0, 85.0, 90.0, 95.0, 100.0
+    };
+
+    // [kg / L]
+    static const std::vector<double> waterDensity = {
+        0.99984, 0.99997, 0.99970, 0.99910, 0.99821, 0.99705, 0.99565, 0.99403, 0.99222, 0.99021, 0.98804,
+        0.98569, 0.98320, 0.98055, 0.97776, 0.97484, 0.97179, 0.96861, 0.96531, 0.96189, 0.95835
+    };
+}
+
+#endif // FLOW_TABLES
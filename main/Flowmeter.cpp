@@ -1,59 +1,55 @@
 #include "Flowmeter.h"
-#include "driver/gpio.h"
-
-void IRAM_ATTR Flowmeter::flowmeterISR(void* arg)
-{
-    // Increment the pulse counter on the appropriate flowmeter object
-    Flowmeter* flowmeter = static_cast<Flowmeter*>(arg);
-    flowmeter->incrementFreqCounter();
-}
+#include "Utilities.h"
+#include <algorithm>
 
 Flowmeter::Flowmeter(const FlowmeterConfig& cfg)
+    : Flowmeter(cfg, nullptr)
+{}
+
+Flowmeter::Flowmeter(const FlowmeterConfig& cfg, std::unique_ptr<PulseCounter> counter)
 {
-    if (_initFromParams(cfg) != PBRet::FAILURE) {
+    if (_initFromParams(cfg, std::move(counter)) != PBRet::FAILURE) {
         ESP_LOGI(Flowmeter::Name, "Flowmeter configured on pin %d", cfg.flowmeterPin);
     } else {
         ESP_LOGW(Flowmeter::Name, "Flowmeter was not configured on pin %d", cfg.flowmeterPin);
     }
 }
 
-PBRet Flowmeter::_initFromParams(const FlowmeterConfig& cfg)
+PBRet Flowmeter::_initFromParams(const FlowmeterConfig& cfg, std::unique_ptr<PulseCounter> counter)
 {
     // Check inputs are valid
     if (checkInputs(cfg) == PBRet::FAILURE) {
         return PBRet::FAILURE;
     }
 
-    // Initialize flowmeter GPIO
-    gpio_config_t io_conf = {
-        .pin_bit_mask = (1ULL << cfg.flowmeterPin),
-        .mode = GPIO_MODE_INPUT,
-        .pull_up_en = GPIO_PULLUP_ENABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_POSEDGE
-    };
-
-    if (gpio_config(&io_conf) != ESP_OK) {
-        ESP_LOGE(Flowmeter::Name, "Failed to configure flowmeter GPIO");
-        return PBRet::FAILURE;
+    // Count pulses in the PCNT peripheral where possible. The GPIO
+    // interrupt is kept as a fallback. A counter passed in is used as is
+    if ((counter == nullptr) && (cfg.pcntUnit >= 0)) {
+        counter.reset(new PCNTCounter(cfg.flowmeterPin, static_cast<pcnt_unit_t>(cfg.pcntUnit)));
+        if (counter->isConfigured() == false) {
+            ESP_LOGW(Flowmeter::Name, "PCNT unit %d unavailable. Falling back to GPIO interrupt", cfg.pcntUnit);
+            counter.reset();
+        }
     }
 
-    const esp_err_t err = gpio_install_isr_service(0);
-    if (err != ESP_OK) {
-        if (err != ESP_ERR_INVALID_STATE) {
-            // TODO: Tidy this conditional up
-            ESP_LOGE(Flowmeter::Name, "Failed to install ISR service");
-            return PBRet::FAILURE;
-        }
+    if (counter == nullptr) {
+        counter.reset(new ISRCounter(cfg.flowmeterPin));
     }
 
-    if (gpio_isr_handler_add(cfg.flowmeterPin, Flowmeter::flowmeterISR, static_cast<void*>(this)) != ESP_OK) {
-        ESP_LOGE(Flowmeter::Name, "Failed to add flowmeter ISR");
+    if (counter->isConfigured() == false) {
+        ESP_LOGE(Flowmeter::Name, "Failed to configure pulse counter");
         return PBRet::FAILURE;
     }
 
+    _counter = std::move(counter);
+    _lastCount = _counter->getCount();
     _cfg = cfg;
     _configured = true;
+
+    // Coolant is assumed to be at the reference temperature until told
+    // otherwise
+    _density = 0.0;
+    setFluidTemperature(FlowTables::REFERENCE_TEMPERATURE);
     return PBRet::SUCCESS;
 }
 
@@ -61,25 +57,151 @@ PBRet Flowmeter::readMassFlowrate(int64_t t, double& flowrate)
 {
     // Compute the flowrate from accumulated pulses
     // Ref: https://www.trigasdm.com/files/doc/UVC%20Principles%20EN.pdf
-    // TODO: Account for temperature of coolant
+    if (_configured == false) {
+        ESP_LOGW(Flowmeter::Name, "Cannot read flowrate before flowmeter is configured");
+        return PBRet::FAILURE;
+    }
+
     const double dt = (t - _lastUpdateTime) * 1e-6;     // Convert to seconds
     if (dt < 0) {
         ESP_LOGW(Flowmeter::Name, "dt was negative");
         return PBRet::FAILURE;
     }
 
-    // Note: Currently assumes density of coolant is 1kg / L
-    flowrate = _freqCounter * _cfg.kFactor / dt;        // Compute flowrate [L / s]
+    // Pulses since the last update. Unsigned subtraction handles the
+    // counter wrapping
+    const uint32_t count = _counter->getCount();
+    const uint32_t pulses = count - _lastCount;
+    double pulseRate = pulses / dt;
+
+    // At low rates the pulse period gives a finer measurement. The count
+    // is kept in case edges were missed
+    double periodRate = 0.0;
+    if ((_mode == FlowmeterMode::PERIOD) && (_readPeriodRate(t, periodRate) == PBRet::SUCCESS)) {
+        pulseRate = periodRate;
+    }
+    _updateMode(pulseRate);
+
+    // Volume per pulse depends on pulse rate. Convert to mass with the
+    // density at the last coolant temperature
+    _volumetricFlowrate = pulseRate * _kFactorAt(pulseRate);    // [L / s]
+    flowrate = _volumetricFlowrate * _density;                  // [kg / s]
     _flowrate = flowrate;
-    _lastUpdateTime = t;               
-    _freqCounter = 0;                                   // Reset counter
 
+    // The rate is a mean over the window, so belongs to its middle
+    _sampleTime = _lastUpdateTime + (t - _lastUpdateTime) / 2;
+    _lastUpdateTime = t;
+    _lastCount = count;
+
+    return PBRet::SUCCESS;
+}
+
+void Flowmeter::setFluidTemperature(double T)
+{
+    // Density only changes with the coolant temperature, so the table is
+    // searched here rather than on every read
+
+    if (Utilities::check(T) == false) {
+        return;
+    }
+
+    T = Utilities::bound(T, FlowTables::MIN_TEMPERATURE, FlowTables::MAX_TEMPERATURE);
+    if ((T == _fluidTemperature) && (_density > 0.0)) {
+        return;
+    }
+
+    double density = 0.0;
+    if (Utilities::interpLinear(FlowTables::T, FlowTables::waterDensity, T, density) == PBRet::SUCCESS) {
+        _fluidTemperature = T;
+        _density = density;
+    }
+}
+
+double Flowmeter::_kFactorAt(double pulseRate) const
+{
+    // Interpolate the K-factor curve. Rates outside the curve use the
+    // nearest end
+
+    if (_cfg.kFactorCurve.empty()) {
+        return _cfg.kFactor;
+    }
+
+    const double f = Utilities::bound(pulseRate, _cfg.kFactorFrequency.front(), _cfg.kFactorFrequency.back());
+    double kFactor = _cfg.kFactorCurve.front();
+    Utilities::interpLinear(_cfg.kFactorFrequency, _cfg.kFactorCurve, f, kFactor);
+
+    return kFactor;
+}
+
+PBRet Flowmeter::_readPeriodRate(int64_t t, double& pulseRate)
+{
+    // Mean pulse period over the edges since the last update, measured from
+    // the last edge of the previous window so no period is lost
+
+    const bool dropped = _counter->edgesDropped();
+    int64_t start = _lastEdgeTime;
+    size_t periods = 0;
+    int64_t edge = 0;
+    while (_counter->popEdge(edge)) {
+        if (_hasEdge) {
+            periods++;
+        } else {
+            start = edge;
+            _hasEdge = true;
+        }
+        _lastEdgeTime = edge;
+    }
+
+    // Missed edges make the periods meaningless. Start again from the next
+    // edge
+    if (dropped) {
+        _hasEdge = false;
+        _period = 0.0;
+        return PBRet::FAILURE;
+    }
+
+    if (periods > 0) {
+        _period = static_cast<double>(_lastEdgeTime - start) / periods;
+    }
+
+    if ((_hasEdge == false) || (_period <= 0.0)) {
+        return PBRet::FAILURE;
+    }
+
+    // Without a new edge the period is at least the time since the last
+    // one, so the rate falls away smoothly when flow stops
+    const int64_t sinceEdge = t - _lastEdgeTime;
+    if (sinceEdge > MaxPulsePeriod) {
+        pulseRate = 0.0;
+        return PBRet::SUCCESS;
+    }
+
+    pulseRate = 1e6 / std::max(_period, static_cast<double>(sinceEdge));
     return PBRet::SUCCESS;
 }
 
-void Flowmeter::incrementFreqCounter(void) volatile
+void Flowmeter::_updateMode(double pulseRate)
 {
-    _freqCounter++;
+    // Switch between counting and period measurement. Hysteresis stops the
+    // mode chattering around the threshold
+
+    if (_cfg.periodModeRate <= 0.0) {
+        return;
+    }
+
+    if ((_mode == FlowmeterMode::COUNT) && (pulseRate < _cfg.periodModeRate)) {
+        // Discard edges left from before the switch
+        _counter->clearEdges();
+        _counter->edgesDropped();
+        if (_counter->enableTimestamps(true) == PBRet::SUCCESS) {
+            _mode = FlowmeterMode::PERIOD;
+            _hasEdge = false;
+            _period = 0.0;
+        }
+    } else if ((_mode == FlowmeterMode::PERIOD) && (pulseRate > _cfg.periodModeRate * ModeHysteresis)) {
+        _counter->enableTimestamps(false);
+        _mode = FlowmeterMode::COUNT;
+    }
 }
 
 PBRet Flowmeter::checkInputs(const FlowmeterConfig& cfg)
@@ -90,12 +212,46 @@ PBRet Flowmeter::checkInputs(const FlowmeterConfig& cfg)
         return PBRet::FAILURE;
     }
 
-    // K-factor should be positive
-    if (cfg.kFactor <= 0) {
+    // K-factor should be positive. It is only used without a curve
+    if (cfg.kFactorCurve.empty() && (cfg.kFactor <= 0)) {
         ESP_LOGE(Flowmeter::Name, "K factor must be greater than 0");
         return PBRet::FAILURE;
     }
 
+    // K-factor curve needs a K for every frequency
+    if (cfg.kFactorFrequency.size() != cfg.kFactorCurve.size()) {
+        ESP_LOGE(Flowmeter::Name, "K factor curve has %d frequencies and %d K factors", cfg.kFactorFrequency.size(), cfg.kFactorCurve.size());
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.kFactorCurve.size() == 1) {
+        ESP_LOGE(Flowmeter::Name, "K factor curve needs at least 2 points");
+        return PBRet::FAILURE;
+    }
+
+    for (size_t i = 0; i < cfg.kFactorCurve.size(); i++) {
+        if (cfg.kFactorCurve[i] <= 0.0) {
+            ESP_LOGE(Flowmeter::Name, "K factor curve point %d must be greater than 0", i);
+            return PBRet::FAILURE;
+        }
+
+        if ((i > 0) && (cfg.kFactorFrequency[i] <= cfg.kFactorFrequency[i - 1])) {
+            ESP_LOGE(Flowmeter::Name, "K factor curve frequencies must be increasing");
+            return PBRet::FAILURE;
+        }
+    }
+
+    // Check PCNT unit exists
+    if (cfg.pcntUnit >= PCNT_UNIT_MAX) {
+        ESP_LOGE(Flowmeter::Name, "PCNT unit %d is invalid", cfg.pcntUnit);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.periodModeRate < 0.0) {
+        ESP_LOGE(Flowmeter::Name, "Period mode rate (%.2f) must not be negative", cfg.periodModeRate);
+        return PBRet::FAILURE;
+    }
+
     return PBRet::SUCCESS;
 }
 
@@ -116,14 +272,44 @@ PBRet Flowmeter::loadFromJSON(FlowmeterConfig& cfg, const cJSON* cfgRoot)
         return PBRet::FAILURE;
     }
 
-    // Get flowmeter K-factor
+    // Get flowmeter K-factor curve. This is optional, the single K-factor
+    // is used if it is missing
+    cfg.kFactorFrequency.clear();
+    cfg.kFactorCurve.clear();
+    cJSON* kFactorCurveNode = cJSON_GetObjectItem(cfgRoot, "kFactorCurve");
+    if (cJSON_IsArray(kFactorCurveNode)) {
+        cJSON* pointNode = nullptr;
+        cJSON_ArrayForEach(pointNode, kFactorCurveNode) {
+            cJSON* frequencyNode = cJSON_GetObjectItem(pointNode, "frequency");
+            cJSON* pointKFactorNode = cJSON_GetObjectItem(pointNode, "kFactor");
+            if ((cJSON_IsNumber(frequencyNode) == false) || (cJSON_IsNumber(pointKFactorNode) == false)) {
+                ESP_LOGI(Flowmeter::Name, "Unable to read flowmeter K-factor curve point from JSON");
+                return PBRet::FAILURE;
+            }
+
+            cfg.kFactorFrequency.push_back(frequencyNode->valuedouble);
+            cfg.kFactorCurve.push_back(pointKFactorNode->valuedouble);
+        }
+    }
+
+    // Get flowmeter K-factor. Only required without a curve
     cJSON* kFactorNode = cJSON_GetObjectItem(cfgRoot, "kFactor");
     if (cJSON_IsNumber(kFactorNode)) {
-        cfg.kFactor = static_cast<gpio_num_t>(kFactorNode->valuedouble);
-    } else {
+        cfg.kFactor = kFactorNode->valuedouble;
+    } else if (cfg.kFactorCurve.empty()) {
         ESP_LOGI(Flowmeter::Name, "Unable to read flowmeter K-factor from JSON");
         return PBRet::FAILURE;
     }
 
+    // Get PCNT unit. This is optional, pulses are counted in a GPIO
+    // interrupt if it is missing
+    cJSON* pcntUnitNode = cJSON_GetObjectItem(cfgRoot, "PCNTUnit");
+    cfg.pcntUnit = cJSON_IsNumber(pcntUnitNode) ? pcntUnitNode->valueint : -1;
+
+    // Get period mode rate. This is optional, pulses are always counted if
+    // it is missing
+    cJSON* periodModeRateNode = cJSON_GetObjectItem(cfgRoot, "periodModeRate");
+    cfg.periodModeRate = cJSON_IsNumber(periodModeRateNode) ? periodModeRateNode->valuedouble : 0.0;
+
     return PBRet::SUCCESS;
 }
\ No newline at end of file
@@ -1,26 +1,43 @@
 #ifndef FLOWMETER_H
 #define FLOWMETER_H
 
+#include <memory>
+#include <vector>
 #include "PBCommon.h"
+#include "PulseCounter.h"
+#include "FlowTables.h"
 #include "cJSON.h"
 
 struct FlowmeterConfig
 {
     gpio_num_t flowmeterPin = (gpio_num_t)GPIO_NUM_NC;
-    double kFactor = 0.0;       // Assume linear for now. Add several k factors if required
+    double kFactor = 0.0;       // Used when no K-factor curve is given [L / pulse]
+    std::vector<double> kFactorFrequency {};    // K-factor curve breakpoints, increasing [Hz]
+    std::vector<double> kFactorCurve {};        // K-factor at each breakpoint [L / pulse]
+    int pcntUnit = -1;          // PCNT unit that counts pulses. Negative uses a GPIO interrupt
+    double periodModeRate = 0.0;    // Measure pulse periods below this rate. 0 always counts [Hz]
 };
 
+// Counting pulses over a window resolves the rate to 1 / dt, which is
+// coarse at low flow. Below periodModeRate the time between pulse edges is
+// measured instead
+enum class FlowmeterMode { COUNT, PERIOD };
+
 class Flowmeter
 {
     static constexpr const char* Name = "Flowmeter";
+    static constexpr double ModeHysteresis = 1.5;          // Return to counting above periodModeRate * ModeHysteresis
+    static constexpr int64_t MaxPulsePeriod = 5000000;     // No pulse for this long is zero flow [us]
 
     public:
         // Constructors
         Flowmeter(void) = default;
         explicit Flowmeter(const FlowmeterConfig& cfg);
+        Flowmeter(const FlowmeterConfig& cfg, std::unique_ptr<PulseCounter> counter);
 
         // Update
         PBRet readMassFlowrate(int64_t t, double& flowrate);
+        void setFluidTemperature(double T);
 
         // Utility
         static PBRet checkInputs(const FlowmeterConfig& cfg);
@@ -28,22 +45,35 @@ class Flowmeter
 
         // Getters
         double getFlowrate(void) const { return _flowrate; }
+        double getVolumetricFlowrate(void) const { return _volumetricFlowrate; }
+        double getDensity(void) const { return _density; }
+        int64_t getSampleTime(void) const { return _sampleTime; }
+        FlowmeterMode getMode(void) const { return _mode; }
         bool isConfigured(void) const { return _configured; }
 
-        // Increment frequency counter
-        void incrementFreqCounter(void) volatile;
-
-        // Flowmeter ISR
-        static void IRAM_ATTR flowmeterISR(void* arg);
-
-        friend class FlowmeterUT;
-
     private:
-        PBRet _initFromParams(const FlowmeterConfig& cfg);
+        PBRet _initFromParams(const FlowmeterConfig& cfg, std::unique_ptr<PulseCounter> counter);
+        PBRet _readPeriodRate(int64_t t, double& pulseRate);
+        void _updateMode(double pulseRate);
+        double _kFactorAt(double pulseRate) const;
+
         FlowmeterConfig _cfg {};
+        std::unique_ptr<PulseCounter> _counter {};
         int64_t _lastUpdateTime = 0;        // Time of last update [uS]
-        uint16_t _freqCounter = 0;          // Internal pulse counter
+        int64_t _sampleTime = 0;            // Time the current flowrate applies to [uS]
+        uint32_t _lastCount = 0;            // Pulse count at last update
         double _flowrate = 0;               // Current flowrate [kg/s]
+        double _volumetricFlowrate = 0.0;   // Current flowrate [L/s]
+
+        // Density correction
+        double _fluidTemperature = FlowTables::REFERENCE_TEMPERATURE;  // [deg C]
+        double _density = 0.0;              // Coolant density at _fluidTemperature [kg/L]
+
+        // Period measurement
+        FlowmeterMode _mode = FlowmeterMode::COUNT;
+        int64_t _lastEdgeTime = 0;          // [uS]
+        double _period = 0.0;               // Mean pulse period over the last window [uS]
+        bool _hasEdge = false;
         bool _configured = false;
 };
 
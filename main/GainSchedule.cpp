@@ -0,0 +1,151 @@
+#include "GainSchedule.h"
+#include "ABVTables.h"
+#include "Utilities.h"
+#include <cstring>
+
+GainSchedule::GainSchedule(const GainScheduleConfig& cfg)
+    : _variable(cfg.variable)
+{
+    if ((checkInputs(cfg) != PBRet::SUCCESS) || cfg.points.empty()) {
+        return;
+    }
+
+    // Each segment runs from its point to the next. The last one is flat
+    _size = cfg.points.size();
+    for (size_t i = 0; i < _size; i++) {
+        Segment& seg = _segments[i];
+        seg.start = cfg.points[i];
+        if (i + 1 < _size) {
+            const GainSchedulePoint& next = cfg.points[i + 1];
+            const double dx = next.x - seg.start.x;
+            seg.dP = (next.PGain - seg.start.PGain) / dx;
+            seg.dI = (next.IGain - seg.start.IGain) / dx;
+            seg.dD = (next.DGain - seg.start.DGain) / dx;
+        }
+    }
+
+    _configured = true;
+}
+
+GainSchedulePoint GainSchedule::evaluate(double x)
+{
+    if (_configured == false) {
+        return GainSchedulePoint {};
+    }
+
+    // Hold the first point below the table
+    const double xMin = _segments[0].start.x;
+    if (x <= xMin) {
+        _last = 0;
+        GainSchedulePoint gains = _segments[0].start;
+        gains.x = x;
+        return gains;
+    }
+
+    // Walk from the last segment to the one containing x
+    while ((_last + 1 < _size) && (x >= _segments[_last + 1].start.x)) {
+        _last++;
+    }
+    while ((_last > 0) && (x < _segments[_last].start.x)) {
+        _last--;
+    }
+
+    const Segment& seg = _segments[_last];
+    const double dx = x - seg.start.x;
+
+    GainSchedulePoint gains {};
+    gains.x = x;
+    gains.PGain = seg.start.PGain + seg.dP * dx;
+    gains.IGain = seg.start.IGain + seg.dI * dx;
+    gains.DGain = seg.start.DGain + seg.dD * dx;
+
+    return gains;
+}
+
+double GainSchedule::boilerABV(double boilerTemp)
+{
+    const double T = Utilities::bound(boilerTemp, ABVTables::MIN_TEMPERATURE, ABVTables::MAX_TEMPERATURE);
+    double ABV = ABVTables::liquidABV.front();
+    Utilities::interpLinear(ABVTables::T, ABVTables::liquidABV, T, ABV);
+
+    return ABV;
+}
+
+PBRet GainSchedule::checkInputs(const GainScheduleConfig& cfg)
+{
+    if (cfg.points.size() > MaxPoints) {
+        ESP_LOGE(GainSchedule::Name, "Gain schedule has %d points. At most %d are supported", cfg.points.size(), MaxPoints);
+        return PBRet::FAILURE;
+    }
+
+    for (size_t i = 0; i < cfg.points.size(); i++) {
+        const GainSchedulePoint& point = cfg.points[i];
+        if ((point.PGain < 0.0) || (point.IGain < 0.0) || (point.DGain < 0.0)) {
+            ESP_LOGE(GainSchedule::Name, "Gain schedule point %d has a negative gain", i);
+            return PBRet::FAILURE;
+        }
+
+        if ((i > 0) && (point.x <= cfg.points[i - 1].x)) {
+            ESP_LOGE(GainSchedule::Name, "Gain schedule points must be increasing in x");
+            return PBRet::FAILURE;
+        }
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet GainSchedule::loadFromJSON(GainScheduleConfig& cfg, const cJSON* cfgRoot)
+{
+    // Load GainScheduleConfig struct from JSON
+
+    if (cfgRoot == nullptr) {
+        ESP_LOGW(GainSchedule::Name, "cfgRoot was null");
+        return PBRet::FAILURE;
+    }
+
+    // Get scheduling variable
+    cJSON* variableNode = cJSON_GetObjectItem(cfgRoot, "variable");
+    if (cJSON_IsString(variableNode) == false) {
+        ESP_LOGI(GainSchedule::Name, "Unable to read scheduling variable from JSON");
+        return PBRet::FAILURE;
+    }
+
+    if (strcmp(variableNode->valuestring, "headTemp") == 0) {
+        cfg.variable = ScheduleVariable::HEAD_TEMP;
+    } else if (strcmp(variableNode->valuestring, "boilerABV") == 0) {
+        cfg.variable = ScheduleVariable::BOILER_ABV;
+    } else {
+        ESP_LOGI(GainSchedule::Name, "Scheduling variable %s is unknown", variableNode->valuestring);
+        return PBRet::FAILURE;
+    }
+
+    // Get schedule points
+    cfg.points.clear();
+    cJSON* pointsNode = cJSON_GetObjectItem(cfgRoot, "points");
+    if (cJSON_IsArray(pointsNode) == false) {
+        ESP_LOGI(GainSchedule::Name, "Unable to read gain schedule points from JSON");
+        return PBRet::FAILURE;
+    }
+
+    cJSON* pointNode = nullptr;
+    cJSON_ArrayForEach(pointNode, pointsNode) {
+        cJSON* xNode = cJSON_GetObjectItem(pointNode, "x");
+        cJSON* PGainNode = cJSON_GetObjectItem(pointNode, "PGain");
+        cJSON* IGainNode = cJSON_GetObjectItem(pointNode, "IGain");
+        cJSON* DGainNode = cJSON_GetObjectItem(pointNode, "DGain");
+        if ((cJSON_IsNumber(xNode) == false) || (cJSON_IsNumber(PGainNode) == false) ||
+            (cJSON_IsNumber(IGainNode) == false) || (cJSON_IsNumber(DGainNode) == false)) {
+            ESP_LOGI(GainSchedule::Name, "Unable to read gain schedule point from JSON");
+            return PBRet::FAILURE;
+        }
+
+        GainSchedulePoint point {};
+        point.x = xNode->valuedouble;
+        point.PGain = PGainNode->valuedouble;
+        point.IGain = IGainNode->valuedouble;
+        point.DGain = DGainNode->valuedouble;
+        cfg.points.push_back(point);
+    }
+
+    return PBRet::SUCCESS;
+}
@@ -0,0 +1,72 @@
+#ifndef MAIN_GAIN_SCHEDULE_H
+#define MAIN_GAIN_SCHEDULE_H
+
+#include <array>
+#include <vector>
+#include "PBCommon.h"
+#include "cJSON.h"
+
+enum class ScheduleVariable
+{
+    HEAD_TEMP,      // [deg C]
+    BOILER_ABV      // Liquid ABV at the boiler temperature [%]
+};
+
+struct GainSchedulePoint
+{
+    double x = 0.0;         // Scheduling variable
+    double PGain = 0.0;
+    double IGain = 0.0;
+    double DGain = 0.0;
+};
+
+struct GainScheduleConfig
+{
+    ScheduleVariable variable = ScheduleVariable::HEAD_TEMP;
+    std::vector<GainSchedulePoint> points {};       // Increasing in x. Empty disables scheduling
+};
+
+// PID gains as a function of a scheduling variable. The table is turned
+// into segments with precomputed slopes, so a lookup is one multiply-add
+// per gain. The variable moves slowly, so the search for the segment
+// starts from the last one used
+class GainSchedule
+{
+    static constexpr const char* Name = "GainSchedule";
+
+    public:
+        static constexpr size_t MaxPoints = 16;
+
+        GainSchedule(void) = default;
+        explicit GainSchedule(const GainScheduleConfig& cfg);
+
+        // Gains at x. Interpolated between points and held beyond the ends
+        GainSchedulePoint evaluate(double x);
+
+        ScheduleVariable getVariable(void) const { return _variable; }
+        size_t size(void) const { return _size; }
+
+        // Liquid ABV from the boiling point [%]
+        static double boilerABV(double boilerTemp);
+
+        static PBRet checkInputs(const GainScheduleConfig& cfg);
+        static PBRet loadFromJSON(GainScheduleConfig& cfg, const cJSON* cfgRoot);
+        bool isConfigured(void) const { return _configured; }
+
+    private:
+        struct Segment
+        {
+            GainSchedulePoint start {};
+            double dP = 0.0;            // Change in gain per unit x
+            double dI = 0.0;
+            double dD = 0.0;
+        };
+
+        std::array<Segment, MaxPoints> _segments {};
+        size_t _size = 0;
+        size_t _last = 0;               // Segment used by the last lookup
+        ScheduleVariable _variable = ScheduleVariable::HEAD_TEMP;
+        bool _configured = false;
+};
+
+#endif // MAIN_GAIN_SCHEDULE_H
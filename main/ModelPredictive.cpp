@@ -0,0 +1,373 @@
+#include "ModelPredictive.h"
+#include <cmath>
+#include <vector>
+
+using Matrix = std::vector<std::vector<double>>;
+
+// Head temperatures predicted by the velocity form model over the
+// horizon, from the state z = [y[k], y[k-1], u[k-d-1] ... u[k-1]] and the
+// future moves U, the last of which is held. The dead time is the length
+// of the past moves in z
+static std::vector<double> predict(const std::vector<double>& z, const std::vector<double>& U, double a, double b, size_t horizon)
+{
+    // Past and future outputs on one time line. Index 0 is u[k-d-1]
+    std::vector<double> u(z.begin() + 2, z.end());
+    for (size_t j = 0; j < horizon; j++) {
+        u.push_back(U[std::min(j, U.size() - 1)]);
+    }
+
+    // y[k+j+1] - y[k+j] = a * (y[k+j] - y[k+j-1]) + b * (u[k+j-d] - u[k+j-d-1])
+    std::vector<double> Y(horizon, 0.0);
+    double y = z[0];
+    double yPrev = z[1];
+    for (size_t j = 0; j < horizon; j++) {
+        Y[j] = y + a * (y - yPrev) + b * (u[j + 1] - u[j]);
+        yPrev = y;
+        y = Y[j];
+    }
+
+    return Y;
+}
+
+// Gauss-Jordan inverse of a symmetric positive definite matrix, so no
+// pivoting is needed
+static PBRet invertSPD(Matrix A, Matrix& inv)
+{
+    const size_t n = A.size();
+    inv.assign(n, std::vector<double>(n, 0.0));
+    for (size_t i = 0; i < n; i++) {
+        inv[i][i] = 1.0;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        const double pivot = A[i][i];
+        if (pivot <= 0.0) {
+            return PBRet::FAILURE;
+        }
+
+        for (size_t j = 0; j < n; j++) {
+            A[i][j] /= pivot;
+            inv[i][j] /= pivot;
+        }
+
+        for (size_t r = 0; r < n; r++) {
+            if (r == i) {
+                continue;
+            }
+
+            const double factor = A[r][i];
+            for (size_t j = 0; j < n; j++) {
+                A[r][j] -= factor * A[i][j];
+                inv[r][j] -= factor * inv[i][j];
+            }
+        }
+    }
+
+    return PBRet::SUCCESS;
+}
+
+ModelPredictiveController::ModelPredictiveController(const MPCConfig& cfg, double dt, double outputMin, double outputMax)
+    : _outputMin(outputMin), _outputMax(outputMax)
+{
+    if ((checkInputs(cfg, dt) != PBRet::SUCCESS) || (cfg.predictionHorizon == 0)) {
+        return;
+    }
+
+    if (outputMax <= outputMin) {
+        ESP_LOGE(ModelPredictiveController::Name, "Output range [%.1f, %.1f] is empty", outputMin, outputMax);
+        return;
+    }
+
+    if (_computeGains(cfg, dt) != PBRet::SUCCESS) {
+        ESP_LOGE(ModelPredictiveController::Name, "Failed to compute controller gains");
+        return;
+    }
+
+    _outputs = CircularBuffer(_deadSteps + 1);
+    _configured = true;
+}
+
+PBRet ModelPredictiveController::_computeGains(const MPCConfig& cfg, double dt)
+{
+    // Discretise the model
+    const double a = std::exp(-dt / cfg.timeConstant);
+    const double b = cfg.processGain * (1.0 - a);
+    const size_t N = cfg.predictionHorizon;
+    const size_t M = cfg.controlHorizon;
+    _deadSteps = static_cast<size_t>(std::lround(cfg.deadTime / dt));
+    _stateSize = _deadSteps + 3;
+    _controlHorizon = M;
+
+    // Predictions are Y = F z + G U. Build both a column at a time
+    Matrix F(N, std::vector<double>(_stateSize, 0.0));
+    Matrix G(N, std::vector<double>(M, 0.0));
+    for (size_t m = 0; m < _stateSize; m++) {
+        std::vector<double> z(_stateSize, 0.0);
+        z[m] = 1.0;
+        const std::vector<double> Y = predict(z, std::vector<double>(M, 0.0), a, b, N);
+        for (size_t j = 0; j < N; j++) {
+            F[j][m] = Y[j];
+        }
+    }
+
+    for (size_t i = 0; i < M; i++) {
+        std::vector<double> U(M, 0.0);
+        U[i] = 1.0;
+        const std::vector<double> Y = predict(std::vector<double>(_stateSize, 0.0), U, a, b, N);
+        for (size_t j = 0; j < N; j++) {
+            G[j][i] = Y[j];
+        }
+    }
+
+    // J = |F z + G U - r|^2 + R |D U - e0 u[k-1]|^2, where D differences
+    // successive moves. H = G'G + R D'D
+    const double R = cfg.moveWeight * cfg.processGain * cfg.processGain;
+    Matrix H(M, std::vector<double>(M, 0.0));
+    for (size_t i = 0; i < M; i++) {
+        for (size_t j = 0; j < M; j++) {
+            for (size_t k = 0; k < N; k++) {
+                H[i][j] += G[k][i] * G[k][j];
+            }
+        }
+
+        H[i][i] += R * ((i + 1 < M) ? 2.0 : 1.0);
+        if (i + 1 < M) {
+            H[i][i + 1] -= R;
+            H[i + 1][i] -= R;
+        }
+    }
+
+    Matrix Hinv {};
+    if (invertSPD(H, Hinv) != PBRet::SUCCESS) {
+        return PBRet::FAILURE;
+    }
+
+    // U = Hinv (G'(r - F z) + R e0 u[k-1])
+    for (size_t i = 0; i < M; i++) {
+        for (size_t m = 0; m < _stateSize; m++) {
+            double GtF = 0.0;
+            for (size_t k = 0; k < N; k++) {
+                double HinvGt = 0.0;
+                for (size_t j = 0; j < M; j++) {
+                    HinvGt += Hinv[i][j] * G[k][j];
+                }
+                GtF += HinvGt * F[k][m];
+            }
+            _Kz[i][m] = -GtF;
+        }
+        _Kz[i][_stateSize - 1] += R * Hinv[i][0];
+
+        _Kr[i] = 0.0;
+        for (size_t k = 0; k < N; k++) {
+            for (size_t j = 0; j < M; j++) {
+                _Kr[i] += Hinv[i][j] * G[k][j];
+            }
+        }
+    }
+
+    // Gershgorin bound on the largest eigenvalue gives a step that always
+    // converges
+    double maxRowSum = 0.0;
+    for (size_t i = 0; i < M; i++) {
+        double rowSum = 0.0;
+        for (size_t j = 0; j < M; j++) {
+            _H[i][j] = H[i][j];
+            rowSum += std::fabs(H[i][j]);
+        }
+        maxRowSum = std::max(maxRowSum, rowSum);
+    }
+    _stepSize = 1.0 / maxRowSum;
+
+    ESP_LOGI(ModelPredictiveController::Name, "Configured with %d step horizon, %d moves and %d steps of dead time", N, M, _deadSteps);
+    return PBRet::SUCCESS;
+}
+
+void ModelPredictiveController::reset(double output, double temp)
+{
+    const double u = _clamp(output);
+    for (size_t i = 0; i < _outputs.size(); i++) {
+        _outputs.insert(u);
+    }
+
+    _prevTemp = temp;
+    _iterations = 0;
+    _initialized = true;
+}
+
+double ModelPredictiveController::update(double temp, double setpoint)
+{
+    if (_configured == false) {
+        return _outputMin;
+    }
+
+    if (_initialized == false) {
+        reset(_outputMin, temp);
+    }
+
+    // Unconstrained moves
+    std::array<double, MaxControlHorizon> U {};
+    std::array<double, MaxControlHorizon> Uc {};
+    bool constrained = false;
+    for (size_t i = 0; i < _controlHorizon; i++) {
+        const std::array<double, MaxStateSize>& Kz = _Kz[i];
+        double u = Kz[0] * temp + Kz[1] * _prevTemp + _Kr[i] * setpoint;
+        for (size_t m = 2; m < _stateSize; m++) {
+            u += Kz[m] * _outputs.at(m - 2);
+        }
+
+        U[i] = u;
+        Uc[i] = _clamp(u);
+        constrained |= (Uc[i] != u);
+    }
+
+    // Box constrained QP. The gradient of the cost is H (U - Uunc)
+    _iterations = 0;
+    if (constrained) {
+        for (_iterations = 1; _iterations <= MaxIterations; _iterations++) {
+            double change = 0.0;
+            std::array<double, MaxControlHorizon> next {};
+            for (size_t i = 0; i < _controlHorizon; i++) {
+                double grad = 0.0;
+                for (size_t j = 0; j < _controlHorizon; j++) {
+                    grad += _H[i][j] * (Uc[j] - U[j]);
+                }
+                next[i] = _clamp(Uc[i] - _stepSize * grad);
+                change = std::max(change, std::fabs(next[i] - Uc[i]));
+            }
+
+            Uc = next;
+            if (change < SolveTolerance) {
+                break;
+            }
+        }
+        _iterations = std::min(_iterations, MaxIterations);
+    }
+
+    // Apply the first move
+    _outputs.insert(Uc[0]);
+    _prevTemp = temp;
+
+    return Uc[0];
+}
+
+PBRet ModelPredictiveController::checkInputs(const MPCConfig& cfg, double dt)
+{
+    // An empty horizon disables MPC
+    if (cfg.predictionHorizon == 0) {
+        return PBRet::SUCCESS;
+    }
+
+    if (dt <= 0.0) {
+        ESP_LOGE(ModelPredictiveController::Name, "Step dt (%.3f) must be positive", dt);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.processGain == 0.0) {
+        ESP_LOGE(ModelPredictiveController::Name, "Process gain must not be zero");
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.timeConstant <= 0.0) {
+        ESP_LOGE(ModelPredictiveController::Name, "Time constant (%.2f) must be positive", cfg.timeConstant);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.deadTime < 0.0) {
+        ESP_LOGE(ModelPredictiveController::Name, "Dead time (%.2f) must not be negative", cfg.deadTime);
+        return PBRet::FAILURE;
+    }
+
+    if (static_cast<size_t>(std::lround(cfg.deadTime / dt)) > MaxDeadSteps) {
+        ESP_LOGE(ModelPredictiveController::Name, "Dead time (%.2f) must not exceed %.2f", cfg.deadTime, MaxDeadSteps * dt);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.predictionHorizon > MaxPredictionHorizon) {
+        ESP_LOGE(ModelPredictiveController::Name, "Prediction horizon (%d) must not exceed %d", cfg.predictionHorizon, MaxPredictionHorizon);
+        return PBRet::FAILURE;
+    }
+
+    if ((cfg.controlHorizon == 0) || (cfg.controlHorizon > MaxControlHorizon) || (cfg.controlHorizon > cfg.predictionHorizon)) {
+        ESP_LOGE(ModelPredictiveController::Name, "Control horizon (%d) must be in [1, %d] and within the prediction horizon", cfg.controlHorizon, MaxControlHorizon);
+        return PBRet::FAILURE;
+    }
+
+    // Moves made within the dead time are never seen
+    if (cfg.predictionHorizon <= static_cast<size_t>(std::lround(cfg.deadTime / dt))) {
+        ESP_LOGE(ModelPredictiveController::Name, "Prediction horizon (%d) must be longer than the dead time", cfg.predictionHorizon);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.moveWeight <= 0.0) {
+        ESP_LOGE(ModelPredictiveController::Name, "Move weight (%.3f) must be positive", cfg.moveWeight);
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet ModelPredictiveController::loadFromJSON(MPCConfig& cfg, const cJSON* cfgRoot)
+{
+    // Load MPCConfig struct from JSON
+
+    if (cfgRoot == nullptr) {
+        ESP_LOGW(ModelPredictiveController::Name, "cfgRoot was null");
+        return PBRet::FAILURE;
+    }
+
+    // Get process gain
+    cJSON* processGainNode = cJSON_GetObjectItem(cfgRoot, "processGain");
+    if (cJSON_IsNumber(processGainNode)) {
+        cfg.processGain = processGainNode->valuedouble;
+    } else {
+        ESP_LOGI(ModelPredictiveController::Name, "Unable to read process gain from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get time constant
+    cJSON* timeConstantNode = cJSON_GetObjectItem(cfgRoot, "timeConstant");
+    if (cJSON_IsNumber(timeConstantNode)) {
+        cfg.timeConstant = timeConstantNode->valuedouble;
+    } else {
+        ESP_LOGI(ModelPredictiveController::Name, "Unable to read time constant from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get dead time
+    cJSON* deadTimeNode = cJSON_GetObjectItem(cfgRoot, "deadTime");
+    if (cJSON_IsNumber(deadTimeNode)) {
+        cfg.deadTime = deadTimeNode->valuedouble;
+    } else {
+        ESP_LOGI(ModelPredictiveController::Name, "Unable to read dead time from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get prediction horizon
+    cJSON* predictionHorizonNode = cJSON_GetObjectItem(cfgRoot, "predictionHorizon");
+    if (cJSON_IsNumber(predictionHorizonNode) && (predictionHorizonNode->valueint >= 0)) {
+        cfg.predictionHorizon = predictionHorizonNode->valueint;
+    } else {
+        ESP_LOGI(ModelPredictiveController::Name, "Unable to read prediction horizon from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get control horizon
+    cJSON* controlHorizonNode = cJSON_GetObjectItem(cfgRoot, "controlHorizon");
+    if (cJSON_IsNumber(controlHorizonNode) && (controlHorizonNode->valueint >= 0)) {
+        cfg.controlHorizon = controlHorizonNode->valueint;
+    } else {
+        ESP_LOGI(ModelPredictiveController::Name, "Unable to read control horizon from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get move weight
+    cJSON* moveWeightNode = cJSON_GetObjectItem(cfgRoot, "moveWeight");
+    if (cJSON_IsNumber(moveWeightNode)) {
+        cfg.moveWeight = moveWeightNode->valuedouble;
+    } else {
+        ESP_LOGI(ModelPredictiveController::Name, "Unable to read move weight from JSON");
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
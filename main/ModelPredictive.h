@@ -0,0 +1,85 @@
+#ifndef MAIN_MODEL_PREDICTIVE_H
+#define MAIN_MODEL_PREDICTIVE_H
+
+#include <array>
+#include "PBCommon.h"
+#include "Utilities.h"
+#include "cJSON.h"
+
+struct MPCConfig
+{
+    double processGain = 0.0;           // Steady state change in head temperature per unit pump speed. Negative [deg C / pump speed]
+    double timeConstant = 0.0;          // [s]
+    double deadTime = 0.0;              // Rounded to whole steps [s]
+    size_t predictionHorizon = 0;       // Steps of head temperature predicted. 0 disables MPC
+    size_t controlHorizon = 0;          // Moves optimised. The last is held to the end of the prediction [steps]
+    double moveWeight = 0.0;            // Cost of a pump speed move relative to the squared temperature change it would cause at steady state
+};
+
+// Linear model predictive control of head temperature through the reflux
+// pump. The plant is modelled as first order plus dead time in velocity
+// form, so steady disturbances like the element power drop out without an
+// observer. Each step minimises the squared error over the prediction
+// horizon plus the weighted pump moves over the control horizon.
+//
+// The unconstrained solution is linear in the past temperatures, past
+// outputs and setpoint, so its gains are computed once at construction
+// and a step is two small matrix-vector products. Only when a move would
+// leave the output limits is the box constrained QP solved, by a bounded
+// number of projected gradient iterations warm started from there
+class ModelPredictiveController
+{
+    static constexpr const char* Name = "MPC";
+
+    public:
+        static constexpr size_t MaxPredictionHorizon = 120;
+        static constexpr size_t MaxControlHorizon = 8;
+        static constexpr size_t MaxDeadSteps = 30;
+        static constexpr size_t MaxIterations = 30;
+        static constexpr double SolveTolerance = 0.5;              // Largest change in a move between iterations once converged [pump speed]
+        static constexpr size_t MaxStateSize = MaxDeadSteps + 3;   // y[k], y[k-1] and u[k-d-1] to u[k-1]
+
+        ModelPredictiveController(void) = default;
+        ModelPredictiveController(const MPCConfig& cfg, double dt, double outputMin, double outputMax);
+
+        // Start from a steady output, so control passes to MPC without a
+        // bump. Must be called before the first update
+        void reset(double output, double temp);
+
+        // Step with the current head temperature. Returns the output to
+        // apply, which is assumed to be applied until the next step
+        double update(double temp, double setpoint);
+
+        bool isInitialized(void) const { return _initialized; }
+        size_t getIterations(void) const { return _iterations; }      // Projected gradient iterations on the last step. 0 if unconstrained
+        size_t getDeadSteps(void) const { return _deadSteps; }
+
+        static PBRet checkInputs(const MPCConfig& cfg, double dt);
+        static PBRet loadFromJSON(MPCConfig& cfg, const cJSON* cfgRoot);
+        bool isConfigured(void) const { return _configured; }
+
+    private:
+        PBRet _computeGains(const MPCConfig& cfg, double dt);
+        double _clamp(double output) const { return std::min(std::max(output, _outputMin), _outputMax); }
+
+        // Offline. Unconstrained moves are Kz * z + Kr * setpoint
+        std::array<std::array<double, MaxStateSize>, MaxControlHorizon> _Kz {};
+        std::array<double, MaxControlHorizon> _Kr {};
+        std::array<std::array<double, MaxControlHorizon>, MaxControlHorizon> _H {};    // QP Hessian
+        double _stepSize = 0.0;             // Projected gradient step. 1 / bound on the largest eigenvalue of H
+        size_t _controlHorizon = 0;
+        size_t _deadSteps = 0;
+        size_t _stateSize = 0;
+        double _outputMin = 0.0;
+        double _outputMax = 0.0;
+
+        // State
+        CircularBuffer _outputs {0};        // u[k-d-1] oldest to u[k-1] newest
+        double _prevTemp = 0.0;
+        bool _initialized = false;
+        size_t _iterations = 0;
+
+        bool _configured = false;
+};
+
+#endif // MAIN_MODEL_PREDICTIVE_H
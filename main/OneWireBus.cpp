@@ -1,6 +1,22 @@
 #include "OneWireBus.h"
 #include "SensorManager.h"
 #include "Generated/SensorManagerMessaging.h"
+#include <array>
+#include <algorithm>
+#include <set>
+#include <cstring>
+
+// Config names of each sensor role
+static const std::array<std::pair<DS18B20Role, const char*>, 5> RoleNames = {{
+    {DS18B20Role::HEAD_TEMP, "headTemp"},
+    {DS18B20Role::REFLUX_TEMP, "refluxTemp"},
+    {DS18B20Role::PRODUCT_TEMP, "productTemp"},
+    {DS18B20Role::RADIATOR_TEMP, "radiatorTemp"},
+    {DS18B20Role::BOILER_TEMP, "boilerTemp"}
+}};
+
+static_assert(RoleNames.size() == SensorRoleCount, "Every role needs a config name");
+static_assert(SensorRoleCount * MaxSensorsPerRole <= SensorHealthMonitor::MaxSensors, "Health table is too small for every sensor slot");
 
 PBOneWire::PBOneWire(const PBOneWireConfig& cfg)
 {
@@ -23,19 +39,99 @@ PBOneWire::PBOneWire(const PBOneWireConfig& cfg)
 PBRet PBOneWire::checkInputs(const PBOneWireConfig& cfg)
 {
     // Check pin is valid GPIO
-    if ((cfg.oneWirePin <= GPIO_NUM_NC) || (cfg.oneWirePin > GPIO_NUM_MAX)) {
+    if (cfg.buses.empty() && ((cfg.oneWirePin <= GPIO_NUM_NC) || (cfg.oneWirePin > GPIO_NUM_MAX))) {
         ESP_LOGE(PBOneWire::Name, "OneWire pin %d is invalid. Bus was not configured", cfg.oneWirePin);
         return PBRet::FAILURE;
     }
 
+    // Check buses. Each needs its own GPIO and RMT channels
+    std::set<int> pins {};
+    std::set<int> channels {};
+    for (const OneWireChannelConfig& bus : cfg.buses) {
+        if (OneWireChannel::checkInputs(bus) != PBRet::SUCCESS) {
+            ESP_LOGE(PBOneWire::Name, "OneWire bus config was invalid. Bus was not configured");
+            return PBRet::FAILURE;
+        }
+
+        if ((pins.insert(bus.pin).second == false) || (channels.insert(bus.txChannel).second == false) ||
+            (channels.insert(bus.rxChannel).second == false)) {
+            ESP_LOGE(PBOneWire::Name, "OneWire buses must not share GPIO or RMT channels");
+            return PBRet::FAILURE;
+        }
+    }
+
     if (cfg.tempSensorResolution == DS18B20_RESOLUTION_INVALID) {
         ESP_LOGE(PBOneWire::Name, "Temperature sensor resolution was invalid");
         return PBRet::FAILURE;
     }
 
+    // Check per role sampling
+    for (const std::pair<const DS18B20Role, DS18B20SamplingConfig>& entry : cfg.sensorSampling) {
+        const DS18B20SamplingConfig& sampling = entry.second;
+        if ((sampling.resolution < DS18B20_RESOLUTION_9_BIT) || (sampling.resolution > DS18B20_RESOLUTION_12_BIT)) {
+            ESP_LOGE(PBOneWire::Name, "%s resolution was invalid", getRoleName(entry.first));
+            return PBRet::FAILURE;
+        }
+
+        if (sampling.samplePeriod < 0.0) {
+            ESP_LOGE(PBOneWire::Name, "%s sample period (%.2f) was negative", getRoleName(entry.first), sampling.samplePeriod);
+            return PBRet::FAILURE;
+        }
+
+        if (sampling.adaptive) {
+            if ((sampling.lowResolution < DS18B20_RESOLUTION_9_BIT) || (sampling.lowResolution > DS18B20_RESOLUTION_12_BIT)) {
+                ESP_LOGE(PBOneWire::Name, "%s low resolution was invalid", getRoleName(entry.first));
+                return PBRet::FAILURE;
+            }
+
+            if (sampling.adaptiveBand < 0.0) {
+                ESP_LOGE(PBOneWire::Name, "%s adaptive band (%.2f) was negative", getRoleName(entry.first), sampling.adaptiveBand);
+                return PBRet::FAILURE;
+            }
+        }
+    }
+
+    // Check discovery. A zero period disables it
+    if ((cfg.discovery.period != 0.0) && (DeviceDiscovery::checkInputs(cfg.discovery) != PBRet::SUCCESS)) {
+        ESP_LOGE(PBOneWire::Name, "Device discovery config was invalid");
+        return PBRet::FAILURE;
+    }
+
+    // Check health tracking. A zero timeout disables it
+    if (cfg.health.timeout != 0.0) {
+        if (SensorHealthMonitor::checkInputs(cfg.health) != PBRet::SUCCESS) {
+            ESP_LOGE(PBOneWire::Name, "Sensor health config was invalid");
+            return PBRet::FAILURE;
+        }
+
+        // Slow roles would otherwise time out between samples
+        for (const std::pair<const DS18B20Role, DS18B20SamplingConfig>& entry : cfg.sensorSampling) {
+            if (entry.second.samplePeriod >= cfg.health.timeout) {
+                ESP_LOGE(PBOneWire::Name, "%s sample period (%.2f) must be shorter than the sensor timeout (%.2f)",
+                         getRoleName(entry.first), entry.second.samplePeriod, cfg.health.timeout);
+                return PBRet::FAILURE;
+            }
+        }
+    }
+
     return PBRet::SUCCESS;
 }
 
+DS18B20SamplingConfig PBOneWire::getSamplingConfig(const PBOneWireConfig& cfg, DS18B20Role role)
+{
+    // Roles without their own sampling config use the bus default resolution
+    // and sample as fast as it allows
+
+    SamplingMap::const_iterator it = cfg.sensorSampling.find(role);
+    if (it != cfg.sensorSampling.end()) {
+        return it->second;
+    }
+
+    DS18B20SamplingConfig sampling {};
+    sampling.resolution = cfg.tempSensorResolution;
+    return sampling;
+}
+
 PBRet PBOneWire::loadFromJSON(PBOneWireConfig& cfg, const cJSON* cfgRoot)
 {
     // Load PBOneWire struct from JSON
@@ -62,62 +158,183 @@ PBRet PBOneWire::loadFromJSON(PBOneWireConfig& cfg, const cJSON* cfgRoot)
         ESP_LOGI(PBOneWire::Name, "Unable to read DS18B20 resolution from JSON");
         return PBRet::FAILURE;
     }
+
+    // Get per role sampling. This is optional, roles not listed use the
+    // default resolution
+    cfg.sensorSampling.clear();
+    cJSON* samplingNode = cJSON_GetObjectItem(cfgRoot, "sensorSampling");
+    if (cJSON_IsObject(samplingNode)) {
+        for (const std::pair<DS18B20Role, const char*>& role : RoleNames) {
+            cJSON* roleNode = cJSON_GetObjectItem(samplingNode, role.second);
+            if (roleNode == nullptr) {
+                continue;
+            }
+
+            DS18B20SamplingConfig sampling {};
+            if (_loadSamplingFromJSON(sampling, roleNode) != PBRet::SUCCESS) {
+                ESP_LOGI(PBOneWire::Name, "Unable to read %s sampling config from JSON", role.second);
+                return PBRet::FAILURE;
+            }
+
+            cfg.sensorSampling[role.first] = sampling;
+        }
+    } else {
+        ESP_LOGI(PBOneWire::Name, "No sensor sampling config found. Using default resolution for all sensors");
+    }
+
+    // Get buses. This is optional, a single bus on GPIO_onewire is used if
+    // none are listed
+    cfg.buses.clear();
+    cJSON* busesNode = cJSON_GetObjectItem(cfgRoot, "buses");
+    if (cJSON_IsArray(busesNode)) {
+        cJSON* busNode = nullptr;
+        cJSON_ArrayForEach(busNode, busesNode) {
+            OneWireChannelConfig bus {};
+            if (_loadBusFromJSON(bus, busNode) != PBRet::SUCCESS) {
+                ESP_LOGI(PBOneWire::Name, "Unable to read OneWire bus config from JSON");
+                return PBRet::FAILURE;
+            }
+
+            cfg.buses.push_back(bus);
+        }
+    }
+
+    // Get background discovery. This is optional, new sensors are only
+    // found on request if it is missing
+    cfg.discovery = DeviceDiscoveryConfig {};
+    cJSON* discoveryNode = cJSON_GetObjectItem(cfgRoot, "discovery");
+    if (discoveryNode != nullptr) {
+        cJSON* periodNode = cJSON_GetObjectItem(discoveryNode, "period");
+        if (cJSON_IsNumber(periodNode)) {
+            cfg.discovery.period = periodNode->valuedouble;
+        } else {
+            ESP_LOGI(PBOneWire::Name, "Unable to read discovery period from JSON");
+            return PBRet::FAILURE;
+        }
+
+        cJSON* missedNode = cJSON_GetObjectItem(discoveryNode, "missedPasses");
+        if (cJSON_IsNumber(missedNode)) {
+            cfg.discovery.missedPasses = missedNode->valueint;
+        } else {
+            ESP_LOGI(PBOneWire::Name, "Unable to read discovery missed passes from JSON");
+            return PBRet::FAILURE;
+        }
+    }
+
+    // Get sensor health tracking. This is optional, only primary sensors
+    // are used and no failover happens if it is missing
+    cfg.health = SensorHealthConfig {};
+    cJSON* healthNode = cJSON_GetObjectItem(cfgRoot, "health");
+    if ((healthNode != nullptr) && (SensorHealthMonitor::loadFromJSON(cfg.health, healthNode) != PBRet::SUCCESS)) {
+        ESP_LOGI(PBOneWire::Name, "Unable to read sensor health config from JSON");
+        return PBRet::FAILURE;
+    }
     
     // Success by here
     return PBRet::SUCCESS;
 }
 
-PBRet PBOneWire::_initOWB()
+PBRet PBOneWire::_loadSamplingFromJSON(DS18B20SamplingConfig& cfg, const cJSON* cfgRoot)
 {
-    _rmtDriver = new owb_rmt_driver_info;
-    if (_rmtDriver == nullptr) {
-        ESP_LOGE(PBOneWire::Name, "Unable to allocate memory for RMT driver");
+    // Load sampling config for a single sensor role
+
+    // Get resolution
+    cJSON* resolutionNode = cJSON_GetObjectItem(cfgRoot, "resolution");
+    if (cJSON_IsNumber(resolutionNode)) {
+        cfg.resolution = static_cast<DS18B20_RESOLUTION>(resolutionNode->valueint);
+    } else {
+        ESP_LOGI(PBOneWire::Name, "Unable to read resolution from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get sample period
+    cJSON* samplePeriodNode = cJSON_GetObjectItem(cfgRoot, "samplePeriod");
+    if (cJSON_IsNumber(samplePeriodNode)) {
+        cfg.samplePeriod = samplePeriodNode->valuedouble;
+    } else {
+        ESP_LOGI(PBOneWire::Name, "Unable to read sample period from JSON");
         return PBRet::FAILURE;
     }
 
-    // Fields are statically allocated within owb_rmt_initialize
-    _owb = owb_rmt_initialize(_rmtDriver, _cfg.oneWirePin, RMT_CHANNEL_1, RMT_CHANNEL_0);
-    if (_owb == nullptr) {
-        ESP_LOGE(PBOneWire::Name, "OnewWireBus initialization returned nullptr");
+    // Adaptive resolution is optional
+    cJSON* adaptiveNode = cJSON_GetObjectItem(cfgRoot, "adaptive");
+    cfg.adaptive = cJSON_IsTrue(adaptiveNode);
+    if (cfg.adaptive == false) {
+        return PBRet::SUCCESS;
+    }
+
+    // Get low resolution
+    cJSON* lowResolutionNode = cJSON_GetObjectItem(cfgRoot, "lowResolution");
+    if (cJSON_IsNumber(lowResolutionNode)) {
+        cfg.lowResolution = static_cast<DS18B20_RESOLUTION>(lowResolutionNode->valueint);
+    } else {
+        ESP_LOGI(PBOneWire::Name, "Unable to read low resolution from JSON");
         return PBRet::FAILURE;
     }
 
-    // Enable CRC check for ROM code. The return type from this method indicates 
-    // if bus was configured correctly
-    if (owb_use_crc(_owb, true) != OWB_STATUS_OK) {
-        ESP_LOGE(PBOneWire::Name, "OnewWireBus initialization failed");
+    // Get adaptive band
+    cJSON* adaptiveBandNode = cJSON_GetObjectItem(cfgRoot, "adaptiveBand");
+    if (cJSON_IsNumber(adaptiveBandNode)) {
+        cfg.adaptiveBand = adaptiveBandNode->valuedouble;
+    } else {
+        ESP_LOGI(PBOneWire::Name, "Unable to read adaptive band from JSON");
         return PBRet::FAILURE;
     }
 
     return PBRet::SUCCESS;
 }
 
-PBRet PBOneWire::_scanForDevices(DeviceVector& devices) const
+PBRet PBOneWire::_loadBusFromJSON(OneWireChannelConfig& cfg, const cJSON* cfgRoot)
 {
-    if (_owb == nullptr) {
-        ESP_LOGW(PBOneWire::Name, "Onewire bus pointer was null");
+    // Load config for a single OneWire bus
+
+    // Get GPIO
+    cJSON* GPIONode = cJSON_GetObjectItem(cfgRoot, "GPIO");
+    if (cJSON_IsNumber(GPIONode)) {
+        cfg.pin = static_cast<gpio_num_t>(GPIONode->valueint);
+    } else {
+        ESP_LOGI(PBOneWire::Name, "Unable to read bus GPIO from JSON");
         return PBRet::FAILURE;
     }
 
-    if (xSemaphoreTake(_OWBMutex, 250 / portTICK_PERIOD_MS) == pdTRUE) {
-        OneWireBus_SearchState search_state {};
-        bool found = false;
-        devices.clear();
+    // Get RMT tx channel
+    cJSON* txNode = cJSON_GetObjectItem(cfgRoot, "RMTTxChannel");
+    if (cJSON_IsNumber(txNode)) {
+        cfg.txChannel = static_cast<rmt_channel_t>(txNode->valueint);
+    } else {
+        ESP_LOGI(PBOneWire::Name, "Unable to read bus RMT tx channel from JSON");
+        return PBRet::FAILURE;
+    }
 
-        owb_search_first(_owb, &search_state, &found);
-        while (found) {
-            devices.emplace_back(search_state.rom_code);
-            owb_search_next(_owb, &search_state, &found);
-        }
-        xSemaphoreGive(_OWBMutex);
+    // Get RMT rx channel
+    cJSON* rxNode = cJSON_GetObjectItem(cfgRoot, "RMTRxChannel");
+    if (cJSON_IsNumber(rxNode)) {
+        cfg.rxChannel = static_cast<rmt_channel_t>(rxNode->valueint);
     } else {
-        ESP_LOGW(PBOneWire::Name, "Unable to access PBOneWire shared resource");
+        ESP_LOGI(PBOneWire::Name, "Unable to read bus RMT rx channel from JSON");
         return PBRet::FAILURE;
     }
 
     return PBRet::SUCCESS;
 }
 
+std::vector<OneWireChannelConfig> PBOneWire::getBusConfigs(const PBOneWireConfig& cfg)
+{
+    // Buses to create. Configs without a bus list get a single bus on 
+    // GPIO_onewire using the original RMT channel pair
+
+    if (cfg.buses.empty() == false) {
+        return cfg.buses;
+    }
+
+    OneWireChannelConfig bus {};
+    bus.pin = cfg.oneWirePin;
+    bus.txChannel = RMT_CHANNEL_1;
+    bus.rxChannel = RMT_CHANNEL_0;
+
+    return std::vector<OneWireChannelConfig> { bus };
+}
+
 PBRet PBOneWire::_broadcastDeviceAddresses(const DeviceVector& deviceAddresses) const
 {
     // Broadcast the available device addresses to all listening tasks
@@ -140,65 +357,103 @@ PBRet PBOneWire::_broadcastDeviceAddresses(const DeviceVector& deviceAddresses)
 
 PBRet PBOneWire::broadcastAvailableDevices(void) const
 {
+    // Devices on all buses are reported together
+
     DeviceVector deviceAddresses {};
-    if (_scanForDevices(deviceAddresses) != PBRet::SUCCESS) {
-        ESP_LOGW(PBOneWire::Name, "Scan of OneWire bus failed");
-        return PBRet::FAILURE;
+    for (const std::unique_ptr<OneWireChannel>& channel : _channels) {
+        DeviceVector busAddresses {};
+        if (channel->getDevices(busAddresses) != PBRet::SUCCESS) {
+            ESP_LOGW(PBOneWire::Name, "Scan of OneWire bus %d failed", channel->getIndex());
+            return PBRet::FAILURE;
+        }
+
+        deviceAddresses.insert(deviceAddresses.end(), busAddresses.begin(), busAddresses.end());
     }
 
     return _broadcastDeviceAddresses(deviceAddresses);
 }
 
-PBRet PBOneWire::_oneWireConvert(void) const
+PBRet PBOneWire::readTempSensors(TemperatureData& Tdata, bool& updated)
 {
-    // Command all temperature sensors on the bus to convert temperatures
+    // Advance the conversion pipelines on every bus. This never waits on a
+    // conversion, so should be called every tick. With more than one bus
+    // the buses are stepped in parallel by their worker tasks, so the time
+    // spent here is set by the busiest bus rather than the total number of
+    // sensors. updated is set when Tdata holds at least one new sample
 
-    if (_assignedSensors.size() == 0) {
-        ESP_LOGW(PBOneWire::Name, "No assigned devices. Cannot convert temperatures");
+    updated = false;
+    if (_configured == false) {
+        ESP_LOGW(PBOneWire::Name, "Cannot read temperatures before PBOneWireBuse is configured");
         return PBRet::FAILURE;
     }
 
-    ds18b20_convert_all(_owb);
-
-    // Wait until the first sensor in the map has finished converting measurement
-    ds18b20_wait_for_conversion(&_assignedSensors.begin()->second->getInfo());
+    const int64_t t = esp_timer_get_time();
+    if (_channels.size() == 1) {
+        _channels.front()->step(t, _setpoint, _hasSetpoint);
+    } else {
+        std::vector<OneWireChannel*> requested {};
+        for (const std::unique_ptr<OneWireChannel>& channel : _channels) {
+            if (channel->requestStep(t, _setpoint, _hasSetpoint)) {
+                requested.push_back(channel.get());
+            } else {
+                ESP_LOGW(PBOneWire::Name, "Bus %d overran. Skipping this tick", channel->getIndex());
+            }
+        }
 
-    return PBRet::SUCCESS;
-}
+        for (OneWireChannel* channel : requested) {
+            if (channel->waitForStep(PBOneWire::StepTimeout) == false) {
+                ESP_LOGW(PBOneWire::Name, "Timed out waiting for bus %d", channel->getIndex());
+            }
+        }
+    }
 
-PBRet PBOneWire::readTempSensors(TemperatureData& Tdata) const
-{
-    // Read all available temperature sensors
-    if (_configured == false) {
-        ESP_LOGW(PBOneWire::Name, "Cannot read temperatures before PBOneWireBuse is configured");
-        return PBRet::FAILURE;
+    // Merge new samples from all buses
+    SampleMap samples {};
+    for (const std::unique_ptr<OneWireChannel>& channel : _channels) {
+        channel->collect(samples);
     }
 
-    if (xSemaphoreTake(_OWBMutex, 10 / portTICK_PERIOD_MS) == pdTRUE) {
-        if (_oneWireConvert() != PBRet::SUCCESS) {
-            ESP_LOGW(PBOneWire::Name, "Temperature sensor conversion failed");
-            xSemaphoreGive(_OWBMutex);
-            return PBRet::FAILURE;
+    // Check every sample and pick the sensor each role reads from
+    _updateHealth(samples, t);
+
+    int64_t sampleTime = 0;
+    for (size_t i = 0; i < RoleNames.size(); i++) {
+        if (_active[i] < 0) {
+            continue;
         }
 
-        // Print a warning for this one, as it required for control
-        if (_readTemperatureSensor(DS18B20Role::HEAD_TEMP, Tdata.mutable_headTemp().get()) != PBRet::SUCCESS) {
-            ESP_LOGW(PBOneWire::Name, "Failed to read head temperature sensor");
+        const SensorSlot slot(RoleNames[i].first, _active[i]);
+        SampleMap::const_iterator sample = samples.find(slot);
+        if ((sample == samples.end()) || (_usable[_slotID(slot)] == false)) {
+            continue;
         }
 
-        // Read all other sensors
-        _readTemperatureSensor(DS18B20Role::REFLUX_TEMP, Tdata.mutable_refluxCondensorTemp().get());
-        _readTemperatureSensor(DS18B20Role::PRODUCT_TEMP, Tdata.mutable_prodCondensorTemp().get());
-        _readTemperatureSensor(DS18B20Role::RADIATOR_TEMP, Tdata.mutable_radiatorTemp().get());
-        _readTemperatureSensor(DS18B20Role::BOILER_TEMP, Tdata.mutable_boilerTemp().get());
+        if (_setRoleTemp(slot.role, sample->second.T, Tdata) == PBRet::SUCCESS) {
+            _sampleTimes[i] = sample->second.timeStamp;
+            sampleTime = std::max(sampleTime, sample->second.timeStamp);
+            updated = true;
+        }
+    }
+
+    // Calibration is always against the primary sensor
+    for (const std::pair<const SensorSlot, RoleSample>& sample : samples) {
+        if ((sample.first.index == 0) && (sample.second.fault == SensorFault::NONE)) {
+            _rawTemps[sample.first.role] = sample.second.rawT;
+        }
+    }
 
-        // Set timestamp
-        Tdata.set_timeStamp(esp_timer_get_time());
+    // Temperatures were sampled when the conversion started
+    if (updated) {
+        Tdata.set_timeStamp(sampleTime);
+    }
 
-        xSemaphoreGive(_OWBMutex);
-    } else {
-        ESP_LOGW(PBOneWire::Name, "Unable to access PBOneWire shared resource");
-        return PBRet::FAILURE;
+    if (_processDiscoveryEvents() != PBRet::SUCCESS) {
+        ESP_LOGW(PBOneWire::Name, "Unable to process device discovery events");
+    }
+
+    _readTime.add((esp_timer_get_time() - t) * 1e-6);
+    if (_readTime.count() >= PBOneWire::TimingReportSamples) {
+        _reportConversionTiming();
     }
 
     // // Reject temperature measurements if head temperature is invalid
@@ -211,60 +466,355 @@ PBRet PBOneWire::readTempSensors(TemperatureData& Tdata) const
     return PBRet::SUCCESS;
 }
 
+void PBOneWire::_updateHealth(const SampleMap& samples, int64_t t)
+{
+    // Pass each new sample through the health checks, then choose the
+    // lowest index healthy sensor for every role. Backups are sampled
+    // alongside the primary, so a failed primary is replaced in the same
+    // read. With health tracking disabled only primary sensors are used
+
+    const bool enabled = _health.isConfigured();
+    std::array<bool, SensorHealthMonitor::MaxSensors> changed {};
+    _usable.fill(false);
+    for (const std::pair<const SensorSlot, RoleSample>& sample : samples) {
+        const size_t id = _slotID(sample.first);
+        if (id >= SensorHealthMonitor::MaxSensors) {
+            continue;
+        }
+
+        if (enabled == false) {
+            _usable[id] = (sample.second.fault == SensorFault::NONE);
+        } else if (sample.second.fault != SensorFault::NONE) {
+            _health.reportError(id, sample.second.fault, changed[id]);
+        } else {
+            _usable[id] = _health.reportRead(id, sample.second.timeStamp, sample.second.T, changed[id]);
+        }
+    }
+
+    if (enabled) {
+        std::array<bool, SensorHealthMonitor::MaxSensors> timedOut {};
+        _health.update(t, timedOut);
+        for (size_t id = 0; id < SensorHealthMonitor::MaxSensors; id++) {
+            changed[id] = changed[id] || timedOut[id];
+        }
+    }
+
+    for (size_t i = 0; i < RoleNames.size(); i++) {
+        int active = -1;
+        bool assigned = false;
+        for (uint8_t index = 0; index < (enabled ? MaxSensorsPerRole : 1); index++) {
+            const SensorSlot slot(RoleNames[i].first, index);
+            if (_getSensor(slot) == nullptr) {
+                continue;
+            }
+
+            assigned = true;
+            if ((enabled == false) || _health.isHealthy(_slotID(slot))) {
+                active = index;
+                break;
+            }
+        }
+
+        if (active == _active[i]) {
+            continue;
+        }
+
+        if (active < 0) {
+            if (assigned) {
+                ESP_LOGE(PBOneWire::Name, "No healthy %s sensor is available", RoleNames[i].second);
+            }
+        } else {
+            ESP_LOGW(PBOneWire::Name, "%s is now read from sensor %d", RoleNames[i].second, active);
+        }
+        _active[i] = active;
+
+        // Every sensor in the role reports the change
+        for (uint8_t index = 0; index < MaxSensorsPerRole; index++) {
+            changed[_slotID(SensorSlot(RoleNames[i].first, index))] = true;
+        }
+    }
+
+    if (enabled == false) {
+        return;
+    }
+
+    // Publish changes straight away, and everything periodically
+    const bool publishAll = (t - _lastHealthPublish) > static_cast<int64_t>(_cfg.health.publishPeriod * 1e6);
+    if (publishAll) {
+        _lastHealthPublish = t;
+    }
+
+    for (const std::pair<DS18B20Role, const char*>& role : RoleNames) {
+        for (uint8_t index = 0; index < MaxSensorsPerRole; index++) {
+            const SensorSlot slot(role.first, index);
+            const size_t id = _slotID(slot);
+            if ((publishAll || changed[id]) && (_health.getStats(id).status != SensorHealthStats::Status::UNUSED)) {
+                _broadcastHealth(slot);
+            }
+        }
+    }
+}
+
+PBRet PBOneWire::_broadcastHealth(const SensorSlot& slot) const
+{
+    // Broadcast the health of a single sensor
+
+    const SensorHealthStats& stats = _health.getStats(_slotID(slot));
+    SensorHealth health {};
+    health.set_role(slot.role);
+    health.set_index(slot.index);
+    health.set_active(isRoleHealthy(slot.role) && (_active[_slotID(slot) / MaxSensorsPerRole] == slot.index));
+    health.set_roleHealthy(isRoleHealthy(slot.role));
+    health.set_crcErrors(stats.crcErrors);
+    health.set_timeouts(stats.timeouts);
+    health.set_stuckEvents(stats.stuckEvents);
+    health.set_rateAnomalies(stats.rateAnomalies);
+
+    switch (stats.status)
+    {
+        case (SensorHealthStats::Status::OK):
+            health.set_status(SensorStatus::SENSOR_OK);
+            break;
+        case (SensorHealthStats::Status::DEGRADED):
+            health.set_status(SensorStatus::SENSOR_DEGRADED);
+            break;
+        case (SensorHealthStats::Status::FAILED):
+            health.set_status(SensorStatus::SENSOR_FAILED);
+            break;
+        default:
+            health.set_status(SensorStatus::SENSOR_UNUSED);
+            break;
+    }
+
+    std::shared_ptr<Ds18b20> sensor = _getSensor(slot);
+    if (sensor != nullptr) {
+        for (size_t i = 0; i < ROM_SIZE; i++) {
+            health.mutable_romCode()[i] = sensor->getInfo().rom_code.bytes[i];
+        }
+    }
+
+    PBMessageWrapper wrapped = MessageServer::wrap(health, PBMessageType::SensorHealth, ID);
+    return MessageServer::broadcastMessage(wrapped);
+}
+
+bool PBOneWire::isRoleHealthy(DS18B20Role role) const
+{
+    for (size_t i = 0; i < RoleNames.size(); i++) {
+        if (RoleNames[i].first == role) {
+            return _active[i] >= 0;
+        }
+    }
+
+    return false;
+}
+
+int64_t PBOneWire::getSampleTime(DS18B20Role role) const
+{
+    for (size_t i = 0; i < RoleNames.size(); i++) {
+        if (RoleNames[i].first == role) {
+            return _sampleTimes[i];
+        }
+    }
+
+    return 0;
+}
+
+size_t PBOneWire::_slotID(const SensorSlot& slot)
+{
+    // Position of a sensor slot in the health table
+
+    for (size_t i = 0; i < RoleNames.size(); i++) {
+        if (RoleNames[i].first == slot.role) {
+            return i * MaxSensorsPerRole + slot.index;
+        }
+    }
+
+    return SensorHealthMonitor::MaxSensors;
+}
+
+PBRet PBOneWire::_processDiscoveryEvents(void)
+{
+    // Handle sensors that have been plugged in or unplugged since the last
+    // read. Saved sensors that were missing at startup are assigned as soon
+    // as they appear, and the new device list is sent to the UI
+
+    std::vector<DiscoveryEvent> events {};
+    for (const std::unique_ptr<OneWireChannel>& channel : _channels) {
+        channel->collectEvents(events);
+    }
+
+    if (events.empty()) {
+        return PBRet::SUCCESS;
+    }
+
+    for (const DiscoveryEvent& event : events) {
+        const DeviceVector device { event.romCode };
+        if (event.type == DiscoveryEvent::Type::ADDED) {
+            ESP_LOGI(PBOneWire::Name, "Device added on bus %d", event.bus);
+
+            std::vector<DeviceVector> busDevices(_channels.size());
+            busDevices[event.bus] = device;
+
+            SavedSensorMap::iterator it = _pendingSensors.begin();
+            while (it != _pendingSensors.end()) {
+                if (_isAvailableSensor(it->second, device) && (_restoreSensor(it->second, it->first, busDevices) == PBRet::SUCCESS)) {
+                    it = _pendingSensors.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        } else {
+            ESP_LOGI(PBOneWire::Name, "Device removed from bus %d", event.bus);
+
+            for (const std::pair<DS18B20Role, const char*>& role : RoleNames) {
+                for (uint8_t index = 0; index < MaxSensorsPerRole; index++) {
+                    std::shared_ptr<Ds18b20> sensor = _getSensor(SensorSlot(role.first, index));
+                    if ((sensor != nullptr) && _romCodesMatch(sensor->getInfo().rom_code, event.romCode)) {
+                        ESP_LOGW(PBOneWire::Name, "Assigned %s sensor %d is no longer on the bus", role.second, index);
+                    }
+                }
+            }
+        }
+    }
+
+    return broadcastAvailableDevices();
+}
+
+PBRet PBOneWire::_setRoleTemp(DS18B20Role role, double T, TemperatureData& Tdata)
+{
+    // Write a sensor reading into its field in Tdata
+
+    switch (role)
+    {
+        case (DS18B20Role::HEAD_TEMP):
+            Tdata.set_headTemp(T);
+            break;
+        case (DS18B20Role::REFLUX_TEMP):
+            Tdata.set_refluxCondensorTemp(T);
+            break;
+        case (DS18B20Role::PRODUCT_TEMP):
+            Tdata.set_prodCondensorTemp(T);
+            break;
+        case (DS18B20Role::RADIATOR_TEMP):
+            Tdata.set_radiatorTemp(T);
+            break;
+        case (DS18B20Role::BOILER_TEMP):
+            Tdata.set_boilerTemp(T);
+            break;
+        default:
+            return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+void PBOneWire::_reportConversionTiming(void)
+{
+    // Log sample period jitter and bus time for each bus, and how long the
+    // caller was blocked, then start a new window
+
+    for (const std::unique_ptr<OneWireChannel>& channel : _channels) {
+        channel->reportTiming();
+    }
+
+    ESP_LOGI(PBOneWire::Name, "Read time: mean %.2f ms, max %.2f ms", _readTime.mean() * 1e3, _readTime.max() * 1e3);
+    _readTime.reset();
+}
+
+DS18B20_RESOLUTION PBOneWire::getResolution(DS18B20Role role) const
+{
+    // Resolution a sensor assigned to role should currently be configured with
+
+    for (const std::unique_ptr<OneWireChannel>& channel : _channels) {
+        if (channel->hasSensor(role)) {
+            return channel->getResolution(role);
+        }
+    }
+
+    // Not yet assigned. Adaptive sensors start at full resolution
+    return getSamplingConfig(_cfg, role).resolution;
+}
+
+const char* PBOneWire::getRoleName(DS18B20Role role)
+{
+    for (const std::pair<DS18B20Role, const char*>& entry : RoleNames) {
+        if (entry.first == role) {
+            return entry.second;
+        }
+    }
+
+    return "unknown";
+}
+
 PBRet PBOneWire::_initFromParams(const PBOneWireConfig& cfg)
 {
     _cfg = cfg;
 
-    // Initialize the bus
-    if (_initOWB() != PBRet::SUCCESS) {
-        ESP_LOGE(PBOneWire::Name, "Failed to configure OneWire bus");
-        return PBRet::FAILURE;
-    }
+    // Health tracking. Only primary sensors are used until a sensor fails
+    _health = (_cfg.health.timeout > 0.0) ? SensorHealthMonitor(_cfg.health) : SensorHealthMonitor();
+    _active.fill(0);
+
+    // Initialize the buses
+    const std::vector<OneWireChannelConfig> busConfigs = getBusConfigs(_cfg);
+    _channels.clear();
+    for (size_t i = 0; i < busConfigs.size(); i++) {
+        std::unique_ptr<OneWireChannel> channel(new OneWireChannel(busConfigs[i], i));
+        if (channel->isConfigured() == false) {
+            ESP_LOGE(PBOneWire::Name, "Failed to configure OneWire bus %d", i);
+            return PBRet::FAILURE;
+        }
 
-    // Initialise bus semaphore
-    _OWBMutex = xSemaphoreCreateMutex();
-    if (_OWBMutex == NULL) {
-        ESP_LOGW(PBOneWire::Name, "Unable to create mutex");
-        return PBRet::FAILURE;
+        if ((_cfg.discovery.period > 0.0) && (channel->enableDiscovery(_cfg.discovery) != PBRet::SUCCESS)) {
+            ESP_LOGE(PBOneWire::Name, "Failed to enable discovery on OneWire bus %d", i);
+            return PBRet::FAILURE;
+        }
+
+        // Buses are only stepped in parallel when there is more than one
+        if ((busConfigs.size() > 1) && (channel->startWorker() != PBRet::SUCCESS)) {
+            ESP_LOGE(PBOneWire::Name, "Failed to start worker for OneWire bus %d", i);
+            return PBRet::FAILURE;
+        }
+
+        _channels.push_back(std::move(channel));
     }
 
     return PBRet::SUCCESS;
 }
 
- PBRet PBOneWire::serialize(Writable& buffer) const
+PBRet PBOneWire::serialize(Writable& buffer) const
 {
     // Write the assigned sensors to buffer
 
     PBAssignedSensorRegistry registry {};
 
-    auto it = _assignedSensors.find(DS18B20Role::HEAD_TEMP);
-    if (it != _assignedSensors.end())
+    std::shared_ptr<Ds18b20> sensor = _getSensor(DS18B20Role::HEAD_TEMP);
+    if (sensor != nullptr)
     {
-        registry.set_headTempSensor((*it->second).toSerialConfig());
+        registry.set_headTempSensor(sensor->toSerialConfig());
     }
 
-    it = _assignedSensors.find(DS18B20Role::REFLUX_TEMP);
-    if (it != _assignedSensors.end())
+    sensor = _getSensor(DS18B20Role::REFLUX_TEMP);
+    if (sensor != nullptr)
     {
-        registry.set_refluxTempSensor((*it->second).toSerialConfig());
+        registry.set_refluxTempSensor(sensor->toSerialConfig());
     }
 
-    it = _assignedSensors.find(DS18B20Role::PRODUCT_TEMP);
-    if (it != _assignedSensors.end())
+    sensor = _getSensor(DS18B20Role::PRODUCT_TEMP);
+    if (sensor != nullptr)
     {
-        registry.set_productTempSensor((*it->second).toSerialConfig());
+        registry.set_productTempSensor(sensor->toSerialConfig());
     }
 
-    it = _assignedSensors.find(DS18B20Role::RADIATOR_TEMP);
-    if (it != _assignedSensors.end())
+    sensor = _getSensor(DS18B20Role::RADIATOR_TEMP);
+    if (sensor != nullptr)
     {
-        registry.set_radiatorTempSensor((*it->second).toSerialConfig());
+        registry.set_radiatorTempSensor(sensor->toSerialConfig());
     }
 
-    it = _assignedSensors.find(DS18B20Role::BOILER_TEMP);
-    if (it != _assignedSensors.end())
+    sensor = _getSensor(DS18B20Role::BOILER_TEMP);
+    if (sensor != nullptr)
     {
-        registry.set_boilerTempSensor((*it->second).toSerialConfig());
+        registry.set_boilerTempSensor(sensor->toSerialConfig());
     }
 
     // Serialize data structure into buffer
@@ -291,64 +841,186 @@ PBRet PBOneWire::deserialize(Readable& buffer)
         return PBRet::FAILURE;
     }
 
-    // Read available devices addresss from bus
-    DeviceVector deviceAddresses {};
-    if (_scanForDevices(deviceAddresses) != PBRet::SUCCESS) {
-        ESP_LOGW(PBOneWire::Name, "Scan for available devices failed");
+    // Read available devices addresss from each bus
+    std::vector<DeviceVector> busDevices {};
+    if (_scanBuses(busDevices) != PBRet::SUCCESS) {
         return PBRet::FAILURE;
     }
 
-    if (_isAvailableSensor(registry.headTempSensor(), deviceAddresses)) {
-        if (_createAndAssignSensor(registry.headTempSensor(), DS18B20Role::HEAD_TEMP, 
-            DS18B20_RESOLUTION::DS18B20_RESOLUTION_11_BIT, "head temp") != PBRet::SUCCESS) {
-            ESP_LOGW(PBOneWire::Name, "Head temp sensor was available on bus but could not be configured");
+    // Sensors that aren't plugged in are kept, and assigned if discovery 
+    // finds them later
+    _pendingSensors.clear();
+    SavedSensorMap saved = {
+        {DS18B20Role::HEAD_TEMP, registry.headTempSensor()},
+        {DS18B20Role::REFLUX_TEMP, registry.refluxTempSensor()},
+        {DS18B20Role::PRODUCT_TEMP, registry.productTempSensor()},
+        {DS18B20Role::RADIATOR_TEMP, registry.radiatorTempSensor()},
+        {DS18B20Role::BOILER_TEMP, registry.boilerTempSensor()}
+    };
+
+    // Backups only live in the bus map
+    saved.insert(_savedBackups.begin(), _savedBackups.end());
+
+    for (const std::pair<const SensorSlot, PBDS18B20Sensor>& sensor : saved) {
+        if (_restoreSensor(sensor.second, sensor.first, busDevices) != PBRet::SUCCESS) {
+            _pendingSensors.insert(sensor);
         }
     }
-    
-    if (_isAvailableSensor(registry.refluxTempSensor(), deviceAddresses)) {
-        if (_createAndAssignSensor(registry.refluxTempSensor(), DS18B20Role::REFLUX_TEMP, 
-            DS18B20_RESOLUTION::DS18B20_RESOLUTION_11_BIT, "reflux temp") != PBRet::SUCCESS) {
-            ESP_LOGW(PBOneWire::Name, "Reflux temp sensor was available on bus but could not be configured");
+
+    return PBRet::SUCCESS;
+}
+
+PBRet PBOneWire::_scanBuses(std::vector<DeviceVector>& busDevices) const
+{
+    busDevices.assign(_channels.size(), DeviceVector {});
+    for (size_t i = 0; i < _channels.size(); i++) {
+        if (_channels[i]->getDevices(busDevices[i]) != PBRet::SUCCESS) {
+            ESP_LOGW(PBOneWire::Name, "Scan for available devices on bus %d failed", i);
+            return PBRet::FAILURE;
         }
     }
 
-    if (_isAvailableSensor(registry.productTempSensor(), deviceAddresses)) {
-        if (_createAndAssignSensor(registry.productTempSensor(), DS18B20Role::PRODUCT_TEMP, 
-            DS18B20_RESOLUTION::DS18B20_RESOLUTION_11_BIT, "product temp") != PBRet::SUCCESS) {
-            ESP_LOGW(PBOneWire::Name, "Product temp sensor was available on bus but could not be configured");
-        }
+    return PBRet::SUCCESS;
+}
+
+PBRet PBOneWire::_restoreSensor(const PBDS18B20Sensor& sensorConfig, const SensorSlot& slot, const std::vector<DeviceVector>& busDevices)
+{
+    // Create a sensor object from the registry and assign it a role. The
+    // saved bus is tried first, but a sensor that has been moved to another
+    // bus is still found
+
+    std::vector<size_t> searchOrder {};
+    BusMap::const_iterator saved = _savedBusMap.find(slot);
+    if ((saved != _savedBusMap.end()) && (saved->second < busDevices.size())) {
+        searchOrder.push_back(saved->second);
+    }
+
+    for (size_t i = 0; i < busDevices.size(); i++) {
+        searchOrder.push_back(i);
     }
 
-    if (_isAvailableSensor(registry.radiatorTempSensor(), deviceAddresses)) {
-        if (_createAndAssignSensor(registry.radiatorTempSensor(), DS18B20Role::RADIATOR_TEMP, 
-            DS18B20_RESOLUTION::DS18B20_RESOLUTION_11_BIT, "radiator temp") != PBRet::SUCCESS) {
-            ESP_LOGW(PBOneWire::Name, "Radiator temp sensor was available on bus but could not be configured");
+    for (size_t bus : searchOrder) {
+        if (_isAvailableSensor(sensorConfig, busDevices[bus]) == false) {
+            continue;
+        }
+
+        std::shared_ptr<Ds18b20> sensor = std::make_shared<Ds18b20>(sensorConfig, getResolution(slot.role), _channels[bus]->getOWB());
+        if (sensor->isConfigured() == false) {
+            ESP_LOGW(PBOneWire::Name, "%s sensor %d was available on bus %d but could not be configured", getRoleName(slot.role), slot.index, bus);
+            return PBRet::FAILURE;
+        }
+
+        SensorCalibration calibration {};
+        if (_calibrations.find(sensor->getInfo().rom_code, calibration)) {
+            sensor->setCalibration(calibration);
         }
+
+        ESP_LOGI(PBOneWire::Name, "Read %s sensor %d on bus %d from file", getRoleName(slot.role), slot.index, bus);
+        if (_channels[bus]->addSensor(slot, sensor, getSamplingConfig(_cfg, slot.role)) != PBRet::SUCCESS) {
+            return PBRet::FAILURE;
+        }
+
+        _health.addSensor(_slotID(slot), esp_timer_get_time());
+        return PBRet::SUCCESS;
+    }
+
+    return PBRet::FAILURE;
+}
+
+PBRet PBOneWire::serializeBusMap(cJSON* root) const
+{
+    // Write the bus each assigned sensor is wired to. Stored alongside the
+    // sensor registry. The registry only holds primary sensors, so backups
+    // are written here in full
+
+    if (root == nullptr) {
+        ESP_LOGW(PBOneWire::Name, "cJSON root was null");
+        return PBRet::FAILURE;
+    }
+
+    cJSON* backups = cJSON_AddArrayToObject(root, "backups");
+    if (backups == nullptr) {
+        ESP_LOGW(PBOneWire::Name, "Failed to create JSON array for backup sensors");
+        return PBRet::FAILURE;
     }
 
-    if (_isAvailableSensor(registry.boilerTempSensor(), deviceAddresses)) {
-        if (_createAndAssignSensor(registry.boilerTempSensor(), DS18B20Role::BOILER_TEMP, 
-            DS18B20_RESOLUTION::DS18B20_RESOLUTION_11_BIT, "boiler temp") != PBRet::SUCCESS) {
-            ESP_LOGW(PBOneWire::Name, "Boiler temp sensor was available on bus but could not be configured");
+    for (const std::unique_ptr<OneWireChannel>& channel : _channels) {
+        for (const std::pair<DS18B20Role, const char*>& role : RoleNames) {
+            if (channel->hasSensor(role.first)) {
+                cJSON_AddNumberToObject(root, role.second, channel->getIndex());
+            }
+
+            for (uint8_t index = 1; index < MaxSensorsPerRole; index++) {
+                std::shared_ptr<Ds18b20> sensor = channel->getSensor(SensorSlot(role.first, index));
+                if (sensor == nullptr) {
+                    continue;
+                }
+
+                cJSON* backup = cJSON_CreateObject();
+                cJSON_AddStringToObject(backup, "role", role.second);
+                cJSON_AddNumberToObject(backup, "index", index);
+                cJSON_AddNumberToObject(backup, "bus", channel->getIndex());
+                cJSON* romCode = cJSON_AddArrayToObject(backup, "romCode");
+                for (size_t i = 0; i < ROM_SIZE; i++) {
+                    cJSON_AddItemToArray(romCode, cJSON_CreateNumber(sensor->getInfo().rom_code.bytes[i]));
+                }
+                cJSON_AddItemToArray(backups, backup);
+            }
         }
     }
 
     return PBRet::SUCCESS;
 }
 
-PBRet PBOneWire::_createAndAssignSensor(const PBDS18B20Sensor& sensorConfig, DS18B20Role role, DS18B20_RESOLUTION res, const std::string& name)
+PBRet PBOneWire::deserializeBusMap(const cJSON* root)
 {
-    // Create a sensor object and assign it a role
-    std::shared_ptr<Ds18b20> sensor = std::make_shared<Ds18b20>(sensorConfig, res, _owb);
+    // Read the saved bus of each sensor. Must be called before deserialize
 
-    if (sensor->isConfigured() == false) {
-        ESP_LOGW(PBOneWire::Name, "Failed to initialize and assign %s sensor", name.c_str());
+    if (root == nullptr) {
+        ESP_LOGW(PBOneWire::Name, "cJSON root was null");
         return PBRet::FAILURE;
     }
 
-    ESP_LOGI(PBOneWire::Name, "Read %s sensor from file", name.c_str());
+    _savedBusMap.clear();
+    _savedBackups.clear();
+    for (const std::pair<DS18B20Role, const char*>& role : RoleNames) {
+        cJSON* busNode = cJSON_GetObjectItem(root, role.second);
+        if (cJSON_IsNumber(busNode) && (busNode->valueint >= 0)) {
+            _savedBusMap[role.first] = busNode->valueint;
+        }
+    }
+
+    // Backup sensors. Older files don't have any
+    cJSON* backups = cJSON_GetObjectItem(root, "backups");
+    cJSON* backup = nullptr;
+    cJSON_ArrayForEach(backup, backups) {
+        cJSON* roleNode = cJSON_GetObjectItem(backup, "role");
+        cJSON* indexNode = cJSON_GetObjectItem(backup, "index");
+        cJSON* busNode = cJSON_GetObjectItem(backup, "bus");
+        cJSON* romNode = cJSON_GetObjectItem(backup, "romCode");
+        if ((cJSON_IsString(roleNode) == false) || (cJSON_IsNumber(indexNode) == false) || (cJSON_IsNumber(busNode) == false) ||
+            (indexNode->valueint < 1) || (indexNode->valueint >= MaxSensorsPerRole) || (cJSON_GetArraySize(romNode) != ROM_SIZE)) {
+            ESP_LOGW(PBOneWire::Name, "Backup sensor entry was invalid");
+            continue;
+        }
+
+        for (const std::pair<DS18B20Role, const char*>& role : RoleNames) {
+            if (strcmp(roleNode->valuestring, role.second) != 0) {
+                continue;
+            }
+
+            // Calibration comes from the calibration store
+            const SensorSlot slot(role.first, indexNode->valueint);
+            PBDS18B20Sensor sensor {};
+            for (size_t i = 0; i < ROM_SIZE; i++) {
+                sensor.mutable_romCode()[i] = cJSON_GetArrayItem(romNode, i)->valueint;
+            }
+
+            _savedBackups[slot] = sensor;
+            _savedBusMap[slot] = busNode->valueint;
+        }
+    }
 
-    _assignedSensors[role] = sensor;
     return PBRet::SUCCESS;
 }
 
@@ -379,41 +1051,182 @@ bool PBOneWire::_romCodesMatch(const OneWireBus_ROMCode& a, const OneWireBus_ROM
     return memcmp(a.bytes, b.bytes, ROM_SIZE) == 0;
 }
 
-PBRet PBOneWire::setTempSensor(DS18B20Role type, const std::shared_ptr<Ds18b20>& sensor)
+PBRet PBOneWire::setTempSensor(DS18B20Role type, const std::shared_ptr<Ds18b20>& sensor, uint8_t index)
 {
-    // First, we must "unassign" the sensor if it is already assigned
-    auto it = std::find_if(_assignedSensors.begin(), _assignedSensors.end(), 
-                           [&sensor] (const auto& p) { return *p.second == *sensor; });
+    // Index 0 is the primary sensor for the role, others are backups
+    if (index >= MaxSensorsPerRole) {
+        ESP_LOGW(PBOneWire::Name, "Sensor index %d is out of range", index);
+        return PBRet::FAILURE;
+    }
+    const SensorSlot slot(type, index);
 
-    if (it != _assignedSensors.end()) { 
-        _assignedSensors.erase(it); 
+    // Sensor must be on one of our buses
+    OneWireChannel* target = _getChannel(sensor->getInfo().bus);
+    if (target == nullptr) {
+        ESP_LOGW(PBOneWire::Name, "Sensor is not on a known bus");
+        return PBRet::FAILURE;
     }
 
-    // Assign sensor to new type
-    _assignedSensors[type] = sensor;
+    // First, we must "unassign" the sensor if it is already assigned, and
+    // whatever sensor currently holds the role, which may be on another bus
+    for (const std::unique_ptr<OneWireChannel>& channel : _channels) {
+        SensorSlot removed {};
+        if (channel->removeSensor(*sensor, &removed)) {
+            _health.removeSensor(_slotID(removed));
+        }
+
+        std::shared_ptr<Ds18b20> current = channel->getSensor(slot);
+        if (current != nullptr) {
+            channel->removeSensor(*current);
+        }
+    }
+
+    // A user assignment replaces any saved sensor still waiting to appear,
+    // and any calibration in progress for the role
+    _pendingSensors.erase(slot);
+    if (index == 0) {
+        _calibrationPoints.erase(type);
+        _rawTemps.erase(type);
+    }
+
+    // Assign sensor to new type. This applies the role's resolution
+    if (target->addSensor(slot, sensor, getSamplingConfig(_cfg, type)) != PBRet::SUCCESS) {
+        return PBRet::FAILURE;
+    }
+
+    return _health.addSensor(_slotID(slot), esp_timer_get_time());
+}
+
+const OneWireBus* PBOneWire::getOWB(const OneWireBus_ROMCode& romCode) const
+{
+    // Find the bus a device is wired to
+
+    for (const std::unique_ptr<OneWireChannel>& channel : _channels) {
+        DeviceVector devices {};
+        if (channel->getDevices(devices) != PBRet::SUCCESS) {
+            continue;
+        }
+
+        for (const OneWireBus_ROMCode& addr : devices) {
+            if (_romCodesMatch(romCode, addr)) {
+                return channel->getOWB();
+            }
+        }
+    }
+
+    ESP_LOGW(PBOneWire::Name, "Device was not found on any bus");
+    return nullptr;
+}
+
+std::shared_ptr<Ds18b20> PBOneWire::_getSensor(const SensorSlot& slot) const
+{
+    for (const std::unique_ptr<OneWireChannel>& channel : _channels) {
+        std::shared_ptr<Ds18b20> sensor = channel->getSensor(slot);
+        if (sensor != nullptr) {
+            return sensor;
+        }
+    }
+
+    return nullptr;
+}
+
+OneWireChannel* PBOneWire::_getChannel(const OneWireBus* bus) const
+{
+    for (const std::unique_ptr<OneWireChannel>& channel : _channels) {
+        if ((bus != nullptr) && (channel->getOWB() == bus)) {
+            return channel.get();
+        }
+    }
+
+    return nullptr;
+}
+
+SensorCalibration PBOneWire::getCalibration(const OneWireBus_ROMCode& romCode) const
+{
+    // Uncalibrated sensors read raw temperature
+
+    SensorCalibration calibration {};
+    _calibrations.find(romCode, calibration);
+
+    return calibration;
+}
+
+PBRet PBOneWire::addCalibrationPoint(DS18B20Role role, double referenceTemp)
+{
+    // Pair the latest raw reading of the sensor in role with a reference
+    // reading. The sensor should have settled at the reference temperature
+
+    std::unordered_map<DS18B20Role, double>::const_iterator raw = _rawTemps.find(role);
+    if ((_getSensor(role) == nullptr) || (raw == _rawTemps.end())) {
+        ESP_LOGW(PBOneWire::Name, "No reading from %s sensor to calibrate against", getRoleName(role));
+        return PBRet::FAILURE;
+    }
+
+    CalibrationPoints& points = _calibrationPoints[role];
+    points.raw.push_back(raw->second);
+    points.ref.push_back(referenceTemp);
+    ESP_LOGI(PBOneWire::Name, "%s calibration point %d: raw %.3f, reference %.3f", getRoleName(role), points.raw.size(), raw->second, referenceTemp);
 
     return PBRet::SUCCESS;
 }
 
-PBRet PBOneWire::_readTemperatureSensor(DS18B20Role sensor, double& T) const
+PBRet PBOneWire::fitCalibration(DS18B20Role role, size_t order)
 {
-    // Attempt to read the temperature of a sensor with a prescribed role.
-    SensorMap::const_iterator it = _assignedSensors.find(sensor);
+    // Fit calibration coefficients to the collected points and apply them
+    // to the sensor. Two points with a first order fit is a standard two
+    // point calibration
+
+    std::shared_ptr<Ds18b20> sensor = _getSensor(role);
+    std::unordered_map<DS18B20Role, CalibrationPoints>::iterator points = _calibrationPoints.find(role);
+    if ((sensor == nullptr) || (points == _calibrationPoints.end())) {
+        ESP_LOGW(PBOneWire::Name, "No %s calibration points to fit", getRoleName(role));
+        return PBRet::FAILURE;
+    }
+
+    const std::vector<double>& raw = points->second.raw;
+    const std::vector<double>& ref = points->second.ref;
+    SensorCalibration calibration {};
+    PBRet err = PBRet::FAILURE;
+    if ((order == 1) && (raw.size() == 2)) {
+        err = SensorCalibration::fitTwoPoint(raw[0], ref[0], raw[1], ref[1], calibration);
+    } else {
+        err = SensorCalibration::fitPolynomial(raw, ref, order, calibration);
+    }
 
-    if (it == _assignedSensors.end()) {
-        // Role has no assigned sensor
+    if (err != PBRet::SUCCESS) {
+        ESP_LOGW(PBOneWire::Name, "Unable to fit %s calibration", getRoleName(role));
         return PBRet::FAILURE;
     }
 
-    // Compiler doesn't like getting the address for a double inside this fn
-    // TODO: Fix this weirdness
-    float temp = 0.0;
-    if (it->second->readTemp(temp) == PBRet::SUCCESS) {
-        // Successfully read temperature sensor
-        T = temp;
+    for (const std::unique_ptr<OneWireChannel>& channel : _channels) {
+        if (channel->hasSensor(role)) {
+            channel->setCalibration(role, calibration);
+        }
+    }
+
+    _calibrations.set(sensor->getInfo().rom_code, calibration);
+    _calibrationPoints.erase(points);
+    ESP_LOGI(PBOneWire::Name, "%s sensor calibrated with order %d fit", getRoleName(role), order);
+
+    return PBRet::SUCCESS;
+}
+
+PBRet PBOneWire::clearCalibration(DS18B20Role role)
+{
+    // Discard collected points and return the sensor to raw readings
+
+    _calibrationPoints.erase(role);
+    std::shared_ptr<Ds18b20> sensor = _getSensor(role);
+    if (sensor == nullptr) {
         return PBRet::SUCCESS;
     }
 
-    // Sensor read failed
-    return PBRet::FAILURE;
-}
\ No newline at end of file
+    for (const std::unique_ptr<OneWireChannel>& channel : _channels) {
+        if (channel->hasSensor(role)) {
+            channel->setCalibration(role, SensorCalibration {});
+        }
+    }
+    _calibrations.erase(sensor->getInfo().rom_code);
+
+    return PBRet::SUCCESS;
+}
@@ -1,15 +1,14 @@
 #ifndef ONEWIRE_BUS_H
 #define ONEWIRE_BUS_H
 
+#include <array>
 #include <vector>
 #include <memory>
 #include <unordered_map>
 #include "PBCommon.h"
 #include "MessageServer.h"
 #include "PBds18b20.h"
-#include "owb.h"
-#include "owb_rmt.h"
-#include "freertos/semphr.h"
+#include "OneWireChannel.h"
 #include "ds18b20.h"
 #include "IO/Writable.h"
 #include "IO/Readable.h"
@@ -22,13 +21,25 @@
 
 constexpr uint8_t DEVICE_DATA_LEN = 12;
 using PBDeviceData = DeviceData<DEVICE_DATA_LEN, ROM_SIZE>;
-using SensorMap = std::unordered_map<DS18B20Role, std::shared_ptr<Ds18b20>>;
-using DeviceVector = std::vector<OneWireBus_ROMCode>;
+using SamplingMap = std::unordered_map<DS18B20Role, DS18B20SamplingConfig>;
+using BusMap = std::unordered_map<SensorSlot, size_t, SensorSlotHash>;
+using SavedSensorMap = std::unordered_map<SensorSlot, PBDS18B20Sensor, SensorSlotHash>;
+
+// Reference readings collected during a calibration procedure
+struct CalibrationPoints
+{
+    std::vector<double> raw {};         // Uncalibrated sensor readings [deg C]
+    std::vector<double> ref {};         // Reference thermometer readings [deg C]
+};
 
 struct PBOneWireConfig
 {
-    gpio_num_t oneWirePin = (gpio_num_t)GPIO_NUM_NC;
-    DS18B20_RESOLUTION tempSensorResolution = DS18B20_RESOLUTION_INVALID;
+    gpio_num_t oneWirePin = (gpio_num_t)GPIO_NUM_NC;                        // Used when no buses are listed
+    DS18B20_RESOLUTION tempSensorResolution = DS18B20_RESOLUTION_INVALID;   // Default for roles without sampling config
+    SamplingMap sensorSampling {};                                          // Per role resolution and sample period
+    std::vector<OneWireChannelConfig> buses {};                             // Independent buses, each on its own RMT channel pair
+    DeviceDiscoveryConfig discovery {};                                     // Background hot-plug discovery. Disabled if period is 0
+    SensorHealthConfig health {};                                           // Sensor health tracking. Disabled if timeout is 0
 };
 
 class PBOneWire
@@ -37,6 +48,8 @@ class PBOneWire
     static constexpr const char *Name = "PBOneWire";
     static constexpr double MaxValidTemp = 110.0;
     static constexpr double MinValidTemp = -10.0;
+    static constexpr size_t TimingReportSamples = 500;     // Log conversion timing every N reads
+    static constexpr TickType_t StepTimeout = 50 / portTICK_PERIOD_MS;
 
 public:
     // Constructors
@@ -44,45 +57,91 @@ public:
     explicit PBOneWire(const PBOneWireConfig &cfg);
 
     // Update
-    PBRet readTempSensors(TemperatureData &Tdata) const;
+    PBRet readTempSensors(TemperatureData &Tdata, bool& updated);
 
     // Get/Set
-    PBRet setTempSensor(DS18B20Role type, const std::shared_ptr<Ds18b20>& sensor);
-    const OneWireBus *getOWB(void) const { return _owb; } // Probably not a great idea. Consider removing
+    PBRet setTempSensor(DS18B20Role type, const std::shared_ptr<Ds18b20>& sensor, uint8_t index = 0);
+    void setSetpoint(double setpoint) { _setpoint = setpoint; _hasSetpoint = true; }
+    double getSetpoint(void) const { return _setpoint; }
+    DS18B20_RESOLUTION getResolution(DS18B20Role role) const;
+    const OneWireBus *getOWB(const OneWireBus_ROMCode& romCode) const;
+    size_t getBusCount(void) const { return _channels.size(); }
+
+    // Health. A role is healthy while any of its sensors is
+    bool isRoleHealthy(DS18B20Role role) const;
+
+    // Acquisition time of the latest temperature for a role. 0 if none
+    int64_t getSampleTime(DS18B20Role role) const;
+    const SensorHealthStats& getHealth(const SensorSlot& slot) const { return _health.getStats(_slotID(slot)); }
+
+    // Calibration. Coefficients are looked up from the store when a sensor
+    // is assigned, so must be set before sensors are loaded
+    void setCalibrationStore(const CalibrationStore& store) { _calibrations = store; }
+    const CalibrationStore& getCalibrationStore(void) const { return _calibrations; }
+    SensorCalibration getCalibration(const OneWireBus_ROMCode& romCode) const;
+    PBRet addCalibrationPoint(DS18B20Role role, double referenceTemp);
+    PBRet fitCalibration(DS18B20Role role, size_t order);
+    PBRet clearCalibration(DS18B20Role role);
 
     // Utility
     PBRet serialize(Writable& buffer) const;
     PBRet deserialize(Readable& buffer);
+    PBRet serializeBusMap(cJSON* root) const;
+    PBRet deserializeBusMap(const cJSON* root);
     PBRet broadcastAvailableDevices(void) const;
 
     static PBRet checkInputs(const PBOneWireConfig &cfg);
     static PBRet loadFromJSON(PBOneWireConfig &cfg, const cJSON *cfgRoot);
+    static DS18B20SamplingConfig getSamplingConfig(const PBOneWireConfig& cfg, DS18B20Role role);
+    static std::vector<OneWireChannelConfig> getBusConfigs(const PBOneWireConfig& cfg);
+    static const char* getRoleName(DS18B20Role role);
     bool isConfigured(void) const { return _configured; }
 
 private:
     // Initialisation
     PBRet _initFromParams(const PBOneWireConfig &cfg);
-    PBRet _initOWB();
-    PBRet _loadKnownDevices(const char *basePath, const char *partitionLabel);
 
     // Update
-    PBRet _readTempSensors(const TemperatureData &Tdata);
-    PBRet _oneWireConvert(void) const;
+    void _reportConversionTiming(void);
+    static PBRet _setRoleTemp(DS18B20Role role, double T, TemperatureData& Tdata);
+    PBRet _processDiscoveryEvents(void);
+    void _updateHealth(const SampleMap& samples, int64_t t);
+    PBRet _broadcastHealth(const SensorSlot& slot) const;
+    PBRet _scanBuses(std::vector<DeviceVector>& busDevices) const;
 
     // Utility
-    PBRet _scanForDevices(DeviceVector& devices) const;
     PBRet _broadcastDeviceAddresses(const DeviceVector& deviceAddresses) const;
-    PBRet _readTemperatureSensor(DS18B20Role sensor, double& T) const;
+    std::shared_ptr<Ds18b20> _getSensor(const SensorSlot& slot) const;
+    OneWireChannel* _getChannel(const OneWireBus* bus) const;
     static bool _isAvailableSensor(const PBDS18B20Sensor& sensor, const DeviceVector& deviceAddresses);
     static bool _romCodesMatch(const OneWireBus_ROMCode& a, const OneWireBus_ROMCode& b);
-    PBRet _createAndAssignSensor(const PBDS18B20Sensor& sensorConfig, DS18B20Role role, DS18B20_RESOLUTION res, const std::string& name);
-
-    SemaphoreHandle_t _OWBMutex = NULL;
-    OneWireBus *_owb = nullptr;
-    owb_rmt_driver_info *_rmtDriver = nullptr;
-
-    // Assigned sensors
-    SensorMap _assignedSensors {};
+    static PBRet _loadSamplingFromJSON(DS18B20SamplingConfig& cfg, const cJSON* cfgRoot);
+    static PBRet _loadBusFromJSON(OneWireChannelConfig& cfg, const cJSON* cfgRoot);
+    PBRet _restoreSensor(const PBDS18B20Sensor& sensorConfig, const SensorSlot& slot, const std::vector<DeviceVector>& busDevices);
+    static size_t _slotID(const SensorSlot& slot);
+
+    // Buses
+    std::vector<std::unique_ptr<OneWireChannel>> _channels {};
+    BusMap _savedBusMap {};
+    SavedSensorMap _pendingSensors {};  // Saved sensors not yet found on any bus
+    SavedSensorMap _savedBackups {};    // Backup sensors read with the bus map
+
+    // Health and failover
+    SensorHealthMonitor _health {};
+    std::array<bool, SensorHealthMonitor::MaxSensors> _usable {};   // Sensors whose latest sample passed health checks
+    std::array<int, SensorRoleCount> _active {};                    // Slot index in use for each role. -1 if none is healthy
+    int64_t _lastHealthPublish = 0;
+    std::array<int64_t, SensorRoleCount> _sampleTimes {};          // Conversion start of the latest temperature for each role [us]
+
+    // Calibration
+    CalibrationStore _calibrations {};
+    std::unordered_map<DS18B20Role, double> _rawTemps {};
+    std::unordered_map<DS18B20Role, CalibrationPoints> _calibrationPoints {};
+
+    // Conversion sequencing
+    double _setpoint = 0.0;
+    bool _hasSetpoint = false;
+    RunningStats _readTime {};      // Time the caller is blocked per read [s]
 
     // Class data
     PBOneWireConfig _cfg{};
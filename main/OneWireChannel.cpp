@@ -0,0 +1,524 @@
+#include "OneWireChannel.h"
+#include "esp_timer.h"
+#include <algorithm>
+
+OneWireChannel::OneWireChannel(const OneWireChannelConfig& cfg, size_t index)
+    : _cfg(cfg), _index(index)
+{
+    if (checkInputs(cfg) != PBRet::SUCCESS) {
+        ESP_LOGE(OneWireChannel::Name, "Bus %d config was invalid", _index);
+        return;
+    }
+
+    if (_initOWB() != PBRet::SUCCESS) {
+        ESP_LOGE(OneWireChannel::Name, "Failed to configure bus %d", _index);
+        return;
+    }
+
+    _mutex = xSemaphoreCreateMutex();
+    if (_mutex == NULL) {
+        ESP_LOGW(OneWireChannel::Name, "Unable to create mutex");
+        return;
+    }
+
+    ESP_LOGI(OneWireChannel::Name, "Bus %d configured on GPIO %d", _index, _cfg.pin);
+    _configured = true;
+}
+
+PBRet OneWireChannel::checkInputs(const OneWireChannelConfig& cfg)
+{
+    // Check pin is valid GPIO
+    if ((cfg.pin <= GPIO_NUM_NC) || (cfg.pin > GPIO_NUM_MAX)) {
+        ESP_LOGE(OneWireChannel::Name, "OneWire pin %d is invalid", cfg.pin);
+        return PBRet::FAILURE;
+    }
+
+    if ((cfg.txChannel < RMT_CHANNEL_0) || (cfg.txChannel >= RMT_CHANNEL_MAX) ||
+        (cfg.rxChannel < RMT_CHANNEL_0) || (cfg.rxChannel >= RMT_CHANNEL_MAX)) {
+        ESP_LOGE(OneWireChannel::Name, "RMT channels (%d, %d) are invalid", cfg.txChannel, cfg.rxChannel);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.txChannel == cfg.rxChannel) {
+        ESP_LOGE(OneWireChannel::Name, "RMT tx and rx channels must be different");
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet OneWireChannel::_initOWB(void)
+{
+    _rmtDriver = new owb_rmt_driver_info;
+    if (_rmtDriver == nullptr) {
+        ESP_LOGE(OneWireChannel::Name, "Unable to allocate memory for RMT driver");
+        return PBRet::FAILURE;
+    }
+
+    // Fields are statically allocated within owb_rmt_initialize
+    _owb = owb_rmt_initialize(_rmtDriver, _cfg.pin, _cfg.txChannel, _cfg.rxChannel);
+    if (_owb == nullptr) {
+        ESP_LOGE(OneWireChannel::Name, "OnewWireBus initialization returned nullptr");
+        return PBRet::FAILURE;
+    }
+
+    // Enable CRC check for ROM code. The return type from this method indicates
+    // if bus was configured correctly
+    if (owb_use_crc(_owb, true) != OWB_STATUS_OK) {
+        ESP_LOGE(OneWireChannel::Name, "OnewWireBus initialization failed");
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet OneWireChannel::scan(DeviceVector& devices) const
+{
+    if (_owb == nullptr) {
+        ESP_LOGW(OneWireChannel::Name, "Onewire bus pointer was null");
+        return PBRet::FAILURE;
+    }
+
+    if (xSemaphoreTake(_mutex, 250 / portTICK_PERIOD_MS) == pdTRUE) {
+        OneWireBus_SearchState search_state {};
+        bool found = false;
+        devices.clear();
+
+        owb_search_first(_owb, &search_state, &found);
+        while (found) {
+            devices.emplace_back(search_state.rom_code);
+            owb_search_next(_owb, &search_state, &found);
+        }
+        xSemaphoreGive(_mutex);
+    } else {
+        ESP_LOGW(OneWireChannel::Name, "Unable to access bus %d", _index);
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet OneWireChannel::getDevices(DeviceVector& devices) const
+{
+    // Devices on this bus. Answered from the discovery cache once a pass
+    // has completed, otherwise the bus is scanned
+
+    if (xSemaphoreTake(_mutex, 250 / portTICK_PERIOD_MS) != pdTRUE) {
+        ESP_LOGW(OneWireChannel::Name, "Unable to access bus %d", _index);
+        return PBRet::FAILURE;
+    }
+
+    const bool cached = _discovery.hasCompletedPass();
+    if (cached) {
+        _discovery.getKnownDevices(devices);
+    }
+    xSemaphoreGive(_mutex);
+
+    return cached ? PBRet::SUCCESS : scan(devices);
+}
+
+PBRet OneWireChannel::enableDiscovery(const DeviceDiscoveryConfig& cfg)
+{
+    DeviceDiscovery discovery(cfg, _index);
+    if (discovery.isConfigured() == false) {
+        ESP_LOGW(OneWireChannel::Name, "Bus %d: discovery config was invalid", _index);
+        return PBRet::FAILURE;
+    }
+
+    if (xSemaphoreTake(_mutex, 250 / portTICK_PERIOD_MS) != pdTRUE) {
+        ESP_LOGW(OneWireChannel::Name, "Unable to access bus %d", _index);
+        return PBRet::FAILURE;
+    }
+
+    _discovery = discovery;
+    xSemaphoreGive(_mutex);
+
+    return PBRet::SUCCESS;
+}
+
+PBRet OneWireChannel::collectEvents(std::vector<DiscoveryEvent>& events)
+{
+    // Move devices added or removed since the last call into events
+
+    if (xSemaphoreTake(_mutex, 10 / portTICK_PERIOD_MS) != pdTRUE) {
+        ESP_LOGW(OneWireChannel::Name, "Unable to access bus %d", _index);
+        return PBRet::FAILURE;
+    }
+
+    events.insert(events.end(), _events.begin(), _events.end());
+    _events.clear();
+    xSemaphoreGive(_mutex);
+
+    return PBRet::SUCCESS;
+}
+
+PBRet OneWireChannel::_discoveryStep(int64_t t)
+{
+    // Run one step of the ROM search. Each step finds at most one device,
+    // so the bus is held for a single search transaction. Must be called
+    // with the mutex held
+
+    if ((_discovery.inPass() == false) && (_discovery.passDue(t) == false)) {
+        return PBRet::SUCCESS;
+    }
+
+    const int64_t searchStart = esp_timer_get_time();
+    bool found = false;
+    owb_status err = OWB_STATUS_OK;
+    if (_discovery.inPass() == false) {
+        _discovery.beginPass(t);
+        _searchState = OneWireBus_SearchState {};
+        err = owb_search_first(_owb, &_searchState, &found);
+    } else {
+        err = owb_search_next(_owb, &_searchState, &found);
+    }
+    _searchTime.add((esp_timer_get_time() - searchStart) * 1e-6);
+
+    if (err != OWB_STATUS_OK) {
+        ESP_LOGW(OneWireChannel::Name, "Bus %d: ROM search failed (%d)", _index, err);
+        _discovery.abortPass();
+        return PBRet::FAILURE;
+    }
+
+    if (found) {
+        _discovery.found(_searchState.rom_code);
+    } else {
+        _discovery.endPass(_events);
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet OneWireChannel::addSensor(const SensorSlot& slot, const std::shared_ptr<Ds18b20>& sensor, const DS18B20SamplingConfig& sampling)
+{
+    // Assign a sensor on this bus to slot and start its sampling afresh
+
+    if (sensor == nullptr) {
+        ESP_LOGW(OneWireChannel::Name, "Sensor was null");
+        return PBRet::FAILURE;
+    }
+
+    if (xSemaphoreTake(_mutex, 250 / portTICK_PERIOD_MS) == pdTRUE) {
+        RoleSampler sampler {};
+        sampler.resolution = AdaptiveResolution(sampling);
+        const DS18B20_RESOLUTION res = sampler.resolution.getResolution();
+        sampler.pipeline = DS18B20Pipeline(DS18B20Pipeline::getConversionTime(res), sampler.resolution.getSamplePeriod());
+
+        if (sensor->getResolution() != res) {
+            sensor->setResolution(res);
+        }
+
+        _sensors[slot] = sensor;
+        _samplers[slot] = sampler;
+        _samples.erase(slot);
+        xSemaphoreGive(_mutex);
+    } else {
+        ESP_LOGW(OneWireChannel::Name, "Unable to access bus %d", _index);
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+bool OneWireChannel::removeSensor(const Ds18b20& sensor, SensorSlot* removedSlot)
+{
+    // Unassign sensor from whatever slot it holds on this bus. Returns true
+    // if it was found
+
+    bool removed = false;
+    if (xSemaphoreTake(_mutex, 250 / portTICK_PERIOD_MS) == pdTRUE) {
+        SensorMap::iterator it = std::find_if(_sensors.begin(), _sensors.end(),
+                                              [&sensor] (const auto& p) { return *p.second == sensor; });
+
+        if (it != _sensors.end()) {
+            if (removedSlot != nullptr) {
+                *removedSlot = it->first;
+            }
+            _samplers.erase(it->first);
+            _samples.erase(it->first);
+            _sensors.erase(it);
+            removed = true;
+        }
+        xSemaphoreGive(_mutex);
+    } else {
+        ESP_LOGW(OneWireChannel::Name, "Unable to access bus %d", _index);
+    }
+
+    return removed;
+}
+
+std::shared_ptr<Ds18b20> OneWireChannel::getSensor(const SensorSlot& slot) const
+{
+    SensorMap::const_iterator it = _sensors.find(slot);
+    if (it == _sensors.end()) {
+        return nullptr;
+    }
+
+    return it->second;
+}
+
+DS18B20_RESOLUTION OneWireChannel::getResolution(const SensorSlot& slot) const
+{
+    std::unordered_map<SensorSlot, RoleSampler, SensorSlotHash>::const_iterator it = _samplers.find(slot);
+    if (it == _samplers.end()) {
+        return DS18B20_RESOLUTION_INVALID;
+    }
+
+    return it->second.resolution.getResolution();
+}
+
+PBRet OneWireChannel::setCalibration(const SensorSlot& slot, const SensorCalibration& calibration)
+{
+    // Takes effect from the next read
+
+    if (xSemaphoreTake(_mutex, 250 / portTICK_PERIOD_MS) != pdTRUE) {
+        ESP_LOGW(OneWireChannel::Name, "Unable to access bus %d", _index);
+        return PBRet::FAILURE;
+    }
+
+    SensorMap::iterator it = _sensors.find(slot);
+    const bool found = (it != _sensors.end());
+    if (found) {
+        it->second->setCalibration(calibration);
+    }
+    xSemaphoreGive(_mutex);
+
+    return found ? PBRet::SUCCESS : PBRet::FAILURE;
+}
+
+PBRet OneWireChannel::_convert(const std::vector<SensorSlot>& slots) const
+{
+    // Start conversions on the requested sensors. This returns immediately;
+    // results are read from the scratchpads once the conversion time has
+    // elapsed. When every sensor on the bus is due a single skip ROM command
+    // starts them all, otherwise each sensor is addressed individually so
+    // conversions already in progress aren't disturbed
+
+    if (slots.size() == _sensors.size()) {
+        ds18b20_convert_all(_owb);
+        return PBRet::SUCCESS;
+    }
+
+    for (const SensorSlot& slot : slots) {
+        SensorMap::const_iterator it = _sensors.find(slot);
+        if ((it == _sensors.end()) || (it->second->startConversion() != PBRet::SUCCESS)) {
+            ESP_LOGW(OneWireChannel::Name, "Bus %d: unable to start conversion for role %d/%d", _index, static_cast<int>(slot.role), slot.index);
+            return PBRet::FAILURE;
+        }
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet OneWireChannel::_updateResolution(const SensorSlot& slot, RoleSampler& sampler, double T)
+{
+    // Switch adaptive sensors between high and low resolution depending on
+    // how close they are to the setpoint. Only called between conversions
+
+    const DS18B20_RESOLUTION res = sampler.resolution.getResolution();
+    SensorMap::const_iterator it = _sensors.find(slot);
+    if ((it == _sensors.end()) || (it->second->setResolution(res) != PBRet::SUCCESS)) {
+        ESP_LOGW(OneWireChannel::Name, "Bus %d: unable to set resolution for role %d/%d", _index, static_cast<int>(slot.role), slot.index);
+        return PBRet::FAILURE;
+    }
+
+    sampler.pipeline.setTiming(DS18B20Pipeline::getConversionTime(res), sampler.resolution.getSamplePeriod());
+    ESP_LOGI(OneWireChannel::Name, "Bus %d: role %d/%d switched to %d bit resolution", _index, static_cast<int>(slot.role), slot.index, res);
+
+    return PBRet::SUCCESS;
+}
+
+PBRet OneWireChannel::step(int64_t t, double setpoint, bool hasSetpoint)
+{
+    // Advance the conversion pipeline of each sensor on this bus. Each role
+    // samples at its own rate and resolution, and conversions on different
+    // sensors overlap
+
+    if (_configured == false) {
+        return PBRet::FAILURE;
+    }
+
+    if (xSemaphoreTake(_mutex, 10 / portTICK_PERIOD_MS) != pdTRUE) {
+        ESP_LOGW(OneWireChannel::Name, "Unable to access bus %d", _index);
+        return PBRet::FAILURE;
+    }
+
+    // Work out which sensors need the bus this tick
+    std::vector<SensorSlot> toRead {};
+    std::vector<SensorSlot> toStart {};
+    for (const std::pair<const SensorSlot, RoleSampler>& sampler : _samplers) {
+        const DS18B20Pipeline::Action action = sampler.second.pipeline.update(t);
+        if (action == DS18B20Pipeline::Action::READ) {
+            toRead.push_back(sampler.first);
+        } else if (action == DS18B20Pipeline::Action::START_CONVERSION) {
+            toStart.push_back(sampler.first);
+        }
+    }
+
+    // Bus is free this tick. Use it to look for new devices
+    if (toRead.empty() && toStart.empty()) {
+        const PBRet err = _discoveryStep(t);
+        xSemaphoreGive(_mutex);
+        return err;
+    }
+
+    const int64_t busStart = esp_timer_get_time();
+    for (const SensorSlot& slot : toRead) {
+        RoleSampler& sampler = _samplers[slot];
+
+        float temp = 0.0;
+        float rawTemp = 0.0;
+        DS18B20_ERROR err = DS18B20_OK;
+        RoleSample& sample = _samples[slot];
+        sample.timeStamp = sampler.pipeline.getConversionStartTime();
+        sample.fresh = true;
+        if (_sensors[slot]->readTemp(temp, rawTemp, err) == PBRet::SUCCESS) {
+            sample.T = temp;
+            sample.rawT = rawTemp;
+            sample.fault = SensorFault::NONE;
+
+            if (hasSetpoint && sampler.resolution.update(temp, setpoint)) {
+                _updateResolution(slot, sampler, temp);
+            }
+        } else {
+            sample.fault = (err == DS18B20_ERROR_CRC) ? SensorFault::CRC : SensorFault::TIMEOUT;
+        }
+        sampler.pipeline.samplesRead();
+
+        // Restart straight away if the sample period allows
+        if (sampler.pipeline.update(t) == DS18B20Pipeline::Action::START_CONVERSION) {
+            toStart.push_back(slot);
+        }
+    }
+
+    if (toStart.empty() == false) {
+        const bool started = (_convert(toStart) == PBRet::SUCCESS);
+        const int64_t startTime = esp_timer_get_time();
+        for (const SensorSlot& slot : toStart) {
+            if (started) {
+                _samplers[slot].pipeline.conversionStarted(startTime);
+            } else {
+                _samplers[slot].pipeline.abort();
+            }
+        }
+    }
+
+    _busTime.add((esp_timer_get_time() - busStart) * 1e-6);
+    xSemaphoreGive(_mutex);
+
+    return PBRet::SUCCESS;
+}
+
+PBRet OneWireChannel::collect(SampleMap& samples)
+{
+    // Copy samples taken since the last collect into samples
+
+    if (xSemaphoreTake(_mutex, 10 / portTICK_PERIOD_MS) != pdTRUE) {
+        ESP_LOGW(OneWireChannel::Name, "Unable to access bus %d", _index);
+        return PBRet::FAILURE;
+    }
+
+    for (std::pair<const SensorSlot, RoleSample>& sample : _samples) {
+        if (sample.second.fresh) {
+            samples[sample.first] = sample.second;
+            sample.second.fresh = false;
+        }
+    }
+
+    xSemaphoreGive(_mutex);
+    return PBRet::SUCCESS;
+}
+
+PBRet OneWireChannel::startWorker(void)
+{
+    // Create a task to run this bus's pipeline in parallel with the others
+
+    _stepDone = xSemaphoreCreateBinary();
+    if (_stepDone == NULL) {
+        ESP_LOGW(OneWireChannel::Name, "Unable to create step semaphore");
+        return PBRet::FAILURE;
+    }
+
+    if (xTaskCreatePinnedToCore(&OneWireChannel::_workerMain, OneWireChannel::Name, OneWireChannel::WorkerStackDepth,
+                                this, OneWireChannel::WorkerPriority, &_worker, OneWireChannel::WorkerCoreID) != pdPASS) {
+        ESP_LOGW(OneWireChannel::Name, "Unable to create worker task for bus %d", _index);
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+bool OneWireChannel::requestStep(int64_t t, double setpoint, bool hasSetpoint)
+{
+    // Ask the worker to run a step. A worker that overran last time is
+    // skipped rather than queued behind
+
+    if ((_worker == NULL) || _busy) {
+        return false;
+    }
+
+    // Clear a late completion from an earlier step
+    xSemaphoreTake(_stepDone, 0);
+
+    _reqTime = t;
+    _reqSetpoint = setpoint;
+    _reqHasSetpoint = hasSetpoint;
+    _busy = true;
+    xTaskNotifyGive(_worker);
+
+    return true;
+}
+
+bool OneWireChannel::waitForStep(TickType_t timeout)
+{
+    return xSemaphoreTake(_stepDone, timeout) == pdTRUE;
+}
+
+void OneWireChannel::_workerMain(void* arg)
+{
+    OneWireChannel* channel = static_cast<OneWireChannel*>(arg);
+    if (channel == nullptr) {
+        ESP_LOGW(OneWireChannel::Name, "Channel object was null");
+        vTaskDelete(NULL);
+        return;
+    }
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        channel->step(channel->_reqTime, channel->_reqSetpoint, channel->_reqHasSetpoint);
+        channel->_busy = false;
+        xSemaphoreGive(channel->_stepDone);
+    }
+}
+
+void OneWireChannel::reportTiming(void)
+{
+    // Log sample period jitter for each role and time spent on the bus,
+    // then start a new window
+
+    if (xSemaphoreTake(_mutex, 10 / portTICK_PERIOD_MS) != pdTRUE) {
+        return;
+    }
+
+    for (std::pair<const SensorSlot, RoleSampler>& sampler : _samplers) {
+        const RunningStats& interval = sampler.second.pipeline.getSampleIntervalStats();
+        if (interval.count() > 0) {
+            ESP_LOGI(OneWireChannel::Name, "Bus %d role %d/%d sample interval: mean %.1f ms, std %.2f ms, min %.1f ms, max %.1f ms",
+                _index, static_cast<int>(sampler.first.role), sampler.first.index, interval.mean() * 1e3, interval.stdDev() * 1e3,
+                interval.min() * 1e3, interval.max() * 1e3);
+        }
+        sampler.second.pipeline.resetStats();
+    }
+
+    if (_busTime.count() > 0) {
+        ESP_LOGI(OneWireChannel::Name, "Bus %d time per step: mean %.2f ms, max %.2f ms", _index, _busTime.mean() * 1e3, _busTime.max() * 1e3);
+    }
+    _busTime.reset();
+
+    if (_searchTime.count() > 0) {
+        ESP_LOGI(OneWireChannel::Name, "Bus %d time per discovery step: mean %.2f ms, max %.2f ms", _index, _searchTime.mean() * 1e3, _searchTime.max() * 1e3);
+    }
+    _searchTime.reset();
+
+    xSemaphoreGive(_mutex);
+}
@@ -0,0 +1,159 @@
+#ifndef ONEWIRE_CHANNEL_H
+#define ONEWIRE_CHANNEL_H
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <unordered_map>
+#include "PBCommon.h"
+#include "PBds18b20.h"
+#include "DS18B20Pipeline.h"
+#include "DeviceDiscovery.h"
+#include "SensorHealth.h"
+#include "owb.h"
+#include "owb_rmt.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "driver/rmt.h"
+
+// Each role has a primary sensor (index 0) and may have backups that are
+// sampled alongside it so they can take over straight away
+constexpr uint8_t MaxSensorsPerRole = 3;
+constexpr size_t SensorRoleCount = 5;
+
+struct SensorSlot
+{
+    SensorSlot(void) = default;
+    SensorSlot(DS18B20Role role, uint8_t index = 0)
+        : role(role), index(index) {}
+
+    bool operator==(const SensorSlot& other) const { return (role == other.role) && (index == other.index); }
+
+    DS18B20Role role {};
+    uint8_t index = 0;
+};
+
+struct SensorSlotHash
+{
+    size_t operator()(const SensorSlot& slot) const { return static_cast<size_t>(slot.role) * MaxSensorsPerRole + slot.index; }
+};
+
+using SensorMap = std::unordered_map<SensorSlot, std::shared_ptr<Ds18b20>, SensorSlotHash>;
+
+struct OneWireChannelConfig
+{
+    gpio_num_t pin = (gpio_num_t)GPIO_NUM_NC;
+    rmt_channel_t txChannel = RMT_CHANNEL_MAX;
+    rmt_channel_t rxChannel = RMT_CHANNEL_MAX;
+};
+
+// Conversion state of a sensor role
+struct RoleSampler
+{
+    DS18B20Pipeline pipeline {};
+    AdaptiveResolution resolution {};
+};
+
+// Latest reading from a sensor. Failed reads are passed on so the sensor's
+// health can be tracked
+struct RoleSample
+{
+    double T = 0.0;                         // Calibrated temperature [deg C]
+    double rawT = 0.0;                      // Uncalibrated temperature [deg C]
+    int64_t timeStamp = 0;                  // Conversion start time [us]
+    SensorFault fault = SensorFault::NONE;  // Why the read failed
+    bool fresh = false;                     // Not yet collected
+};
+
+using SampleMap = std::unordered_map<SensorSlot, RoleSample, SensorSlotHash>;
+
+// A single physical OneWire bus on its own GPIO and RMT channel pair. Each
+// channel runs the conversion pipelines for the sensors wired to it. When
+// there is more than one channel, each gets a worker task so transactions
+// on different buses run in parallel
+class OneWireChannel
+{
+    static constexpr const char* Name = "OneWireChannel";
+    static constexpr UBaseType_t WorkerPriority = 8;
+    static constexpr UBaseType_t WorkerStackDepth = 4096;
+    static constexpr BaseType_t WorkerCoreID = 0;
+
+    public:
+        // Constructors
+        OneWireChannel(void) = default;
+        OneWireChannel(const OneWireChannelConfig& cfg, size_t index);
+        OneWireChannel(const OneWireChannel&) = delete;
+        OneWireChannel& operator=(const OneWireChannel&) = delete;
+
+        // Update. Advance the conversion pipelines of all sensors on this
+        // bus. Never waits on a conversion
+        PBRet step(int64_t t, double setpoint, bool hasSetpoint);
+        PBRet collect(SampleMap& samples);
+
+        // Worker task. requestStep returns false if the previous step is
+        // still running
+        PBRet startWorker(void);
+        bool requestStep(int64_t t, double setpoint, bool hasSetpoint);
+        bool waitForStep(TickType_t timeout);
+
+        // Background discovery. Runs one ROM search step on ticks where the
+        // bus is otherwise idle
+        PBRet enableDiscovery(const DeviceDiscoveryConfig& cfg);
+        PBRet collectEvents(std::vector<DiscoveryEvent>& events);
+
+        // Sensors
+        PBRet addSensor(const SensorSlot& slot, const std::shared_ptr<Ds18b20>& sensor, const DS18B20SamplingConfig& sampling);
+        bool removeSensor(const Ds18b20& sensor, SensorSlot* removedSlot = nullptr);
+        bool hasSensor(const SensorSlot& slot) const { return _sensors.find(slot) != _sensors.end(); }
+        std::shared_ptr<Ds18b20> getSensor(const SensorSlot& slot) const;
+        DS18B20_RESOLUTION getResolution(const SensorSlot& slot) const;
+        PBRet setCalibration(const SensorSlot& slot, const SensorCalibration& calibration);
+
+        // Utility
+        PBRet scan(DeviceVector& devices) const;
+        PBRet getDevices(DeviceVector& devices) const;
+        void reportTiming(void);
+
+        const OneWireBus* getOWB(void) const { return _owb; }
+        size_t getIndex(void) const { return _index; }
+        static PBRet checkInputs(const OneWireChannelConfig& cfg);
+        bool isConfigured(void) const { return _configured; }
+
+    private:
+        PBRet _initOWB(void);
+        PBRet _convert(const std::vector<SensorSlot>& slots) const;
+        PBRet _updateResolution(const SensorSlot& slot, RoleSampler& sampler, double T);
+        PBRet _discoveryStep(int64_t t);
+        static void _workerMain(void* arg);
+
+        OneWireChannelConfig _cfg {};
+        size_t _index = 0;
+        OneWireBus* _owb = nullptr;
+        owb_rmt_driver_info* _rmtDriver = nullptr;
+        SemaphoreHandle_t _mutex = NULL;
+
+        // Sensors on this bus
+        SensorMap _sensors {};
+        std::unordered_map<SensorSlot, RoleSampler, SensorSlotHash> _samplers {};
+        SampleMap _samples {};
+
+        // Background discovery
+        DeviceDiscovery _discovery {};
+        OneWireBus_SearchState _searchState {};
+        std::vector<DiscoveryEvent> _events {};
+
+        // Worker task
+        TaskHandle_t _worker = NULL;
+        SemaphoreHandle_t _stepDone = NULL;
+        std::atomic<bool> _busy {false};
+        int64_t _reqTime = 0;
+        double _reqSetpoint = 0.0;
+        bool _reqHasSetpoint = false;
+
+        RunningStats _busTime {};       // Time spent on bus transactions per step [s]
+        RunningStats _searchTime {};    // Time spent per discovery step [s]
+        bool _configured = false;
+};
+
+#endif // ONEWIRE_CHANNEL_H
@@ -48,25 +48,71 @@ PBRet Ds18b20::loadFromSerial(const PBDS18B20Sensor& serialConfig, DS18B20_RESOL
         romCode.bytes[i] = serialConfig.romCode()[i];
     }
 
-    const double calibLinear = serialConfig.calibLinear();
-    const double calibOffset = serialConfig.calibOffset();
+    // Registries written before calibration was applied may hold a zero
+    // gain. Treat these as uncalibrated
+    SensorCalibration calibration {};
+    if (serialConfig.calibLinear() != 0.0) {
+        calibration = SensorCalibration({serialConfig.calibOffset(), serialConfig.calibLinear(), 0.0, 0.0}, 1);
+    }
 
-    config = Ds18b20Config(romCode, calibLinear, calibOffset, res, bus);
+    config = Ds18b20Config(romCode, calibration, res, bus);
     return PBRet::SUCCESS;
 }
 
 PBRet Ds18b20::readTemp(float& temp) const
 {
+    float rawTemp = 0.0;
+    DS18B20_ERROR err = DS18B20_OK;
+    return readTemp(temp, rawTemp, err);
+}
+
+PBRet Ds18b20::readTemp(float& temp, float& rawTemp, DS18B20_ERROR& err) const
+{
+    err = DS18B20_ERROR_UNKNOWN;
     if (_configured == false) {
         ESP_LOGW(Ds18b20::Name, "Sensor is not configured. Temperature read failed");
         return PBRet::FAILURE;
     }
 
-    if (ds18b20_read_temp(&_info, &temp) != DS18B20_OK) {
+    err = ds18b20_read_temp(&_info, &rawTemp);
+    if (err != DS18B20_OK) {
         ESP_LOGW(Ds18b20::Name, "Temperature read failed");
         return PBRet::FAILURE;
     }
 
+    temp = _config.calibration.apply(rawTemp);
+    return PBRet::SUCCESS;
+}
+
+PBRet Ds18b20::startConversion(void) const
+{
+    // Start a conversion on this sensor only. Returns immediately
+
+    if (_configured == false) {
+        ESP_LOGW(Ds18b20::Name, "Sensor is not configured. Conversion not started");
+        return PBRet::FAILURE;
+    }
+
+    ds18b20_convert(&_info);
+
+    return PBRet::SUCCESS;
+}
+
+PBRet Ds18b20::setResolution(DS18B20_RESOLUTION res)
+{
+    // Change the sensor resolution. Must not be called mid conversion
+
+    if (_configured == false) {
+        ESP_LOGW(Ds18b20::Name, "Sensor is not configured. Resolution not set");
+        return PBRet::FAILURE;
+    }
+
+    if (ds18b20_set_resolution(&_info, res) == false) {
+        ESP_LOGW(Ds18b20::Name, "Failed to set resolution");
+        return PBRet::FAILURE;
+    }
+
+    _config.res = res;
     return PBRet::SUCCESS;
 }
 
@@ -142,9 +188,11 @@ bool Ds18b20::operator==(const Ds18b20& other) const
 // of the sensor
 PBDS18B20Sensor Ds18b20::toSerialConfig(void) const
 {
+    // Only the linear terms fit in the registry. Higher order calibrations
+    // live in the calibration store
     PBDS18B20Sensor sensor {};
-    sensor.set_calibLinear(_config.calibLinear);
-    sensor.set_calibOffset(_config.calibOffset);
+    sensor.set_calibLinear(_config.calibration.getCoefficients()[1]);
+    sensor.set_calibOffset(_config.calibration.getCoefficients()[0]);
 
     // Copy ROM code
     for (size_t i = 0; i < ROM_SIZE; i++) {
@@ -4,6 +4,7 @@
 #include "PBCommon.h"
 #include "ds18b20.h"
 #include "cJSON.h"
+#include "SensorCalibration.h"
 #include "Generated/DS18B20Messaging.h"
 #include "Generated/SensorManagerMessaging.h"
 
@@ -15,14 +16,12 @@ class Ds18b20Config
 {
     public:
         Ds18b20Config(void) = default;
-        Ds18b20Config(const OneWireBus_ROMCode& romCode, double calibLinear, 
-                      double calibOffset, DS18B20_RESOLUTION res, const OneWireBus* bus)
-            : romCode(romCode), calibLinear(calibLinear), calibOffset(calibOffset),
-              res(res), bus(bus) {}
+        Ds18b20Config(const OneWireBus_ROMCode& romCode, const SensorCalibration& calibration,
+                      DS18B20_RESOLUTION res, const OneWireBus* bus)
+            : romCode(romCode), calibration(calibration), res(res), bus(bus) {}
 
         OneWireBus_ROMCode romCode {};
-        double calibLinear = 0.0;
-        double calibOffset = 0.0;
+        SensorCalibration calibration {};
         DS18B20_RESOLUTION res = DS18B20_RESOLUTION::DS18B20_RESOLUTION_INVALID;
         const OneWireBus* bus = nullptr;
 };
@@ -36,8 +35,12 @@ class Ds18b20
         explicit Ds18b20(const Ds18b20Config& config);
         Ds18b20(const PBDS18B20Sensor& serialConfig, DS18B20_RESOLUTION res, const OneWireBus* bus);
         
-        // Update
+        // Update. Temperatures are calibrated, rawTemp is as read from the
+        // sensor
         PBRet readTemp(float& temp) const;
+        PBRet readTemp(float& temp, float& rawTemp, DS18B20_ERROR& err) const;
+        PBRet startConversion(void) const;
+        PBRet setResolution(DS18B20_RESOLUTION res);
 
         // Utility
         PBRet serialize(cJSON* root) const;
@@ -50,6 +53,9 @@ class Ds18b20
         bool operator ==(const Ds18b20& other) const;
 
         const DS18B20_Info& getInfo(void) const { return _info; }
+        DS18B20_RESOLUTION getResolution(void) const { return _config.res; }
+        const SensorCalibration& getCalibration(void) const { return _config.calibration; }
+        void setCalibration(const SensorCalibration& calibration) { _config.calibration = calibration; }
         bool isConfigured(void) const { return _configured; }
 
     private:
@@ -0,0 +1,223 @@
+#include "PulseCounter.h"
+#include "driver/gpio.h"
+
+PCNTCounter::PCNTCounter(gpio_num_t pin, pcnt_unit_t unit)
+    : _pin(pin), _unit(unit)
+{
+    if ((_initPCNT(pin) == PBRet::SUCCESS) && (_initEdgeISR() == PBRet::SUCCESS)) {
+        ESP_LOGI(PCNTCounter::Name, "Counting pulses on pin %d with PCNT unit %d", pin, unit);
+        _configured = true;
+    } else {
+        ESP_LOGW(PCNTCounter::Name, "PCNT unit %d was not configured on pin %d", unit, pin);
+    }
+}
+
+PCNTCounter::~PCNTCounter(void)
+{
+    if (_configured) {
+        pcnt_counter_pause(_unit);
+        pcnt_isr_handler_remove(_unit);
+        gpio_isr_handler_remove(_pin);
+    }
+}
+
+PBRet PCNTCounter::_initPCNT(gpio_num_t pin)
+{
+    if ((_unit < PCNT_UNIT_0) || (_unit >= PCNT_UNIT_MAX)) {
+        ESP_LOGE(PCNTCounter::Name, "PCNT unit %d is invalid", _unit);
+        return PBRet::FAILURE;
+    }
+
+    // Count rising edges only. The control input is unused
+    pcnt_config_t pcntConfig = {
+        .pulse_gpio_num = pin,
+        .ctrl_gpio_num = PCNT_PIN_NOT_USED,
+        .lctrl_mode = PCNT_MODE_KEEP,
+        .hctrl_mode = PCNT_MODE_KEEP,
+        .pos_mode = PCNT_COUNT_INC,
+        .neg_mode = PCNT_COUNT_DIS,
+        .counter_h_lim = HighLimit,
+        .counter_l_lim = 0,
+        .unit = _unit,
+        .channel = PCNT_CHANNEL_0
+    };
+
+    if (pcnt_unit_config(&pcntConfig) != ESP_OK) {
+        ESP_LOGE(PCNTCounter::Name, "Failed to configure PCNT unit");
+        return PBRet::FAILURE;
+    }
+
+    // The flowmeter input is pulled up like the GPIO fallback
+    gpio_set_pull_mode(pin, GPIO_PULLUP_ONLY);
+
+    if ((pcnt_set_filter_value(_unit, FilterLength) != ESP_OK) || (pcnt_filter_enable(_unit) != ESP_OK)) {
+        ESP_LOGE(PCNTCounter::Name, "Failed to configure PCNT glitch filter");
+        return PBRet::FAILURE;
+    }
+
+    pcnt_counter_pause(_unit);
+    pcnt_counter_clear(_unit);
+
+    // The hardware clears the counter when it reaches the high limit
+    if (pcnt_event_enable(_unit, PCNT_EVT_H_LIM) != ESP_OK) {
+        ESP_LOGE(PCNTCounter::Name, "Failed to enable PCNT overflow event");
+        return PBRet::FAILURE;
+    }
+
+    // The service may already be installed by another counter
+    const esp_err_t err = pcnt_isr_service_install(0);
+    if ((err != ESP_OK) && (err != ESP_ERR_INVALID_STATE)) {
+        ESP_LOGE(PCNTCounter::Name, "Failed to install PCNT ISR service");
+        return PBRet::FAILURE;
+    }
+
+    if (pcnt_isr_handler_add(_unit, PCNTCounter::_overflowISR, static_cast<void*>(this)) != ESP_OK) {
+        ESP_LOGE(PCNTCounter::Name, "Failed to add PCNT overflow ISR");
+        return PBRet::FAILURE;
+    }
+
+    if (pcnt_counter_resume(_unit) != ESP_OK) {
+        ESP_LOGE(PCNTCounter::Name, "Failed to start PCNT unit");
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet PCNTCounter::_initEdgeISR(void)
+{
+    // Rising edge interrupt on the counted pin. Left disabled until edge
+    // times are requested
+
+    if (gpio_set_intr_type(_pin, GPIO_INTR_POSEDGE) != ESP_OK) {
+        ESP_LOGE(PCNTCounter::Name, "Failed to set edge interrupt type");
+        return PBRet::FAILURE;
+    }
+
+    // The service may already be installed by another driver. It is shared
+    // with the zero crossing input, so is IRAM resident
+    const esp_err_t err = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+    if ((err != ESP_OK) && (err != ESP_ERR_INVALID_STATE)) {
+        ESP_LOGE(PCNTCounter::Name, "Failed to install ISR service");
+        return PBRet::FAILURE;
+    }
+
+    if (gpio_isr_handler_add(_pin, PCNTCounter::_edgeISR, static_cast<void*>(this)) != ESP_OK) {
+        ESP_LOGE(PCNTCounter::Name, "Failed to add edge ISR");
+        return PBRet::FAILURE;
+    }
+
+    gpio_intr_disable(_pin);
+    return PBRet::SUCCESS;
+}
+
+PBRet PCNTCounter::enableTimestamps(bool enable)
+{
+    const esp_err_t err = enable ? gpio_intr_enable(_pin) : gpio_intr_disable(_pin);
+    if (err != ESP_OK) {
+        ESP_LOGW(PCNTCounter::Name, "Failed to %s edge interrupt", enable ? "enable" : "disable");
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+uint32_t PCNTCounter::getCount(void)
+{
+    // Read the overflow count either side of the hardware counter so a
+    // clear in between is caught
+
+    uint32_t overflow = 0;
+    int16_t count = 0;
+    do {
+        overflow = _overflow.load();
+        pcnt_get_counter_value(_unit, &count);
+    } while (overflow != _overflow.load());
+
+    // The counter may have been cleared while the overflow interrupt is
+    // still pending. Counts never go backwards, so correct for it here
+    uint32_t total = overflow + static_cast<uint16_t>(count);
+    if (static_cast<int32_t>(total - _lastCount) < 0) {
+        total += HighLimit;
+    }
+    _lastCount = total;
+
+    return total;
+}
+
+void IRAM_ATTR PCNTCounter::_overflowISR(void* arg)
+{
+    PCNTCounter* counter = static_cast<PCNTCounter*>(arg);
+    counter->_overflow.fetch_add(HighLimit);
+}
+
+void IRAM_ATTR PCNTCounter::_edgeISR(void* arg)
+{
+    PCNTCounter* counter = static_cast<PCNTCounter*>(arg);
+    counter->_edges.push(esp_timer_get_time());
+}
+
+ISRCounter::ISRCounter(gpio_num_t pin)
+    : _pin(pin)
+{
+    if (_initGPIO() == PBRet::SUCCESS) {
+        ESP_LOGI(ISRCounter::Name, "Counting pulses on pin %d with GPIO interrupt", pin);
+        _configured = true;
+    } else {
+        ESP_LOGW(ISRCounter::Name, "Pulse interrupt was not configured on pin %d", pin);
+    }
+}
+
+ISRCounter::~ISRCounter(void)
+{
+    if (_configured) {
+        gpio_isr_handler_remove(_pin);
+    }
+}
+
+PBRet ISRCounter::_initGPIO(void)
+{
+    gpio_config_t io_conf = {
+        .pin_bit_mask = (1ULL << _pin),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_POSEDGE
+    };
+
+    if (gpio_config(&io_conf) != ESP_OK) {
+        ESP_LOGE(ISRCounter::Name, "Failed to configure pulse GPIO");
+        return PBRet::FAILURE;
+    }
+
+    // The service may already be installed by another driver. It is shared
+    // with the zero crossing input, so is IRAM resident
+    const esp_err_t err = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+    if ((err != ESP_OK) && (err != ESP_ERR_INVALID_STATE)) {
+        ESP_LOGE(ISRCounter::Name, "Failed to install ISR service");
+        return PBRet::FAILURE;
+    }
+
+    if (gpio_isr_handler_add(_pin, ISRCounter::_pulseISR, static_cast<void*>(this)) != ESP_OK) {
+        ESP_LOGE(ISRCounter::Name, "Failed to add pulse ISR");
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet ISRCounter::enableTimestamps(bool enable)
+{
+    // Every edge already takes an interrupt
+    _timestamping.store(enable);
+    return PBRet::SUCCESS;
+}
+
+void IRAM_ATTR ISRCounter::_pulseISR(void* arg)
+{
+    ISRCounter* counter = static_cast<ISRCounter*>(arg);
+    counter->_count.fetch_add(1);
+    if (counter->_timestamping.load()) {
+        counter->_edges.push(esp_timer_get_time());
+    }
+}
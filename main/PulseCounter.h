@@ -0,0 +1,133 @@
+#ifndef PULSE_COUNTER_H
+#define PULSE_COUNTER_H
+
+#include <atomic>
+#include "PBCommon.h"
+#include "driver/pcnt.h"
+#include "esp_timer.h"
+
+// Lock free single producer, single consumer queue of edge times. The
+// producer is an ISR. Edges that arrive while the queue is full are
+// dropped and flagged
+template <size_t N>
+class PulseEdgeRing
+{
+    static_assert((N & (N - 1)) == 0, "Capacity must be a power of 2");
+
+    public:
+        bool IRAM_ATTR push(int64_t t)
+        {
+            const uint32_t head = _head.load(std::memory_order_relaxed);
+            if ((head - _tail.load(std::memory_order_acquire)) >= N) {
+                _dropped.store(true, std::memory_order_relaxed);
+                return false;
+            }
+
+            _buffer[head % N] = t;
+            _head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(int64_t& t)
+        {
+            const uint32_t tail = _tail.load(std::memory_order_relaxed);
+            if (tail == _head.load(std::memory_order_acquire)) {
+                return false;
+            }
+
+            t = _buffer[tail % N];
+            _tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side only
+        void clear(void) { _tail.store(_head.load(std::memory_order_acquire), std::memory_order_release); }
+        bool takeDropped(void) { return _dropped.exchange(false); }
+
+    private:
+        int64_t _buffer[N] {};
+        std::atomic<uint32_t> _head {0};
+        std::atomic<uint32_t> _tail {0};
+        std::atomic<bool> _dropped {false};
+};
+
+// Counts rising edges on a GPIO. Counts are 32 bit and wrap, so callers
+// should only ever use the difference between two counts
+class PulseCounter
+{
+    public:
+        static constexpr size_t EdgeCapacity = 32;
+
+        virtual ~PulseCounter(void) = default;
+
+        virtual uint32_t getCount(void) = 0;
+        bool isConfigured(void) const { return _configured; }
+
+        // Edge times for period measurement. Each edge costs an interrupt,
+        // so they are only recorded while enabled
+        virtual PBRet enableTimestamps(bool enable) = 0;
+        bool popEdge(int64_t& t) { return _edges.pop(t); }
+        bool edgesDropped(void) { return _edges.takeDropped(); }
+        void clearEdges(void) { _edges.clear(); }
+
+    protected:
+        PulseEdgeRing<EdgeCapacity> _edges {};
+        bool _configured = false;
+};
+
+// Counts in the PCNT peripheral, so pulses cost no CPU. The hardware
+// counter is 16 bit. It is cleared each time it reaches HighLimit and the
+// overflow event extends the count to 32 bits. Edge times come from a GPIO
+// interrupt on the same pin, enabled only when they are needed
+class PCNTCounter : public PulseCounter
+{
+    static constexpr const char* Name = "PCNTCounter";
+    static constexpr int16_t HighLimit = 32000;
+    static constexpr uint16_t FilterLength = 100;      // Ignore glitches shorter than this [APB cycles]
+
+    public:
+        PCNTCounter(gpio_num_t pin, pcnt_unit_t unit);
+        ~PCNTCounter(void);
+        PCNTCounter(const PCNTCounter&) = delete;
+        PCNTCounter& operator=(const PCNTCounter&) = delete;
+
+        uint32_t getCount(void) override;
+        PBRet enableTimestamps(bool enable) override;
+
+    private:
+        PBRet _initPCNT(gpio_num_t pin);
+        PBRet _initEdgeISR(void);
+        static void IRAM_ATTR _overflowISR(void* arg);
+        static void IRAM_ATTR _edgeISR(void* arg);
+
+        gpio_num_t _pin = GPIO_NUM_NC;
+        pcnt_unit_t _unit = PCNT_UNIT_MAX;
+        std::atomic<uint32_t> _overflow {0};        // Counts cleared from the hardware counter
+        uint32_t _lastCount = 0;
+};
+
+// Fallback that takes a GPIO interrupt on every pulse. Used when no PCNT
+// unit is available
+class ISRCounter : public PulseCounter
+{
+    static constexpr const char* Name = "ISRCounter";
+
+    public:
+        explicit ISRCounter(gpio_num_t pin);
+        ~ISRCounter(void);
+        ISRCounter(const ISRCounter&) = delete;
+        ISRCounter& operator=(const ISRCounter&) = delete;
+
+        uint32_t getCount(void) override { return _count.load(); }
+        PBRet enableTimestamps(bool enable) override;
+
+    private:
+        PBRet _initGPIO(void);
+        static void IRAM_ATTR _pulseISR(void* arg);
+
+        gpio_num_t _pin = GPIO_NUM_NC;
+        std::atomic<uint32_t> _count {0};
+        std::atomic<bool> _timestamping {false};
+};
+
+#endif // PULSE_COUNTER_H
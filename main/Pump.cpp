@@ -1,11 +1,17 @@
 #include <driver/ledc.h>
+#include <driver/gpio.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <esp_log.h>
+#include <esp_timer.h>
+#include "esp_rom_gpio.h"
+#include "hal/gpio_ll.h"
+#include "soc/gpio_sig_map.h"
 #include "Pump.h"
 #include "Controller.h"
 #include "Utilities.h"
 #include <stdint.h>
+#include <array>
 
 Pump::Pump(const PumpConfig& cfg)
 {
@@ -41,7 +47,7 @@ PBRet Pump::_initFromParams(const PumpConfig& cfg)
         .intr_type  = LEDC_INTR_DISABLE,
         .timer_sel  = cfg.timerChannel,
         .duty       = 0,
-        .hpoint     = 0xff
+        .hpoint     = Pump::HPOINT
     };
 
     esp_err_t err = ledc_timer_config(&PWM_timer);
@@ -59,27 +65,148 @@ PBRet Pump::_initFromParams(const PumpConfig& cfg)
         return PBRet::FAILURE;
     }
 
+    // Speed ramps are run by the fade hardware. The service is shared by
+    // all channels and may already be installed
+    err = ledc_fade_func_install(0);
+    if ((err != ESP_OK) && (err != ESP_ERR_INVALID_STATE)) {
+        ESP_LOGW(Pump::Name, "Failed to install fade service. Unable to configure pump on channel %d", cfg.PWMChannel);
+        return PBRet::FAILURE;
+    }
+
     // Success by here
+    _output = PumpOutput({Pump::PUMP_MAX_SPEED, cfg.slewRate, cfg.dither});
+    ChannelState& channel = _channel(cfg.PWMChannel);
+    portENTER_CRITICAL(&channel.lock);
+    _releases = channel.releases;
+    portEXIT_CRITICAL(&channel.lock);
     _cfg = cfg;
     _configured = true;
     return PBRet::SUCCESS;
 }
 
-PBRet Pump::_drivePump(uint32_t pumpSpeed) const
+PBRet Pump::_drivePump(const PumpWrite& write) const
 {
-    if (ledc_set_duty(LEDC_HIGH_SPEED_MODE, _cfg.PWMChannel, pumpSpeed) != ESP_OK) {
-        ESP_LOGW(Pump::Name, "ledc_set_duty failed with invalid parameter error. Likely pumpSpeed (%d)", pumpSpeed);
+    // Writes are dropped while the safety supervisor holds the channel.
+    // After a hold the pin stays at flush speed until the pump next writes,
+    // so the channel is brought up to flush speed first and the write
+    // carries on from there. This waits out any fade that was running
+
+    ChannelState& channel = _channel(_cfg.PWMChannel);
+    portENTER_CRITICAL(&channel.lock);
+    const bool held = channel.held;
+    const bool detached = channel.detached;
+    portEXIT_CRITICAL(&channel.lock);
+
+    if (held) {
+        return PBRet::SUCCESS;
+    }
+
+    esp_err_t err = ESP_OK;
+    if (detached) {
+        err |= ledc_set_duty_and_update(LEDC_HIGH_SPEED_MODE, _cfg.PWMChannel, Pump::FLUSH_SPEED, Pump::HPOINT);
+    }
+
+    if (write.fadeTime > 0) {
+        err |= ledc_set_fade_time_and_start(LEDC_HIGH_SPEED_MODE, _cfg.PWMChannel, write.duty, write.fadeTime, LEDC_FADE_NO_WAIT);
+    } else {
+        err |= ledc_set_duty_and_update(LEDC_HIGH_SPEED_MODE, _cfg.PWMChannel, write.duty, Pump::HPOINT);
+    }
+
+    // Hand the pin back to LEDC, unless the channel was held again since
+    if (detached && (err == ESP_OK)) {
+        portENTER_CRITICAL(&channel.lock);
+        if (channel.held == false) {
+            esp_rom_gpio_connect_out_signal(_cfg.pumpGPIO, LEDC_HS_SIG_OUT0_IDX + _cfg.PWMChannel, false, false);
+            channel.detached = false;
+        }
+        portEXIT_CRITICAL(&channel.lock);
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGW(Pump::Name, "Failed to write pump speed (%d) on channel %d", write.duty, _cfg.PWMChannel);
         return PBRet::FAILURE;
     }
-    
-    if (ledc_update_duty(LEDC_HIGH_SPEED_MODE, _cfg.PWMChannel) != ESP_OK) {
-        ESP_LOGW(Pump::Name, "ledc_update_duty failed with invalid parameter error");
+
+    return PBRet::SUCCESS;
+}
+
+void Pump::_syncAfterHold(void)
+{
+    // A safety hold leaves the channel at flush speed. Carry on from there
+    // once it is released
+
+    ChannelState& channel = _channel(_cfg.PWMChannel);
+    portENTER_CRITICAL(&channel.lock);
+    const uint32_t releases = channel.releases;
+    portEXIT_CRITICAL(&channel.lock);
+
+    if (releases != _releases) {
+        _output.reset(Pump::FLUSH_SPEED);
+        _releases = releases;
+    }
+}
+
+PBRet Pump::holdAtFlush(const PumpConfig& cfg)
+{
+    // LEDC can't cancel a running fade, and its calls wait for one to
+    // finish. Flush is full scale, so instead the pin is switched from the
+    // LEDC signal to a plain GPIO output driven high, which no fade can
+    // touch. Only register writes, so this never blocks
+
+    static_assert(Pump::FLUSH_SPEED >= Pump::PUMP_MAX_SPEED, "Flush speed must be full scale to hold the pin high");
+
+    if ((cfg.PWMChannel < LEDC_CHANNEL_0) || (cfg.PWMChannel >= LEDC_CHANNEL_MAX) || (GPIO_IS_VALID_OUTPUT_GPIO(cfg.pumpGPIO) == false)) {
+        ESP_LOGE(Pump::Name, "PUMP PWM channel %d or GPIO %d is invalid", cfg.PWMChannel, cfg.pumpGPIO);
+        return PBRet::FAILURE;
+    }
+
+    ChannelState& channel = _channel(cfg.PWMChannel);
+    portENTER_CRITICAL(&channel.lock);
+    channel.held = true;
+    channel.detached = true;
+    gpio_ll_set_level(&GPIO, cfg.pumpGPIO, 1);
+    esp_rom_gpio_connect_out_signal(cfg.pumpGPIO, SIG_GPIO_OUT_IDX, false, false);
+    portEXIT_CRITICAL(&channel.lock);
+
+    return PBRet::SUCCESS;
+}
+
+PBRet Pump::release(const PumpConfig& cfg)
+{
+    // Hand the channel back to its pump. The pin stays at flush speed until
+    // the pump next writes, so this doesn't wait on LEDC either
+
+    if ((cfg.PWMChannel < LEDC_CHANNEL_0) || (cfg.PWMChannel >= LEDC_CHANNEL_MAX)) {
+        ESP_LOGE(Pump::Name, "PUMP PWM channel %d is invalid", cfg.PWMChannel);
         return PBRet::FAILURE;
     }
 
+    ChannelState& channel = _channel(cfg.PWMChannel);
+    portENTER_CRITICAL(&channel.lock);
+    if (channel.held) {
+        channel.held = false;
+        channel.releases++;
+    }
+    portEXIT_CRITICAL(&channel.lock);
+
     return PBRet::SUCCESS;
 }
 
+Pump::ChannelState& Pump::_channel(ledc_channel_t channel)
+{
+    // Shared by every pump on the channel and the safety supervisor.
+    // Created by whichever gets here first
+    static std::array<ChannelState, LEDC_CHANNEL_MAX> channels = [] {
+        std::array<ChannelState, LEDC_CHANNEL_MAX> states {};
+        for (ChannelState& state : states) {
+            vPortCPUInitializeMutex(&state.lock);
+        }
+        return states;
+    }();
+
+    return channels[channel];
+}
+
 uint32_t Pump::getPumpSpeed(void) const
 {
     // Return the current speed of the pump
@@ -89,21 +216,44 @@ uint32_t Pump::getPumpSpeed(void) const
         return 0;
     }
 
-    return _pumpSpeed;
+    return _output.getDuty();
 }
 
-PBRet Pump::updatePumpSpeed(uint32_t pumpSpeed)
+PBRet Pump::updatePumpSpeed(double pumpSpeed)
 {
-    // Update the current speed of the pump
+    // Update the current speed of the pump. The output stage saturates the
+    // command and skips the write if nothing changed
 
     if (isConfigured() == false) {
         ESP_LOGW(Pump::Name, "Pump was not configured");
         return PBRet::FAILURE;
     }
 
-    // Saturate output command
-    _pumpSpeed = Utilities::bound(pumpSpeed, Pump::PUMP_OFF, Pump::PUMP_MAX_SPEED);
-    return _drivePump(_pumpSpeed);
+    _syncAfterHold();
+    PumpWrite write {};
+    if (_output.update(pumpSpeed, esp_timer_get_time(), write) == false) {
+        return PBRet::SUCCESS;
+    }
+
+    return _drivePump(write);
+}
+
+PBRet Pump::forcePumpSpeed(uint32_t pumpSpeed)
+{
+    // Set the pump speed without ramping
+
+    if (isConfigured() == false) {
+        ESP_LOGW(Pump::Name, "Pump was not configured");
+        return PBRet::FAILURE;
+    }
+
+    _syncAfterHold();
+    PumpWrite write {};
+    if (_output.force(pumpSpeed, esp_timer_get_time(), write) == false) {
+        return PBRet::SUCCESS;
+    }
+
+    return _drivePump(write);
 }
 
 PBRet Pump::checkInputs(const PumpConfig& cfg)
@@ -115,7 +265,7 @@ PBRet Pump::checkInputs(const PumpConfig& cfg)
     }
 
     // Check PWM channel is valid
-    if ((cfg.PWMChannel < LEDC_CHANNEL_0) || (cfg.PWMChannel > LEDC_CHANNEL_MAX)) {
+    if ((cfg.PWMChannel < LEDC_CHANNEL_0) || (cfg.PWMChannel >= LEDC_CHANNEL_MAX)) {
         ESP_LOGE(Pump::Name, "PUMP PWM channel %d is invalid", cfg.PWMChannel);
         return PBRet::FAILURE;
     }
@@ -126,6 +276,12 @@ PBRet Pump::checkInputs(const PumpConfig& cfg)
         return PBRet::FAILURE;
     }
 
+    // Check slew rate is valid
+    if (cfg.slewRate < 0.0) {
+        ESP_LOGE(Pump::Name, "PUMP slew rate (%.2f) must be positive, or zero to disable", cfg.slewRate);
+        return PBRet::FAILURE;
+    }
+
     return PBRet::SUCCESS;
 }
 
@@ -165,5 +321,14 @@ PBRet Pump::loadFromJSON(PumpConfig& cfg, const cJSON* cfgRoot)
         return PBRet::FAILURE;
     }
 
+    // Get slew rate. This is optional, speed changes are stepped if it is
+    // missing
+    cJSON* slewRateNode = cJSON_GetObjectItem(cfgRoot, "slewRate");
+    cfg.slewRate = cJSON_IsNumber(slewRateNode) ? slewRateNode->valuedouble : 0.0;
+
+    // Get dithering. This is optional, and off if it is missing
+    cJSON* ditherNode = cJSON_GetObjectItem(cfgRoot, "dither");
+    cfg.dither = cJSON_IsTrue(ditherNode);
+
     return PBRet::SUCCESS;
 }
\ No newline at end of file
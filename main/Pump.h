@@ -2,7 +2,9 @@
 #define PUMP_H
 
 #include "PBCommon.h"
+#include "PumpOutput.h"
 #include "cJSON.h"
+#include "freertos/FreeRTOS.h"
 #include <driver/ledc.h>
 
 class PumpConfig
@@ -15,6 +17,8 @@ class PumpConfig
         gpio_num_t pumpGPIO = (gpio_num_t) GPIO_NUM_NC;
         ledc_channel_t PWMChannel = LEDC_CHANNEL_0;
         ledc_timer_t timerChannel = LEDC_TIMER_0;
+        double slewRate = 0.0;          // Optional. 0 steps straight to each new speed [pump speed / s]
+        bool dither = false;            // Optional. Resolve fractional speeds by dithering between counts
 };
 
 class Pump
@@ -26,8 +30,15 @@ class Pump
         Pump() = default;
         explicit Pump(const PumpConfig& cfg);
 
-        // Update
-        PBRet updatePumpSpeed(uint32_t pumpSpeed);      // TODO: make this function body _updatePump
+        // Update. Speeds are slew limited and only written when they change
+        PBRet updatePumpSpeed(double pumpSpeed);
+        PBRet forcePumpSpeed(uint32_t pumpSpeed);       // Immediate, ignoring the slew limit
+
+        // Safety override, for the safety supervisor. Takes the channel from
+        // its pump and holds it at flush speed until released. Neither call
+        // waits on LEDC, so a speed ramp that is running can't delay them
+        static PBRet holdAtFlush(const PumpConfig& cfg);
+        static PBRet release(const PumpConfig& cfg);
 
         // Utility
         static PBRet checkInputs(const PumpConfig& cfg);
@@ -41,6 +52,7 @@ class Pump
         static constexpr uint32_t PUMP_IDLE_SPEED = 50;
         static constexpr uint32_t PUMP_MAX_SPEED = 1024;        // Based on 9 bit PWM
         static constexpr uint32_t FLUSH_SPEED = 1024;
+        static constexpr uint32_t HPOINT = 0xff;
 
         // Friend class for unit testing
         friend class PumpUT;
@@ -49,11 +61,25 @@ class Pump
         PBRet _initFromParams(const PumpConfig& cfg);
 
         // Update
-        PBRet _drivePump(uint32_t pumpSpeed) const;
+        PBRet _drivePump(const PumpWrite& write) const;
+        void _syncAfterHold(void);
+
+        // Ownership of an LEDC channel between its pump and the safety
+        // override. The pump only writes the channel while it isn't held.
+        // The lock also covers which signal drives the pin
+        struct ChannelState
+        {
+            portMUX_TYPE lock {};
+            bool held = false;
+            bool detached = false;          // Pin driven high directly rather than by LEDC
+            uint32_t releases = 0;
+        };
+        static ChannelState& _channel(ledc_channel_t channel);
 
         bool _configured = false;
-        uint32_t _pumpSpeed = 0;
+        PumpOutput _output {};
         PumpConfig _cfg;
+        uint32_t _releases = 0;             // Holds on this channel the output has caught up with
 };
 
 #endif // PUMP_H
\ No newline at end of file
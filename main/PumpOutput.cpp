@@ -0,0 +1,78 @@
+#include "PumpOutput.h"
+#include "Utilities.h"
+#include <algorithm>
+#include <cmath>
+
+bool PumpOutput::update(double speed, int64_t t, PumpWrite& write)
+{
+    const double period = (_lastUpdate >= 0) ? (t - _lastUpdate) * 1e-6 : PumpOutput::DefaultPeriod;
+    _lastUpdate = t;
+
+    // Can't start a new fade until the last one is done
+    if (isFading(t)) {
+        return false;
+    }
+
+    double wanted = Utilities::bound(speed, 0.0, static_cast<double> (_cfg.maxDuty));
+    if (_cfg.dither) {
+        wanted += _residual;
+    }
+    double duty = Utilities::bound(std::round(wanted), 0.0, static_cast<double> (_cfg.maxDuty));
+
+    // Slew limit. Step by whole counts, at least one, so the ramp always
+    // makes progress
+    bool ramping = false;
+    if (_cfg.slewRate > 0.0) {
+        const double maxStep = std::max(std::floor(_cfg.slewRate * period * PumpOutput::FadeFraction), 1.0);
+        const double step = duty - _duty;
+        if (std::abs(step) > maxStep) {
+            duty = _duty + std::copysign(maxStep, step);
+            ramping = true;
+        }
+    }
+
+    // Only carry the dither error while tracking. Mid ramp it would just
+    // be the distance left to go
+    _residual = (_cfg.dither && (ramping == false)) ? Utilities::bound(wanted - duty, -0.5, 0.5) : 0.0;
+
+    const uint32_t newDuty = static_cast<uint32_t> (duty);
+    if (newDuty == _duty) {
+        return false;
+    }
+
+    write.duty = newDuty;
+    write.fadeTime = 0;
+    if (_cfg.slewRate > 0.0) {
+        const double delta = std::abs(static_cast<double> (newDuty) - _duty);
+        write.fadeTime = static_cast<uint32_t> (std::ceil(delta / _cfg.slewRate * 1e3));
+    }
+    _fadeEnd = t + static_cast<int64_t> (write.fadeTime) * 1000;
+    _duty = newDuty;
+
+    return true;
+}
+
+bool PumpOutput::force(uint32_t duty, int64_t t, PumpWrite& write)
+{
+    _lastUpdate = t;
+    _residual = 0.0;
+    _fadeEnd = 0;
+
+    const uint32_t newDuty = std::min(duty, _cfg.maxDuty);
+    if (newDuty == _duty) {
+        return false;
+    }
+
+    write.duty = newDuty;
+    write.fadeTime = 0;
+    _duty = newDuty;
+
+    return true;
+}
+
+void PumpOutput::reset(uint32_t duty)
+{
+    _duty = std::min(duty, _cfg.maxDuty);
+    _residual = 0.0;
+    _fadeEnd = 0;
+}
@@ -0,0 +1,61 @@
+#ifndef MAIN_PUMP_OUTPUT_H
+#define MAIN_PUMP_OUTPUT_H
+
+#include <cstdint>
+
+struct PumpOutputConfig
+{
+    uint32_t maxDuty = 0;               // Full scale [counts]
+    double slewRate = 0.0;              // Fastest ramp. 0 steps straight to the new speed [counts / s]
+    bool dither = false;                // Carry the fraction of a count from update to update
+};
+
+// Hardware write requested by the output stage. A non zero fade time is
+// ramped by the LEDC fade hardware
+struct PumpWrite
+{
+    uint32_t duty = 0;                  // [counts]
+    uint32_t fadeTime = 0;              // [ms]
+};
+
+// Turns the controller's pump speed into LEDC duty writes. Each update
+// either asks for one write or none. No write is asked for when the duty
+// is unchanged, or while the previous fade is still running (the fade
+// hardware holds the channel until it finishes). With a slew rate, each
+// write is a fade sized to finish before the next update is expected, so
+// the hardware ramps continuously without the CPU interpolating. With
+// dithering, the fraction of a count the duty can't represent is carried
+// to later updates, so the average duty has sub-count resolution
+class PumpOutput
+{
+    public:
+        PumpOutput(void) = default;
+        explicit PumpOutput(const PumpOutputConfig& cfg) : _cfg(cfg) {}
+
+        // Returns true if write should be sent to the hardware
+        bool update(double speed, int64_t t, PumpWrite& write);
+
+        // Jump straight to duty, skipping the slew limit. Still returns
+        // false when the duty is already there
+        bool force(uint32_t duty, int64_t t, PumpWrite& write);
+
+        // Take duty as already written, e.g. after another writer has
+        // set the channel
+        void reset(uint32_t duty);
+
+        // Duty last written. Where the hardware ends up once any fade is done
+        uint32_t getDuty(void) const { return _duty; }
+        bool isFading(int64_t t) const { return t < _fadeEnd; }
+
+        static constexpr double FadeFraction = 0.8;             // Fades finish within this fraction of the update period
+        static constexpr double DefaultPeriod = 0.1;            // Assumed update period until one has been measured [s]
+
+    private:
+        PumpOutputConfig _cfg {};
+        uint32_t _duty = 0;
+        double _residual = 0.0;         // Dither error carried to the next update [counts]
+        int64_t _lastUpdate = -1;       // [us]
+        int64_t _fadeEnd = 0;           // [us]
+};
+
+#endif // MAIN_PUMP_OUTPUT_H
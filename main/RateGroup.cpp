@@ -0,0 +1,23 @@
+#include "RateGroup.h"
+
+bool RateGroup::isDue(int64_t t)
+{
+    // First call always runs and sets the phase of the schedule
+    if (_started == false) {
+        _nextDue = t + _period;
+        _started = true;
+        return true;
+    }
+
+    if (t < _nextDue) {
+        return false;
+    }
+
+    // Advance by whole periods to avoid drift. Resync if we've fallen behind
+    _nextDue += _period;
+    if (_nextDue <= t) {
+        _nextDue = t + _period;
+    }
+
+    return true;
+}
@@ -0,0 +1,65 @@
+#ifndef RATE_GROUP_H
+#define RATE_GROUP_H
+
+#include "PBCommon.h"
+#include <array>
+#include <cmath>
+
+// Schedules a periodic activity from within a faster task loop. Deadlines are
+// advanced by a whole period each time so the rate doesn't drift with loop
+// jitter. If the loop falls more than a period behind, the schedule is
+// resynchronised rather than running the activity back to back to catch up
+class RateGroup
+{
+    public:
+        RateGroup(void) = default;
+        explicit RateGroup(double period)
+            : _period(static_cast<int64_t>(period * 1e6)) {}
+
+        // Returns true if the activity is due at time t [us]
+        bool isDue(int64_t t);
+
+        double getPeriod(void) const { return _period * 1e-6; }
+
+    private:
+        int64_t _period = 0;        // [us]
+        int64_t _nextDue = 0;       // [us]
+        bool _started = false;
+};
+
+// Change triggered publishing. A set of N channels is published when any
+// channel has moved by more than the deadband since it was last published,
+// or when maxInterval has elapsed so subscribers never see stale data
+template <size_t N>
+class DeadbandFilter
+{
+    public:
+        DeadbandFilter(void) = default;
+        DeadbandFilter(double deadband, double maxInterval)
+            : _deadband(deadband), _maxInterval(static_cast<int64_t>(maxInterval * 1e6)) {}
+
+        bool shouldPublish(int64_t t, const std::array<double, N>& vals)
+        {
+            bool publish = (_hasPublished == false) || ((t - _lastPublishTime) >= _maxInterval);
+            for (size_t i = 0; (i < N) && (publish == false); i++) {
+                publish = std::fabs(vals[i] - _lastPublished[i]) > _deadband;
+            }
+
+            if (publish) {
+                _lastPublished = vals;
+                _lastPublishTime = t;
+                _hasPublished = true;
+            }
+
+            return publish;
+        }
+
+    private:
+        double _deadband = 0.0;
+        int64_t _maxInterval = 0;               // [us]
+        std::array<double, N> _lastPublished {};
+        int64_t _lastPublishTime = 0;           // [us]
+        bool _hasPublished = false;
+};
+
+#endif // RATE_GROUP_H
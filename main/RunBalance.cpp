@@ -0,0 +1,252 @@
+#include "RunBalance.h"
+#include "Utilities.h"
+#include "esp_timer.h"
+#include <algorithm>
+
+void CompensatedSum::add(double val)
+{
+    // Kahan summation
+    // Ref: https://en.wikipedia.org/wiki/Kahan_summation_algorithm
+    const double y = val - _comp;
+    const double t = _sum + y;
+    _comp = (t - _sum) - y;
+    _sum = t;
+}
+
+RunBalanceEstimator::RunBalanceEstimator(const RunBalanceConfig& cfg)
+{
+    if (_initFromParams(cfg) == PBRet::SUCCESS) {
+        ESP_LOGI(RunBalanceEstimator::Name, "RunBalanceEstimator configured!");
+        _configured = true;
+    } else {
+        ESP_LOGW(RunBalanceEstimator::Name, "Unable to configure RunBalanceEstimator");
+    }
+}
+
+PBRet RunBalanceEstimator::update(int64_t t, double refluxFlowrate, double productFlowrate, double productABV)
+{
+    // Integrate the latest flowrate sample into the run totals
+
+    if (_configured == false) {
+        ESP_LOGW(RunBalanceEstimator::Name, "Estimator was not configured");
+        return PBRet::FAILURE;
+    }
+
+    if ((Utilities::check(refluxFlowrate) == false) || (Utilities::check(productFlowrate) == false) ||
+        (Utilities::check(productABV) == false)) {
+        ESP_LOGW(RunBalanceEstimator::Name, "Input was inf or NaN");
+        return PBRet::FAILURE;
+    }
+
+    const double ethanolFlowrate = productFlowrate * Utilities::bound(productABV, 0.0, 100.0) * 0.01 * EthanolDensity;   // [kg / s]
+
+    if (_hasPrevSample) {
+        const double dt = (t - _prevTime) * 1e-6;
+        if (dt < 0) {
+            ESP_LOGW(RunBalanceEstimator::Name, "dt was negative");
+            return PBRet::FAILURE;
+        }
+
+        // Don't integrate across long gaps (e.g. stalled task). The trapezoid over
+        // such an interval says nothing about what actually flowed
+        if (dt <= MaxIntegrationGap) {
+            _refluxVolume.add(0.5 * dt * (refluxFlowrate + _prevRefluxFlowrate));
+            _productVolume.add(0.5 * dt * (productFlowrate + _prevProductFlowrate));
+            _ethanolMass.add(0.5 * dt * (ethanolFlowrate + _prevEthanolFlowrate));
+            _runTime.add(dt);
+        } else {
+            ESP_LOGW(RunBalanceEstimator::Name, "Skipped integration over %.1f s gap", dt);
+        }
+    }
+
+    _prevTime = t;
+    _prevRefluxFlowrate = refluxFlowrate;
+    _prevProductFlowrate = productFlowrate;
+    _prevEthanolFlowrate = ethanolFlowrate;
+    _hasPrevSample = true;
+
+    return PBRet::SUCCESS;
+}
+
+PBRet RunBalanceEstimator::reset(void)
+{
+    // Start a new run
+
+    _productVolume.reset(0.0);
+    _refluxVolume.reset(0.0);
+    _ethanolMass.reset(0.0);
+    _runTime.reset(0.0);
+    _hasPrevSample = false;
+
+    return PBRet::SUCCESS;
+}
+
+double RunBalanceEstimator::getBoilerVolume(void) const
+{
+    // Reflux is returned to the column, so only product leaves the boiler
+    return _cfg.boilerChargeVolume - _productVolume.value();
+}
+
+double RunBalanceEstimator::getBoilerEthanolMass(void) const
+{
+    const double chargeEthanolMass = _cfg.boilerChargeVolume * _cfg.boilerChargeABV * 0.01 * EthanolDensity;
+    return chargeEthanolMass - _ethanolMass.value();
+}
+
+double RunBalanceEstimator::getRefluxRatio(void) const
+{
+    // Run averaged reflux ratio L/D
+    if (_productVolume.value() <= 0.0) {
+        return 0.0;
+    }
+
+    return _refluxVolume.value() / _productVolume.value();
+}
+
+PBRet RunBalanceEstimator::toMessage(RunBalance& msg) const
+{
+    msg.set_productVolume(_productVolume.value());
+    msg.set_refluxVolume(_refluxVolume.value());
+    msg.set_ethanolMass(_ethanolMass.value());
+    msg.set_boilerVolume(getBoilerVolume());
+    msg.set_boilerEthanolMass(getBoilerEthanolMass());
+    msg.set_refluxRatio(getRefluxRatio());
+    msg.set_runTime(_runTime.value());
+    msg.set_timeStamp(esp_timer_get_time());
+
+    return PBRet::SUCCESS;
+}
+
+PBRet RunBalanceEstimator::restore(const RunBalance& msg)
+{
+    // Restore run totals from a checkpoint. The next sample starts a new
+    // integration interval as timestamps do not survive a reboot
+
+    if ((Utilities::check(msg.productVolume()) == false) || (Utilities::check(msg.refluxVolume()) == false) ||
+        (Utilities::check(msg.ethanolMass()) == false) || (Utilities::check(msg.runTime()) == false)) {
+        ESP_LOGW(RunBalanceEstimator::Name, "Checkpoint contained inf or NaN");
+        return PBRet::FAILURE;
+    }
+
+    _productVolume.reset(msg.productVolume());
+    _refluxVolume.reset(msg.refluxVolume());
+    _ethanolMass.reset(msg.ethanolMass());
+    _runTime.reset(msg.runTime());
+    _hasPrevSample = false;
+
+    return PBRet::SUCCESS;
+}
+
+PBRet RunBalanceEstimator::condensateFlowrate(const CondenserReading& condenser, double ABV, double vapourTemp, 
+                                              double condensateTemp, double& flowrate)
+{
+    // Distillate condensed in a condenser, from a heat balance. The heat
+    // the coolant picks up is given up by vapour at vapourTemp condensing
+    // and cooling to condensateTemp [L / s]
+
+    if ((Utilities::check(condenser.coolantFlowrate) == false) || (Utilities::check(condenser.coolantDensity) == false) ||
+        (Utilities::check(condenser.inletTemp) == false) || (Utilities::check(condenser.outletTemp) == false) ||
+        (Utilities::check(ABV) == false) || (Utilities::check(vapourTemp) == false) || (Utilities::check(condensateTemp) == false)) {
+        ESP_LOGW(RunBalanceEstimator::Name, "Input was inf or NaN");
+        return PBRet::FAILURE;
+    }
+
+    // Distillate properties. Volume contraction on mixing is ignored
+    const double volFrac = Utilities::bound(ABV, 0.0, 100.0) * 0.01;
+    const double density = volFrac * EthanolDensity + (1.0 - volFrac) * WaterDensity;     // [kg / L]
+    const double massFrac = volFrac * EthanolDensity / density;
+    const double latentHeat = massFrac * EthanolLatentHeat + (1.0 - massFrac) * WaterLatentHeat;
+    const double heatCapacity = massFrac * EthanolHeatCapacity + (1.0 - massFrac) * WaterHeatCapacity;
+    const double heatPerMass = latentHeat + heatCapacity * std::max(vapourTemp - condensateTemp, 0.0);    // [kJ / kg]
+
+    // Coolant can only take up heat. Sensor noise with no heat load reads
+    // as no flow
+    const double coolantMassFlowrate = condenser.coolantFlowrate * condenser.coolantDensity;   // [kg / s]
+    const double heat = coolantMassFlowrate * WaterHeatCapacity * (condenser.outletTemp - condenser.inletTemp);  // [kW]
+    flowrate = std::max(heat, 0.0) / heatPerMass / density;
+
+    return PBRet::SUCCESS;
+}
+
+PBRet RunBalanceEstimator::checkInputs(const RunBalanceConfig& cfg)
+{
+    if (cfg.publishPeriod <= 0.0) {
+        ESP_LOGE(RunBalanceEstimator::Name, "Publish period (%.2f) must be greater than 0", cfg.publishPeriod);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.checkpointPeriod <= 0.0) {
+        ESP_LOGE(RunBalanceEstimator::Name, "Checkpoint period (%.2f) must be greater than 0", cfg.checkpointPeriod);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.boilerChargeVolume < 0.0) {
+        ESP_LOGE(RunBalanceEstimator::Name, "Boiler charge volume (%.2f) was negative", cfg.boilerChargeVolume);
+        return PBRet::FAILURE;
+    }
+
+    if ((cfg.boilerChargeABV < 0.0) || (cfg.boilerChargeABV > 100.0)) {
+        ESP_LOGE(RunBalanceEstimator::Name, "Boiler charge ABV (%.2f) was outside the valid range [0, 100]", cfg.boilerChargeABV);
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet RunBalanceEstimator::loadFromJSON(RunBalanceConfig& cfg, const cJSON* cfgRoot)
+{
+    // Load RunBalanceConfig from JSON
+
+    if (cfgRoot == nullptr) {
+        ESP_LOGW(RunBalanceEstimator::Name, "cfgRoot was null");
+        return PBRet::FAILURE;
+    }
+
+    // Get publish period
+    cJSON* publishNode = cJSON_GetObjectItem(cfgRoot, "publishPeriod");
+    if (cJSON_IsNumber(publishNode)) {
+        cfg.publishPeriod = publishNode->valuedouble;
+    } else {
+        ESP_LOGI(RunBalanceEstimator::Name, "Unable to read publish period from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get checkpoint period
+    cJSON* checkpointNode = cJSON_GetObjectItem(cfgRoot, "checkpointPeriod");
+    if (cJSON_IsNumber(checkpointNode)) {
+        cfg.checkpointPeriod = checkpointNode->valuedouble;
+    } else {
+        ESP_LOGI(RunBalanceEstimator::Name, "Unable to read checkpoint period from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get boiler charge volume
+    cJSON* volumeNode = cJSON_GetObjectItem(cfgRoot, "boilerChargeVolume");
+    if (cJSON_IsNumber(volumeNode)) {
+        cfg.boilerChargeVolume = volumeNode->valuedouble;
+    } else {
+        ESP_LOGI(RunBalanceEstimator::Name, "Unable to read boiler charge volume from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get boiler charge ABV
+    cJSON* ABVNode = cJSON_GetObjectItem(cfgRoot, "boilerChargeABV");
+    if (cJSON_IsNumber(ABVNode)) {
+        cfg.boilerChargeABV = ABVNode->valuedouble;
+    } else {
+        ESP_LOGI(RunBalanceEstimator::Name, "Unable to read boiler charge ABV from JSON");
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet RunBalanceEstimator::_initFromParams(const RunBalanceConfig& cfg)
+{
+    if (checkInputs(cfg) != PBRet::SUCCESS) {
+        return PBRet::FAILURE;
+    }
+
+    _cfg = cfg;
+    return reset();
+}
@@ -0,0 +1,107 @@
+#ifndef RUN_BALANCE_H
+#define RUN_BALANCE_H
+
+#include "PBCommon.h"
+#include "cJSON.h"
+#include "Generated/SensorManagerMessaging.h"
+
+struct RunBalanceConfig
+{
+    double publishPeriod = 0.0;         // Time between RunBalance broadcasts [s]
+    double checkpointPeriod = 0.0;      // Time between checkpoints written to flash [s]
+    double boilerChargeVolume = 0.0;    // Volume of wash in the boiler at the start of the run [L]
+    double boilerChargeABV = 0.0;       // ABV of wash in the boiler at the start of the run [%]
+};
+
+// Coolant side of a condenser, as measured. The flowmeters are on the
+// coolant lines, not the distillate
+struct CondenserReading
+{
+    double coolantFlowrate = 0.0;       // [L / s]
+    double coolantDensity = 0.0;        // [kg / L]
+    double inletTemp = 0.0;             // Coolant supply [deg C]
+    double outletTemp = 0.0;            // [deg C]
+};
+
+// Kahan compensated summation. Run totals are the sum of ~1e5 tiny
+// increments, so naive summation would slowly bleed precision
+class CompensatedSum
+{
+    public:
+        void add(double val);
+        void reset(double val) { _sum = val; _comp = 0.0; }
+        double value(void) const { return _sum; }
+
+    private:
+        double _sum = 0.0;
+        double _comp = 0.0;
+};
+
+// Streaming mass and ethanol balance over a distillation run. Flowrates are
+// distillate condensed in each condenser, integrated with the trapezoidal
+// rule on the timestamps provided, so the estimate is independent of the
+// rate it is updated at
+class RunBalanceEstimator
+{
+    static constexpr const char* Name = "RunBalanceEstimator";
+    static constexpr double EthanolDensity = 0.78945;      // [kg / L] at 20 deg C
+    static constexpr double WaterDensity = 0.99821;        // [kg / L] at 20 deg C
+    static constexpr double EthanolLatentHeat = 846.0;     // [kJ / kg] at its boiling point
+    static constexpr double WaterLatentHeat = 2257.0;      // [kJ / kg] at its boiling point
+    static constexpr double EthanolHeatCapacity = 2.44;    // Liquid [kJ / kg K]
+    static constexpr double WaterHeatCapacity = 4.18;      // Liquid [kJ / kg K]
+    static constexpr double MaxIntegrationGap = 5.0;       // Intervals longer than this are not integrated [s]
+
+    public:
+        // Constructors
+        RunBalanceEstimator(void) = default;
+        explicit RunBalanceEstimator(const RunBalanceConfig& cfg);
+
+        // Update. Flowrates are distillate [L / s]
+        PBRet update(int64_t t, double refluxFlowrate, double productFlowrate, double productABV);
+        PBRet reset(void);
+
+        // Checkpointing
+        PBRet toMessage(RunBalance& msg) const;
+        PBRet restore(const RunBalance& msg);
+
+        // Utility
+        static PBRet checkInputs(const RunBalanceConfig& cfg);
+        static PBRet loadFromJSON(RunBalanceConfig& cfg, const cJSON* cfgRoot);
+        static PBRet condensateFlowrate(const CondenserReading& condenser, double ABV, double vapourTemp, 
+                                        double condensateTemp, double& flowrate);
+
+        // Getters
+        double getProductVolume(void) const { return _productVolume.value(); }
+        double getRefluxVolume(void) const { return _refluxVolume.value(); }
+        double getEthanolMass(void) const { return _ethanolMass.value(); }
+        double getBoilerVolume(void) const;
+        double getBoilerEthanolMass(void) const;
+        double getRefluxRatio(void) const;
+        double getRunTime(void) const { return _runTime.value(); }
+        bool isConfigured(void) const { return _configured; }
+
+        friend class RunBalanceEstimatorUT;
+
+    private:
+        PBRet _initFromParams(const RunBalanceConfig& cfg);
+
+        RunBalanceConfig _cfg {};
+
+        // Run totals
+        CompensatedSum _productVolume {};       // [L]
+        CompensatedSum _refluxVolume {};        // [L]
+        CompensatedSum _ethanolMass {};         // [kg]
+        CompensatedSum _runTime {};             // [s]
+
+        // Previous sample for trapezoidal integration
+        int64_t _prevTime = 0;                  // [us]
+        double _prevRefluxFlowrate = 0.0;       // [L / s]
+        double _prevProductFlowrate = 0.0;      // [L / s]
+        double _prevEthanolFlowrate = 0.0;      // [kg / s]
+        bool _hasPrevSample = false;
+
+        bool _configured = false;
+};
+
+#endif // RUN_BALANCE_H
@@ -0,0 +1,330 @@
+#include "RunPhase.h"
+#include "Utilities.h"
+#include <cstring>
+
+static constexpr const char* PhaseNames[RunPhaseCount] = {"warmUp", "stabilise", "heads", "hearts", "tails", "shutdown"};
+
+RunPhaseEngine::RunPhaseEngine(const RunPhaseConfig& cfg)
+{
+    if ((checkInputs(cfg) != PBRet::SUCCESS) || cfg.phases.empty()) {
+        return;
+    }
+
+    _phases = cfg.phases;
+    _configured = true;
+}
+
+PBRet RunPhaseEngine::start(double setpoint)
+{
+    if (_configured == false) {
+        ESP_LOGW(RunPhaseEngine::Name, "No run phases are configured");
+        return PBRet::FAILURE;
+    }
+
+    _running = true;
+    _setpoint = setpoint;
+    _enter(0);
+
+    return PBRet::SUCCESS;
+}
+
+void RunPhaseEngine::stop(void)
+{
+    if (_running) {
+        ESP_LOGI(RunPhaseEngine::Name, "Run stopped in phase %s after %.0f s", getPhaseName(getPhase()), _timeInPhase);
+    }
+
+    _running = false;
+    _entered = false;
+}
+
+PBRet RunPhaseEngine::jumpTo(RunPhase phase)
+{
+    if (_running == false) {
+        ESP_LOGW(RunPhaseEngine::Name, "Run is not in progress");
+        return PBRet::FAILURE;
+    }
+
+    const int index = _find(phase);
+    if (index < 0) {
+        ESP_LOGW(RunPhaseEngine::Name, "Phase %s is not configured", getPhaseName(phase));
+        return PBRet::FAILURE;
+    }
+
+    _enter(index);
+    return PBRet::SUCCESS;
+}
+
+bool RunPhaseEngine::update(const PhaseInputs& inputs, double dt)
+{
+    if (_running == false) {
+        return false;
+    }
+
+    _timeInPhase += dt;
+
+    // Check the transitions out of this phase. The first to have held for
+    // its hold time is taken. Unknown (NaN) inputs never meet a condition
+    const std::vector<PhaseTransition>& transitions = _phases[_current].transitions;
+    for (size_t i = 0; i < transitions.size(); i++) {
+        const PhaseTransition& transition = transitions[i];
+        const double val = _value(transition.variable, inputs);
+        const bool met = transition.above ? (val > transition.threshold) : (val < transition.threshold);
+
+        _holdTimes[i] = met ? _holdTimes[i] + dt : 0.0;
+        if (met && (_holdTimes[i] >= transition.holdTime)) {
+            _enter(_find(transition.next));
+            break;
+        }
+    }
+
+    // Move the setpoint along the ramp of the phase we're now in
+    const PhaseSettings& settings = _phases[_current];
+    const double target = (settings.setpoint >= 0.0) ? settings.setpoint : inputs.setpoint;
+    if (settings.rampRate > 0.0) {
+        const double step = settings.rampRate * dt;
+        _setpoint += Utilities::bound(target - _setpoint, -step, step);
+    } else {
+        _setpoint = target;
+    }
+
+    const bool entered = _entered;
+    _entered = false;
+
+    return entered;
+}
+
+void RunPhaseEngine::_enter(size_t index)
+{
+    _current = index;
+    _timeInPhase = 0.0;
+    _holdTimes.assign(_phases[index].transitions.size(), 0.0);
+    _entered = true;
+
+    ESP_LOGI(RunPhaseEngine::Name, "Entered phase %s", getPhaseName(_phases[index].phase));
+}
+
+int RunPhaseEngine::_find(RunPhase phase) const
+{
+    for (size_t i = 0; i < _phases.size(); i++) {
+        if (_phases[i].phase == phase) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+double RunPhaseEngine::_value(PhaseVariable variable, const PhaseInputs& inputs) const
+{
+    switch (variable)
+    {
+        case (PhaseVariable::HEAD_TEMP):
+            return inputs.headTemp;
+        case (PhaseVariable::BOILER_TEMP):
+            return inputs.boilerTemp;
+        case (PhaseVariable::VAPOUR_ABV):
+            return inputs.vapourABV;
+        case (PhaseVariable::BOILER_ABV):
+            return inputs.boilerABV;
+        case (PhaseVariable::PRODUCT_VOLUME):
+            return inputs.productVolume;
+        case (PhaseVariable::TIME_IN_PHASE):
+            return _timeInPhase;
+        default:
+            return NAN;
+    }
+}
+
+const char* RunPhaseEngine::getPhaseName(RunPhase phase)
+{
+    const size_t index = static_cast<size_t>(phase);
+    return (index < RunPhaseCount) ? PhaseNames[index] : "unknown";
+}
+
+PBRet RunPhaseEngine::checkInputs(const RunPhaseConfig& cfg)
+{
+    for (size_t i = 0; i < cfg.phases.size(); i++) {
+        const PhaseSettings& settings = cfg.phases[i];
+        const char* name = getPhaseName(settings.phase);
+
+        for (size_t j = 0; j < i; j++) {
+            if (cfg.phases[j].phase == settings.phase) {
+                ESP_LOGE(RunPhaseEngine::Name, "Phase %s is listed more than once", name);
+                return PBRet::FAILURE;
+            }
+        }
+
+        if (settings.rampRate < 0.0) {
+            ESP_LOGE(RunPhaseEngine::Name, "Phase %s ramp rate (%.3f) must not be negative", name, settings.rampRate);
+            return PBRet::FAILURE;
+        }
+
+        if ((settings.LPElementDuty > 1.0) || (settings.HPElementDuty > 1.0)) {
+            ESP_LOGE(RunPhaseEngine::Name, "Phase %s element duty must not exceed 1", name);
+            return PBRet::FAILURE;
+        }
+
+        if (settings.fanState > 1) {
+            ESP_LOGE(RunPhaseEngine::Name, "Phase %s fan state (%d) is invalid", name, settings.fanState);
+            return PBRet::FAILURE;
+        }
+
+        for (const PhaseTransition& transition : settings.transitions) {
+            if (transition.holdTime < 0.0) {
+                ESP_LOGE(RunPhaseEngine::Name, "Phase %s transition hold time must not be negative", name);
+                return PBRet::FAILURE;
+            }
+
+            if (transition.next == settings.phase) {
+                ESP_LOGE(RunPhaseEngine::Name, "Phase %s cannot transition to itself", name);
+                return PBRet::FAILURE;
+            }
+
+            bool found = false;
+            for (const PhaseSettings& other : cfg.phases) {
+                found |= (other.phase == transition.next);
+            }
+
+            if (found == false) {
+                ESP_LOGE(RunPhaseEngine::Name, "Phase %s transitions to %s, which is not configured", name, getPhaseName(transition.next));
+                return PBRet::FAILURE;
+            }
+        }
+    }
+
+    return PBRet::SUCCESS;
+}
+
+static PBRet readPhase(const cJSON* node, RunPhase& phase)
+{
+    if (cJSON_IsString(node)) {
+        for (size_t i = 0; i < RunPhaseCount; i++) {
+            if (strcmp(node->valuestring, PhaseNames[i]) == 0) {
+                phase = static_cast<RunPhase>(i);
+                return PBRet::SUCCESS;
+            }
+        }
+    }
+
+    return PBRet::FAILURE;
+}
+
+static PBRet readPumpMode(const cJSON* node, PhasePumpMode& mode)
+{
+    if (node == nullptr) {
+        mode = PhasePumpMode::UNCHANGED;
+    } else if (cJSON_IsString(node) == false) {
+        return PBRet::FAILURE;
+    } else if (strcmp(node->valuestring, "off") == 0) {
+        mode = PhasePumpMode::OFF;
+    } else if (strcmp(node->valuestring, "active") == 0) {
+        mode = PhasePumpMode::ACTIVE;
+    } else if (strcmp(node->valuestring, "manual") == 0) {
+        mode = PhasePumpMode::MANUAL;
+    } else {
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+static PBRet readVariable(const cJSON* node, PhaseVariable& variable)
+{
+    static constexpr const char* VariableNames[] = {"headTemp", "boilerTemp", "vapourABV", "boilerABV", "productVolume", "timeInPhase"};
+
+    if (cJSON_IsString(node)) {
+        for (size_t i = 0; i < sizeof(VariableNames) / sizeof(VariableNames[0]); i++) {
+            if (strcmp(node->valuestring, VariableNames[i]) == 0) {
+                variable = static_cast<PhaseVariable>(i);
+                return PBRet::SUCCESS;
+            }
+        }
+    }
+
+    return PBRet::FAILURE;
+}
+
+PBRet RunPhaseEngine::loadFromJSON(RunPhaseConfig& cfg, const cJSON* cfgRoot)
+{
+    // Load RunPhaseConfig struct from JSON. The root is the array of phases
+    // in run order. Everything but the phase name is optional
+
+    if (cfgRoot == nullptr) {
+        ESP_LOGW(RunPhaseEngine::Name, "cfgRoot was null");
+        return PBRet::FAILURE;
+    }
+
+    if (cJSON_IsArray(cfgRoot) == false) {
+        ESP_LOGI(RunPhaseEngine::Name, "Run phases must be an array");
+        return PBRet::FAILURE;
+    }
+
+    cfg.phases.clear();
+    cJSON* phaseNode = nullptr;
+    cJSON_ArrayForEach(phaseNode, cfgRoot) {
+        PhaseSettings settings {};
+
+        // Get phase
+        if (readPhase(cJSON_GetObjectItem(phaseNode, "phase"), settings.phase) != PBRet::SUCCESS) {
+            ESP_LOGI(RunPhaseEngine::Name, "Unable to read phase name from JSON");
+            return PBRet::FAILURE;
+        }
+
+        // Get setpoint and ramp
+        cJSON* setpointNode = cJSON_GetObjectItem(phaseNode, "setpoint");
+        settings.setpoint = cJSON_IsNumber(setpointNode) ? setpointNode->valuedouble : -1.0;
+        cJSON* rampRateNode = cJSON_GetObjectItem(phaseNode, "rampRate");
+        settings.rampRate = cJSON_IsNumber(rampRateNode) ? rampRateNode->valuedouble : 0.0;
+
+        // Get integral enable
+        cJSON* integralNode = cJSON_GetObjectItem(phaseNode, "integral");
+        settings.integralEnabled = cJSON_IsBool(integralNode) ? cJSON_IsTrue(integralNode) : true;
+
+        // Get element duties
+        cJSON* LPElementDutyNode = cJSON_GetObjectItem(phaseNode, "LPElementDuty");
+        settings.LPElementDuty = cJSON_IsNumber(LPElementDutyNode) ? LPElementDutyNode->valuedouble : -1.0;
+        cJSON* HPElementDutyNode = cJSON_GetObjectItem(phaseNode, "HPElementDuty");
+        settings.HPElementDuty = cJSON_IsNumber(HPElementDutyNode) ? HPElementDutyNode->valuedouble : -1.0;
+
+        // Get fan state
+        cJSON* fanNode = cJSON_GetObjectItem(phaseNode, "fan");
+        settings.fanState = cJSON_IsBool(fanNode) ? static_cast<int>(cJSON_IsTrue(fanNode)) : -1;
+
+        // Get pump settings
+        if ((readPumpMode(cJSON_GetObjectItem(phaseNode, "refluxPumpMode"), settings.refluxPumpMode) != PBRet::SUCCESS) ||
+            (readPumpMode(cJSON_GetObjectItem(phaseNode, "productPumpMode"), settings.productPumpMode) != PBRet::SUCCESS)) {
+            ESP_LOGI(RunPhaseEngine::Name, "Unable to read %s pump mode from JSON", getPhaseName(settings.phase));
+            return PBRet::FAILURE;
+        }
+        cJSON* refluxPumpSpeedNode = cJSON_GetObjectItem(phaseNode, "refluxPumpSpeed");
+        settings.refluxPumpSpeed = cJSON_IsNumber(refluxPumpSpeedNode) ? refluxPumpSpeedNode->valuedouble : -1.0;
+        cJSON* productPumpSpeedNode = cJSON_GetObjectItem(phaseNode, "productPumpSpeed");
+        settings.productPumpSpeed = cJSON_IsNumber(productPumpSpeedNode) ? productPumpSpeedNode->valuedouble : -1.0;
+
+        // Get transitions
+        cJSON* transitionNode = nullptr;
+        cJSON_ArrayForEach(transitionNode, cJSON_GetObjectItem(phaseNode, "transitions")) {
+            PhaseTransition transition {};
+            cJSON* aboveNode = cJSON_GetObjectItem(transitionNode, "above");
+            cJSON* belowNode = cJSON_GetObjectItem(transitionNode, "below");
+            cJSON* holdNode = cJSON_GetObjectItem(transitionNode, "hold");
+
+            if ((readVariable(cJSON_GetObjectItem(transitionNode, "variable"), transition.variable) != PBRet::SUCCESS) ||
+                (readPhase(cJSON_GetObjectItem(transitionNode, "next"), transition.next) != PBRet::SUCCESS) ||
+                (cJSON_IsNumber(aboveNode) == cJSON_IsNumber(belowNode))) {
+                ESP_LOGI(RunPhaseEngine::Name, "Unable to read %s transition from JSON", getPhaseName(settings.phase));
+                return PBRet::FAILURE;
+            }
+
+            transition.above = cJSON_IsNumber(aboveNode);
+            transition.threshold = transition.above ? aboveNode->valuedouble : belowNode->valuedouble;
+            transition.holdTime = cJSON_IsNumber(holdNode) ? holdNode->valuedouble : 0.0;
+            settings.transitions.push_back(transition);
+        }
+
+        cfg.phases.push_back(settings);
+    }
+
+    return PBRet::SUCCESS;
+}
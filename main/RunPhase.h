@@ -0,0 +1,135 @@
+#ifndef MAIN_RUN_PHASE_H
+#define MAIN_RUN_PHASE_H
+
+#include <vector>
+#include <cmath>
+#include "PBCommon.h"
+#include "cJSON.h"
+
+// Phases of a run, in the order they normally occur. Published as their
+// index
+enum class RunPhase : uint32_t
+{
+    WARM_UP,
+    STABILISE,
+    HEADS,
+    HEARTS,
+    TAILS,
+    SHUTDOWN
+};
+
+static constexpr size_t RunPhaseCount = 6;
+
+// Process values transitions can be conditioned on
+enum class PhaseVariable
+{
+    HEAD_TEMP,          // [deg C]
+    BOILER_TEMP,        // [deg C]
+    VAPOUR_ABV,         // [%]
+    BOILER_ABV,         // [%]
+    PRODUCT_VOLUME,     // Collected over the run [L]
+    TIME_IN_PHASE       // [s]
+};
+
+enum class PhasePumpMode
+{
+    UNCHANGED,
+    OFF,
+    ACTIVE,
+    MANUAL
+};
+
+// Values that haven't been measured yet are NaN
+struct PhaseInputs
+{
+    double setpoint = 0.0;          // Tuning setpoint. Used by phases that don't set one [deg C]
+    double headTemp = NAN;          // [deg C]
+    double boilerTemp = NAN;        // [deg C]
+    double vapourABV = NAN;         // [%]
+    double boilerABV = NAN;         // [%]
+    double productVolume = NAN;     // [L]
+};
+
+// Leave the current phase once the condition has held for holdTime
+struct PhaseTransition
+{
+    PhaseVariable variable = PhaseVariable::TIME_IN_PHASE;
+    bool above = true;              // Condition is variable > threshold, or variable < threshold if false
+    double threshold = 0.0;
+    double holdTime = 0.0;          // [s]
+    RunPhase next = RunPhase::SHUTDOWN;
+};
+
+// Settings applied on entry to a phase. They can be overridden by hand
+// until the next phase starts. Negative values leave the current setting
+struct PhaseSettings
+{
+    RunPhase phase = RunPhase::WARM_UP;
+    double setpoint = -1.0;                 // Head setpoint. Negative follows the tuning setpoint [deg C]
+    double rampRate = 0.0;                  // Rate the setpoint moves to the new value. 0 steps [deg C / s]
+    bool integralEnabled = true;            // Integral is held at zero when disabled
+    double LPElementDuty = -1.0;            // [0, 1]
+    double HPElementDuty = -1.0;            // [0, 1]
+    int fanState = -1;                      // 0 off, 1 on
+    PhasePumpMode refluxPumpMode = PhasePumpMode::UNCHANGED;
+    PhasePumpMode productPumpMode = PhasePumpMode::UNCHANGED;
+    double refluxPumpSpeed = -1.0;          // Manual speed [pump speed]
+    double productPumpSpeed = -1.0;         // Manual speed [pump speed]
+    std::vector<PhaseTransition> transitions {};
+};
+
+struct RunPhaseConfig
+{
+    std::vector<PhaseSettings> phases {};   // The run starts in the first. Empty disables phase tracking
+};
+
+// Data driven run phase state machine. Each update checks only the
+// transitions out of the current phase, and moves the setpoint one step
+// along its ramp. The caller applies the phase settings when a phase is
+// entered
+class RunPhaseEngine
+{
+    static constexpr const char* Name = "RunPhaseEngine";
+
+    public:
+        RunPhaseEngine(void) = default;
+        explicit RunPhaseEngine(const RunPhaseConfig& cfg);
+
+        // Start in the first phase, ramping from the current setpoint
+        PBRet start(double setpoint);
+        void stop(void);
+        PBRet jumpTo(RunPhase phase);
+
+        // Step the engine. Returns true when a phase has been entered since
+        // the last update, including by start or jumpTo
+        bool update(const PhaseInputs& inputs, double dt);
+
+        // Phase getters are only valid while running
+        bool isRunning(void) const { return _running; }
+        RunPhase getPhase(void) const { return _phases[_current].phase; }
+        const PhaseSettings& getSettings(void) const { return _phases[_current]; }
+        double getTimeInPhase(void) const { return _timeInPhase; }
+        double getSetpoint(void) const { return _setpoint; }
+        bool isIntegralEnabled(void) const { return (_running == false) || _phases[_current].integralEnabled; }
+
+        static const char* getPhaseName(RunPhase phase);
+        static PBRet checkInputs(const RunPhaseConfig& cfg);
+        static PBRet loadFromJSON(RunPhaseConfig& cfg, const cJSON* cfgRoot);
+        bool isConfigured(void) const { return _configured; }
+
+    private:
+        void _enter(size_t index);
+        int _find(RunPhase phase) const;
+        double _value(PhaseVariable variable, const PhaseInputs& inputs) const;
+
+        std::vector<PhaseSettings> _phases {};
+        size_t _current = 0;
+        bool _running = false;
+        bool _entered = false;
+        double _timeInPhase = 0.0;              // [s]
+        double _setpoint = 0.0;                 // Current point on the ramp [deg C]
+        std::vector<double> _holdTimes {};      // Time each transition out of the current phase has held [s]
+        bool _configured = false;
+};
+
+#endif // MAIN_RUN_PHASE_H
@@ -0,0 +1,264 @@
+#include "SafetyMonitor.h"
+#include <algorithm>
+#include <limits>
+
+SafetyMonitor::SafetyMonitor(const SafetyLimits& cfg)
+{
+    if (checkInputs(cfg) == PBRet::SUCCESS) {
+        _cfg = cfg;
+        _onsets.fill(-1);
+        _configured = true;
+    } else {
+        ESP_LOGW(SafetyMonitor::Name, "Unable to configure safety monitor");
+    }
+}
+
+uint32_t SafetyMonitor::update(const SafetyInputs& inputs, int64_t t)
+{
+    if (_configured == false) {
+        return 0;
+    }
+
+    _active = 0;
+    _due = 0;
+    _dueTime = std::numeric_limits<int64_t>::max();
+
+    // Staleness. A signal that has never arrived is a fault from when the
+    // elements were reported on
+    const int64_t missingOnset = inputs.elementsOn ? inputs.outputsTime : -1;
+    const int64_t tempTime = ((inputs.headTempTime < 0) || (inputs.boilerTempTime < 0)) ? -1 : std::min(inputs.headTempTime, inputs.boilerTempTime);
+    _checkStale(SafetyFault::TEMP_STALE, tempTime, t, missingOnset);
+    _checkStale(SafetyFault::FLOW_STALE, inputs.flowTime, t, missingOnset);
+    _checkStale(SafetyFault::OUTPUTS_STALE, inputs.outputsTime, t, -1);
+
+    // Over temperature. Comparisons with NaN are false, so a temperature
+    // that hasn't arrived is left to the staleness check
+    _check(SafetyFault::HEAD_OVER_TEMP, inputs.headTemp > _cfg.maxHeadTemp, inputs.headTempTime, _cfg.overTempTime, t);
+    _check(SafetyFault::BOILER_OVER_TEMP, inputs.boilerTemp > _cfg.maxBoilerTemp, inputs.boilerTempTime, _cfg.overTempTime, t);
+
+    // Pumps driven without flow. The condition starts with whichever of the
+    // command and the flow measurement came last
+    const int64_t pumpOnset = std::max(inputs.flowTime, inputs.outputsTime);
+    _check(SafetyFault::REFLUX_PUMP_STALL, (inputs.refluxPumpSpeed >= _cfg.pumpCheckSpeed) && (inputs.refluxFlow < _cfg.minPumpFlow),
+           pumpOnset, _cfg.pumpStallTime, t);
+    _check(SafetyFault::PRODUCT_PUMP_STALL, (inputs.productPumpSpeed >= _cfg.pumpCheckSpeed) && (inputs.productFlow < _cfg.minPumpFlow),
+           pumpOnset, _cfg.pumpStallTime, t);
+
+    // Heating with vapour at the head and nothing to condense it
+    const bool coolingLoss = inputs.elementsOn && (inputs.headTemp > _cfg.coolingTemp) &&
+                             ((inputs.refluxFlow + inputs.productFlow) < _cfg.minCoolingFlow);
+    _check(SafetyFault::COOLING_LOSS, coolingLoss, std::max(pumpOnset, inputs.headTempTime), _cfg.coolingLossTime, t);
+
+    if (_due != 0) {
+        if (_latched == 0) {
+            _tripTime = _dueTime;
+        }
+        _latched |= _due;
+    }
+
+    return _due;
+}
+
+PBRet SafetyMonitor::reset(void)
+{
+    if (_active != 0) {
+        ESP_LOGW(SafetyMonitor::Name, "Faults are still present (0x%02x). Not resetting", _active);
+        return PBRet::FAILURE;
+    }
+
+    _latched = 0;
+    return PBRet::SUCCESS;
+}
+
+void SafetyMonitor::_check(SafetyFault fault, bool present, int64_t onset, double persistence, int64_t t)
+{
+    const size_t i = static_cast<size_t>(fault);
+    if (present == false) {
+        _onsets[i] = -1;
+        return;
+    }
+
+    const uint32_t bit = mask(fault);
+    _active |= bit;
+    if (_onsets[i] < 0) {
+        _onsets[i] = onset;
+    }
+
+    const int64_t due = _onsets[i] + static_cast<int64_t>(persistence * 1e6);
+    if ((t >= due) && ((_latched & bit) == 0)) {
+        _due |= bit;
+        _dueTime = std::min(_dueTime, due);
+    }
+}
+
+void SafetyMonitor::_checkStale(SafetyFault fault, int64_t time, int64_t t, int64_t missingOnset)
+{
+    // A signal that has never arrived is a fault from missingOnset, or not
+    // at all if that is negative. Otherwise it goes stale the moment it
+    // is older than the timeout
+    if (time < 0) {
+        _check(fault, missingOnset >= 0, missingOnset, 0.0, t);
+        return;
+    }
+
+    const int64_t expiry = time + static_cast<int64_t>(_cfg.sensorTimeout * 1e6);
+    _check(fault, t > expiry, expiry, 0.0, t);
+}
+
+const char* SafetyMonitor::getFaultName(SafetyFault fault)
+{
+    switch (fault)
+    {
+        case (SafetyFault::TEMP_STALE):
+            return "temperatures stale";
+        case (SafetyFault::FLOW_STALE):
+            return "flowrates stale";
+        case (SafetyFault::OUTPUTS_STALE):
+            return "controller outputs stale";
+        case (SafetyFault::HEAD_OVER_TEMP):
+            return "head over temperature";
+        case (SafetyFault::BOILER_OVER_TEMP):
+            return "boiler over temperature";
+        case (SafetyFault::REFLUX_PUMP_STALL):
+            return "reflux pump stalled";
+        case (SafetyFault::PRODUCT_PUMP_STALL):
+            return "product pump stalled";
+        case (SafetyFault::COOLING_LOSS):
+            return "loss of cooling flow";
+        default:
+            return "unknown";
+    }
+}
+
+PBRet SafetyMonitor::checkInputs(const SafetyLimits& cfg)
+{
+    if (cfg.sensorTimeout <= 0.0) {
+        ESP_LOGE(SafetyMonitor::Name, "Sensor timeout (%.2f) must be positive", cfg.sensorTimeout);
+        return PBRet::FAILURE;
+    }
+
+    if ((cfg.maxHeadTemp <= 0.0) || (cfg.maxBoilerTemp <= 0.0)) {
+        ESP_LOGE(SafetyMonitor::Name, "Temperature limits (%.2f, %.2f) must be positive", cfg.maxHeadTemp, cfg.maxBoilerTemp);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.coolingTemp >= cfg.maxHeadTemp) {
+        ESP_LOGE(SafetyMonitor::Name, "Cooling temperature (%.2f) must be below the head limit (%.2f)", cfg.coolingTemp, cfg.maxHeadTemp);
+        return PBRet::FAILURE;
+    }
+
+    // A check speed of 0 would trip on pumps that are off
+    if ((cfg.pumpCheckSpeed <= 0.0) || (cfg.minPumpFlow <= 0.0) || (cfg.minCoolingFlow <= 0.0)) {
+        ESP_LOGE(SafetyMonitor::Name, "Pump check speed and flow limits must be positive");
+        return PBRet::FAILURE;
+    }
+
+    if ((cfg.overTempTime < 0.0) || (cfg.pumpStallTime < 0.0) || (cfg.coolingLossTime < 0.0)) {
+        ESP_LOGE(SafetyMonitor::Name, "Persistence times must not be negative");
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet SafetyMonitor::loadFromJSON(SafetyLimits& cfg, const cJSON* cfgRoot)
+{
+    // Load SafetyLimits struct from JSON
+
+    if (cfgRoot == nullptr) {
+        ESP_LOGW(SafetyMonitor::Name, "cfgRoot was null");
+        return PBRet::FAILURE;
+    }
+
+    // Get sensor timeout
+    cJSON* sensorTimeoutNode = cJSON_GetObjectItem(cfgRoot, "sensorTimeout");
+    if (cJSON_IsNumber(sensorTimeoutNode)) {
+        cfg.sensorTimeout = sensorTimeoutNode->valuedouble;
+    } else {
+        ESP_LOGI(SafetyMonitor::Name, "Unable to read sensor timeout from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get head temperature limit
+    cJSON* maxHeadTempNode = cJSON_GetObjectItem(cfgRoot, "maxHeadTemp");
+    if (cJSON_IsNumber(maxHeadTempNode)) {
+        cfg.maxHeadTemp = maxHeadTempNode->valuedouble;
+    } else {
+        ESP_LOGI(SafetyMonitor::Name, "Unable to read head temperature limit from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get boiler temperature limit
+    cJSON* maxBoilerTempNode = cJSON_GetObjectItem(cfgRoot, "maxBoilerTemp");
+    if (cJSON_IsNumber(maxBoilerTempNode)) {
+        cfg.maxBoilerTemp = maxBoilerTempNode->valuedouble;
+    } else {
+        ESP_LOGI(SafetyMonitor::Name, "Unable to read boiler temperature limit from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get over temperature persistence
+    cJSON* overTempTimeNode = cJSON_GetObjectItem(cfgRoot, "overTempTime");
+    if (cJSON_IsNumber(overTempTimeNode)) {
+        cfg.overTempTime = overTempTimeNode->valuedouble;
+    } else {
+        ESP_LOGI(SafetyMonitor::Name, "Unable to read over temperature time from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get pump check speed
+    cJSON* pumpCheckSpeedNode = cJSON_GetObjectItem(cfgRoot, "pumpCheckSpeed");
+    if (cJSON_IsNumber(pumpCheckSpeedNode)) {
+        cfg.pumpCheckSpeed = pumpCheckSpeedNode->valuedouble;
+    } else {
+        ESP_LOGI(SafetyMonitor::Name, "Unable to read pump check speed from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get minimum pump flow
+    cJSON* minPumpFlowNode = cJSON_GetObjectItem(cfgRoot, "minPumpFlow");
+    if (cJSON_IsNumber(minPumpFlowNode)) {
+        cfg.minPumpFlow = minPumpFlowNode->valuedouble;
+    } else {
+        ESP_LOGI(SafetyMonitor::Name, "Unable to read minimum pump flow from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get pump stall persistence
+    cJSON* pumpStallTimeNode = cJSON_GetObjectItem(cfgRoot, "pumpStallTime");
+    if (cJSON_IsNumber(pumpStallTimeNode)) {
+        cfg.pumpStallTime = pumpStallTimeNode->valuedouble;
+    } else {
+        ESP_LOGI(SafetyMonitor::Name, "Unable to read pump stall time from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get cooling temperature
+    cJSON* coolingTempNode = cJSON_GetObjectItem(cfgRoot, "coolingTemp");
+    if (cJSON_IsNumber(coolingTempNode)) {
+        cfg.coolingTemp = coolingTempNode->valuedouble;
+    } else {
+        ESP_LOGI(SafetyMonitor::Name, "Unable to read cooling temperature from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get minimum cooling flow
+    cJSON* minCoolingFlowNode = cJSON_GetObjectItem(cfgRoot, "minCoolingFlow");
+    if (cJSON_IsNumber(minCoolingFlowNode)) {
+        cfg.minCoolingFlow = minCoolingFlowNode->valuedouble;
+    } else {
+        ESP_LOGI(SafetyMonitor::Name, "Unable to read minimum cooling flow from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get cooling loss persistence
+    cJSON* coolingLossTimeNode = cJSON_GetObjectItem(cfgRoot, "coolingLossTime");
+    if (cJSON_IsNumber(coolingLossTimeNode)) {
+        cfg.coolingLossTime = coolingLossTimeNode->valuedouble;
+    } else {
+        ESP_LOGI(SafetyMonitor::Name, "Unable to read cooling loss time from JSON");
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
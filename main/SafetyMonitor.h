@@ -0,0 +1,100 @@
+#ifndef MAIN_SAFETY_MONITOR_H
+#define MAIN_SAFETY_MONITOR_H
+
+#include <array>
+#include <cmath>
+#include "PBCommon.h"
+#include "cJSON.h"
+
+// Conditions that trip the safety supervisor. Published as a mask of
+// 1 << index
+enum class SafetyFault : uint32_t
+{
+    TEMP_STALE,             // Head or boiler temperature stopped arriving
+    FLOW_STALE,             // Flowrates stopped arriving
+    OUTPUTS_STALE,          // Controller stopped reporting its outputs
+    HEAD_OVER_TEMP,
+    BOILER_OVER_TEMP,
+    REFLUX_PUMP_STALL,      // Reflux pump driven with no flow
+    PRODUCT_PUMP_STALL,     // Product pump driven with no flow
+    COOLING_LOSS            // Elements on and vapour at the head without coolant flow
+};
+
+static constexpr size_t SafetyFaultCount = 8;
+
+struct SafetyLimits
+{
+    double sensorTimeout = 0.0;         // Signals older than this are stale [s]
+    double maxHeadTemp = 0.0;           // [deg C]
+    double maxBoilerTemp = 0.0;         // [deg C]
+    double overTempTime = 0.0;          // Over temperature persistence [s]
+    double pumpCheckSpeed = 0.0;        // Pumps driven at or above this speed must show flow [pump speed]
+    double minPumpFlow = 0.0;           // [L / s]
+    double pumpStallTime = 0.0;         // Pump stall persistence. Covers spin up [s]
+    double coolingTemp = 0.0;           // Head temperature above which the elements need coolant flow [deg C]
+    double minCoolingFlow = 0.0;        // Reflux plus product flow [L / s]
+    double coolingLossTime = 0.0;       // Cooling loss persistence [s]
+};
+
+// Latest value of each supervised signal and the time it was produced.
+// Times are negative until the signal has arrived
+struct SafetyInputs
+{
+    double headTemp = NAN;              // [deg C]
+    int64_t headTempTime = -1;          // [us]
+    double boilerTemp = NAN;            // [deg C]
+    int64_t boilerTempTime = -1;        // [us]
+    double refluxFlow = NAN;            // [L / s]
+    double productFlow = NAN;           // [L / s]
+    int64_t flowTime = -1;              // [us]
+    double refluxPumpSpeed = 0.0;       // Commanded [pump speed]
+    double productPumpSpeed = 0.0;      // Commanded [pump speed]
+    bool elementsOn = false;
+    int64_t outputsTime = -1;           // [us]
+};
+
+// Fault evaluation for the safety supervisor. Each condition has an onset,
+// the production time of the first signal showing it, and is due once it
+// has held for its persistence. Due faults latch until reset. Signals that
+// have never arrived are only a fault while the elements are on
+class SafetyMonitor
+{
+    static constexpr const char* Name = "SafetyMonitor";
+
+    public:
+        SafetyMonitor(void) = default;
+        explicit SafetyMonitor(const SafetyLimits& cfg);
+
+        // Evaluate every condition at time t [us]. Returns the mask of
+        // faults latched by this update
+        uint32_t update(const SafetyInputs& inputs, int64_t t);
+
+        // Clears the latched faults if no condition is present
+        PBRet reset(void);
+
+        uint32_t getLatched(void) const { return _latched; }
+        uint32_t getActive(void) const { return _active; }      // Conditions present, due or not
+        bool isTripped(void) const { return _latched != 0; }
+        int64_t getTripTime(void) const { return _tripTime; }   // When the first fault latched since reset was due [us]
+
+        static uint32_t mask(SafetyFault fault) { return 1u << static_cast<uint32_t>(fault); }
+        static const char* getFaultName(SafetyFault fault);
+        static PBRet checkInputs(const SafetyLimits& cfg);
+        static PBRet loadFromJSON(SafetyLimits& cfg, const cJSON* cfgRoot);
+        bool isConfigured(void) const { return _configured; }
+
+    private:
+        void _check(SafetyFault fault, bool present, int64_t onset, double persistence, int64_t t);
+        void _checkStale(SafetyFault fault, int64_t time, int64_t t, int64_t missingOnset);
+
+        SafetyLimits _cfg {};
+        std::array<int64_t, SafetyFaultCount> _onsets {};   // Negative while the condition is absent [us]
+        uint32_t _active = 0;
+        uint32_t _latched = 0;
+        uint32_t _due = 0;                  // Faults due on this update
+        int64_t _dueTime = 0;               // Earliest due time on this update [us]
+        int64_t _tripTime = 0;              // [us]
+        bool _configured = false;
+};
+
+#endif // MAIN_SAFETY_MONITOR_H
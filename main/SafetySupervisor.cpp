@@ -0,0 +1,322 @@
+#include "esp_task_wdt.h"
+#include "SafetySupervisor.h"
+
+SafetySignal<1> SafetySupervisor::_headTemp {};
+SafetySignal<1> SafetySupervisor::_boilerTemp {};
+SafetySignal<2> SafetySupervisor::_flowrates {};
+SafetySignal<3> SafetySupervisor::_outputs {};
+std::atomic<bool> SafetySupervisor::_tripped {false};
+
+SafetySupervisor::SafetySupervisor(UBaseType_t priority, UBaseType_t stackDepth, BaseType_t coreID, const SafetySupervisorConfig& cfg)
+    : Task(SafetySupervisor::Name, priority, stackDepth, coreID)
+{
+    // Setup callback table
+    _setupCBTable();
+
+    // Set message ID
+    Task::_ID = MessageOrigin::SafetySupervisor;
+
+    // Initialize safety supervisor
+    if (_initFromParams(cfg) == PBRet::SUCCESS) {
+        ESP_LOGI(SafetySupervisor::Name, "Safety supervisor configured!");
+        _configured = true;
+    } else {
+        ESP_LOGW(SafetySupervisor::Name, "Unable to configure safety supervisor");
+    }
+}
+
+void SafetySupervisor::taskMain(void)
+{
+    // Subscribe to messages
+    std::set<PBMessageType> subscriptions = {
+        PBMessageType::SafetyCommand
+    };
+    Subscriber sub(SafetySupervisor::Name, _GPQueue, subscriptions);
+    MessageServer::registerTask(sub);
+
+    // Subscribe this task to the TWDT
+    esp_task_wdt_add(NULL);
+
+    // Checks run at a fixed period independent of the other tasks. Being
+    // the highest priority application task, a trip is acted on within a
+    // period of becoming due
+    const TickType_t period = std::max<TickType_t>(_cfg.period * 1000 / portTICK_PERIOD_MS, 1);
+    TickType_t lastWakeTime = xTaskGetTickCount();
+
+    while (true) {
+        vTaskDelayUntil(&lastWakeTime, period);
+        const int64_t t = esp_timer_get_time();
+
+        // Check for faults before anything else, so nothing delays a trip
+        const uint32_t faults = _monitor.update(_readInputs(t), t);
+        if (faults != 0) {
+            _trip(faults);
+        } else if (isTripped() && (_driveSafe() != PBRet::SUCCESS)) {
+            ESP_LOGE(SafetySupervisor::Name, "Failed to hold outputs safe");
+        }
+
+        // Handle reset requests
+        _processQueue();
+
+        if (_statusPublishRate.isDue(t) && (_broadcastSafetyStatus() != PBRet::SUCCESS)) {
+            ESP_LOGW(SafetySupervisor::Name, "Could not broadcast safety status");
+        }
+
+        // Feed the TWDT
+        esp_task_wdt_reset();
+    }
+}
+
+PBRet SafetySupervisor::_initFromParams(const SafetySupervisorConfig& cfg)
+{
+    if (checkInputs(cfg) != PBRet::SUCCESS) {
+        return PBRet::FAILURE;
+    }
+
+    _monitor = SafetyMonitor(cfg.limits);
+    if (_monitor.isConfigured() == false) {
+        return PBRet::FAILURE;
+    }
+
+    _statusPublishRate = RateGroup(cfg.statusPublishPeriod);
+    _cfg = cfg;
+
+    return PBRet::SUCCESS;
+}
+
+PBRet SafetySupervisor::_setupCBTable(void)
+{
+    _cbTable = std::map<PBMessageType, queueCallback> {
+        {PBMessageType::SafetyCommand, std::bind(&SafetySupervisor::_safetyCommandCB, this, std::placeholders::_1)}
+    };
+
+    return PBRet::SUCCESS;
+}
+
+void SafetySupervisor::reportFlowrates(double refluxFlow, double productFlow, int64_t t)
+{
+    _flowrates.write({static_cast<float>(refluxFlow), static_cast<float>(productFlow)}, t);
+}
+
+void SafetySupervisor::reportOutputs(uint32_t refluxPumpSpeed, uint32_t productPumpSpeed, bool elementsOn, int64_t t)
+{
+    _outputs.write({static_cast<float>(refluxPumpSpeed), static_cast<float>(productPumpSpeed), elementsOn ? 1.0f : 0.0f}, t);
+}
+
+int64_t SafetySupervisor::_extend(SignalTime& signal, uint32_t stamp, int64_t t)
+{
+    // A new stamp is at most a few periods old when first seen, so its age
+    // fits in 32 bits. The full time is kept from then on, so the age of a
+    // signal that stops is never wrapped
+    if ((signal.time < 0) || (stamp != signal.stamp)) {
+        signal.stamp = stamp;
+        signal.time = t - static_cast<uint32_t>(static_cast<uint32_t>(t) - stamp);
+    }
+
+    return signal.time;
+}
+
+SafetyInputs SafetySupervisor::_readInputs(int64_t t)
+{
+    SafetyInputs inputs {};
+    uint32_t stamp = 0;
+
+    std::array<float, 1> temp {};
+    if (_headTemp.read(temp, stamp)) {
+        inputs.headTemp = temp[0];
+        inputs.headTempTime = _extend(_headTempTime, stamp, t);
+    }
+
+    if (_boilerTemp.read(temp, stamp)) {
+        inputs.boilerTemp = temp[0];
+        inputs.boilerTempTime = _extend(_boilerTempTime, stamp, t);
+    }
+
+    std::array<float, 2> flows {};
+    if (_flowrates.read(flows, stamp)) {
+        inputs.refluxFlow = flows[0];
+        inputs.productFlow = flows[1];
+        inputs.flowTime = _extend(_flowTime, stamp, t);
+    }
+
+    std::array<float, 3> outputs {};
+    if (_outputs.read(outputs, stamp)) {
+        inputs.refluxPumpSpeed = outputs[0];
+        inputs.productPumpSpeed = outputs[1];
+        inputs.elementsOn = outputs[2] > 0.0f;
+        inputs.outputsTime = _extend(_outputsTime, stamp, t);
+    }
+
+    return inputs;
+}
+
+void SafetySupervisor::_trip(uint32_t faults)
+{
+    // Make the outputs safe first. Everything else can wait
+    const bool wasTripped = _tripped.exchange(true, std::memory_order_acq_rel);
+    const PBRet driven = _driveSafe();
+    const int64_t drivenTime = esp_timer_get_time();
+
+    if (driven != PBRet::SUCCESS) {
+        ESP_LOGE(SafetySupervisor::Name, "Failed to drive outputs safe");
+    }
+
+    // Reaction time is only meaningful for the fault that made the outputs
+    // safe. Later faults are recorded against the same trip
+    if (wasTripped == false) {
+        _lastReactionTime = (drivenTime - _monitor.getTripTime()) * 1e-6;
+        _reactionTime.add(_lastReactionTime);
+        if (_lastReactionTime > _cfg.reactionDeadline) {
+            _missedDeadlines++;
+            ESP_LOGE(SafetySupervisor::Name, "Trip took %.1f ms, over the %.1f ms deadline", _lastReactionTime * 1e3, _cfg.reactionDeadline * 1e3);
+        } else {
+            ESP_LOGI(SafetySupervisor::Name, "Outputs safe %.1f ms after trip (worst %.1f ms)", _lastReactionTime * 1e3, _reactionTime.max() * 1e3);
+        }
+    }
+
+    for (size_t i = 0; i < SafetyFaultCount; i++) {
+        const SafetyFault fault = static_cast<SafetyFault>(i);
+        if (faults & SafetyMonitor::mask(fault)) {
+            ESP_LOGE(SafetySupervisor::Name, "Tripped on %s", SafetyMonitor::getFaultName(fault));
+        }
+    }
+
+    if (_broadcastSafetyStatus() != PBRet::SUCCESS) {
+        ESP_LOGW(SafetySupervisor::Name, "Could not broadcast safety status");
+    }
+}
+
+PBRet SafetySupervisor::_driveSafe(void) const
+{
+    // Elements off and pumps to flush speed for full cooling. Written
+    // straight to the peripherals, so nothing depends on the controller.
+    // The pumps are held at flush until reset, without waiting on any ramp
+    // they are part way through
+    esp_err_t err = ESP_OK;
+    err |= gpio_set_level(_cfg.element1Pin, 0);
+    err |= gpio_set_level(_cfg.element2Pin, 0);
+    const PBRet reflux = Pump::holdAtFlush(_cfg.refluxPumpConfig);
+    const PBRet prod = Pump::holdAtFlush(_cfg.prodPumpConfig);
+
+    return ((err == ESP_OK) && (reflux == PBRet::SUCCESS) && (prod == PBRet::SUCCESS)) ? PBRet::SUCCESS : PBRet::FAILURE;
+}
+
+PBRet SafetySupervisor::_safetyCommandCB(std::shared_ptr<PBMessageWrapper> msg)
+{
+    SafetyCommand cmd {};
+    if (MessageServer::unwrap(*msg, cmd) != PBRet::SUCCESS) {
+        ESP_LOGW(SafetySupervisor::Name, "Unable to unwrap SafetyCommand message");
+        return PBRet::FAILURE;
+    }
+
+    if (cmd.get_command() != SafetyCommandType::RESET) {
+        return PBRet::SUCCESS;
+    }
+
+    // The trip only clears once every condition has gone
+    if (_monitor.reset() != PBRet::SUCCESS) {
+        return _broadcastSafetyStatus();
+    }
+
+    if (isTripped()) {
+        ESP_LOGI(SafetySupervisor::Name, "Trip reset");
+        const PBRet reflux = Pump::release(_cfg.refluxPumpConfig);
+        const PBRet prod = Pump::release(_cfg.prodPumpConfig);
+        if ((reflux != PBRet::SUCCESS) || (prod != PBRet::SUCCESS)) {
+            ESP_LOGW(SafetySupervisor::Name, "Could not hand the pumps back to the controller");
+        }
+    }
+    _tripped.store(false, std::memory_order_release);
+
+    return _broadcastSafetyStatus();
+}
+
+PBRet SafetySupervisor::_broadcastSafetyStatus(void) const
+{
+    // Send a SafetyStatus message to the queue
+    SafetyStatus status {};
+    status.set_tripped(isTripped());
+    status.set_latchedFaults(_monitor.getLatched());
+    status.set_activeFaults(_monitor.getActive());
+    status.set_reactionTime(_lastReactionTime);
+    status.set_maxReactionTime(_reactionTime.max());
+    status.set_missedDeadlines(_missedDeadlines);
+    status.set_timeStamp(esp_timer_get_time());
+
+    PBMessageWrapper wrapped = MessageServer::wrap(status, PBMessageType::SafetyStatus, _ID);
+
+    return MessageServer::broadcastMessage(wrapped);
+}
+
+PBRet SafetySupervisor::checkInputs(const SafetySupervisorConfig& cfg)
+{
+    if (cfg.period <= 0.0) {
+        ESP_LOGE(SafetySupervisor::Name, "Period (%.3f) must be positive", cfg.period);
+        return PBRet::FAILURE;
+    }
+
+    // The deadline can only be met if faults are checked at least this often
+    if (cfg.reactionDeadline < cfg.period) {
+        ESP_LOGE(SafetySupervisor::Name, "Reaction deadline (%.3f) must be at least the period (%.3f)", cfg.reactionDeadline, cfg.period);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.statusPublishPeriod <= 0.0) {
+        ESP_LOGE(SafetySupervisor::Name, "Status publish period (%.2f) must be positive", cfg.statusPublishPeriod);
+        return PBRet::FAILURE;
+    }
+
+    if ((cfg.element1Pin == GPIO_NUM_NC) || (cfg.element2Pin == GPIO_NUM_NC)) {
+        ESP_LOGE(SafetySupervisor::Name, "Element pins were not set");
+        return PBRet::FAILURE;
+    }
+
+    return SafetyMonitor::checkInputs(cfg.limits);
+}
+
+PBRet SafetySupervisor::loadFromJSON(SafetySupervisorConfig& cfg, const cJSON* cfgRoot)
+{
+    // Load SafetySupervisorConfig struct from JSON. The outputs come from
+    // the controller config
+
+    if (cfgRoot == nullptr) {
+        ESP_LOGW(SafetySupervisor::Name, "cfgRoot was null");
+        return PBRet::FAILURE;
+    }
+
+    // Get period
+    cJSON* periodNode = cJSON_GetObjectItem(cfgRoot, "period");
+    if (cJSON_IsNumber(periodNode)) {
+        cfg.period = periodNode->valuedouble;
+    } else {
+        ESP_LOGI(SafetySupervisor::Name, "Unable to read period from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get reaction deadline
+    cJSON* reactionDeadlineNode = cJSON_GetObjectItem(cfgRoot, "reactionDeadline");
+    if (cJSON_IsNumber(reactionDeadlineNode)) {
+        cfg.reactionDeadline = reactionDeadlineNode->valuedouble;
+    } else {
+        ESP_LOGI(SafetySupervisor::Name, "Unable to read reaction deadline from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get status publish period
+    cJSON* statusPublishPeriodNode = cJSON_GetObjectItem(cfgRoot, "statusPublishPeriod");
+    if (cJSON_IsNumber(statusPublishPeriodNode)) {
+        cfg.statusPublishPeriod = statusPublishPeriodNode->valuedouble;
+    } else {
+        ESP_LOGI(SafetySupervisor::Name, "Unable to read status publish period from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get fault limits
+    cJSON* limitsNode = cJSON_GetObjectItem(cfgRoot, "limits");
+    if (SafetyMonitor::loadFromJSON(cfg.limits, limitsNode) != PBRet::SUCCESS) {
+        ESP_LOGI(SafetySupervisor::Name, "Unable to read fault limits from JSON");
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
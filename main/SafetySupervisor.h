@@ -0,0 +1,149 @@
+#ifndef MAIN_SAFETY_SUPERVISOR_H
+#define MAIN_SAFETY_SUPERVISOR_H
+
+#include <atomic>
+#include <array>
+#include "PBCommon.h"
+#include "CppTask.h"
+#include "Pump.h"
+#include "SafetyMonitor.h"
+#include "RateGroup.h"
+#include "Utilities.h"
+#include "Generated/MessageBase.h"
+#include "Generated/SafetyMessaging.h"
+
+struct SafetySupervisorConfig
+{
+    double period = 0.0;                    // Check period [s]
+    double reactionDeadline = 0.0;          // Time from a fault being due to the outputs being safe [s]
+    double statusPublishPeriod = 0.0;       // Time between SafetyStatus messages [s]
+    SafetyLimits limits {};
+
+    // Outputs driven on a trip. Taken from the controller config
+    gpio_num_t element1Pin = (gpio_num_t) GPIO_NUM_NC;
+    gpio_num_t element2Pin = (gpio_num_t) GPIO_NUM_NC;
+    PumpConfig refluxPumpConfig {};
+    PumpConfig prodPumpConfig {};
+};
+
+// Values shared with the supervisor without going through the message
+// queue, so a stuck queue or task shows up as a stale signal. One task
+// writes, the supervisor reads. Stamps are the low 32 bits of the
+// esp_timer time, which is plenty for ages of a few seconds
+template <size_t N>
+class SafetySignal
+{
+    public:
+        void write(const std::array<float, N>& values, int64_t t)
+        {
+            for (size_t i = 0; i < N; i++) {
+                _values[i].store(values[i], std::memory_order_relaxed);
+            }
+            _stamp.store(static_cast<uint32_t>(t), std::memory_order_release);
+            _written.store(true, std::memory_order_release);
+        }
+
+        // Returns false if the signal has never been written. A write that
+        // races the read can give values newer than the stamp, which only
+        // makes them look one period older than they are
+        bool read(std::array<float, N>& values, uint32_t& stamp) const
+        {
+            if (_written.load(std::memory_order_acquire) == false) {
+                return false;
+            }
+
+            stamp = _stamp.load(std::memory_order_acquire);
+            for (size_t i = 0; i < N; i++) {
+                values[i] = _values[i].load(std::memory_order_relaxed);
+            }
+            return true;
+        }
+
+    private:
+        std::array<std::atomic<float>, N> _values {};
+        std::atomic<uint32_t> _stamp {0};
+        std::atomic<bool> _written {false};
+};
+
+// Independent high priority task that watches temperature and flow
+// freshness, over temperature, pump stalls and loss of cooling flow. On a
+// fault it drives the elements off and the pumps to flush speed itself,
+// then latches the trip until a SafetyCommand resets it. The controller
+// holds the same safe outputs while tripped. Outputs are driven again
+// every period while tripped, so a controller write racing the trip is
+// undone within a period.
+//
+// The time from each trip becoming due to the outputs being driven is
+// measured and checked against the reaction deadline
+class SafetySupervisor : public Task
+{
+    static constexpr const char* Name = "SafetySupervisor";
+
+    public:
+        SafetySupervisor(UBaseType_t priority, UBaseType_t stackDepth, BaseType_t coreID, const SafetySupervisorConfig& cfg);
+
+        // Called by the producing tasks. Time stamps are when the value
+        // was produced [us]
+        static void reportHeadTemp(double temp, int64_t t) { _headTemp.write({static_cast<float>(temp)}, t); }
+        static void reportBoilerTemp(double temp, int64_t t) { _boilerTemp.write({static_cast<float>(temp)}, t); }
+        static void reportFlowrates(double refluxFlow, double productFlow, int64_t t);
+        static void reportOutputs(uint32_t refluxPumpSpeed, uint32_t productPumpSpeed, bool elementsOn, int64_t t);
+
+        // Outputs must be held safe while true. Forced inline, as the
+        // element ISRs call it from IRAM
+        static inline __attribute__((always_inline)) bool isTripped(void) { return _tripped.load(std::memory_order_acquire); }
+
+        static PBRet checkInputs(const SafetySupervisorConfig& cfg);
+        static PBRet loadFromJSON(SafetySupervisorConfig& cfg, const cJSON* cfgRoot);
+        bool isConfigured(void) const { return _configured; }
+
+    private:
+        PBRet _initFromParams(const SafetySupervisorConfig& cfg);
+        PBRet _setupCBTable(void) override;
+
+        // FreeRTOS hook method
+        void taskMain(void) override;
+
+        // Updates
+        SafetyInputs _readInputs(int64_t t);
+        void _trip(uint32_t faults);
+        PBRet _driveSafe(void) const;
+
+        // Queue callbacks
+        PBRet _safetyCommandCB(std::shared_ptr<PBMessageWrapper> msg);
+
+        // Data broadcast
+        PBRet _broadcastSafetyStatus(void) const;
+
+        // Shared signals
+        static SafetySignal<1> _headTemp;
+        static SafetySignal<1> _boilerTemp;
+        static SafetySignal<2> _flowrates;
+        static SafetySignal<3> _outputs;        // Reflux pump speed, product pump speed, elements on
+        static std::atomic<bool> _tripped;
+
+        // Last stamp seen on each signal, extended to a full time [us]
+        struct SignalTime
+        {
+            uint32_t stamp = 0;
+            int64_t time = -1;
+        };
+        static int64_t _extend(SignalTime& signal, uint32_t stamp, int64_t t);
+        SignalTime _headTempTime {};
+        SignalTime _boilerTempTime {};
+        SignalTime _flowTime {};
+        SignalTime _outputsTime {};
+
+        SafetySupervisorConfig _cfg {};
+        SafetyMonitor _monitor {};
+        RateGroup _statusPublishRate {};
+
+        // Reaction time from trips becoming due to outputs driven [s]
+        RunningStats _reactionTime {};
+        double _lastReactionTime = 0.0;
+        uint32_t _missedDeadlines = 0;
+
+        bool _configured = false;
+};
+
+#endif // MAIN_SAFETY_SUPERVISOR_H
@@ -0,0 +1,248 @@
+#include "SensorCalibration.h"
+#include "Utilities.h"
+#include <cmath>
+#include <algorithm>
+#include <string>
+
+SensorCalibration::SensorCalibration(const Coefficients& coeffs, size_t order)
+    : _coeffs(coeffs), _order((order < MaxOrder) ? order : MaxOrder)
+{
+    // Terms above the order are ignored
+    for (size_t i = _order + 1; i <= MaxOrder; i++) {
+        _coeffs[i] = 0.0;
+    }
+}
+
+double SensorCalibration::apply(double raw) const
+{
+    // Horner's method
+    double T = 0.0;
+    for (size_t i = _order + 1; i > 0; i--) {
+        T = T * raw + _coeffs[i - 1];
+    }
+
+    return T;
+}
+
+bool SensorCalibration::isIdentity(void) const
+{
+    return (_coeffs[0] == 0.0) && (_coeffs[1] == 1.0) && (_coeffs[2] == 0.0) && (_coeffs[3] == 0.0);
+}
+
+PBRet SensorCalibration::fitTwoPoint(double rawLow, double refLow, double rawHigh, double refHigh, SensorCalibration& cal)
+{
+    // Gain and offset through two reference points, typically an ice bath
+    // and boiling water
+
+    if ((Utilities::check({rawLow, refLow, rawHigh, refHigh}) == false) || (std::fabs(rawHigh - rawLow) < 1.0)) {
+        ESP_LOGW(SensorCalibration::Name, "Two point calibration needs distinct, valid points");
+        return PBRet::FAILURE;
+    }
+
+    const double gain = (refHigh - refLow) / (rawHigh - rawLow);
+    cal = SensorCalibration({refLow - gain * rawLow, gain, 0.0, 0.0}, 1);
+
+    return PBRet::SUCCESS;
+}
+
+PBRet SensorCalibration::fitPolynomial(const std::vector<double>& raw, const std::vector<double>& ref, size_t order, SensorCalibration& cal)
+{
+    // Least squares fit of a polynomial of the given order. The normal
+    // equations are solved on raw readings scaled to [-1, 1] to keep them
+    // well conditioned, then the coefficients are scaled back
+
+    if ((order < 1) || (order > MaxOrder)) {
+        ESP_LOGW(SensorCalibration::Name, "Calibration order %d is not supported", order);
+        return PBRet::FAILURE;
+    }
+
+    if ((raw.size() != ref.size()) || (raw.size() < order + 1)) {
+        ESP_LOGW(SensorCalibration::Name, "Order %d calibration needs at least %d points", order, order + 1);
+        return PBRet::FAILURE;
+    }
+
+    if ((Utilities::check(raw) == false) || (Utilities::check(ref) == false)) {
+        ESP_LOGW(SensorCalibration::Name, "Calibration points were invalid");
+        return PBRet::FAILURE;
+    }
+
+    double scale = 0.0;
+    for (double x : raw) {
+        scale = std::max(scale, std::fabs(x));
+    }
+    scale = (scale > 0.0) ? scale : 1.0;
+
+    // Build the augmented normal equations A c = b
+    const size_t n = order + 1;
+    double A[MaxOrder + 1][MaxOrder + 2] {};
+    for (size_t k = 0; k < raw.size(); k++) {
+        double powers[2 * MaxOrder + 1] {};
+        powers[0] = 1.0;
+        for (size_t p = 1; p < 2 * n - 1; p++) {
+            powers[p] = powers[p - 1] * raw[k] / scale;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = 0; j < n; j++) {
+                A[i][j] += powers[i + j];
+            }
+            A[i][n] += powers[i] * ref[k];
+        }
+    }
+
+    // Gaussian elimination with partial pivoting
+    for (size_t col = 0; col < n; col++) {
+        size_t pivot = col;
+        for (size_t row = col + 1; row < n; row++) {
+            if (std::fabs(A[row][col]) > std::fabs(A[pivot][col])) {
+                pivot = row;
+            }
+        }
+
+        if (std::fabs(A[pivot][col]) < 1e-12) {
+            ESP_LOGW(SensorCalibration::Name, "Calibration points do not determine an order %d fit", order);
+            return PBRet::FAILURE;
+        }
+
+        for (size_t j = 0; j <= n; j++) {
+            std::swap(A[col][j], A[pivot][j]);
+        }
+
+        for (size_t row = col + 1; row < n; row++) {
+            const double factor = A[row][col] / A[col][col];
+            for (size_t j = col; j <= n; j++) {
+                A[row][j] -= factor * A[col][j];
+            }
+        }
+    }
+
+    Coefficients coeffs {};
+    for (size_t i = n; i > 0; i--) {
+        const size_t row = i - 1;
+        double sum = A[row][n];
+        for (size_t j = row + 1; j < n; j++) {
+            sum -= A[row][j] * coeffs[j];
+        }
+        coeffs[row] = sum / A[row][row];
+    }
+
+    // Undo the scaling of the raw readings
+    double s = 1.0;
+    for (size_t i = 0; i < n; i++) {
+        coeffs[i] /= s;
+        s *= scale;
+    }
+
+    cal = SensorCalibration(coeffs, order);
+    return PBRet::SUCCESS;
+}
+
+bool CalibrationStore::find(const OneWireBus_ROMCode& romCode, SensorCalibration& cal) const
+{
+    std::unordered_map<uint64_t, SensorCalibration>::const_iterator it = _calibrations.find(_toKey(romCode));
+    if (it == _calibrations.end()) {
+        return false;
+    }
+
+    cal = it->second;
+    return true;
+}
+
+void CalibrationStore::set(const OneWireBus_ROMCode& romCode, const SensorCalibration& cal)
+{
+    _calibrations[_toKey(romCode)] = cal;
+}
+
+void CalibrationStore::erase(const OneWireBus_ROMCode& romCode)
+{
+    _calibrations.erase(_toKey(romCode));
+}
+
+PBRet CalibrationStore::serialize(cJSON* root) const
+{
+    // Write all calibrations to JSON
+
+    if (root == nullptr) {
+        ESP_LOGW(CalibrationStore::Name, "cJSON root was null");
+        return PBRet::FAILURE;
+    }
+
+    cJSON* sensors = cJSON_AddArrayToObject(root, "sensors");
+    if (sensors == nullptr) {
+        ESP_LOGW(CalibrationStore::Name, "Failed to create JSON array for calibrations");
+        return PBRet::FAILURE;
+    }
+
+    for (const std::pair<const uint64_t, SensorCalibration>& entry : _calibrations) {
+        cJSON* sensor = cJSON_CreateObject();
+        cJSON* romCode = cJSON_AddArrayToObject(sensor, "romCode");
+        for (size_t i = 0; i < sizeof(OneWireBus_ROMCode::bytes); i++) {
+            cJSON_AddItemToArray(romCode, cJSON_CreateNumber((entry.first >> (8 * i)) & 0xFF));
+        }
+
+        cJSON* coeffs = cJSON_AddArrayToObject(sensor, "coeffs");
+        for (size_t i = 0; i <= entry.second.getOrder(); i++) {
+            cJSON_AddItemToArray(coeffs, cJSON_CreateNumber(entry.second.getCoefficients()[i]));
+        }
+
+        cJSON_AddItemToArray(sensors, sensor);
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet CalibrationStore::deserialize(const cJSON* root)
+{
+    // Replace the store with calibrations read from JSON
+
+    if (root == nullptr) {
+        ESP_LOGW(CalibrationStore::Name, "cJSON root was null");
+        return PBRet::FAILURE;
+    }
+
+    cJSON* sensors = cJSON_GetObjectItem(root, "sensors");
+    if (cJSON_IsArray(sensors) == false) {
+        ESP_LOGW(CalibrationStore::Name, "Unable to read calibrations from JSON");
+        return PBRet::FAILURE;
+    }
+
+    std::unordered_map<uint64_t, SensorCalibration> calibrations {};
+    calibrations.reserve(cJSON_GetArraySize(sensors));
+
+    cJSON* sensor = nullptr;
+    cJSON_ArrayForEach(sensor, sensors) {
+        cJSON* romCode = cJSON_GetObjectItem(sensor, "romCode");
+        cJSON* coeffs = cJSON_GetObjectItem(sensor, "coeffs");
+        if ((cJSON_GetArraySize(romCode) != sizeof(OneWireBus_ROMCode::bytes)) ||
+            (cJSON_GetArraySize(coeffs) < 1) || (cJSON_GetArraySize(coeffs) > static_cast<int>(SensorCalibration::MaxOrder + 1))) {
+            ESP_LOGW(CalibrationStore::Name, "Calibration entry was invalid");
+            return PBRet::FAILURE;
+        }
+
+        uint64_t key = 0;
+        for (size_t i = 0; i < sizeof(OneWireBus_ROMCode::bytes); i++) {
+            key |= static_cast<uint64_t>(cJSON_GetArrayItem(romCode, i)->valueint & 0xFF) << (8 * i);
+        }
+
+        SensorCalibration::Coefficients c {};
+        const size_t nCoeffs = cJSON_GetArraySize(coeffs);
+        for (size_t i = 0; i < nCoeffs; i++) {
+            c[i] = cJSON_GetArrayItem(coeffs, i)->valuedouble;
+        }
+
+        calibrations[key] = SensorCalibration(c, nCoeffs - 1);
+    }
+
+    _calibrations = std::move(calibrations);
+    return PBRet::SUCCESS;
+}
+
+uint64_t CalibrationStore::_toKey(const OneWireBus_ROMCode& romCode)
+{
+    uint64_t key = 0;
+    for (size_t i = 0; i < sizeof(romCode.bytes); i++) {
+        key |= static_cast<uint64_t>(romCode.bytes[i]) << (8 * i);
+    }
+
+    return key;
+}
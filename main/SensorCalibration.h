@@ -0,0 +1,65 @@
+#ifndef SENSOR_CALIBRATION_H
+#define SENSOR_CALIBRATION_H
+
+#include <array>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "PBCommon.h"
+#include "owb.h"
+#include "cJSON.h"
+
+// Polynomial correction from a raw sensor reading to true temperature,
+// T = c0 + c1 * raw + c2 * raw^2 + c3 * raw^3. The default is the identity
+class SensorCalibration
+{
+    static constexpr const char* Name = "SensorCalibration";
+
+    public:
+        static constexpr size_t MaxOrder = 3;
+        using Coefficients = std::array<double, MaxOrder + 1>;
+
+        SensorCalibration(void) = default;
+        SensorCalibration(const Coefficients& coeffs, size_t order);
+
+        double apply(double raw) const;
+
+        // Fit coefficients from (raw, reference) pairs
+        static PBRet fitTwoPoint(double rawLow, double refLow, double rawHigh, double refHigh, SensorCalibration& cal);
+        static PBRet fitPolynomial(const std::vector<double>& raw, const std::vector<double>& ref, size_t order, SensorCalibration& cal);
+
+        const Coefficients& getCoefficients(void) const { return _coeffs; }
+        size_t getOrder(void) const { return _order; }
+        bool isIdentity(void) const;
+
+    private:
+        Coefficients _coeffs {0.0, 1.0, 0.0, 0.0};
+        size_t _order = 1;
+};
+
+// Calibrations for every known sensor, keyed by ROM code. The whole store is
+// loaded into RAM once at startup so sensors are calibrated without flash
+// access
+class CalibrationStore
+{
+    static constexpr const char* Name = "CalibrationStore";
+
+    public:
+        CalibrationStore(void) = default;
+
+        bool find(const OneWireBus_ROMCode& romCode, SensorCalibration& cal) const;
+        void set(const OneWireBus_ROMCode& romCode, const SensorCalibration& cal);
+        void erase(const OneWireBus_ROMCode& romCode);
+        size_t size(void) const { return _calibrations.size(); }
+
+        // Utility
+        PBRet serialize(cJSON* root) const;
+        PBRet deserialize(const cJSON* root);
+
+    private:
+        static uint64_t _toKey(const OneWireBus_ROMCode& romCode);
+
+        std::unordered_map<uint64_t, SensorCalibration> _calibrations {};
+};
+
+#endif // SENSOR_CALIBRATION_H
@@ -0,0 +1,202 @@
+#include "SensorFrame.h"
+#include <algorithm>
+
+FrameAligner::FrameAligner(const FrameAlignerConfig& cfg)
+    : _cfg(cfg)
+{
+    _configured = checkInputs(cfg) == PBRet::SUCCESS;
+}
+
+PBRet FrameAligner::checkInputs(const FrameAlignerConfig& cfg)
+{
+    if (cfg.maxSkew <= 0.0) {
+        ESP_LOGE(FrameAligner::Name, "Max skew (%.2f) must be positive", cfg.maxSkew);
+        return PBRet::FAILURE;
+    }
+
+    if (static_cast<size_t>(cfg.reference) >= SensorChannelCount) {
+        ESP_LOGE(FrameAligner::Name, "Reference channel (%d) is invalid", static_cast<size_t>(cfg.reference));
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet FrameAligner::loadFromJSON(FrameAlignerConfig& cfg, const cJSON* cfgRoot)
+{
+    // Load FrameAlignerConfig struct from JSON
+
+    if (cfgRoot == nullptr) {
+        ESP_LOGW(FrameAligner::Name, "cfgRoot was null");
+        return PBRet::FAILURE;
+    }
+
+    // Get max skew
+    cJSON* maxSkewNode = cJSON_GetObjectItem(cfgRoot, "maxSkew");
+    if (cJSON_IsNumber(maxSkewNode)) {
+        cfg.maxSkew = maxSkewNode->valuedouble;
+    } else {
+        ESP_LOGI(FrameAligner::Name, "Unable to read max skew from JSON");
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet FrameAligner::addReading(SensorChannel channel, double value, int64_t t)
+{
+    const size_t i = static_cast<size_t>(channel);
+    if (i >= SensorChannelCount) {
+        ESP_LOGW(FrameAligner::Name, "Sensor channel %d is invalid", i);
+        return PBRet::FAILURE;
+    }
+
+    if (Utilities::check(value) == false) {
+        ESP_LOGW(FrameAligner::Name, "Reading on %s was invalid", getChannelName(channel));
+        return PBRet::FAILURE;
+    }
+
+    ChannelHistory& history = _channels[i];
+    if (history.last.valid && (t <= history.last.timeStamp)) {
+        return PBRet::SUCCESS;
+    }
+
+    if (history.last.valid) {
+        history.interval.add((t - history.last.timeStamp) * 1e-6);
+    }
+
+    history.prev = history.last;
+    history.last.value = value;
+    history.last.timeStamp = t;
+    history.last.valid = true;
+
+    return PBRet::SUCCESS;
+}
+
+PBRet FrameAligner::align(SensorFrame& frame)
+{
+    // Pick the tick, then interpolate each channel to it
+
+    if (_configured == false) {
+        ESP_LOGW(FrameAligner::Name, "Cannot align frame before FrameAligner is configured");
+        return PBRet::FAILURE;
+    }
+
+    int64_t newest = 0;
+    bool hasReading = false;
+    for (const ChannelHistory& history : _channels) {
+        if (history.last.valid) {
+            newest = hasReading ? std::max(newest, history.last.timeStamp) : history.last.timeStamp;
+            hasReading = true;
+        }
+    }
+
+    if (hasReading == false) {
+        return PBRet::FAILURE;
+    }
+
+    // Newest reference reading, or the newest reading if the reference
+    // is stale. Ticks never go backwards, even when the reference rejoins
+    const int64_t maxSkew = static_cast<int64_t>(_cfg.maxSkew * 1e6);
+    const SensorReading& reference = _channels[static_cast<size_t>(_cfg.reference)].last;
+    int64_t tick = newest;
+    if (reference.valid && ((newest - reference.timeStamp) <= maxSkew)) {
+        tick = reference.timeStamp;
+    }
+    tick = std::max(tick, _lastTick);
+
+    frame.tick = tick;
+    for (size_t i = 0; i < SensorChannelCount; i++) {
+        ChannelHistory& history = _channels[i];
+        SensorReading& reading = frame.readings[i];
+        reading.timeStamp = tick;
+        reading.valid = history.last.valid && ((newest - history.last.timeStamp) <= maxSkew);
+        if (history.last.valid == false) {
+            continue;
+        }
+
+        reading.value = _interpolate(history, tick);
+        if (reading.valid) {
+            history.skew.add((history.last.timeStamp - tick) * 1e-6);
+        }
+    }
+
+    _lastTick = tick;
+    if (++_frames >= FrameAligner::TimingReportFrames) {
+        reportTiming();
+    }
+
+    return PBRet::SUCCESS;
+}
+
+double FrameAligner::_interpolate(const ChannelHistory& history, int64_t tick)
+{
+    // Linear between the last two readings. Outside them the nearest is
+    // held, as extrapolating a noisy signal amplifies the noise
+
+    const SensorReading& prev = history.prev;
+    const SensorReading& last = history.last;
+    if ((prev.valid == false) || (tick >= last.timeStamp)) {
+        return last.value;
+    }
+
+    if (tick <= prev.timeStamp) {
+        return prev.value;
+    }
+
+    const double frac = static_cast<double>(tick - prev.timeStamp) / (last.timeStamp - prev.timeStamp);
+    return prev.value + frac * (last.value - prev.value);
+}
+
+void FrameAligner::reset(void)
+{
+    for (ChannelHistory& history : _channels) {
+        history = ChannelHistory {};
+    }
+
+    _lastTick = 0;
+    _frames = 0;
+}
+
+void FrameAligner::reportTiming(void)
+{
+    // Log the sample interval jitter and skew of each channel, then start
+    // a new window
+
+    for (size_t i = 0; i < SensorChannelCount; i++) {
+        ChannelHistory& history = _channels[i];
+        if (history.interval.count() > 0) {
+            ESP_LOGI(FrameAligner::Name, "%s: interval %.1f ms, jitter %.2f ms, skew mean %.1f ms, max %.1f ms",
+                     getChannelName(static_cast<SensorChannel>(i)), history.interval.mean() * 1e3, history.interval.stdDev() * 1e3,
+                     history.skew.mean() * 1e3, history.skew.max() * 1e3);
+        }
+
+        history.interval.reset();
+        history.skew.reset();
+    }
+
+    _frames = 0;
+}
+
+const char* FrameAligner::getChannelName(SensorChannel channel)
+{
+    switch (channel)
+    {
+        case (SensorChannel::HEAD_TEMP):
+            return "headTemp";
+        case (SensorChannel::REFLUX_TEMP):
+            return "refluxTemp";
+        case (SensorChannel::PRODUCT_TEMP):
+            return "productTemp";
+        case (SensorChannel::RADIATOR_TEMP):
+            return "radiatorTemp";
+        case (SensorChannel::BOILER_TEMP):
+            return "boilerTemp";
+        case (SensorChannel::REFLUX_FLOW):
+            return "refluxFlow";
+        case (SensorChannel::PRODUCT_FLOW):
+            return "productFlow";
+        default:
+            return "unknown";
+    }
+}
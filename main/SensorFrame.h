@@ -0,0 +1,103 @@
+#ifndef SENSOR_FRAME_H
+#define SENSOR_FRAME_H
+
+#include <array>
+#include "PBCommon.h"
+#include "Utilities.h"
+#include "cJSON.h"
+
+// Every signal SensorManager acquires
+enum class SensorChannel : size_t
+{
+    HEAD_TEMP,
+    REFLUX_TEMP,
+    PRODUCT_TEMP,
+    RADIATOR_TEMP,
+    BOILER_TEMP,
+    REFLUX_FLOW,
+    PRODUCT_FLOW
+};
+
+constexpr size_t SensorChannelCount = 7;
+
+// A single reading and the time it was acquired
+struct SensorReading
+{
+    double value = 0.0;
+    int64_t timeStamp = 0;      // Acquisition time [us]
+    bool valid = false;
+};
+
+// Readings from every channel at the same instant
+struct SensorFrame
+{
+    int64_t tick = 0;           // [us]
+    std::array<SensorReading, SensorChannelCount> readings {};
+
+    SensorReading& operator[](SensorChannel channel) { return readings[static_cast<size_t>(channel)]; }
+    const SensorReading& operator[](SensorChannel channel) const { return readings[static_cast<size_t>(channel)]; }
+};
+
+struct FrameAlignerConfig
+{
+    double maxSkew = 0.0;       // Channels further than this behind the newest reading are stale [s]
+    SensorChannel reference = SensorChannel::HEAD_TEMP;     // Channel the tick follows
+};
+
+// Channels are sampled at different rates and instants. Temperatures are
+// stamped when their conversion starts and flowrates at the middle of their
+// measurement window. The aligner keeps the last two readings of each
+// channel and interpolates them all to a common tick, the newest reading on
+// the reference channel. The control loop acts on the reference, so it is
+// never delayed to wait for slower channels. Those hold their last reading
+// until the next arrives. If the reference goes stale the tick follows the
+// newest reading on any channel. A channel more than maxSkew behind the
+// newest reading holds its last value marked invalid
+class FrameAligner
+{
+    static constexpr const char* Name = "FrameAligner";
+    static constexpr size_t TimingReportFrames = 1000;      // Log timing every N frames
+
+    public:
+        // Constructors
+        FrameAligner(void) = default;
+        explicit FrameAligner(const FrameAlignerConfig& cfg);
+
+        // Update. Readings no newer than the last on a channel are ignored,
+        // so a channel can be offered the same reading every tick
+        PBRet addReading(SensorChannel channel, double value, int64_t t);
+        PBRet align(SensorFrame& frame);
+        void reset(void);
+
+        // Timing. Jitter is the spread of the interval between readings,
+        // skew is how far a channel's newest reading is ahead of the tick
+        // (negative when behind)
+        const RunningStats& getInterval(SensorChannel channel) const { return _channels[static_cast<size_t>(channel)].interval; }
+        const RunningStats& getSkew(SensorChannel channel) const { return _channels[static_cast<size_t>(channel)].skew; }
+        void reportTiming(void);
+
+        // Utility
+        static PBRet checkInputs(const FrameAlignerConfig& cfg);
+        static PBRet loadFromJSON(FrameAlignerConfig& cfg, const cJSON* cfgRoot);
+        static const char* getChannelName(SensorChannel channel);
+        bool isConfigured(void) const { return _configured; }
+
+    private:
+        struct ChannelHistory
+        {
+            SensorReading prev {};
+            SensorReading last {};
+            RunningStats interval {};       // [s]
+            RunningStats skew {};           // [s]
+        };
+
+        static double _interpolate(const ChannelHistory& history, int64_t tick);
+
+        FrameAlignerConfig _cfg {};
+        std::array<ChannelHistory, SensorChannelCount> _channels {};
+        int64_t _lastTick = 0;              // [us]
+        size_t _frames = 0;
+        bool _configured = false;
+};
+
+#endif // SENSOR_FRAME_H
@@ -0,0 +1,259 @@
+#include "SensorHealth.h"
+#include <cmath>
+
+SensorHealthMonitor::SensorHealthMonitor(const SensorHealthConfig& cfg)
+    : _cfg(cfg)
+{
+    _configured = checkInputs(cfg) == PBRet::SUCCESS;
+}
+
+PBRet SensorHealthMonitor::checkInputs(const SensorHealthConfig& cfg)
+{
+    if (cfg.timeout <= 0.0) {
+        ESP_LOGE(SensorHealthMonitor::Name, "Timeout (%.2f) must be positive", cfg.timeout);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.maxConsecutiveErrors < 1) {
+        ESP_LOGE(SensorHealthMonitor::Name, "Max consecutive errors (%d) must be at least 1", cfg.maxConsecutiveErrors);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.recoveryReads < 1) {
+        ESP_LOGE(SensorHealthMonitor::Name, "Recovery reads (%d) must be at least 1", cfg.recoveryReads);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.maxRate <= 0.0) {
+        ESP_LOGE(SensorHealthMonitor::Name, "Max rate (%.2f) must be positive", cfg.maxRate);
+        return PBRet::FAILURE;
+    }
+
+    if ((cfg.stuckTime < 0.0) || (cfg.stuckBand < 0.0)) {
+        ESP_LOGE(SensorHealthMonitor::Name, "Stuck time (%.2f) and band (%.2f) must not be negative", cfg.stuckTime, cfg.stuckBand);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.publishPeriod <= 0.0) {
+        ESP_LOGE(SensorHealthMonitor::Name, "Publish period (%.2f) must be positive", cfg.publishPeriod);
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet SensorHealthMonitor::loadFromJSON(SensorHealthConfig& cfg, const cJSON* cfgRoot)
+{
+    // Load SensorHealthConfig struct from JSON
+
+    if (cfgRoot == nullptr) {
+        ESP_LOGW(SensorHealthMonitor::Name, "cfgRoot was null");
+        return PBRet::FAILURE;
+    }
+
+    // Get sensor timeout
+    cJSON* timeoutNode = cJSON_GetObjectItem(cfgRoot, "timeout");
+    if (cJSON_IsNumber(timeoutNode)) {
+        cfg.timeout = timeoutNode->valuedouble;
+    } else {
+        ESP_LOGI(SensorHealthMonitor::Name, "Unable to read sensor timeout from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get max consecutive errors
+    cJSON* maxConsecutiveErrorsNode = cJSON_GetObjectItem(cfgRoot, "maxConsecutiveErrors");
+    if (cJSON_IsNumber(maxConsecutiveErrorsNode)) {
+        cfg.maxConsecutiveErrors = maxConsecutiveErrorsNode->valueint;
+    } else {
+        ESP_LOGI(SensorHealthMonitor::Name, "Unable to read max consecutive errors from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get recovery reads
+    cJSON* recoveryReadsNode = cJSON_GetObjectItem(cfgRoot, "recoveryReads");
+    if (cJSON_IsNumber(recoveryReadsNode)) {
+        cfg.recoveryReads = recoveryReadsNode->valueint;
+    } else {
+        ESP_LOGI(SensorHealthMonitor::Name, "Unable to read recovery reads from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get max rate
+    cJSON* maxRateNode = cJSON_GetObjectItem(cfgRoot, "maxRate");
+    if (cJSON_IsNumber(maxRateNode)) {
+        cfg.maxRate = maxRateNode->valuedouble;
+    } else {
+        ESP_LOGI(SensorHealthMonitor::Name, "Unable to read max rate from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get stuck time
+    cJSON* stuckTimeNode = cJSON_GetObjectItem(cfgRoot, "stuckTime");
+    if (cJSON_IsNumber(stuckTimeNode)) {
+        cfg.stuckTime = stuckTimeNode->valuedouble;
+    } else {
+        ESP_LOGI(SensorHealthMonitor::Name, "Unable to read stuck time from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get stuck band
+    cJSON* stuckBandNode = cJSON_GetObjectItem(cfgRoot, "stuckBand");
+    if (cJSON_IsNumber(stuckBandNode)) {
+        cfg.stuckBand = stuckBandNode->valuedouble;
+    } else {
+        ESP_LOGI(SensorHealthMonitor::Name, "Unable to read stuck band from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get publish period
+    cJSON* publishPeriodNode = cJSON_GetObjectItem(cfgRoot, "publishPeriod");
+    if (cJSON_IsNumber(publishPeriodNode)) {
+        cfg.publishPeriod = publishPeriodNode->valuedouble;
+    } else {
+        ESP_LOGI(SensorHealthMonitor::Name, "Unable to read publish period from JSON");
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet SensorHealthMonitor::addSensor(size_t id, int64_t t)
+{
+    // New sensors start healthy and have timeout to produce a first reading
+
+    if (id >= MaxSensors) {
+        ESP_LOGW(SensorHealthMonitor::Name, "Sensor id %d is out of range", id);
+        return PBRet::FAILURE;
+    }
+
+    _stats[id] = SensorHealthStats {};
+    _stats[id].status = SensorHealthStats::Status::OK;
+    _stats[id].lastGoodTime = t;
+    _stats[id].lastChangeTime = t;
+
+    return PBRet::SUCCESS;
+}
+
+PBRet SensorHealthMonitor::removeSensor(size_t id)
+{
+    if (id >= MaxSensors) {
+        ESP_LOGW(SensorHealthMonitor::Name, "Sensor id %d is out of range", id);
+        return PBRet::FAILURE;
+    }
+
+    _stats[id] = SensorHealthStats {};
+    return PBRet::SUCCESS;
+}
+
+bool SensorHealthMonitor::reportRead(size_t id, int64_t t, double T, bool& changed)
+{
+    changed = false;
+    if ((_configured == false) || (id >= MaxSensors) || (_stats[id].status == SensorHealthStats::Status::UNUSED)) {
+        return false;
+    }
+
+    SensorHealthStats& stats = _stats[id];
+
+    // Reject physically implausible jumps
+    if (stats.hasValue) {
+        const double dt = (t - stats.lastGoodTime) * 1e-6;
+        if ((dt > 0.0) && (std::fabs(T - stats.lastValue) / dt > _cfg.maxRate)) {
+            stats.rateAnomalies++;
+            _fault(stats, SensorFault::RATE, changed);
+            return false;
+        }
+    }
+
+    // A live sensor always shows some noise. One that doesn't move at all
+    // has stopped converting
+    if ((stats.hasValue == false) || (std::fabs(T - stats.lastValue) > _cfg.stuckBand)) {
+        stats.lastChangeTime = t;
+    } else if ((_cfg.stuckTime > 0.0) && ((t - stats.lastChangeTime) * 1e-6 > _cfg.stuckTime)) {
+        if (stats.lastFault != SensorFault::STUCK) {
+            stats.stuckEvents++;
+        }
+        _fault(stats, SensorFault::STUCK, changed);
+        return false;
+    }
+
+    stats.lastValue = T;
+    stats.lastGoodTime = t;
+    stats.hasValue = true;
+    stats.lastFault = SensorFault::NONE;
+    stats.consecutiveErrors = 0;
+    stats.consecutiveGood++;
+
+    if ((stats.status != SensorHealthStats::Status::OK) && (stats.consecutiveGood >= _cfg.recoveryReads)) {
+        stats.status = SensorHealthStats::Status::OK;
+        changed = true;
+    }
+
+    return stats.status != SensorHealthStats::Status::FAILED;
+}
+
+void SensorHealthMonitor::reportError(size_t id, SensorFault fault, bool& changed)
+{
+    changed = false;
+    if ((id >= MaxSensors) || (_stats[id].status == SensorHealthStats::Status::UNUSED)) {
+        return;
+    }
+
+    SensorHealthStats& stats = _stats[id];
+    if (fault == SensorFault::CRC) {
+        stats.crcErrors++;
+    } else if (fault == SensorFault::TIMEOUT) {
+        stats.timeouts++;
+    }
+
+    _fault(stats, fault, changed);
+}
+
+void SensorHealthMonitor::update(int64_t t, std::array<bool, MaxSensors>& changed)
+{
+    const int64_t timeout = static_cast<int64_t>(_cfg.timeout * 1e6);
+    for (size_t i = 0; i < MaxSensors; i++) {
+        SensorHealthStats& stats = _stats[i];
+        changed[i] = false;
+        if ((stats.status == SensorHealthStats::Status::UNUSED) || (stats.status == SensorHealthStats::Status::FAILED)) {
+            continue;
+        }
+
+        if ((t - stats.lastGoodTime) > timeout) {
+            stats.timeouts++;
+            stats.lastFault = SensorFault::TIMEOUT;
+            stats.consecutiveGood = 0;
+            stats.status = SensorHealthStats::Status::FAILED;
+            changed[i] = true;
+        }
+    }
+}
+
+bool SensorHealthMonitor::isHealthy(size_t id) const
+{
+    return (id < MaxSensors) && ((_stats[id].status == SensorHealthStats::Status::OK) ||
+                                 (_stats[id].status == SensorHealthStats::Status::DEGRADED));
+}
+
+const SensorHealthStats& SensorHealthMonitor::getStats(size_t id) const
+{
+    static const SensorHealthStats unused {};
+    return (id < MaxSensors) ? _stats[id] : unused;
+}
+
+void SensorHealthMonitor::_fault(SensorHealthStats& stats, SensorFault fault, bool& changed)
+{
+    // Errors degrade a sensor. Enough of them in a row fail it
+
+    const SensorHealthStats::Status prevStatus = stats.status;
+    stats.lastFault = fault;
+    stats.consecutiveGood = 0;
+    stats.consecutiveErrors++;
+
+    if (stats.consecutiveErrors >= _cfg.maxConsecutiveErrors) {
+        stats.status = SensorHealthStats::Status::FAILED;
+    } else if (stats.status == SensorHealthStats::Status::OK) {
+        stats.status = SensorHealthStats::Status::DEGRADED;
+    }
+
+    changed = (stats.status != prevStatus);
+}
@@ -0,0 +1,81 @@
+#ifndef SENSOR_HEALTH_H
+#define SENSOR_HEALTH_H
+
+#include <array>
+#include "PBCommon.h"
+#include "cJSON.h"
+
+struct SensorHealthConfig
+{
+    double timeout = 0.0;               // Time without a good reading before a sensor is failed [s]
+    int maxConsecutiveErrors = 0;       // Errors in a row before a sensor is failed
+    int recoveryReads = 0;              // Good reads in a row before a failed sensor is trusted again
+    double maxRate = 0.0;               // Readings changing faster than this are rejected [deg C / s]
+    double stuckTime = 0.0;             // Time a reading may stay within stuckBand. 0 disables [s]
+    double stuckBand = 0.0;             // Change smaller than this counts as stuck [deg C]
+    double publishPeriod = 0.0;         // Time between SensorHealth messages when nothing changes [s]
+};
+
+enum class SensorFault { NONE, CRC, TIMEOUT, STUCK, RATE };
+
+// Health of a single sensor. Failed sensors are not used until they have
+// recovered
+struct SensorHealthStats
+{
+    enum class Status { UNUSED, OK, DEGRADED, FAILED };
+
+    Status status = Status::UNUSED;
+    uint32_t crcErrors = 0;
+    uint32_t timeouts = 0;
+    uint32_t stuckEvents = 0;
+    uint32_t rateAnomalies = 0;
+    int consecutiveErrors = 0;
+    int consecutiveGood = 0;
+    SensorFault lastFault = SensorFault::NONE;
+    double lastValue = 0.0;             // [deg C]
+    int64_t lastGoodTime = 0;           // [us]
+    int64_t lastChangeTime = 0;         // [us]
+    bool hasValue = false;
+};
+
+// Tracks read errors, missing readings, stuck values and implausible rates
+// for every sensor in a fixed size table. The table is indexed by sensor
+// slot so no allocation happens in the read path
+class SensorHealthMonitor
+{
+    static constexpr const char* Name = "SensorHealthMonitor";
+
+    public:
+        static constexpr size_t MaxSensors = 15;
+
+        SensorHealthMonitor(void) = default;
+        explicit SensorHealthMonitor(const SensorHealthConfig& cfg);
+
+        // Sensors must be added before they are reported on
+        PBRet addSensor(size_t id, int64_t t);
+        PBRet removeSensor(size_t id);
+
+        // Report each read. Returns false if a reading should not be used.
+        // Status changes are flagged through changed
+        bool reportRead(size_t id, int64_t t, double T, bool& changed);
+        void reportError(size_t id, SensorFault fault, bool& changed);
+
+        // Fail sensors that haven't produced a good reading within timeout
+        void update(int64_t t, std::array<bool, MaxSensors>& changed);
+
+        bool isHealthy(size_t id) const;
+        const SensorHealthStats& getStats(size_t id) const;
+
+        static PBRet checkInputs(const SensorHealthConfig& cfg);
+        static PBRet loadFromJSON(SensorHealthConfig& cfg, const cJSON* cfgRoot);
+        bool isConfigured(void) const { return _configured; }
+
+    private:
+        void _fault(SensorHealthStats& stats, SensorFault fault, bool& changed);
+
+        SensorHealthConfig _cfg {};
+        std::array<SensorHealthStats, MaxSensors> _stats {};
+        bool _configured = false;
+};
+
+#endif // SENSOR_HEALTH_H
@@ -1,16 +1,21 @@
 #include "SensorManager.h"
-#include "esp_spiffs.h"
-#include "Filesystem.h"
+#include "SettingsStore.h"
 #include "Thermo.h"
 #include "ABVTables.h"
+#include "SafetySupervisor.h"
 #include "IO/Writable.h"
-#include <fstream>
-#include <sstream>
-#include <iostream>
+#include "IO/Readable.h"
+#include "Generated/ControllerMessaging.h"
+
+// Temperature roles in SensorChannel order
+static const std::array<DS18B20Role, 5> TempRoles = {
+    DS18B20Role::HEAD_TEMP, DS18B20Role::REFLUX_TEMP, DS18B20Role::PRODUCT_TEMP,
+    DS18B20Role::RADIATOR_TEMP, DS18B20Role::BOILER_TEMP
+};
 
 SensorManager::SensorManager(UBaseType_t priority, UBaseType_t stackDepth, BaseType_t coreID, const SensorManagerConfig& cfg)
     : Task(SensorManager::Name, priority, stackDepth, coreID), _refluxFlowmeter(cfg.refluxFlowConfig), 
-      _productFlowmeter(cfg.productFlowConfig)
+      _productFlowmeter(cfg.productFlowConfig), _aligner(cfg.frameAlignerConfig), _runBalance(cfg.runBalanceConfig)
 {
     // Setup callback table
     _setupCBTable();
@@ -32,7 +37,10 @@ void SensorManager::taskMain(void)
     // Subscribe to messages
     std::set<PBMessageType> subscriptions = { 
         PBMessageType::SensorManagerCommand,
-        PBMessageType::AssignSensor
+        PBMessageType::AssignSensor,
+        PBMessageType::ControllerTuning,
+        PBMessageType::RunPhaseState,
+        PBMessageType::SensorCalibrationCommand
     };
     Subscriber sub(SensorManager::Name, _GPQueue, subscriptions);
     MessageServer::registerTask(sub);
@@ -45,33 +53,168 @@ void SensorManager::taskMain(void)
         // Retrieve data from the queue
         _processQueue();
 
-        // Read temperature sensors
-        TemperatureData Tdata {};
-        if (_OWBus.readTempSensors(Tdata) != PBRet::SUCCESS) {
-            ESP_LOGW(SensorManager::Name, "Unable to read temperature sensors");
-            
-            // Record fault
+        // Each group of signals is updated at its own rate. The loop runs at
+        // the base rate dt
+        const int64_t t = esp_timer_get_time();
+
+        // Temperature conversions are pipelined and paced by the sensors
+        _updateTemperatures(t);
+
+        const bool flowDue = _flowRate.isDue(t);
+        if (flowDue) {
+            _updateFlowrates(t);
         }
 
-        // Read flowmeters
-        FlowrateData flowData {};
-        if (_refluxFlowmeter.readMassFlowrate(esp_timer_get_time(), flowData.mutable_refluxFlowrate().get()) != PBRet::SUCCESS) {
-            ESP_LOGW(SensorManager::Name, "Unable to read reflux flowmeter");
+        // Readings are published once they are aligned to a common tick
+        _publishFrame(t, flowDue);
+
+        if (_broadcastRate.isDue(t)) {
+            _updateConcentrations();
         }
 
-        // Compute ABV
-        ConcentrationData concData {};
-        if (_estimateABV(Tdata, concData) != PBRet::SUCCESS) {
-            ESP_LOGW(SensorManager::Name, "Unable to estimate ABV");
+        vTaskDelayUntil(&xLastWakeTime, timestep);
+    }
+}
+
+PBRet SensorManager::_updateTemperatures(int64_t t)
+{
+    // Read temperature sensors and pass new readings to the frame aligner
+
+    bool updated = false;
+    if (_OWBus.readTempSensors(_latestTdata, updated) != PBRet::SUCCESS) {
+        ESP_LOGW(SensorManager::Name, "Unable to read temperature sensors");
+        
+        // Record fault
+    }
+
+    if (updated == false) {
+        return PBRet::SUCCESS;
+    }
+
+    const std::array<double, 5> temps = {
+        _latestTdata.get_headTemp(), _latestTdata.get_refluxCondensorTemp(), _latestTdata.get_prodCondensorTemp(), 
+        _latestTdata.get_radiatorTemp(), _latestTdata.get_boilerTemp()
+    };
+
+    // Each role carries the time its own conversion started
+    for (size_t i = 0; i < TempRoles.size(); i++) {
+        const int64_t sampleTime = _OWBus.getSampleTime(TempRoles[i]);
+        if (sampleTime > 0) {
+            _aligner.addReading(static_cast<SensorChannel>(i), temps[i], sampleTime);
         }
+    }
 
-        // Broadcast data
-        _broadcastTemps(Tdata);
-        _broadcastFlowrates(flowData);
-        _broadcastConcentrations(concData);
+    return PBRet::SUCCESS;
+}
 
-        vTaskDelayUntil(&xLastWakeTime, timestep);
+PBRet SensorManager::_updateFlowrates(int64_t t)
+{
+    // Read flowmeters over the last flow window, accumulate run totals and
+    // pass the flowrates to the frame aligner
+
+    // Correct for coolant density at each condensor outlet. A failed sensor
+    // leaves the last good temperature in place
+    if (_OWBus.isRoleHealthy(DS18B20Role::REFLUX_TEMP)) {
+        _refluxFlowmeter.setFluidTemperature(_Tdata.get_refluxCondensorTemp());
+    }
+
+    if (_OWBus.isRoleHealthy(DS18B20Role::PRODUCT_TEMP)) {
+        _productFlowmeter.setFluidTemperature(_Tdata.get_prodCondensorTemp());
+    }
+
+    if (_refluxFlowmeter.readMassFlowrate(t, _latestFlowData.mutable_refluxFlowrate().get()) == PBRet::SUCCESS) {
+        _aligner.addReading(SensorChannel::REFLUX_FLOW, _latestFlowData.get_refluxFlowrate(), _refluxFlowmeter.getSampleTime());
+    } else {
+        ESP_LOGW(SensorManager::Name, "Unable to read reflux flowmeter");
+    }
+
+    if (_productFlowmeter.readMassFlowrate(t, _latestFlowData.mutable_productFlowrate().get()) == PBRet::SUCCESS) {
+        _aligner.addReading(SensorChannel::PRODUCT_FLOW, _latestFlowData.get_productFlowrate(), _productFlowmeter.getSampleTime());
+    } else {
+        ESP_LOGW(SensorManager::Name, "Unable to read product flowmeter");
+    }
+
+    // Accumulate run totals. Every flow window is integrated, so these use
+    // the flowrates as acquired. Coolant reaches both condensers from the
+    // radiator
+    const CondenserReading refluxCondenser {_refluxFlowmeter.getVolumetricFlowrate(), _refluxFlowmeter.getDensity(),
+                                            _Tdata.get_radiatorTemp(), _Tdata.get_refluxCondensorTemp()};
+    const CondenserReading productCondenser {_productFlowmeter.getVolumetricFlowrate(), _productFlowmeter.getDensity(),
+                                             _Tdata.get_radiatorTemp(), _Tdata.get_prodCondensorTemp()};
+    if (_updateRunBalance(t, refluxCondenser, productCondenser) != PBRet::SUCCESS) {
+        ESP_LOGW(SensorManager::Name, "Unable to update run balance");
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet SensorManager::_publishFrame(int64_t t, bool publishFlows)
+{
+    // Interpolate every channel to a common tick, then publish temperatures
+    // if they have changed. Flowrates only change once per flow window, so
+    // are only considered for publishing then. A channel that has gone stale
+    // holds its last value
+
+    if (_aligner.align(_frame) != PBRet::SUCCESS) {
+        return PBRet::SUCCESS;
+    }
+
+    _Tdata.set_headTemp(_frame[SensorChannel::HEAD_TEMP].value);
+    _Tdata.set_refluxCondensorTemp(_frame[SensorChannel::REFLUX_TEMP].value);
+    _Tdata.set_prodCondensorTemp(_frame[SensorChannel::PRODUCT_TEMP].value);
+    _Tdata.set_radiatorTemp(_frame[SensorChannel::RADIATOR_TEMP].value);
+    _Tdata.set_boilerTemp(_frame[SensorChannel::BOILER_TEMP].value);
+    _Tdata.set_timeStamp(_frame.tick);
+
+    // Fresh readings also go straight to the safety supervisor, so it sees
+    // them even when the queue is backed up
+    if (_frame[SensorChannel::HEAD_TEMP].valid) {
+        SafetySupervisor::reportHeadTemp(_frame[SensorChannel::HEAD_TEMP].value, _frame.tick);
+    }
+    if (_frame[SensorChannel::BOILER_TEMP].valid) {
+        SafetySupervisor::reportBoilerTemp(_frame[SensorChannel::BOILER_TEMP].value, _frame.tick);
+    }
+
+    PBRet ret = PBRet::SUCCESS;
+    const std::array<double, 5> temps = {
+        _Tdata.get_headTemp(), _Tdata.get_refluxCondensorTemp(), _Tdata.get_prodCondensorTemp(), 
+        _Tdata.get_radiatorTemp(), _Tdata.get_boilerTemp()
+    };
+
+    if (_tempDeadband.shouldPublish(t, temps) && (_broadcastTemps(_Tdata) != PBRet::SUCCESS)) {
+        ret = PBRet::FAILURE;
+    }
+
+    if (publishFlows == false) {
+        return ret;
+    }
+
+    _flowData.set_refluxFlowrate(_frame[SensorChannel::REFLUX_FLOW].value);
+    _flowData.set_productFlowrate(_frame[SensorChannel::PRODUCT_FLOW].value);
+    if (_frame[SensorChannel::REFLUX_FLOW].valid && _frame[SensorChannel::PRODUCT_FLOW].valid) {
+        SafetySupervisor::reportFlowrates(_flowData.get_refluxFlowrate(), _flowData.get_productFlowrate(), _frame.tick);
+    }
+
+    const std::array<double, 2> flows = { _flowData.get_refluxFlowrate(), _flowData.get_productFlowrate() };
+    if (_flowDeadband.shouldPublish(t, flows) && (_broadcastFlowrates(_flowData) != PBRet::SUCCESS)) {
+        ret = PBRet::FAILURE;
+    }
+
+    return ret;
+}
+
+PBRet SensorManager::_updateConcentrations(void)
+{
+    // Estimate ABV from the latest temperatures. These change slowly so are
+    // only computed and published at the broadcast rate
+
+    _concData.clear();
+    if (_estimateABV(_Tdata, _concData) != PBRet::SUCCESS) {
+        ESP_LOGW(SensorManager::Name, "Unable to estimate ABV");
+        return PBRet::FAILURE;
     }
+
+    return _broadcastConcentrations(_concData);
 }
 
 PBRet SensorManager::_commandMessageCB(std::shared_ptr<PBMessageWrapper> msg)
@@ -90,6 +233,12 @@ PBRet SensorManager::_commandMessageCB(std::shared_ptr<PBMessageWrapper> msg)
             ESP_LOGI(SensorManager::Name, "Broadcasting sensor adresses");
             return _broadcastSensors();
         }
+        case (SensorManagerCmdType::CMD_RESET_RUN_BALANCE):
+        {
+            ESP_LOGI(SensorManager::Name, "Resetting run balance");
+            _runBalance.reset();
+            return _writeRunBalanceCheckpoint();
+        }
         case (SensorManagerCmdType::CMD_NONE):
         {
             ESP_LOGW(SensorManager::Name, "Received command None");
@@ -125,14 +274,9 @@ PBRet SensorManager::_assignSensorCB(std::shared_ptr<PBMessageWrapper> msg)
         romCode.bytes[i] = sensorMsg.address()[i];
     }
 
-    // TODO: Check here if this is a known sensor, and load it's calibration if so
-    //       Otherwise, initialize with default calibration
-
-    // Use default calibration for now
-    const double calibLinear = 1.0;
-    const double calibOffset = 0.0;
-
-    const Ds18b20Config config(romCode, calibLinear, calibOffset, DS18B20_RESOLUTION::DS18B20_RESOLUTION_11_BIT, _OWBus.getOWB());
+    // Known sensors get their stored calibration, new sensors read raw
+    // temperature until they are calibrated
+    const Ds18b20Config config(romCode, _OWBus.getCalibration(romCode), _OWBus.getResolution(sensorMsg.get_role()), _OWBus.getOWB(romCode));
 
     // TODO: Decide where this object should be created + use unique ptr
     std::shared_ptr<Ds18b20> sensor = std::make_shared<Ds18b20>(config);
@@ -141,24 +285,104 @@ PBRet SensorManager::_assignSensorCB(std::shared_ptr<PBMessageWrapper> msg)
         return PBRet::FAILURE;
     }
 
-    // Assign sensor to requested task
-    if (_OWBus.setTempSensor(sensorMsg.get_role(), sensor) != PBRet::SUCCESS) {
+    // Assign sensor to requested task. Index 0 is the primary sensor,
+    // higher indices are backups
+    const uint8_t index = static_cast<uint8_t>(std::min<uint32_t>(sensorMsg.get_index(), MaxSensorsPerRole));
+    if (_OWBus.setTempSensor(sensorMsg.get_role(), sensor, index) != PBRet::SUCCESS) {
         ESP_LOGW(SensorManager::Name, "Failed to assign sensor");
         return PBRet::FAILURE;
     }
 
     // TODO: Error handling here
-    _writeSensorConfigToFile();
+    _saveSensorConfig();
 
     ESP_LOGI(SensorManager::Name, "Successfully assigned sensor");
     return PBRet::SUCCESS;
 }
 
+PBRet SensorManager::_controllerTuningCB(std::shared_ptr<PBMessageWrapper> msg)
+{
+    // Adaptive temperature sensors need to know the controller setpoint.
+    // While a run is in progress the run phase sets it instead
+
+    ControllerTuning tuning {};
+    if (MessageServer::unwrap(*msg, tuning) != PBRet::SUCCESS) {
+        ESP_LOGW(SensorManager::Name, "Failed to decode ControllerTuning message");
+        return PBRet::FAILURE;
+    }
+
+    if (_runInProgress == false) {
+        _OWBus.setSetpoint(tuning.setpoint());
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet SensorManager::_runPhaseStateCB(std::shared_ptr<PBMessageWrapper> msg)
+{
+    // The setpoint the controller is using, through phase changes and
+    // setpoint ramps
+
+    RunPhaseState state {};
+    if (MessageServer::unwrap(*msg, state) != PBRet::SUCCESS) {
+        ESP_LOGW(SensorManager::Name, "Failed to decode RunPhaseState message");
+        return PBRet::FAILURE;
+    }
+
+    _runInProgress = state.running();
+    _OWBus.setSetpoint(state.setpoint());
+    return PBRet::SUCCESS;
+}
+
+PBRet SensorManager::_calibrationCB(std::shared_ptr<PBMessageWrapper> msg)
+{
+    // Step through a sensor calibration. Reference readings are collected
+    // with the sensor held at known temperatures, then the fit is applied
+    // to the sensor and saved
+
+    SensorCalibrationCommand cmd {};
+    if (MessageServer::unwrap(*msg, cmd) != PBRet::SUCCESS) {
+        ESP_LOGW(SensorManager::Name, "Failed to decode SensorCalibrationCommand");
+        return PBRet::FAILURE;
+    }
+
+    switch (cmd.get_cmdType())
+    {
+        case (CalibrationCmdType::CAL_ADD_POINT):
+        {
+            return _OWBus.addCalibrationPoint(cmd.get_role(), cmd.get_referenceTemp());
+        }
+        case (CalibrationCmdType::CAL_FIT):
+        {
+            if (_OWBus.fitCalibration(cmd.get_role(), cmd.get_order()) != PBRet::SUCCESS) {
+                return PBRet::FAILURE;
+            }
+            break;
+        }
+        case (CalibrationCmdType::CAL_CLEAR):
+        {
+            _OWBus.clearCalibration(cmd.get_role());
+            break;
+        }
+        default:
+        {
+            ESP_LOGW(SensorManager::Name, "Unsupported calibration command");
+            return PBRet::FAILURE;
+        }
+    }
+
+    _saveSensorConfig();
+    return _saveCalibrations();
+}
+
 PBRet SensorManager::_setupCBTable(void)
 {
     _cbTable = std::map<PBMessageType, queueCallback> {
         {PBMessageType::SensorManagerCommand, std::bind(&SensorManager::_commandMessageCB, this, std::placeholders::_1)},
-        {PBMessageType::AssignSensor, std::bind(&SensorManager::_assignSensorCB, this, std::placeholders::_1)}
+        {PBMessageType::AssignSensor, std::bind(&SensorManager::_assignSensorCB, this, std::placeholders::_1)},
+        {PBMessageType::ControllerTuning, std::bind(&SensorManager::_controllerTuningCB, this, std::placeholders::_1)},
+        {PBMessageType::RunPhaseState, std::bind(&SensorManager::_runPhaseStateCB, this, std::placeholders::_1)},
+        {PBMessageType::SensorCalibrationCommand, std::bind(&SensorManager::_calibrationCB, this, std::placeholders::_1)}
     };
 
     return PBRet::SUCCESS;
@@ -176,10 +400,30 @@ PBRet SensorManager::_initFromParams(const SensorManagerConfig& cfg)
         err += ESP_FAIL;
     }
 
+    // Load sensor calibrations. These must be in place before saved devices
+    // are restored
+    if (_loadCalibrations() != PBRet::SUCCESS) {
+        ESP_LOGI(SensorManager::Name, "No sensor calibrations were found");
+    }
+
     // Load saved devices
-    if (_loadKnownDevices(SensorManager::FSBasePath, SensorManager::FSPartitionLabel) != PBRet::SUCCESS) {
+    if (_loadKnownDevices() != PBRet::SUCCESS) {
         ESP_LOGW(SensorManager::Name, "No saved devices were found");
     }
+
+    // Setup rate groups
+    _flowRate = RateGroup(cfg.flowPeriod);
+    _broadcastRate = RateGroup(cfg.broadcastPeriod);
+    _tempDeadband = DeadbandFilter<5>(cfg.tempDeadband, cfg.maxPublishInterval);
+    _flowDeadband = DeadbandFilter<2>(cfg.flowDeadband, cfg.maxPublishInterval);
+
+    // Restore run totals from the last checkpoint
+    if (_runBalance.isConfigured() == false) {
+        ESP_LOGW(SensorManager::Name, "Run balance estimator was not configured");
+        err += ESP_FAIL;
+    } else if (_loadRunBalanceCheckpoint() != PBRet::SUCCESS) {
+        ESP_LOGI(SensorManager::Name, "No run balance checkpoint was found. Starting a new run");
+    }
     
     // Check flowrate sensors are configured
     if (_refluxFlowmeter.isConfigured() == false) {
@@ -191,6 +435,11 @@ PBRet SensorManager::_initFromParams(const SensorManagerConfig& cfg)
         ESP_LOGW(SensorManager::Name, "Product flowmeter was not configured");
         err += ESP_FAIL;
     }
+
+    if (_aligner.isConfigured() == false) {
+        ESP_LOGW(SensorManager::Name, "Frame aligner was not configured");
+        err += ESP_FAIL;
+    }
     
     return err == ESP_OK ? PBRet::SUCCESS : PBRet::FAILURE;
 }
@@ -230,6 +479,52 @@ PBRet SensorManager::_broadcastConcentrations(const ConcentrationData& concData)
     return MessageServer::broadcastMessage(wrapped);
 }
 
+PBRet SensorManager::_broadcastRunBalance(void) const
+{
+    // Send a RunBalance message to the queue
+    RunBalance balance {};
+    _runBalance.toMessage(balance);
+    PBMessageWrapper wrapped = MessageServer::wrap(balance, PBMessageType::RunBalance, _ID);
+
+    return MessageServer::broadcastMessage(wrapped);
+}
+
+PBRet SensorManager::_updateRunBalance(int64_t t, const CondenserReading& refluxCondenser, const CondenserReading& productCondenser)
+{
+    // Integrate the latest sample into the run totals. Totals are broadcast and
+    // checkpointed at a much lower rate than they are updated
+
+    // The flowmeters measure coolant, so distillate comes from the heat each
+    // condenser takes out. Reflux runs back down the column at the vapour
+    // temperature. Product leaves at about the coolant outlet temperature
+    const double ABV = _concData.get_vapourConcentration();
+    const double headTemp = _Tdata.get_headTemp();
+    double refluxFlowrate = 0.0;
+    double productFlowrate = 0.0;
+    if ((RunBalanceEstimator::condensateFlowrate(refluxCondenser, ABV, headTemp, headTemp, refluxFlowrate) != PBRet::SUCCESS) ||
+        (RunBalanceEstimator::condensateFlowrate(productCondenser, ABV, headTemp, productCondenser.outletTemp, productFlowrate) != PBRet::SUCCESS)) {
+        return PBRet::FAILURE;
+    }
+
+    if (_runBalance.update(t, refluxFlowrate, productFlowrate, ABV) != PBRet::SUCCESS) {
+        return PBRet::FAILURE;
+    }
+
+    if ((t - _lastBalancePublishTime) * 1e-6 >= _cfg.runBalanceConfig.publishPeriod) {
+        _broadcastRunBalance();
+        _lastBalancePublishTime = t;
+    }
+
+    if ((t - _lastBalanceCheckpointTime) * 1e-6 >= _cfg.runBalanceConfig.checkpointPeriod) {
+        if (_writeRunBalanceCheckpoint() != PBRet::SUCCESS) {
+            ESP_LOGW(SensorManager::Name, "Failed to checkpoint run balance");
+        }
+        _lastBalanceCheckpointTime = t;
+    }
+
+    return PBRet::SUCCESS;
+}
+
 PBRet SensorManager::checkInputs(const SensorManagerConfig& cfg)
 {
     if (cfg.dt <= 0) {
@@ -237,6 +532,26 @@ PBRet SensorManager::checkInputs(const SensorManagerConfig& cfg)
         return PBRet::FAILURE;
     }
 
+    if (cfg.flowPeriod < cfg.dt) {
+        ESP_LOGE(SensorManager::Name, "Flow period %lf must be at least dt. SensorManager was not configured", cfg.flowPeriod);
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.broadcastPeriod < cfg.dt) {
+        ESP_LOGE(SensorManager::Name, "Broadcast period %lf must be at least dt. SensorManager was not configured", cfg.broadcastPeriod);
+        return PBRet::FAILURE;
+    }
+
+    if ((cfg.tempDeadband < 0) || (cfg.flowDeadband < 0)) {
+        ESP_LOGE(SensorManager::Name, "Publish deadbands must not be negative. SensorManager was not configured");
+        return PBRet::FAILURE;
+    }
+
+    if (cfg.maxPublishInterval <= 0) {
+        ESP_LOGE(SensorManager::Name, "Max publish interval %lf is invalid. SensorManager was not configured", cfg.maxPublishInterval);
+        return PBRet::FAILURE;
+    }
+
     // Check PBOneWire config
     if (PBOneWire::checkInputs(cfg.oneWireConfig) != PBRet::SUCCESS) {
         ESP_LOGE(SensorManager::Name, "Onewire bus config was invalid. SensorManager was not configured");
@@ -259,40 +574,51 @@ PBRet SensorManager::checkInputs(const SensorManagerConfig& cfg)
         }
     }
 
-    return PBRet::SUCCESS;
-}
+    // Check run balance config
+    if (RunBalanceEstimator::checkInputs(cfg.runBalanceConfig) != PBRet::SUCCESS) {
+        ESP_LOGE(SensorManager::Name, "Run balance config was invalid. SensorManager was not configured");
+        return PBRet::FAILURE;
+    }
 
-PBRet SensorManager::_loadKnownDevices(const char* basePath, const char* partitionLabel)
-{
-    // Nullptr check
-    if ((basePath == nullptr) || (partitionLabel == nullptr)) {
-        ESP_LOGW(SensorManager::Name, "Cannot load known devices. One or more input pointers were null");
+    // Check frame aligner config
+    if (FrameAligner::checkInputs(cfg.frameAlignerConfig) != PBRet::SUCCESS) {
+        ESP_LOGE(SensorManager::Name, "Frame aligner config was invalid. SensorManager was not configured");
         return PBRet::FAILURE;
     }
 
-    // Mount filesystem
-    Filesystem F(SensorManager::FSBasePath, SensorManager::FSPartitionLabel, 5, true);
+    return PBRet::SUCCESS;
+}
 
-    // Read serialized config from file
-    std::ifstream configIn(SensorManager::assignedSensorFile, std::ios::binary);
-    if (configIn.good() == false) {
-        ESP_LOGW(SensorManager::Name, "Devices file could not be opened");
+PBRet SensorManager::_loadKnownDevices(void)
+{
+    // Restore assigned sensors from the settings store
+
+    std::vector<uint8_t> bytes {};
+    if (SettingsStore::get(SensorManager::assignedSensorKey, bytes) != PBRet::SUCCESS) {
+        ESP_LOGW(SensorManager::Name, "No saved sensors were found");
         return PBRet::FAILURE;
     }
 
-    std::vector<uint8_t> bytes(
-         (std::istreambuf_iterator<char>(configIn)),
-         (std::istreambuf_iterator<char>()));
-
     Readable buffer {};
     for (uint8_t byte : bytes)
     {
         buffer.push(byte);
     }
 
+    // Read the bus each sensor was wired to. Sensors are searched for on 
+    // all buses if this is missing
+    std::string busStr {};
+    if (SettingsStore::getString(SensorManager::sensorBusKey, busStr) == PBRet::SUCCESS) {
+        cJSON* busRoot = cJSON_Parse(busStr.c_str());
+        if (_OWBus.deserializeBusMap(busRoot) != PBRet::SUCCESS) {
+            ESP_LOGW(SensorManager::Name, "Failed to read saved sensor buses");
+        }
+        cJSON_Delete(busRoot);
+    }
+
     if (_OWBus.deserialize(buffer) != PBRet::SUCCESS)
     {
-        ESP_LOGW(SensorManager::Name, "Failed to read saved sensors from file");
+        ESP_LOGW(SensorManager::Name, "Failed to read saved sensors");
         return PBRet::FAILURE;
     }
 
@@ -316,6 +642,51 @@ PBRet SensorManager::loadFromJSON(SensorManagerConfig& cfg, const cJSON* cfgRoot
         return PBRet::FAILURE;
     }
 
+    // Get flowmeter update period
+    cJSON* flowPeriodNode = cJSON_GetObjectItem(cfgRoot, "flowPeriod");
+    if (cJSON_IsNumber(flowPeriodNode)) {
+        cfg.flowPeriod = flowPeriodNode->valuedouble;
+    } else {
+        ESP_LOGI(SensorManager::Name, "Unable to read SensorManager flow period from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get broadcast period
+    cJSON* broadcastPeriodNode = cJSON_GetObjectItem(cfgRoot, "broadcastPeriod");
+    if (cJSON_IsNumber(broadcastPeriodNode)) {
+        cfg.broadcastPeriod = broadcastPeriodNode->valuedouble;
+    } else {
+        ESP_LOGI(SensorManager::Name, "Unable to read SensorManager broadcast period from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get temperature publish deadband
+    cJSON* tempDeadbandNode = cJSON_GetObjectItem(cfgRoot, "tempDeadband");
+    if (cJSON_IsNumber(tempDeadbandNode)) {
+        cfg.tempDeadband = tempDeadbandNode->valuedouble;
+    } else {
+        ESP_LOGI(SensorManager::Name, "Unable to read SensorManager temperature deadband from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get flowrate publish deadband
+    cJSON* flowDeadbandNode = cJSON_GetObjectItem(cfgRoot, "flowDeadband");
+    if (cJSON_IsNumber(flowDeadbandNode)) {
+        cfg.flowDeadband = flowDeadbandNode->valuedouble;
+    } else {
+        ESP_LOGI(SensorManager::Name, "Unable to read SensorManager flowrate deadband from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get max publish interval
+    cJSON* maxPublishNode = cJSON_GetObjectItem(cfgRoot, "maxPublishInterval");
+    if (cJSON_IsNumber(maxPublishNode)) {
+        cfg.maxPublishInterval = maxPublishNode->valuedouble;
+    } else {
+        ESP_LOGI(SensorManager::Name, "Unable to read SensorManager max publish interval from JSON");
+        return PBRet::FAILURE;
+    }
+
     // Get OneWireBus configuration
     cJSON* OWBNode = cJSON_GetObjectItem(cfgRoot, "oneWireConfig");
     if (PBOneWire::loadFromJSON(cfg.oneWireConfig, OWBNode) != PBRet::SUCCESS) {
@@ -337,38 +708,130 @@ PBRet SensorManager::loadFromJSON(SensorManagerConfig& cfg, const cJSON* cfgRoot
         return PBRet::FAILURE;
     }
 
+    // Get run balance configuration
+    cJSON* runBalanceNode = cJSON_GetObjectItem(cfgRoot, "runBalanceConfig");
+    if (RunBalanceEstimator::loadFromJSON(cfg.runBalanceConfig, runBalanceNode) != PBRet::SUCCESS) {
+        ESP_LOGI(SensorManager::Name, "Unable to read run balance config from JSON");
+        return PBRet::FAILURE;
+    }
+
+    // Get frame aligner configuration
+    cJSON* frameAlignerNode = cJSON_GetObjectItem(cfgRoot, "frameAlignerConfig");
+    if (FrameAligner::loadFromJSON(cfg.frameAlignerConfig, frameAlignerNode) != PBRet::SUCCESS) {
+        ESP_LOGI(SensorManager::Name, "Unable to read frame aligner config from JSON");
+        return PBRet::FAILURE;
+    }
+
     return PBRet::SUCCESS;
 }
 
-PBRet SensorManager::_writeSensorConfigToFile(void) const
+PBRet SensorManager::_saveSensorConfig(void) const
 {
-    // Write the current sensor configuration to JSON
-    ESP_LOGI(SensorManager::Name, "Writing sensor configuration data to file");
+    // Save the current sensor configuration. The settings store writes it
+    // to flash from its own task
+    ESP_LOGI(SensorManager::Name, "Saving sensor configuration");
 
     Writable buffer {};
     if (_OWBus.serialize(buffer) != PBRet::SUCCESS) {
-        ESP_LOGW(SensorManager::Name, "Failed to write sensor config to file");
+        ESP_LOGW(SensorManager::Name, "Failed to serialize sensor config");
         return PBRet::FAILURE;
     }
-    
-    // Mount filesystem
-    Filesystem F(SensorManager::FSBasePath, SensorManager::FSPartitionLabel, 5, true);
-    if (F.isOpen() == false) {
-        ESP_LOGW(SensorManager::Name, "Failed to mount filesystem. Sensor data was not written to file");
+
+    const uint8_t* bytes = buffer.get_buffer();
+    if (SettingsStore::put(SensorManager::assignedSensorKey, std::vector<uint8_t>(bytes, bytes + buffer.get_size())) != PBRet::SUCCESS) {
+        ESP_LOGW(SensorManager::Name, "Sensor configuration was not saved");
+        return PBRet::FAILURE;
+    }
+
+    // Save the bus each sensor is wired to
+    cJSON* busRoot = cJSON_CreateObject();
+    if (_OWBus.serializeBusMap(busRoot) == PBRet::SUCCESS) {
+        char* busStr = cJSON_PrintUnformatted(busRoot);
+        if (SettingsStore::putString(SensorManager::sensorBusKey, busStr) != PBRet::SUCCESS) {
+            ESP_LOGW(SensorManager::Name, "Sensor buses were not saved");
+        }
+        cJSON_free(busStr);
+    }
+    cJSON_Delete(busRoot);
+
+    return PBRet::SUCCESS;
+}
+
+PBRet SensorManager::_writeRunBalanceCheckpoint(void) const
+{
+    // Checkpoint the current run totals so a reboot mid run doesn't lose
+    // them
+
+    RunBalance balance {};
+    _runBalance.toMessage(balance);
+    if (SettingsStore::putMessage(SensorManager::runBalanceKey, balance) != PBRet::SUCCESS) {
+        ESP_LOGW(SensorManager::Name, "Run balance was not saved");
         return PBRet::FAILURE;
     }
 
-    std::ofstream outFile(SensorManager::assignedSensorFile, std::ios::out | std::ios::binary);
-    if (outFile.is_open() == false) {
-        ESP_LOGE(SensorManager::Name, "Failed to open file for writing. Sensor data was not written to file");
+    return PBRet::SUCCESS;
+}
+
+PBRet SensorManager::_loadCalibrations(void)
+{
+    // Read the calibration store into RAM. Sensors are calibrated from this
+    // copy so the read path never touches flash
+
+    std::string calStr {};
+    if (SettingsStore::getString(SensorManager::calibrationKey, calStr) != PBRet::SUCCESS) {
+        return PBRet::FAILURE;
+    }
+
+    CalibrationStore store {};
+    cJSON* root = cJSON_Parse(calStr.c_str());
+    const PBRet ret = store.deserialize(root);
+    cJSON_Delete(root);
+    if (ret != PBRet::SUCCESS) {
+        ESP_LOGW(SensorManager::Name, "Saved calibrations were invalid");
+        return PBRet::FAILURE;
+    }
+
+    ESP_LOGI(SensorManager::Name, "Loaded calibrations for %d sensors", store.size());
+    _OWBus.setCalibrationStore(store);
+    return PBRet::SUCCESS;
+}
+
+PBRet SensorManager::_saveCalibrations(void) const
+{
+    cJSON* root = cJSON_CreateObject();
+    if (_OWBus.getCalibrationStore().serialize(root) != PBRet::SUCCESS) {
+        ESP_LOGW(SensorManager::Name, "Failed to serialize calibrations");
+        cJSON_Delete(root);
+        return PBRet::FAILURE;
+    }
+
+    char* calStr = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    const PBRet ret = SettingsStore::putString(SensorManager::calibrationKey, calStr);
+    cJSON_free(calStr);
+    if (ret != PBRet::SUCCESS) {
+        ESP_LOGW(SensorManager::Name, "Calibrations were not saved");
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet SensorManager::_loadRunBalanceCheckpoint(void)
+{
+    // Restore run totals from the last checkpoint
+
+    RunBalance balance {};
+    if (SettingsStore::getMessage(SensorManager::runBalanceKey, balance) != PBRet::SUCCESS) {
+        ESP_LOGW(SensorManager::Name, "No run balance checkpoint was saved");
         return PBRet::FAILURE;
     }
 
-    // Write serialized to file
-    // TODO: C++ casting
-    outFile.write((const char*) buffer.get_buffer(), buffer.get_size());
+    if (_runBalance.restore(balance) != PBRet::SUCCESS) {
+        return PBRet::FAILURE;
+    }
 
-    ESP_LOGI(SensorManager::Name, "Sensor configuration data successfully written to file");
+    ESP_LOGI(SensorManager::Name, "Restored run balance: %.3f L collected", _runBalance.getProductVolume());
     return PBRet::SUCCESS;
 }
 
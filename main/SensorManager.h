@@ -7,6 +7,9 @@
 #include "CppTask.h"
 #include "OneWireBus.h"
 #include "Flowmeter.h"
+#include "RunBalance.h"
+#include "RateGroup.h"
+#include "SensorFrame.h"
 
 // Forward declarations
 class PBOneWire;
@@ -14,18 +17,26 @@ using PBAssignedSensorRegistry = AssignedSensorRegistry<ROM_SIZE, ROM_SIZE, ROM_
 using PBFieldBytes = ::EmbeddedProto::FieldBytes<ROM_SIZE>;
 struct SensorManagerConfig
 {
-    double dt = 0.0;
+    double dt = 0.0;                    // Base task rate [s]
+    double flowPeriod = 0.0;            // Flowmeter measurement window [s]
+    double broadcastPeriod = 0.0;       // ABV estimation and broadcast rate [s]
+    double tempDeadband = 0.0;          // Change in any temperature that triggers a publish [deg C]
+    double flowDeadband = 0.0;          // Change in any flowrate that triggers a publish [L / s]
+    double maxPublishInterval = 0.0;    // Signals are republished at least this often [s]
     PBOneWireConfig oneWireConfig{};
     FlowmeterConfig refluxFlowConfig{};
     FlowmeterConfig productFlowConfig{};
+    RunBalanceConfig runBalanceConfig{};
+    FrameAlignerConfig frameAlignerConfig{};
 };
 
 class SensorManager : public Task
 {
     static constexpr const char *Name = "SensorManager";
-    static constexpr const char *FSBasePath = "/spiffs";
-    static constexpr const char *FSPartitionLabel = "PBData";
-    static constexpr const char *assignedSensorFile = "/spiffs/assignedSensors";
+    static constexpr const char *assignedSensorKey = "sensors";
+    static constexpr const char *runBalanceKey = "runBalance";
+    static constexpr const char *sensorBusKey = "sensorBuses";
+    static constexpr const char *calibrationKey = "calibrations";
 
 public:
     // Constructors
@@ -48,18 +59,28 @@ private:
     PBRet _initOneWireBus(const SensorManagerConfig &cfg);
     PBRet _initFromParams(const SensorManagerConfig &cfg);
     PBRet _setupCBTable(void) override;
-    PBRet _loadKnownDevices(const char *basePath, const char *partitionLabel);
+    PBRet _loadKnownDevices(void);
+    PBRet _loadCalibrations(void);
 
     // Updates
+    PBRet _updateTemperatures(int64_t t);
+    PBRet _updateFlowrates(int64_t t);
+    PBRet _updateConcentrations(void);
+    PBRet _publishFrame(int64_t t, bool publishFlows);
     PBRet _readFlowmeters(const FlowrateData &F) const;
     PBRet _estimateABV(const TemperatureData &TData, ConcentrationData& concData) const;
     PBRet _broadcastTemps(const TemperatureData &Tdata) const;
     PBRet _broadcastFlowrates(const FlowrateData &flowrateData) const;
     PBRet _broadcastConcentrations(const ConcentrationData& concData) const;
+    PBRet _updateRunBalance(int64_t t, const CondenserReading &refluxCondenser, const CondenserReading &productCondenser);
+    PBRet _broadcastRunBalance(void) const;
 
     // Utilities
-    PBRet _writeSensorConfigToFile(void) const;
+    PBRet _saveSensorConfig(void) const;
     PBRet _broadcastSensors(void);
+    PBRet _writeRunBalanceCheckpoint(void) const;
+    PBRet _loadRunBalanceCheckpoint(void);
+    PBRet _saveCalibrations(void) const;
 
     // FreeRTOS hook method
     void taskMain(void) override;
@@ -67,6 +88,9 @@ private:
     // Queue callbacks
     PBRet _commandMessageCB(std::shared_ptr<PBMessageWrapper> msg);
     PBRet _assignSensorCB(std::shared_ptr<PBMessageWrapper> msg);
+    PBRet _controllerTuningCB(std::shared_ptr<PBMessageWrapper> msg);
+    PBRet _runPhaseStateCB(std::shared_ptr<PBMessageWrapper> msg);
+    PBRet _calibrationCB(std::shared_ptr<PBMessageWrapper> msg);
 
     // SensorManager data
     SensorManagerConfig _cfg{};
@@ -76,7 +100,30 @@ private:
     Flowmeter _refluxFlowmeter{};
     Flowmeter _productFlowmeter{};
 
+    // Latest readings, as acquired
+    TemperatureData _latestTdata{};
+    FlowrateData _latestFlowData{};
+
+    // Readings aligned to a common tick, as published
+    FrameAligner _aligner{};
+    SensorFrame _frame{};
+    TemperatureData _Tdata{};
+    FlowrateData _flowData{};
+    ConcentrationData _concData{};
+
+    // Scheduling
+    RateGroup _flowRate{};
+    RateGroup _broadcastRate{};
+    DeadbandFilter<5> _tempDeadband{};
+    DeadbandFilter<2> _flowDeadband{};
+
+    // Run totals
+    RunBalanceEstimator _runBalance{};
+    int64_t _lastBalancePublishTime = 0;        // [us]
+    int64_t _lastBalanceCheckpointTime = 0;     // [us]
+
     // Class data
+    bool _runInProgress = false;                // Run phase owns the setpoint
     bool _configured = false;
 };
 
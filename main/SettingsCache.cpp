@@ -0,0 +1,118 @@
+#include "SettingsCache.h"
+
+PBRet SettingsCache::put(const std::string& key, const std::vector<uint8_t>& value, int64_t t)
+{
+    if (key.empty() || (key.size() > SettingsCache::MaxKeyLength)) {
+        ESP_LOGW(SettingsCache::Name, "Key '%s' must be 1 to %d characters", key.c_str(), SettingsCache::MaxKeyLength);
+        return PBRet::FAILURE;
+    }
+
+    auto it = _values.find(key);
+    if ((it != _values.end()) && (it->second == value)) {
+        return PBRet::SUCCESS;
+    }
+
+    _values[key] = value;
+
+    // Keep the time of the first unsaved change, so a value that changes
+    // constantly is still written every writeDelay
+    _dirtySince.emplace(key, t);
+
+    return PBRet::SUCCESS;
+}
+
+PBRet SettingsCache::get(const std::string& key, std::vector<uint8_t>& value) const
+{
+    auto it = _values.find(key);
+    if (it == _values.end()) {
+        return PBRet::FAILURE;
+    }
+
+    value = it->second;
+    return PBRet::SUCCESS;
+}
+
+PBRet SettingsCache::restore(const SettingsRecord& record)
+{
+    std::vector<uint8_t> value {};
+    if (decode(record, value) != PBRet::SUCCESS) {
+        ESP_LOGW(SettingsCache::Name, "Setting '%s' failed its CRC check and was dropped", record.key.c_str());
+        return PBRet::FAILURE;
+    }
+
+    _values[record.key] = std::move(value);
+    return PBRet::SUCCESS;
+}
+
+std::vector<SettingsRecord> SettingsCache::takeDue(int64_t t, bool force)
+{
+    std::vector<SettingsRecord> records {};
+    for (auto it = _dirtySince.begin(); it != _dirtySince.end();) {
+        if (force || ((t - it->second) * 1e-6 >= _writeDelay)) {
+            records.push_back(encode(it->first, _values.at(it->first)));
+            it = _dirtySince.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    return records;
+}
+
+void SettingsCache::retry(const SettingsRecord& record, int64_t t)
+{
+    // A put since the record was taken is newer and already dirty
+    _dirtySince.emplace(record.key, t);
+}
+
+SettingsRecord SettingsCache::encode(const std::string& key, const std::vector<uint8_t>& value)
+{
+    SettingsRecord record {key, value};
+
+    // The key is covered too, so a value can't be read back under the
+    // wrong name
+    uint32_t crc = crc32(0, reinterpret_cast<const uint8_t*>(key.data()), key.size());
+    crc = crc32(crc, value.data(), value.size());
+    for (size_t i = 0; i < SettingsCache::CRCSize; i++) {
+        record.data.push_back(static_cast<uint8_t>(crc >> (8 * i)));
+    }
+
+    return record;
+}
+
+PBRet SettingsCache::decode(const SettingsRecord& record, std::vector<uint8_t>& value)
+{
+    if (record.data.size() < SettingsCache::CRCSize) {
+        return PBRet::FAILURE;
+    }
+
+    const size_t size = record.data.size() - SettingsCache::CRCSize;
+    uint32_t stored = 0;
+    for (size_t i = 0; i < SettingsCache::CRCSize; i++) {
+        stored |= static_cast<uint32_t>(record.data[size + i]) << (8 * i);
+    }
+
+    uint32_t crc = crc32(0, reinterpret_cast<const uint8_t*>(record.key.data()), record.key.size());
+    crc = crc32(crc, record.data.data(), size);
+    if (crc != stored) {
+        return PBRet::FAILURE;
+    }
+
+    value.assign(record.data.begin(), record.data.begin() + size);
+    return PBRet::SUCCESS;
+}
+
+uint32_t SettingsCache::crc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+    // CRC-32 (IEEE 802.3), bitwise. Settings are small and rarely written,
+    // so a table isn't worth the RAM
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+
+    return ~crc;
+}
@@ -0,0 +1,60 @@
+#ifndef MAIN_SETTINGS_CACHE_H
+#define MAIN_SETTINGS_CACHE_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "PBCommon.h"
+
+// Flash record for one setting. Data is the value followed by the CRC32 of
+// the key and value, so a corrupted record is rejected rather than applied
+struct SettingsRecord
+{
+    std::string key {};
+    std::vector<uint8_t> data {};
+};
+
+// RAM copy of every setting and which of them still need writing to flash.
+// Values are loaded once at boot, gets never touch flash, and a put only
+// marks the value dirty. A dirty value is due writeDelay after its first
+// unsaved change, so a burst of changes to a setting costs one write
+class SettingsCache
+{
+    static constexpr const char* Name = "SettingsCache";
+
+    public:
+        static constexpr size_t MaxKeyLength = 15;          // NVS key limit
+        static constexpr size_t CRCSize = sizeof(uint32_t);
+
+        SettingsCache(void) = default;
+        explicit SettingsCache(double writeDelay) : _writeDelay(writeDelay) {}
+
+        // Values. Putting an unchanged value doesn't dirty it
+        PBRet put(const std::string& key, const std::vector<uint8_t>& value, int64_t t);
+        PBRet get(const std::string& key, std::vector<uint8_t>& value) const;
+        bool contains(const std::string& key) const { return _values.count(key) > 0; }
+        size_t size(void) const { return _values.size(); }
+
+        // Load a record read from flash. Fails without changing the cache
+        // if the CRC doesn't match
+        PBRet restore(const SettingsRecord& record);
+
+        // Records for every value that is due to be written. They are
+        // clean once taken. Anything that fails to write is handed back
+        // with retry. All dirty values are due if force is set
+        std::vector<SettingsRecord> takeDue(int64_t t, bool force);
+        void retry(const SettingsRecord& record, int64_t t);
+        bool isDirty(void) const { return _dirtySince.empty() == false; }
+
+        static SettingsRecord encode(const std::string& key, const std::vector<uint8_t>& value);
+        static PBRet decode(const SettingsRecord& record, std::vector<uint8_t>& value);
+        static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size);
+
+    private:
+        double _writeDelay = 0.0;                           // [s]
+        std::map<std::string, std::vector<uint8_t>> _values {};
+        std::map<std::string, int64_t> _dirtySince {};      // First unsaved change [us]
+};
+
+#endif // MAIN_SETTINGS_CACHE_H
@@ -0,0 +1,297 @@
+#include "SettingsStore.h"
+#include "nvs_flash.h"
+#include "esp_timer.h"
+#include <algorithm>
+#include <cstring>
+#include "IO/Writable.h"
+#include "IO/Readable.h"
+
+SettingsCache SettingsStore::_cache {};
+SemaphoreHandle_t SettingsStore::_lock = nullptr;
+TaskHandle_t SettingsStore::_writer = nullptr;
+
+SettingsStore::SettingsStore(UBaseType_t priority, UBaseType_t stackDepth, BaseType_t coreID, const SettingsStoreConfig& cfg)
+    : Task(SettingsStore::Name, priority, stackDepth, coreID)
+{
+    // Setup callback table
+    _setupCBTable();
+
+    // Initialize settings store
+    if (_initFromParams(cfg) == PBRet::SUCCESS) {
+        ESP_LOGI(SettingsStore::Name, "Settings store configured!");
+        _configured = true;
+    } else {
+        ESP_LOGW(SettingsStore::Name, "Unable to configure settings store");
+    }
+}
+
+SettingsStore::~SettingsStore(void)
+{
+    if (_handle != 0) {
+        nvs_close(_handle);
+    }
+}
+
+PBRet SettingsStore::_initFromParams(const SettingsStoreConfig& cfg)
+{
+    if (checkInputs(cfg) != PBRet::SUCCESS) {
+        return PBRet::FAILURE;
+    }
+
+    if (_lock == nullptr) {
+        _lock = xSemaphoreCreateMutex();
+        if (_lock == nullptr) {
+            ESP_LOGE(SettingsStore::Name, "Failed to create mutex");
+            return PBRet::FAILURE;
+        }
+    }
+
+    if (_openPartition() != PBRet::SUCCESS) {
+        return PBRet::FAILURE;
+    }
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _cache = SettingsCache(cfg.writeDelay);
+    const PBRet ret = _load();
+    xSemaphoreGive(_lock);
+
+    return ret;
+}
+
+PBRet SettingsStore::_setupCBTable(void)
+{
+    // No messages are handled
+    return PBRet::SUCCESS;
+}
+
+void SettingsStore::taskMain(void)
+{
+    _writer = xTaskGetCurrentTaskHandle();
+
+    // Wake periodically for due settings, or straight away on a flush
+    const TickType_t period = std::max<TickType_t>(SettingsStore::WritebackPeriod * 1000 / portTICK_PERIOD_MS, 1);
+    while (true) {
+        const bool force = ulTaskNotifyTake(pdTRUE, period) > 0;
+        _writeBack(force);
+    }
+}
+
+PBRet SettingsStore::_openPartition(void)
+{
+    // A partition that is full or from a newer NVS version is erased, as
+    // for the default partition. Settings fall back to their defaults
+    esp_err_t err = nvs_flash_init_partition(SettingsStore::PartitionLabel);
+    if ((err == ESP_ERR_NVS_NO_FREE_PAGES) || (err == ESP_ERR_NVS_NEW_VERSION_FOUND)) {
+        ESP_LOGW(SettingsStore::Name, "Settings partition was unreadable and has been erased");
+        nvs_flash_erase_partition(SettingsStore::PartitionLabel);
+        err = nvs_flash_init_partition(SettingsStore::PartitionLabel);
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(SettingsStore::Name, "Failed to initialize settings partition (%s)", esp_err_to_name(err));
+        return PBRet::FAILURE;
+    }
+
+    err = nvs_open_from_partition(SettingsStore::PartitionLabel, SettingsStore::Namespace, NVS_READWRITE, &_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(SettingsStore::Name, "Failed to open settings namespace (%s)", esp_err_to_name(err));
+        _handle = 0;
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet SettingsStore::_load(void)
+{
+    // One pass over the namespace, reading each record straight into the
+    // cache. Records that fail their CRC are left out, so their settings
+    // start from defaults
+    const int64_t start = esp_timer_get_time();
+    size_t loaded = 0;
+    size_t dropped = 0;
+
+    nvs_iterator_t it = nvs_entry_find(SettingsStore::PartitionLabel, SettingsStore::Namespace, NVS_TYPE_BLOB);
+    while (it != nullptr) {
+        nvs_entry_info_t info {};
+        nvs_entry_info(it, &info);
+
+        SettingsRecord record {info.key, {}};
+        size_t size = 0;
+        if (nvs_get_blob(_handle, info.key, nullptr, &size) == ESP_OK) {
+            record.data.resize(size);
+            if ((nvs_get_blob(_handle, info.key, record.data.data(), &size) == ESP_OK) && (_cache.restore(record) == PBRet::SUCCESS)) {
+                loaded++;
+            } else {
+                dropped++;
+            }
+        }
+
+        it = nvs_entry_next(it);
+    }
+
+    ESP_LOGI(SettingsStore::Name, "Loaded %d settings in %.1f ms (%d dropped)", loaded, (esp_timer_get_time() - start) * 1e-3, dropped);
+    return PBRet::SUCCESS;
+}
+
+PBRet SettingsStore::_writeBack(bool force)
+{
+    const int64_t t = esp_timer_get_time();
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    const std::vector<SettingsRecord> records = _cache.takeDue(t, force);
+    xSemaphoreGive(_lock);
+
+    if (records.empty()) {
+        return PBRet::SUCCESS;
+    }
+
+    // NVS replaces each entry atomically. The old record is only erased
+    // once the new one is complete, so a reset leaves one or the other
+    std::vector<const SettingsRecord*> failed {};
+    for (const SettingsRecord& record : records) {
+        if (nvs_set_blob(_handle, record.key.c_str(), record.data.data(), record.data.size()) != ESP_OK) {
+            failed.push_back(&record);
+        }
+    }
+
+    if (nvs_commit(_handle) != ESP_OK) {
+        failed.clear();
+        for (const SettingsRecord& record : records) {
+            failed.push_back(&record);
+        }
+    }
+
+    if (failed.empty() == false) {
+        ESP_LOGW(SettingsStore::Name, "Failed to write %d settings. Retrying later", failed.size());
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        for (const SettingsRecord* record : failed) {
+            _cache.retry(*record, t);
+        }
+        xSemaphoreGive(_lock);
+        return PBRet::FAILURE;
+    }
+
+    ESP_LOGI(SettingsStore::Name, "Wrote %d settings in %.1f ms", records.size(), (esp_timer_get_time() - t) * 1e-3);
+    return PBRet::SUCCESS;
+}
+
+PBRet SettingsStore::put(const char* key, const std::vector<uint8_t>& value)
+{
+    if (_lock == nullptr) {
+        ESP_LOGW(SettingsStore::Name, "Settings store is not running. %s was not saved", key);
+        return PBRet::FAILURE;
+    }
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    const PBRet ret = _cache.put(key, value, esp_timer_get_time());
+    xSemaphoreGive(_lock);
+
+    return ret;
+}
+
+PBRet SettingsStore::get(const char* key, std::vector<uint8_t>& value)
+{
+    if (_lock == nullptr) {
+        ESP_LOGW(SettingsStore::Name, "Settings store is not running. %s was not read", key);
+        return PBRet::FAILURE;
+    }
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    const PBRet ret = _cache.get(key, value);
+    xSemaphoreGive(_lock);
+
+    return ret;
+}
+
+PBRet SettingsStore::putMessage(const char* key, const ::EmbeddedProto::MessageInterface& msg)
+{
+    Writable buffer {};
+    ::EmbeddedProto::Error err = msg.serialize(buffer);
+    if (err != ::EmbeddedProto::Error::NO_ERRORS) {
+        ESP_LOGW(SettingsStore::Name, "Failed to serialize %s (err: %d)", key, static_cast<int>(err));
+        return PBRet::FAILURE;
+    }
+
+    const uint8_t* bytes = buffer.get_buffer();
+    return put(key, std::vector<uint8_t>(bytes, bytes + buffer.get_size()));
+}
+
+PBRet SettingsStore::getMessage(const char* key, ::EmbeddedProto::MessageInterface& msg)
+{
+    std::vector<uint8_t> value {};
+    if (get(key, value) != PBRet::SUCCESS) {
+        return PBRet::FAILURE;
+    }
+
+    Readable buffer {};
+    for (uint8_t byte : value) {
+        buffer.push(byte);
+    }
+
+    ::EmbeddedProto::Error err = msg.deserialize(buffer);
+    if (err != ::EmbeddedProto::Error::NO_ERRORS) {
+        ESP_LOGW(SettingsStore::Name, "Failed to deserialize %s (err: %d)", key, static_cast<int>(err));
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet SettingsStore::putString(const char* key, const char* str)
+{
+    if (str == nullptr) {
+        return PBRet::FAILURE;
+    }
+
+    return put(key, std::vector<uint8_t>(str, str + strlen(str)));
+}
+
+PBRet SettingsStore::getString(const char* key, std::string& str)
+{
+    std::vector<uint8_t> value {};
+    if (get(key, value) != PBRet::SUCCESS) {
+        return PBRet::FAILURE;
+    }
+
+    str.assign(value.begin(), value.end());
+    return PBRet::SUCCESS;
+}
+
+void SettingsStore::flush(void)
+{
+    if (_writer != nullptr) {
+        xTaskNotifyGive(_writer);
+    }
+}
+
+PBRet SettingsStore::checkInputs(const SettingsStoreConfig& cfg)
+{
+    // Check write delay is within bounds
+    if ((cfg.writeDelay < 0.0) || (cfg.writeDelay > SettingsStoreConfig::MAX_WRITE_DELAY)) {
+        ESP_LOGE(SettingsStore::Name, "Write delay (%.2f) was outside of the allowable bounds (0.0, %.2f)", cfg.writeDelay, SettingsStoreConfig::MAX_WRITE_DELAY);
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+PBRet SettingsStore::loadFromJSON(SettingsStoreConfig& cfg, const cJSON* cfgRoot)
+{
+    // Load SettingsStoreConfig struct from JSON
+
+    if (cfgRoot == nullptr) {
+        ESP_LOGW(SettingsStore::Name, "cfgRoot was null");
+        return PBRet::FAILURE;
+    }
+
+    // Get write delay
+    cJSON* writeDelayNode = cJSON_GetObjectItem(cfgRoot, "writeDelay");
+    if (cJSON_IsNumber(writeDelayNode)) {
+        cfg.writeDelay = writeDelayNode->valuedouble;
+    } else {
+        ESP_LOGI(SettingsStore::Name, "Unable to read write delay from JSON");
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
@@ -0,0 +1,74 @@
+#ifndef MAIN_SETTINGS_STORE_H
+#define MAIN_SETTINGS_STORE_H
+
+#include "PBCommon.h"
+#include "CppTask.h"
+#include "SettingsCache.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+#include "cJSON.h"
+
+struct SettingsStoreConfig
+{
+    double writeDelay = 0.0;            // Time from a setting changing to it being written to flash [s]
+
+    static constexpr double MAX_WRITE_DELAY = 600.0;
+};
+
+// Key value store for settings changed at run time (controller tuning,
+// assigned sensors, calibrations, run totals). Settings live in their own
+// NVS partition, which writes each entry atomically and spreads writes
+// across its pages. Every value also carries a CRC32, checked at load.
+//
+// The whole namespace is read into RAM in one pass when the store is
+// constructed, so it must be constructed before the tasks that read it.
+// After that, gets and puts only touch RAM and are safe from any task.
+// Changed values are written back by this task, which runs at low priority
+// so flash writes never hold up control or sensing
+class SettingsStore : public Task
+{
+    static constexpr const char* Name = "SettingsStore";
+    static constexpr const char* PartitionLabel = "settings";
+    static constexpr const char* Namespace = "pissbot";
+    static constexpr double WritebackPeriod = 0.5;          // Time between checks for due settings [s]
+
+    public:
+        SettingsStore(UBaseType_t priority, UBaseType_t stackDepth, BaseType_t coreID, const SettingsStoreConfig& cfg);
+        ~SettingsStore(void);
+
+        // Values
+        static PBRet put(const char* key, const std::vector<uint8_t>& value);
+        static PBRet get(const char* key, std::vector<uint8_t>& value);
+        static PBRet putMessage(const char* key, const ::EmbeddedProto::MessageInterface& msg);
+        static PBRet getMessage(const char* key, ::EmbeddedProto::MessageInterface& msg);
+        static PBRet putString(const char* key, const char* str);
+        static PBRet getString(const char* key, std::string& str);
+
+        // Write every changed value now rather than after the write delay
+        static void flush(void);
+
+        static PBRet checkInputs(const SettingsStoreConfig& cfg);
+        static PBRet loadFromJSON(SettingsStoreConfig& cfg, const cJSON* cfgRoot);
+        bool isConfigured(void) const { return _configured; }
+
+    private:
+        PBRet _initFromParams(const SettingsStoreConfig& cfg);
+        PBRet _setupCBTable(void) override;
+
+        // FreeRTOS hook method
+        void taskMain(void) override;
+
+        PBRet _openPartition(void);
+        PBRet _load(void);
+        PBRet _writeBack(bool force);
+
+        // Shared with every task through the static interface
+        static SettingsCache _cache;
+        static SemaphoreHandle_t _lock;
+        static TaskHandle_t _writer;
+
+        bool _configured = false;
+        nvs_handle_t _handle = 0;
+};
+
+#endif // MAIN_SETTINGS_STORE_H
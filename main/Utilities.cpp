@@ -140,3 +140,38 @@ size_t CircularBuffer::_computeOffset(size_t index) const
 
     return offset;
 }
+
+void RunningStats::add(double val)
+{
+    // Ref: https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance#Welford's_online_algorithm
+    if (_n == 0) {
+        _min = val;
+        _max = val;
+    } else {
+        _min = std::min(_min, val);
+        _max = std::max(_max, val);
+    }
+
+    _n++;
+    const double delta = val - _mean;
+    _mean += delta / _n;
+    _M2 += delta * (val - _mean);
+}
+
+void RunningStats::reset(void)
+{
+    _n = 0;
+    _mean = 0.0;
+    _M2 = 0.0;
+    _min = 0.0;
+    _max = 0.0;
+}
+
+double RunningStats::stdDev(void) const
+{
+    if (_n < 2) {
+        return 0.0;
+    }
+
+    return std::sqrt(_M2 / (_n - 1));
+}
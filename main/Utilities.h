@@ -3,6 +3,8 @@
 
 #include "PBCommon.h"
 #include <vector>
+#include <array>
+#include <algorithm>
 
 class Utilities
 {
@@ -55,4 +57,61 @@ class CircularBuffer
         size_t _size = 0;
 };
 
+// Streaming mean, variance and extrema of a signal using Welford's algorithm.
+// Used for timing measurements where storing every sample isn't practical
+class RunningStats
+{
+    public:
+        void add(double val);
+        void reset(void);
+
+        size_t count(void) const { return _n; }
+        double mean(void) const { return _mean; }
+        double stdDev(void) const;
+        double min(void) const { return _min; }
+        double max(void) const { return _max; }
+
+    private:
+        size_t _n = 0;
+        double _mean = 0.0;
+        double _M2 = 0.0;
+        double _min = 0.0;
+        double _max = 0.0;
+};
+
+// Fixed bin histogram of a non-negative signal. Bin i counts values in
+// [i * binWidth, (i + 1) * binWidth). Values beyond the last bin are
+// counted in it, so nothing is lost
+template <size_t N>
+class Histogram
+{
+    public:
+        Histogram(void) = default;
+        explicit Histogram(double binWidth)
+            : _binWidth(binWidth) {}
+
+        void add(double val)
+        {
+            size_t bin = 0;
+            if ((_binWidth > 0.0) && (val > 0.0)) {
+                bin = static_cast<size_t>(std::min(val / _binWidth, static_cast<double>(N - 1)));
+            }
+
+            _bins[bin]++;
+            _total++;
+        }
+
+        void reset(void) { _bins.fill(0); _total = 0; }
+
+        uint32_t at(size_t bin) const { return bin < N ? _bins[bin] : 0; }
+        uint32_t total(void) const { return _total; }
+        double getBinWidth(void) const { return _binWidth; }
+        static constexpr size_t size(void) { return N; }
+
+    private:
+        double _binWidth = 0.0;
+        std::array<uint32_t, N> _bins {};
+        uint32_t _total = 0;
+};
+
 #endif // UTILITIES_H
\ No newline at end of file
@@ -45,6 +45,7 @@ void Webserver::taskMain(void)
         PBMessageType::FlowrateData,
         PBMessageType::ConcentrationData,
         PBMessageType::ControllerState,
+        PBMessageType::RunBalance,
         PBMessageType::SocketLog
     };
     Subscriber sub(Webserver::Name, _GPQueue, subscriptions);
@@ -212,6 +213,7 @@ PBRet Webserver::_setupCBTable(void)
         {PBMessageType::ControllerCommand, std::bind(&Webserver::_broadcastDataCB, this, std::placeholders::_1)},
         {PBMessageType::ConcentrationData, std::bind(&Webserver::_broadcastDataCB, this, std::placeholders::_1)},
         {PBMessageType::ControllerState, std::bind(&Webserver::_broadcastDataCB, this, std::placeholders::_1)},
+        {PBMessageType::RunBalance, std::bind(&Webserver::_broadcastDataCB, this, std::placeholders::_1)},
         {PBMessageType::SocketLog, std::bind(&Webserver::_broadcastDataCB, this, std::placeholders::_1)}
     };
 
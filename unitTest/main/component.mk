@@ -1,3 +1,3 @@
-COMPONENT_SRCDIRS := . ./test ../../main
+COMPONENT_SRCDIRS := . ./test ./sim ../../main
 COMPONENT_OBJS := ../../main/thermo.o ../../main/controller.o ../../main/pump.o ../../main/OneWireBus.o ../../main/pump.o ../../main/SensorManager.o testMain.o
 COMPONENT_ADD_INCLUDEDIRS := ../../
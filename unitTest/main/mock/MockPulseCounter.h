@@ -0,0 +1,36 @@
+#ifndef MOCK_PULSE_COUNTER_H
+#define MOCK_PULSE_COUNTER_H
+
+#include "main/PulseCounter.h"
+
+// Host side stand in for the PCNT and GPIO interrupt counters. Tests add
+// pulses directly. The count wraps at 32 bits like the real counters, and
+// edge times are queued while timestamps are enabled
+class MockPulseCounter : public PulseCounter
+{
+    public:
+        explicit MockPulseCounter(uint32_t count = 0)
+            : _count(count)
+        {
+            _configured = true;
+        }
+
+        uint32_t getCount(void) override { return _count; }
+        PBRet enableTimestamps(bool enable) override { _timestamping = enable; return PBRet::SUCCESS; }
+        bool isTimestamping(void) const { return _timestamping; }
+
+        void addPulses(uint32_t pulses) { _count += pulses; }
+        void addPulse(int64_t t)
+        {
+            _count++;
+            if (_timestamping) {
+                _edges.push(t);
+            }
+        }
+
+    private:
+        uint32_t _count = 0;
+        bool _timestamping = false;
+};
+
+#endif // MOCK_PULSE_COUNTER_H
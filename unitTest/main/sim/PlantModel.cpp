@@ -0,0 +1,217 @@
+#include "PlantModel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+PlantModel::PlantModel(const PlantModelConfig& cfg)
+    : _cfg(cfg)
+{
+    if (checkInputs(cfg) != PBRet::SUCCESS) {
+        return;
+    }
+
+    _boilerTemp = cfg.initialTemp;
+    _headTemp = cfg.initialTemp;
+    _alcoholMass = cfg.washMass * cfg.washAlcoholFraction;
+    _waterMass = cfg.washMass - _alcoholMass;
+    _configured = true;
+}
+
+PBRet PlantModel::checkInputs(const PlantModelConfig& cfg)
+{
+    if ((cfg.elementPower <= 0.0) || (cfg.washMass <= 0.0) || (cfg.boilerHeatCapacity < 0.0) || (cfg.boilerLossCoeff < 0.0)) {
+        ESP_LOGE(PlantModel::Name, "Boiler parameters were invalid");
+        return PBRet::FAILURE;
+    }
+
+    if ((cfg.washAlcoholFraction < 0.0) || (cfg.washAlcoholFraction >= 1.0)) {
+        ESP_LOGE(PlantModel::Name, "Wash alcohol fraction (%.3f) must be in [0, 1)", cfg.washAlcoholFraction);
+        return PBRet::FAILURE;
+    }
+
+    if ((cfg.headTimeConstant <= 0.0) || (cfg.headLossTimeConstant <= 0.0) || (cfg.pumpTimeConstant <= 0.0)) {
+        ESP_LOGE(PlantModel::Name, "Time constants must be positive");
+        return PBRet::FAILURE;
+    }
+
+    if ((cfg.maxCoolantFlow <= 0.0) || (cfg.condenserEffectiveness <= 0.0) || (cfg.condenserEffectiveness > 1.0)) {
+        ESP_LOGE(PlantModel::Name, "Condenser parameters were invalid");
+        return PBRet::FAILURE;
+    }
+
+    if ((cfg.dt <= 0.0) || (cfg.sensorResolution < 0.0)) {
+        ESP_LOGE(PlantModel::Name, "Integration step (%.3f) and sensor resolution (%.4f) were invalid", cfg.dt, cfg.sensorResolution);
+        return PBRet::FAILURE;
+    }
+
+    return PBRet::SUCCESS;
+}
+
+void PlantModel::setPumpSpeed(double speed)
+{
+    _pumpCmd = std::min(std::max(speed, 0.0), 1.0);
+}
+
+void PlantModel::setElementPower(double power)
+{
+    _power = std::min(std::max(power, 0.0), 1.0);
+}
+
+double PlantModel::getHeadTemp(void) const
+{
+    if (_cfg.sensorResolution <= 0.0) {
+        return _headTemp;
+    }
+
+    return std::round(_headTemp / _cfg.sensorResolution) * _cfg.sensorResolution;
+}
+
+double PlantModel::getBoilerAlcoholFraction(void) const
+{
+    const double liquidMass = _alcoholMass + _waterMass;
+    return (liquidMass > 0.0) ? _alcoholMass / liquidMass : 0.0;
+}
+
+double PlantModel::getBoilingPoint(void) const
+{
+    return std::max(WATER_BOILING_POINT - BOILING_POINT_SLOPE * getBoilerAlcoholFraction(), AZEOTROPE_TEMP);
+}
+
+void PlantModel::step(double duration)
+{
+    if (_configured == false) {
+        return;
+    }
+
+    // Fixed integration step. The last one is shortened to land on the end
+    const double tEnd = _t + duration;
+    while (_t < tEnd - 1e-9) {
+        _integrate(std::min(_cfg.dt, tEnd - _t));
+    }
+}
+
+void PlantModel::_integrate(double dt)
+{
+    // Pump lag
+    const double coolantTarget = _pumpCmd * _cfg.maxCoolantFlow;
+    _coolantFlow += (coolantTarget - _coolantFlow) * dt / _cfg.pumpTimeConstant;
+
+    // Boiler. Below the boiling point all heat goes into the wash. At it,
+    // the temperature follows the boiling point and the rest boils off
+    const double x = getBoilerAlcoholFraction();
+    const double boilingPoint = getBoilingPoint();
+    const double heatCapacity = _cfg.boilerHeatCapacity + (_alcoholMass + _waterMass) * WATER_HEAT_CAPACITY;
+    const double netPower = _power * _cfg.elementPower - _cfg.boilerLossCoeff * (_boilerTemp - _cfg.ambientTemp);
+
+    double vapourRate = 0.0;    // [kg/s]
+    double vapourPower = 0.0;   // [W]
+    _boilerTemp += netPower * dt / heatCapacity;
+    if (_boilerTemp >= boilingPoint) {
+        vapourPower = (_boilerTemp - boilingPoint) * heatCapacity / dt;
+        vapourRate = vapourPower / (x * ETHANOL_LATENT_HEAT + (1.0 - x) * WATER_LATENT_HEAT);
+        _boilerTemp = boilingPoint;
+    }
+
+    // Reflux condenser. Coolant leaving the condenser takes up a fixed
+    // fraction of the temperature difference to the head
+    const double condenserPower = _coolantFlow * WATER_HEAT_CAPACITY * _cfg.condenserEffectiveness * std::max(_headTemp - _cfg.coolantTemp, 0.0);
+    if (vapourPower > 0.0) {
+        _refluxFraction = std::min(condenserPower / vapourPower, 1.0);
+    } else {
+        _refluxFraction = 0.0;
+    }
+
+    // Head. Vapour drives it between the boiling point with no reflux and
+    // the azeotrope with total reflux. Without vapour it cools to ambient
+    if (vapourRate > 0.0) {
+        const double headTarget = boilingPoint - (boilingPoint - AZEOTROPE_TEMP) * _refluxFraction;
+
+        // Rising vapour heats the head much faster than reflux cools it
+        const double tau = (_headTemp < headTarget) ? _cfg.headTimeConstant * 0.1 : _cfg.headTimeConstant;
+        _headTemp += (headTarget - _headTemp) * dt / tau;
+    } else {
+        _headTemp += (_cfg.ambientTemp - _headTemp) * dt / _cfg.headLossTimeConstant;
+    }
+
+    // Product is what gets past the reflux condenser. Its strength follows
+    // the head temperature
+    const double productRate = vapourRate * (1.0 - _refluxFraction);
+    const double strength = AZEOTROPE_FRACTION * std::min(std::max((WATER_BOILING_POINT - _headTemp) / (WATER_BOILING_POINT - AZEOTROPE_TEMP), 0.0), 1.0);
+    const double alcoholRate = std::min(productRate * strength, _alcoholMass / dt);
+    const double waterRate = std::min(productRate - alcoholRate, _waterMass / dt);
+
+    _alcoholMass -= alcoholRate * dt;
+    _waterMass -= waterRate * dt;
+    _productMass += (alcoholRate + waterRate) * dt;
+    _productAlcohol += alcoholRate * dt;
+    _t += dt;
+}
+
+LoopMetrics::LoopMetrics(double setpoint, double settleBand)
+    : _setpoint(setpoint), _band(settleBand)
+{}
+
+void LoopMetrics::add(double t, double T)
+{
+    const double err = T - _setpoint;
+    if (_reached == false) {
+        if (err < 0.0) {
+            _tPrev = t;
+            return;
+        }
+
+        _reached = true;
+        _riseTime = t;
+        _lastExit = t;
+        _tPrev = t;
+    }
+
+    // Rectangular integration is plenty at the control rate
+    const double dt = t - _tPrev;
+    _IAE += std::fabs(err) * dt;
+    _ISE += err * err * dt;
+    _tPrev = t;
+
+    _overshoot = std::max(_overshoot, err);
+    _undershoot = std::max(_undershoot, -err);
+
+    _inBand = std::fabs(err) <= _band;
+    if (_inBand == false) {
+        _lastExit = t;
+    }
+}
+
+double LoopMetrics::getSettlingTime(void) const
+{
+    if (isSettled() == false) {
+        return INFINITY;
+    }
+
+    return _lastExit - _riseTime;
+}
+
+double LoopMetrics::getMeanAbsError(void) const
+{
+    const double duration = getDuration();
+    return (duration > 0.0) ? _IAE / duration : 0.0;
+}
+
+void LoopMetrics::report(const char* label) const
+{
+    printf("%s: rise %.0f s, settling %.0f s, overshoot %.3f C, undershoot %.3f C, IAE %.1f C s, mean |e| %.4f C\n",
+           label, _riseTime, getSettlingTime(), _overshoot, _undershoot, _IAE, getMeanAbsError());
+}
+
+LoopMetrics ClosedLoopSim::run(const ControlLaw& law, double duration, double setpoint, double settleBand)
+{
+    LoopMetrics metrics(setpoint, settleBand);
+    const double tEnd = _plant.getTime() + duration;
+    while (_plant.getTime() < tEnd) {
+        const double T = _plant.getHeadTemp();
+        metrics.add(_plant.getTime(), T);
+        _plant.setPumpSpeed(law(T, _controlDt));
+        _plant.step(_controlDt);
+    }
+
+    return metrics;
+}
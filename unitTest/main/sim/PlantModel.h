@@ -0,0 +1,162 @@
+#ifndef PLANT_MODEL_H
+#define PLANT_MODEL_H
+
+#include <functional>
+#include "main/PBCommon.h"
+
+struct PlantModelConfig
+{
+    // Boiler
+    double elementPower = 3000.0;           // Power with all elements on [W]
+    double washMass = 25.0;                 // [kg]
+    double washAlcoholFraction = 0.1;       // Mass fraction of ethanol in the wash
+    double boilerHeatCapacity = 5000.0;     // Heat capacity of the empty boiler [J/K]
+    double boilerLossCoeff = 5.0;           // Heat loss to ambient [W/K]
+    double initialTemp = 20.0;              // Wash and column temperature at the start [deg C]
+
+    // Column head
+    double headTimeConstant = 60.0;         // Response of head temperature to reflux [s]
+    double headLossTimeConstant = 1800.0;   // Cooling of the head with no vapour [s]
+
+    // Reflux condenser and pump
+    double maxCoolantFlow = 0.03;           // Coolant flow at full pump speed [kg/s]
+    double condenserEffectiveness = 0.8;    // Fraction of the head to coolant temperature difference taken up by the coolant
+    double pumpTimeConstant = 1.0;          // [s]
+    double coolantTemp = 15.0;              // [deg C]
+    double ambientTemp = 20.0;              // [deg C]
+
+    // Simulation
+    double dt = 0.05;                       // Integration step [s]
+    double sensorResolution = 0.0625;       // Head sensor quantization. 0 disables [deg C]
+};
+
+// Lumped thermal model of the still for closed loop testing on the host.
+// The boiler heats the wash to its boiling point, which rises as ethanol
+// is drawn off. Vapour rises to the head, where the reflux condenser
+// returns some fraction of it to the column. The more that is returned,
+// the closer the head gets to the azeotrope. What isn't condensed leaves
+// as product. The pump sets the coolant flow through a first order lag
+class PlantModel
+{
+    static constexpr const char* Name = "PlantModel";
+
+    public:
+        // Physical constants
+        static constexpr double WATER_BOILING_POINT = 100.0;       // [deg C]
+        static constexpr double AZEOTROPE_TEMP = 78.2;             // [deg C]
+        static constexpr double AZEOTROPE_FRACTION = 0.956;        // Mass fraction of ethanol at the azeotrope
+        static constexpr double BOILING_POINT_SLOPE = 80.0;        // Drop in boiling point per unit ethanol fraction [deg C]
+        static constexpr double WATER_HEAT_CAPACITY = 4186.0;      // [J/kg/K]
+        static constexpr double WATER_LATENT_HEAT = 2.26e6;        // [J/kg]
+        static constexpr double ETHANOL_LATENT_HEAT = 0.84e6;      // [J/kg]
+
+        PlantModel(void) = default;
+        explicit PlantModel(const PlantModelConfig& cfg);
+
+        // Advance by duration holding the inputs [s]
+        void step(double duration);
+
+        // Inputs as fractions of full scale [0, 1]
+        void setPumpSpeed(double speed);
+        void setElementPower(double power);
+
+        // Head temperature as the sensor reads it [deg C]
+        double getHeadTemp(void) const;
+
+        double getTrueHeadTemp(void) const { return _headTemp; }
+        double getBoilerTemp(void) const { return _boilerTemp; }
+        double getBoilingPoint(void) const;
+        double getBoilerAlcoholFraction(void) const;
+        double getRefluxFraction(void) const { return _refluxFraction; }
+        double getCoolantFlow(void) const { return _coolantFlow; }
+        double getProductCollected(void) const { return _productMass; }
+        double getProductAlcohol(void) const { return _productAlcohol; }
+        double getTime(void) const { return _t; }
+
+        static PBRet checkInputs(const PlantModelConfig& cfg);
+        bool isConfigured(void) const { return _configured; }
+
+    private:
+        void _integrate(double dt);
+
+        PlantModelConfig _cfg {};
+
+        // Inputs
+        double _pumpCmd = 0.0;
+        double _power = 1.0;
+
+        // State
+        double _t = 0.0;                    // [s]
+        double _boilerTemp = 0.0;           // [deg C]
+        double _headTemp = 0.0;             // [deg C]
+        double _alcoholMass = 0.0;          // Ethanol left in the boiler [kg]
+        double _waterMass = 0.0;            // Water left in the boiler [kg]
+        double _coolantFlow = 0.0;          // [kg/s]
+        double _refluxFraction = 0.0;       // Fraction of vapour returned by the reflux condenser
+        double _productMass = 0.0;          // [kg]
+        double _productAlcohol = 0.0;       // Ethanol in the product [kg]
+
+        bool _configured = false;
+};
+
+// Closed loop performance against a fixed setpoint. Measurement starts
+// when the head first reaches the setpoint, so the boiler warm up doesn't
+// dominate
+class LoopMetrics
+{
+    public:
+        LoopMetrics(void) = default;
+        LoopMetrics(double setpoint, double settleBand);
+
+        void add(double t, double T);
+
+        bool hasReachedSetpoint(void) const { return _reached; }
+        bool isSettled(void) const { return _reached && _inBand; }
+
+        double getRiseTime(void) const { return _riseTime; }            // Time to first reach setpoint [s]
+        double getSettlingTime(void) const;                             // Time from reaching setpoint until the last exit from the band [s]
+        double getOvershoot(void) const { return _overshoot; }          // Largest excursion above setpoint [deg C]
+        double getUndershoot(void) const { return _undershoot; }        // Largest excursion below setpoint after reaching it [deg C]
+        double getIAE(void) const { return _IAE; }                      // Integral absolute error [deg C s]
+        double getISE(void) const { return _ISE; }                      // Integral squared error [deg C^2 s]
+        double getDuration(void) const { return _tPrev - _riseTime; }   // Time measured over [s]
+        double getMeanAbsError(void) const;                             // [deg C]
+
+        void report(const char* label) const;
+
+    private:
+        double _setpoint = 0.0;
+        double _band = 0.0;
+
+        bool _reached = false;
+        bool _inBand = false;
+        double _tPrev = 0.0;
+        double _riseTime = 0.0;
+        double _lastExit = 0.0;
+        double _overshoot = 0.0;
+        double _undershoot = 0.0;
+        double _IAE = 0.0;
+        double _ISE = 0.0;
+};
+
+// Runs a control law against the plant model as fast as it will compute.
+// The law is given the measured head temperature and the step, and
+// returns the pump speed as a fraction of full scale
+class ClosedLoopSim
+{
+    public:
+        using ControlLaw = std::function<double(double T, double dt)>;
+
+        ClosedLoopSim(const PlantModelConfig& plantCfg, double controlDt)
+            : _plant(plantCfg), _controlDt(controlDt) {}
+
+        LoopMetrics run(const ControlLaw& law, double duration, double setpoint, double settleBand);
+
+        PlantModel& getPlant(void) { return _plant; }
+
+    private:
+        PlantModel _plant {};
+        double _controlDt = 0.0;            // [s]
+};
+
+#endif // PLANT_MODEL_H
@@ -14,8 +14,26 @@ void includePumpTests(void);
 void includeControllerTests(void);
 void includeDistillerManagerTests(void);
 void includeFlowmeterTests(void);
-void includeSlowPWMTests(void);
 void includeFilterTests(void);
 void includeMessageServerTests(void);
+void includeRunBalanceTests(void);
+void includeRateGroupTests(void);
+void includeDS18B20PipelineTests(void);
+void includeDeviceDiscoveryTests(void);
+void includeSensorCalibrationTests(void);
+void includeSensorHealthTests(void);
+void includeSensorFrameTests(void);
+void includeControlLoopTests(void);
+void includePlantModelTests(void);
+void includeAutotunerTests(void);
+void includeGainScheduleTests(void);
+void includeFeedforwardTests(void);
+void includeRunPhaseTests(void);
+void includeModelPredictiveTests(void);
+void includeSafetyMonitorTests(void);
+void includeElementModulatorTests(void);
+void includeElementDriverTests(void);
+void includePumpOutputTests(void);
+void includeSettingsCacheTests(void);
 
 #endif // INCLUDE_TEST_FILES
\ No newline at end of file
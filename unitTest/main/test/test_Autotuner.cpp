@@ -0,0 +1,176 @@
+#include "unity.h"
+#include <cmath>
+#include <deque>
+#include "main/Autotuner.h"
+#include "PlantModel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void includeAutotunerTests(void)
+{
+    // Dummy function to force discovery of unit tests by main test runner
+}
+
+static RelayAutotunerConfig validConfig(void)
+{
+    RelayAutotunerConfig cfg {};
+    cfg.relayAmplitude = 150.0;
+    cfg.hysteresis = 0.1;
+    cfg.cycles = 3;
+    cfg.tolerance = 0.2;
+    cfg.maxDuration = 3600.0;
+    cfg.maxDeviation = 3.0;
+    cfg.rule = TuningRule::TYREUS_LUYBEN;
+
+    return cfg;
+}
+
+TEST_CASE("checkInputs", "[RelayAutotuner]")
+{
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, RelayAutotuner::checkInputs(validConfig()));
+
+    // No relay amplitude
+    {
+        RelayAutotunerConfig cfg = validConfig();
+        cfg.relayAmplitude = 0.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, RelayAutotuner::checkInputs(cfg));
+    }
+
+    // No cycles
+    {
+        RelayAutotunerConfig cfg = validConfig();
+        cfg.cycles = 0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, RelayAutotuner::checkInputs(cfg));
+    }
+
+    // Deviation limit inside the hysteresis band
+    {
+        RelayAutotunerConfig cfg = validConfig();
+        cfg.maxDeviation = 0.05;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, RelayAutotuner::checkInputs(cfg));
+    }
+
+    // Relay wider than the output range
+    {
+        RelayAutotuner tuner(validConfig(), 0.0, 1024.0);
+        TEST_ASSERT_TRUE(tuner.isConfigured());
+        RelayAutotuner narrow(validConfig(), 0.0, 200.0);
+        TEST_ASSERT_FALSE(narrow.isConfigured());
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, narrow.start(100.0));
+    }
+}
+
+TEST_CASE("computeTuning", "[RelayAutotuner]")
+{
+    // Ziegler-Nichols. Kp = 0.6 Ku, Ti = Tu / 2, Td = Tu / 8
+    const RelayTuning zn = RelayAutotuner::computeTuning(100.0, 60.0, TuningRule::ZIEGLER_NICHOLS, 1.0 / 0.375);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 60.0, zn.PGain);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 2.0, zn.IGain);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 450.0, zn.DGain);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 10.0 / (2.0 * M_PI * 7.5), zn.LPFcutoffFreq);
+
+    // Tyreus-Luyben. Kp = Ku / 2.2, Ti = 2.2 Tu, Td = Tu / 6.3
+    const RelayTuning tl = RelayAutotuner::computeTuning(100.0, 60.0, TuningRule::TYREUS_LUYBEN, 1.0 / 0.375);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 100.0 / 2.2, tl.PGain);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, tl.PGain / 132.0, tl.IGain);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, tl.PGain * 60.0 / 6.3, tl.DGain);
+
+    // Derivative filter is held below the sample rate
+    const RelayTuning fast = RelayAutotuner::computeTuning(100.0, 1.0, TuningRule::ZIEGLER_NICHOLS, 2.0);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.8, fast.LPFcutoffFreq);
+}
+
+TEST_CASE("integratorWithDelay", "[RelayAutotuner]")
+{
+    // An integrator with dead time has a known relay response. The limit
+    // cycle has period 4L and amplitude d K L, so the describing function
+    // estimate of the ultimate gain is 4 / (pi K L)
+    const double dt = 0.1;
+    const double K = 0.01;      // [deg C / s per unit output]
+    const double L = 5.0;       // [s]
+    RelayAutotunerConfig cfg = validConfig();
+    cfg.relayAmplitude = 100.0;
+    cfg.hysteresis = 0.0;
+    cfg.maxDeviation = 10.0;
+
+    RelayAutotuner tuner(cfg, 0.0, 1024.0);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, tuner.start(500.0));
+
+    std::deque<double> delay(static_cast<size_t>(L / dt), 500.0);
+    double err = 0.5;
+    while (tuner.isRunning()) {
+        delay.push_back(tuner.update(err, dt));
+        err -= K * (delay.front() - 500.0) * dt;
+        delay.pop_front();
+    }
+
+    TEST_ASSERT_EQUAL(RelayAutotuner::State::DONE, tuner.getState());
+    TEST_ASSERT_DOUBLE_WITHIN(2 * dt, 4 * L, tuner.getResult().ultimatePeriod);
+    TEST_ASSERT_DOUBLE_WITHIN(0.05 * 4.0 / (M_PI * K * L), 4.0 / (M_PI * K * L), tuner.getResult().ultimateGain);
+    TEST_ASSERT_DOUBLE_WITHIN(500.0, tuner.getBias(), tuner.update(err, dt));
+}
+
+TEST_CASE("abandon", "[RelayAutotuner]")
+{
+    RelayAutotuner tuner(validConfig(), 0.0, 1024.0);
+
+    // Bias moved in from the output limit
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, tuner.start(1000.0));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 1024.0 - 150.0, tuner.getBias());
+
+    // Error out of bounds
+    tuner.update(0.5, 1.0);
+    TEST_ASSERT_TRUE(tuner.isRunning());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, tuner.getBias(), tuner.update(3.5, 1.0));
+    TEST_ASSERT_EQUAL(RelayAutotuner::State::FAILED, tuner.getState());
+
+    // No oscillation within the time limit
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, tuner.start(500.0));
+    for (int i = 0; i < 3601; i++) {
+        tuner.update(0.05, 1.0);
+    }
+    TEST_ASSERT_EQUAL(RelayAutotuner::State::FAILED, tuner.getState());
+
+    // Cancelled
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, tuner.start(500.0));
+    tuner.cancel();
+    TEST_ASSERT_EQUAL(RelayAutotuner::State::FAILED, tuner.getState());
+}
+
+TEST_CASE("plant", "[RelayAutotuner]")
+{
+    // Tune against the plant model once the head is near setpoint, then
+    // check the proposed gains hold it there
+    const double setpoint = 78.6;
+    const double dt = 0.375;
+    double output = 0.0;
+    ClosedLoopSim sim(PlantModelConfig {}, dt);
+    sim.run([&](double T, double) {
+        output = std::min(std::max(200.0 * (T - setpoint), 0.0), 1024.0);
+        return output / 1024.0;
+    }, 3600.0, setpoint, 0.25);
+
+    RelayAutotuner tuner(validConfig(), 50.0, 1024.0);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, tuner.start(output));
+    sim.run([&](double T, double dt) {
+        return tuner.update(T - setpoint, dt) / 1024.0;
+    }, 1800.0, setpoint, 0.25);
+
+    TEST_ASSERT_EQUAL(RelayAutotuner::State::DONE, tuner.getState());
+    const RelayTuning& result = tuner.getResult();
+    printf("Ultimate gain %.1f, period %.1f s after %.0f s\n", result.ultimateGain, result.ultimatePeriod, tuner.getElapsed());
+    TEST_ASSERT_TRUE(result.ultimatePeriod > 10.0);
+    TEST_ASSERT_TRUE(result.ultimatePeriod < 300.0);
+
+    // Proportional control at the proposed gain settles
+    const LoopMetrics metrics = sim.run([&](double T, double) {
+        return std::min(std::max(tuner.getBias() + result.PGain * (T - setpoint), 0.0), 1024.0) / 1024.0;
+    }, 1800.0, setpoint, 0.25);
+    TEST_ASSERT_TRUE(metrics.isSettled());
+}
+
+#ifdef __cplusplus
+}
+#endif
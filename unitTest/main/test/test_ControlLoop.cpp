@@ -0,0 +1,229 @@
+#include "unity.h"
+#include "main/ControlLoop.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void includeControlLoopTests(void)
+{
+    // Dummy function to force discovery of unit tests by main test runner
+}
+
+TEST_CASE("startCycle", "[LoopTiming]")
+{
+    // 100 ms loop started at t = 1 s
+    LoopTiming timing(0.1, 50e-6, 500e-6);
+    timing.start(1000000);
+
+    // On time
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.1, timing.startCycle(1100000, 1));
+    TEST_ASSERT_EQUAL(1, timing.getStartJitter().at(0));
+
+    // 120 us late. dt is measured, not nominal
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.10012, timing.startCycle(1200120, 1));
+    TEST_ASSERT_EQUAL(1, timing.getStartJitter().at(2));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 120e-6, timing.getStartJitterStats().max());
+
+    // Lateness doesn't carry into the next cycle
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.09988, timing.startCycle(1300000, 1));
+    TEST_ASSERT_EQUAL(2, timing.getStartJitter().at(0));
+    TEST_ASSERT_EQUAL(0, timing.getMissedCycles());
+
+    // Two steps missed
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.3, timing.startCycle(1600000, 3));
+    TEST_ASSERT_EQUAL(2, timing.getMissedCycles());
+    TEST_ASSERT_EQUAL(3, timing.getStartJitter().at(0));
+
+    // Timed out. dt is still measured but no jitter is recorded
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.4, timing.startCycle(2000000, 0));
+    TEST_ASSERT_EQUAL(4, timing.getStartJitter().total());
+    TEST_ASSERT_EQUAL(5, timing.getDtStats().count());
+}
+
+TEST_CASE("endCycle", "[LoopTiming]")
+{
+    LoopTiming timing(0.1, 50e-6, 500e-6);
+    timing.start(0);
+
+    // 1.2 ms of work, then 40 ms of work
+    timing.startCycle(100000, 1);
+    timing.endCycle(101200);
+    timing.startCycle(200000, 1);
+    timing.endCycle(240000);
+
+    TEST_ASSERT_EQUAL(1, timing.getExecTime().at(2));
+    TEST_ASSERT_EQUAL(1, timing.getExecTime().at(LoopTiming::HistogramBins - 1));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.04, timing.getExecTimeStats().max());
+
+    // Reset clears statistics but keeps the schedule
+    timing.reset();
+    TEST_ASSERT_EQUAL(0, timing.getExecTime().total());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.1, timing.startCycle(300000, 1));
+    TEST_ASSERT_EQUAL(1, timing.getStartJitter().at(0));
+}
+
+static ControlBudgetConfig budgetConfig(OverrunAction action)
+{
+    // 100 ms step. 1 MHz counter so cycles are microseconds
+    ControlBudgetConfig cfg {};
+    cfg.budget = 0.1;
+    cfg.phaseBudgets = {0.04, 0.02, 0.02, 0.03};
+    cfg.action = action;
+    cfg.degradeCycles = 2;
+
+    return cfg;
+}
+
+// Run one step with the given phase times [us]. Returns whether the
+// broadcast was allowed
+static bool runStep(ControlBudget& budget, uint32_t& ccount, uint32_t control, uint32_t peripherals, uint32_t pumps, uint32_t broadcast)
+{
+    budget.startCycle(ccount);
+    ccount += control;
+    budget.endPhase(ControlPhase::CONTROL, ccount);
+    ccount += peripherals;
+    budget.endPhase(ControlPhase::PERIPHERALS, ccount);
+    ccount += pumps;
+    budget.endPhase(ControlPhase::PUMPS, ccount);
+    const bool broadcasting = budget.shouldBroadcast(ccount);
+    if (broadcasting) {
+        ccount += broadcast;
+    }
+    budget.endPhase(ControlPhase::BROADCAST, ccount);
+    budget.endCycle();
+    ccount += 1000;
+
+    return broadcasting;
+}
+
+TEST_CASE("checkInputs", "[ControlBudget]")
+{
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControlBudget::checkInputs(budgetConfig(OverrunAction::SKIP_BROADCAST)));
+
+    // Non positive budget
+    {
+        ControlBudgetConfig cfg = budgetConfig(OverrunAction::SKIP_BROADCAST);
+        cfg.budget = 0.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, ControlBudget::checkInputs(cfg));
+    }
+
+    // Phase budget longer than the step budget
+    {
+        ControlBudgetConfig cfg = budgetConfig(OverrunAction::SKIP_BROADCAST);
+        cfg.phaseBudgets[1] = 0.2;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, ControlBudget::checkInputs(cfg));
+    }
+
+    // No degrade cycles
+    {
+        ControlBudgetConfig cfg = budgetConfig(OverrunAction::DEGRADE);
+        cfg.degradeCycles = 0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, ControlBudget::checkInputs(cfg));
+    }
+
+    // Budget longer than the cycle counter wraps
+    {
+        ControlBudget budget(budgetConfig(OverrunAction::SKIP_BROADCAST), 240000000);
+        TEST_ASSERT_TRUE(budget.isConfigured());
+
+        ControlBudgetConfig cfg = budgetConfig(OverrunAction::SKIP_BROADCAST);
+        cfg.budget = 20.0;
+        cfg.phaseBudgets = {1.0, 1.0, 1.0, 1.0};
+        ControlBudget tooLong(cfg, 240000000);
+        TEST_ASSERT_FALSE(tooLong.isConfigured());
+    }
+}
+
+TEST_CASE("phaseOverruns", "[ControlBudget]")
+{
+    ControlBudget budget(budgetConfig(OverrunAction::SKIP_BROADCAST), 1000000);
+    TEST_ASSERT_TRUE(budget.isConfigured());
+
+    // Within budget
+    uint32_t ccount = 0;
+    TEST_ASSERT_TRUE(runStep(budget, ccount, 30000, 10000, 10000, 20000));
+    TEST_ASSERT_EQUAL(0, budget.getCycleOverruns());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.03, budget.getWorstCase(ControlPhase::CONTROL));
+
+    // Slow control phase. The step still fits
+    TEST_ASSERT_TRUE(runStep(budget, ccount, 45000, 10000, 10000, 20000));
+    TEST_ASSERT_EQUAL(1, budget.getOverruns(ControlPhase::CONTROL));
+    TEST_ASSERT_EQUAL(0, budget.getOverruns(ControlPhase::PUMPS));
+    TEST_ASSERT_EQUAL(0, budget.getCycleOverruns());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.045, budget.getWorstCase(ControlPhase::CONTROL));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.085, budget.getWorstCycle());
+
+    // Timing survives the cycle counter wrapping
+    ccount = UINT32_MAX - 5000;
+    TEST_ASSERT_TRUE(runStep(budget, ccount, 30000, 10000, 10000, 20000));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.03, budget.getPhaseTime(ControlPhase::CONTROL));
+
+    budget.reset();
+    TEST_ASSERT_EQUAL(0, budget.getOverruns(ControlPhase::CONTROL));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, budget.getWorstCycle());
+}
+
+TEST_CASE("skipBroadcast", "[ControlBudget]")
+{
+    ControlBudget budget(budgetConfig(OverrunAction::SKIP_BROADCAST), 1000000);
+    uint32_t ccount = 0;
+
+    // 80 ms used before the broadcast leaves too little for it
+    TEST_ASSERT_FALSE(runStep(budget, ccount, 60000, 10000, 10000, 20000));
+    TEST_ASSERT_EQUAL(0, budget.getCycleOverruns());
+
+    // Overruns are still counted, but never degrade the loop
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_FALSE(runStep(budget, ccount, 90000, 10000, 10000, 20000));
+    }
+    TEST_ASSERT_EQUAL(5, budget.getCycleOverruns());
+    TEST_ASSERT_FALSE(budget.isDegraded());
+    TEST_ASSERT_FALSE(budget.isAlarmed());
+}
+
+TEST_CASE("degrade", "[ControlBudget]")
+{
+    ControlBudget budget(budgetConfig(OverrunAction::DEGRADE), 1000000);
+    uint32_t ccount = 0;
+
+    // Two overruns in a row degrade the loop
+    runStep(budget, ccount, 95000, 10000, 10000, 20000);
+    TEST_ASSERT_FALSE(budget.isDegraded());
+    runStep(budget, ccount, 95000, 10000, 10000, 20000);
+    TEST_ASSERT_TRUE(budget.isDegraded());
+
+    // Broadcasts are throttled even when a step has room for them
+    TEST_ASSERT_FALSE(runStep(budget, ccount, 10000, 10000, 10000, 20000));
+    TEST_ASSERT_TRUE(budget.isDegraded());
+    TEST_ASSERT_EQUAL(2, budget.getCycleOverruns());
+
+    // Good steps in a row recover
+    runStep(budget, ccount, 10000, 10000, 10000, 20000);
+    TEST_ASSERT_FALSE(budget.isDegraded());
+    TEST_ASSERT_TRUE(runStep(budget, ccount, 10000, 10000, 10000, 20000));
+}
+
+TEST_CASE("alarm", "[ControlBudget]")
+{
+    ControlBudget budget(budgetConfig(OverrunAction::ALARM), 1000000);
+    uint32_t ccount = 0;
+
+    // Broadcasts always go out
+    TEST_ASSERT_TRUE(runStep(budget, ccount, 95000, 10000, 10000, 20000));
+    TEST_ASSERT_FALSE(budget.isAlarmed());
+    TEST_ASSERT_TRUE(runStep(budget, ccount, 95000, 10000, 10000, 20000));
+    TEST_ASSERT_TRUE(budget.isAlarmed());
+    TEST_ASSERT_FALSE(budget.isDegraded());
+
+    // Reset keeps the alarm until the loop recovers
+    budget.reset();
+    TEST_ASSERT_TRUE(budget.isAlarmed());
+    runStep(budget, ccount, 10000, 10000, 10000, 20000);
+    runStep(budget, ccount, 10000, 10000, 10000, 20000);
+    TEST_ASSERT_FALSE(budget.isAlarmed());
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,6 +1,8 @@
 #include "unity.h"
+#include <cmath>
 #include "main/Controller.h"
 #include "testControllerConfig.h"
+#include "PlantModel.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -15,6 +17,7 @@ static ControllerConfig validConfig(void)
 {
     ControllerConfig cfg {};
     cfg.dt = 1.0;
+    cfg.timingPublishPeriod = 5.0;
     cfg.refluxPumpConfig.pumpGPIO = GPIO_NUM_0;
     cfg.refluxPumpConfig.PWMChannel = LEDC_CHANNEL_0;
     cfg.refluxPumpConfig.timerChannel = LEDC_TIMER_0;
@@ -24,8 +27,18 @@ static ControllerConfig validConfig(void)
     cfg.element1Pin = GPIO_NUM_0;
     cfg.element2Pin = GPIO_NUM_0;
     cfg.fanPin = GPIO_NUM_0;
-    cfg.LPElementPWM.PWMFreq = 1.0;
-    cfg.HPElementPWM.PWMFreq = 1.0;
+    cfg.elementDriver.slotFreq = 100.0;
+    cfg.elementDriver.timerGroup = TIMER_GROUP_1;
+    cfg.elementDriver.timerIdx = TIMER_0;
+    cfg.budgetConfig.budget = 0.5;
+    cfg.budgetConfig.phaseBudgets = {0.1, 0.1, 0.1, 0.1};
+    cfg.budgetConfig.degradeCycles = 3;
+    cfg.autotuneConfig.relayAmplitude = 150.0;
+    cfg.autotuneConfig.hysteresis = 0.1;
+    cfg.autotuneConfig.cycles = 3;
+    cfg.autotuneConfig.tolerance = 0.2;
+    cfg.autotuneConfig.maxDuration = 3600.0;
+    cfg.autotuneConfig.maxDeviation = 3.0;
 
     return cfg;
 }
@@ -59,6 +72,46 @@ class ControllerUT
         static void setCurrentOutput(Controller& ctrl, double output) { ctrl._currentOutput = output; }
         static void setManualPumpSpeed(Controller& ctrl, const PumpSpeeds& pumpSpeeds) { ctrl._ctrlSettings.set_manualPumpSpeeds(pumpSpeeds); }
         static PBRet checkTemperatures(Controller& ctrl, const TemperatureData& currTemp) { return ctrl._checkTemperatures(currTemp); }
+        static PBRet doControl(Controller& ctrl, double temp, double dt) { return ctrl._doControl(temp, dt); }
+        static PBRet stepControl(Controller& ctrl, double dt) { return ctrl._stepControl(dt); }
+        static void setTemperatures(Controller& ctrl, const TemperatureData& TData) { ctrl._currentTemp = TData; }
+        static PBRet sensorHealthCB(Controller& ctrl, const SensorHealth& health)
+        {
+            std::shared_ptr<PBMessageWrapper> msg = std::make_shared<PBMessageWrapper>(MessageServer::wrap(health, PBMessageType::SensorHealth, MessageOrigin::SensorManager));
+            return ctrl._sensorHealthCB(msg);
+        }
+        static double getCurrentOutput(Controller& ctrl) { return ctrl._currentOutput; }
+        static void setTuning(Controller& ctrl, const ControllerTuning& tuning)
+        {
+            // As if loaded at startup
+            ctrl._ctrlTuning = tuning;
+            ctrl._derivFilter = IIRLowpassFilter(IIRLowpassFilterConfig(tuning.LPFsampleFreq(), tuning.LPFcutoffFreq()));
+            ctrl._activePGain = tuning.PGain();
+        }
+        static PBRet controlTuningCB(Controller& ctrl, const ControllerTuning& tuning)
+        {
+            std::shared_ptr<PBMessageWrapper> msg = std::make_shared<PBMessageWrapper>(MessageServer::wrap(tuning, PBMessageType::ControllerTuning, MessageOrigin::Webserver));
+            return ctrl._controlTuningCB(msg);
+        }
+        static PBRet startAutotune(Controller& ctrl) { return ctrl._startAutotune(); }
+        static const RelayAutotuner& getAutotuner(Controller& ctrl) { return ctrl._autotuner; }
+        static PBRet setGainSchedule(Controller& ctrl, const GainScheduleConfig& cfg) { return ctrl._setGainSchedule(cfg); }
+        static void setFeedforward(Controller& ctrl, const FeedforwardConfig& cfg) { ctrl._feedforward = Feedforward(cfg); }
+        static void setBoilerTemp(Controller& ctrl, double T) { ctrl._currentTemp.set_boilerTemp(T); }
+        static void setElementDuty(Controller& ctrl, double LPDuty, double HPDuty)
+        {
+            ctrl._elementDriver.setDuty(Element::LP, LPDuty);
+            ctrl._elementDriver.setDuty(Element::HP, HPDuty);
+        }
+        static void setRunPhases(Controller& ctrl, const RunPhaseConfig& cfg) { ctrl._runPhase = RunPhaseEngine(cfg); }
+        static RunPhaseEngine& getRunPhase(Controller& ctrl) { return ctrl._runPhase; }
+        static PBRet updateRunPhase(Controller& ctrl, double headTemp, double dt)
+        {
+            ctrl._currentTemp.set_headTemp(headTemp);
+            return ctrl._updateRunPhase(dt);
+        }
+        static double getIntegral(Controller& ctrl) { return ctrl._integral; }
+        static void setMPC(Controller& ctrl, const MPCConfig& cfg) { ctrl._mpc = ModelPredictiveController(cfg, ctrl._cfg.dt, Pump::PUMP_IDLE_SPEED, Pump::PUMP_MAX_SPEED); }
 };
 
 TEST_CASE("Constructor", "[Controller]")
@@ -93,6 +146,20 @@ TEST_CASE("checkInputs", "[Controller]")
         TEST_ASSERT_EQUAL(PBRet::FAILURE, Controller::checkInputs(cfg));
     }
 
+    // Timing published faster than the loop runs
+    {
+        ControllerConfig cfg = validConfig();
+        cfg.timingPublishPeriod = 0.5;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, Controller::checkInputs(cfg));
+    }
+
+    // Step budget longer than the step
+    {
+        ControllerConfig cfg = validConfig();
+        cfg.budgetConfig.budget = 1.5;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, Controller::checkInputs(cfg));
+    }
+
     // Invalid reflux pump config
     {
         ControllerConfig cfg = validConfig();
@@ -360,11 +427,392 @@ TEST_CASE("checkTemperatures", "[Controller]")
     // Temperature message is stale
     {
         TemperatureData validTemp = createTemperatureData(0.0, 0.0, 0.0, 0.0, 0.0);
-        vTaskDelay(1250 / portTICK_PERIOD_MS);      // Wait for message to go stale
+        vTaskDelay(2250 / portTICK_PERIOD_MS);      // Wait for message to go stale
         TEST_ASSERT_EQUAL(PBRet::FAILURE, ControllerUT::checkTemperatures(ctrl, validTemp));
     }
 }
 
+TEST_CASE("unhealthyHeadSensor", "[Controller]")
+{
+    // With no healthy head sensor left, the control output and integral
+    // hold whatever the head temperature does
+    Controller ctrl(1, 1024, 1, validConfig());
+    TEST_ASSERT_TRUE(ctrl.isConfigured());
+
+    const double dt = 0.2;
+    ControllerTuning tuning {};
+    tuning.set_setpoint(78.6);
+    tuning.set_PGain(200.0);
+    tuning.set_IGain(2.0);
+    tuning.set_DGain(0.0);
+    tuning.set_LPFsampleFreq(1.0 / dt);
+    tuning.set_LPFcutoffFreq(0.5);
+    ControllerUT::setTuning(ctrl, tuning);
+
+    ControllerUT::setTemperatures(ctrl, createTemperatureData(79.0, 0.0, 0.0, 0.0, 0.0));
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::stepControl(ctrl, dt));
+    const double output = ControllerUT::getCurrentOutput(ctrl);
+    const double integral = ControllerUT::getIntegral(ctrl);
+
+    SensorHealth health {};
+    health.set_role(DS18B20Role::HEAD_TEMP);
+    health.set_roleHealthy(false);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::sensorHealthCB(ctrl, health));
+
+    for (int i = 0; i < 10; i++) {
+        ControllerUT::setTemperatures(ctrl, createTemperatureData(79.0 + 0.5 * i, 0.0, 0.0, 0.0, 0.0));
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, ControllerUT::stepControl(ctrl, dt));
+        TEST_ASSERT_EQUAL_DOUBLE(output, ControllerUT::getCurrentOutput(ctrl));
+        TEST_ASSERT_EQUAL_DOUBLE(integral, ControllerUT::getIntegral(ctrl));
+    }
+
+    // Control resumes once a healthy sensor is back
+    health.set_roleHealthy(true);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::sensorHealthCB(ctrl, health));
+    ControllerUT::setTemperatures(ctrl, createTemperatureData(80.0, 0.0, 0.0, 0.0, 0.0));
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::stepControl(ctrl, dt));
+    TEST_ASSERT_TRUE(ControllerUT::getCurrentOutput(ctrl) > output);
+}
+
+TEST_CASE("closedLoop", "[Controller]")
+{
+    // Run the control law against the plant model over a full 8 hour run.
+    // Only the PID is exercised. Pumps and elements are left to the model
+    Controller ctrl(1, 1024, 1, validConfig());
+    TEST_ASSERT_TRUE(ctrl.isConfigured());
+
+    const double dt = 0.375;
+    ControllerTuning tuning {};
+    tuning.set_setpoint(78.6);
+    tuning.set_PGain(200.0);
+    tuning.set_IGain(2.0);
+    tuning.set_DGain(0.0);
+    tuning.set_LPFsampleFreq(1.0 / dt);
+    tuning.set_LPFcutoffFreq(0.5);
+    ControllerUT::setTuning(ctrl, tuning);
+
+    ClosedLoopSim sim(PlantModelConfig {}, dt);
+    const LoopMetrics metrics = sim.run([&ctrl](double T, double dt) {
+        ControllerUT::doControl(ctrl, T, dt);
+        return ControllerUT::getCurrentOutput(ctrl) / Pump::PUMP_MAX_SPEED;
+    }, 8 * 3600.0, tuning.setpoint(), 0.25);
+    metrics.report("PID");
+
+    // Startup overshoot is expected as the vapour front reaches the head
+    // before the condenser has any coolant. After that the head should
+    // hold setpoint while the wash is stripped
+    TEST_ASSERT_TRUE(metrics.hasReachedSetpoint());
+    TEST_ASSERT_TRUE(metrics.isSettled());
+    TEST_ASSERT_TRUE(metrics.getSettlingTime() < 600.0);
+    TEST_ASSERT_TRUE(metrics.getOvershoot() < 5.0);
+    TEST_ASSERT_TRUE(metrics.getMeanAbsError() < 0.1);
+}
+
+TEST_CASE("autotune", "[Controller]")
+{
+    // Hold the head near setpoint, run the relay experiment through the
+    // control loop, then apply the proposed tuning as the user would
+    Controller ctrl(1, 1024, 1, validConfig());
+    TEST_ASSERT_TRUE(ctrl.isConfigured());
+
+    const double dt = 0.375;
+    ControllerTuning tuning {};
+    tuning.set_setpoint(78.6);
+    tuning.set_PGain(200.0);
+    tuning.set_IGain(2.0);
+    tuning.set_DGain(0.0);
+    tuning.set_LPFsampleFreq(1.0 / dt);
+    tuning.set_LPFcutoffFreq(0.5);
+    ControllerUT::setTuning(ctrl, tuning);
+
+    ClosedLoopSim sim(PlantModelConfig {}, dt);
+    const ClosedLoopSim::ControlLaw law = [&ctrl](double T, double dt) {
+        ControllerUT::doControl(ctrl, T, dt);
+        return ControllerUT::getCurrentOutput(ctrl) / Pump::PUMP_MAX_SPEED;
+    };
+
+    // Only runs with the reflux pump under active control
+    ctrl.setRefluxPumpMode(PumpMode::MANUAL_CONTROL);
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, ControllerUT::startAutotune(ctrl));
+    ctrl.setRefluxPumpMode(PumpMode::ACTIVE_CONTROL);
+
+    sim.run(law, 3600.0, tuning.setpoint(), 0.25);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::startAutotune(ctrl));
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, ControllerUT::startAutotune(ctrl));
+
+    const RelayAutotuner& tuner = ControllerUT::getAutotuner(ctrl);
+    while (tuner.isRunning() && (sim.getPlant().getTime() < 3 * 3600.0)) {
+        sim.run(law, 60.0, tuning.setpoint(), 0.25);
+    }
+    TEST_ASSERT_EQUAL(RelayAutotuner::State::DONE, tuner.getState());
+
+    const RelayTuning& result = tuner.getResult();
+    tuning.set_PGain(result.PGain);
+    tuning.set_IGain(result.IGain);
+    tuning.set_DGain(result.DGain);
+    tuning.set_LPFcutoffFreq(result.LPFcutoffFreq);
+    ControllerUT::setTuning(ctrl, tuning);
+
+    // The transfer back to PID shouldn't knock the head out of the band
+    const LoopMetrics metrics = sim.run(law, 4 * 3600.0, tuning.setpoint(), 0.25);
+    metrics.report("Autotuned PID");
+    TEST_ASSERT_TRUE(metrics.isSettled());
+    TEST_ASSERT_TRUE(metrics.getMeanAbsError() < 0.1);
+}
+
+TEST_CASE("gainSchedule", "[Controller]")
+{
+    Controller ctrl(1, 1024, 1, validConfig());
+    TEST_ASSERT_TRUE(ctrl.isConfigured());
+
+    ControllerTuning tuning {};
+    tuning.set_setpoint(78.0);
+    tuning.set_PGain(200.0);
+    tuning.set_IGain(0.0);
+    tuning.set_DGain(0.0);
+    tuning.set_LPFsampleFreq(10.0);
+    tuning.set_LPFcutoffFreq(1.0);
+    ControllerUT::setTuning(ctrl, tuning);
+
+    // Fixed tuning
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::doControl(ctrl, 78.5, 0.1));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 100.0, ControllerUT::getCurrentOutput(ctrl));
+
+    // Proportional gain rises with head temperature. Moving along the
+    // schedule changes the output only as much as the error does at the
+    // gain in use on the last step
+    GainScheduleConfig cfg {};
+    cfg.variable = ScheduleVariable::HEAD_TEMP;
+    cfg.points = {
+        {78.0, 150.0, 0.0, 0.0},
+        {79.0, 350.0, 0.0, 0.0}
+    };
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::setGainSchedule(ctrl, cfg));
+
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::doControl(ctrl, 78.5, 0.1));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 100.0, ControllerUT::getCurrentOutput(ctrl));
+
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::doControl(ctrl, 78.6, 0.1));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 125.0, ControllerUT::getCurrentOutput(ctrl));
+
+    // Replacing the schedule doesn't bump the output either
+    cfg.points[1].PGain = 50.0;
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::setGainSchedule(ctrl, cfg));
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::doControl(ctrl, 78.6, 0.1));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 125.0, ControllerUT::getCurrentOutput(ctrl));
+
+    // Invalid schedules are rejected and the old one kept
+    cfg.points[1].x = 77.0;
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, ControllerUT::setGainSchedule(ctrl, cfg));
+}
+
+TEST_CASE("bumplessGainChange", "[Controller]")
+{
+    // Output doesn't step with the proportional gain, however it changes
+    Controller ctrl(1, 1024, 1, validConfig());
+    TEST_ASSERT_TRUE(ctrl.isConfigured());
+
+    ControllerTuning tuning {};
+    tuning.set_setpoint(78.0);
+    tuning.set_PGain(200.0);
+    tuning.set_IGain(0.0);
+    tuning.set_DGain(0.0);
+    tuning.set_LPFsampleFreq(10.0);
+    tuning.set_LPFcutoffFreq(1.0);
+    ControllerUT::setTuning(ctrl, tuning);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::setGainSchedule(ctrl, GainScheduleConfig {}));
+
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::doControl(ctrl, 78.5, 0.1));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 100.0, ControllerUT::getCurrentOutput(ctrl));
+
+    // New tuning with no schedule
+    tuning.set_PGain(400.0);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::controlTuningCB(ctrl, tuning));
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::doControl(ctrl, 78.5, 0.1));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 100.0, ControllerUT::getCurrentOutput(ctrl));
+
+    // Then moves with the error at the new gain
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::doControl(ctrl, 78.6, 0.1));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 140.0, ControllerUT::getCurrentOutput(ctrl));
+
+    // Clearing a schedule drops back to the tuned gain without a step
+    GainScheduleConfig cfg {};
+    cfg.variable = ScheduleVariable::HEAD_TEMP;
+    cfg.points = {
+        {78.0, 100.0, 0.0, 0.0},
+        {79.0, 100.0, 0.0, 0.0}
+    };
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::setGainSchedule(ctrl, cfg));
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::doControl(ctrl, 78.6, 0.1));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 140.0, ControllerUT::getCurrentOutput(ctrl));
+
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::setGainSchedule(ctrl, GainScheduleConfig {}));
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::doControl(ctrl, 78.6, 0.1));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 140.0, ControllerUT::getCurrentOutput(ctrl));
+
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::doControl(ctrl, 78.7, 0.1));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 180.0, ControllerUT::getCurrentOutput(ctrl));
+}
+
+TEST_CASE("runPhase", "[Controller]")
+{
+    // While a run is in progress the phase owns the setpoint, and the
+    // integral is held at zero through phases that disable it
+    Controller ctrl(1, 1024, 1, validConfig());
+    TEST_ASSERT_TRUE(ctrl.isConfigured());
+
+    ControllerTuning tuning {};
+    tuning.set_setpoint(78.0);
+    tuning.set_PGain(100.0);
+    tuning.set_IGain(10.0);
+    tuning.set_DGain(0.0);
+    tuning.set_LPFsampleFreq(10.0);
+    tuning.set_LPFcutoffFreq(1.0);
+    ControllerUT::setTuning(ctrl, tuning);
+
+    RunPhaseConfig cfg {};
+    PhaseSettings warmUp {};
+    warmUp.phase = RunPhase::WARM_UP;
+    warmUp.setpoint = 80.0;
+    warmUp.integralEnabled = false;
+    PhaseTransition toStabilise {};
+    toStabilise.variable = PhaseVariable::HEAD_TEMP;
+    toStabilise.threshold = 79.0;
+    toStabilise.next = RunPhase::STABILISE;
+    warmUp.transitions = {toStabilise};
+    cfg.phases.push_back(warmUp);
+
+    PhaseSettings stabilise {};
+    stabilise.phase = RunPhase::STABILISE;
+    stabilise.setpoint = 78.5;
+    stabilise.refluxPumpMode = PhasePumpMode::MANUAL;
+    stabilise.refluxPumpSpeed = 300.0;
+    cfg.phases.push_back(stabilise);
+    ControllerUT::setRunPhases(ctrl, cfg);
+
+    // Warm up. The head is below setpoint but the integral doesn't wind up
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::getRunPhase(ctrl).start(tuning.setpoint()));
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::updateRunPhase(ctrl, 78.5, 1.0));
+        TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::doControl(ctrl, 78.5, 1.0));
+        TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, ControllerUT::getIntegral(ctrl));
+        TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, ControllerUT::getCurrentOutput(ctrl));
+    }
+
+    // Stabilise applies its pump settings, and the integral picks up from
+    // the previous error
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::updateRunPhase(ctrl, 79.5, 1.0));
+    TEST_ASSERT_EQUAL(RunPhase::STABILISE, ControllerUT::getRunPhase(ctrl).getPhase());
+    TEST_ASSERT_EQUAL(PumpMode::MANUAL_CONTROL, ctrl.getRefluxPumpMode());
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::doControl(ctrl, 79.5, 1.0));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 100.0 - 2.5, ControllerUT::getCurrentOutput(ctrl));
+
+    // Stopping the run hands the setpoint back to the tuning
+    ControllerUT::getRunPhase(ctrl).stop();
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::doControl(ctrl, 79.5, 1.0));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 150.0 + 10.0, ControllerUT::getCurrentOutput(ctrl));
+}
+
+TEST_CASE("mpc", "[Controller]")
+{
+    // Control passes between the PID and MPC without a bump
+    Controller ctrl(1, 1024, 1, validConfig());
+    TEST_ASSERT_TRUE(ctrl.isConfigured());
+
+    MPCConfig mpcCfg {};
+    mpcCfg.processGain = -0.025;
+    mpcCfg.timeConstant = 55.0;
+    mpcCfg.deadTime = 2.0;
+    mpcCfg.predictionHorizon = 60;
+    mpcCfg.controlHorizon = 4;
+    mpcCfg.moveWeight = 1.0;
+    ControllerUT::setMPC(ctrl, mpcCfg);
+
+    ControllerTuning tuning {};
+    tuning.set_setpoint(78.6);
+    tuning.set_PGain(200.0);
+    tuning.set_IGain(0.0);
+    tuning.set_DGain(0.0);
+    tuning.set_LPFsampleFreq(10.0);
+    tuning.set_LPFcutoffFreq(1.0);
+    tuning.set_controlLaw(ControlLaw::MPC);
+    ControllerUT::setTuning(ctrl, tuning);
+    ControllerUT::setCurrentOutput(ctrl, 400.0);
+
+    // Holds the output it took over at setpoint
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::doControl(ctrl, 78.6, 1.0));
+        TEST_ASSERT_DOUBLE_WITHIN(1e-6, 400.0, ControllerUT::getCurrentOutput(ctrl));
+    }
+
+    // Head above setpoint asks for more reflux
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::doControl(ctrl, 78.8, 1.0));
+    const double output = ControllerUT::getCurrentOutput(ctrl);
+    TEST_ASSERT_TRUE(output > 400.0);
+
+    // The PID picks up from the MPC output
+    tuning.set_controlLaw(ControlLaw::PID);
+    ControllerUT::setTuning(ctrl, tuning);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ControllerUT::doControl(ctrl, 78.8, 1.0));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, output, ControllerUT::getCurrentOutput(ctrl));
+}
+
+TEST_CASE("feedforward", "[Controller]")
+{
+    // Step the element duty with the head at setpoint. With feedforward
+    // the pump moves with the duty instead of waiting for the head to
+    // drift. The plant model's element stands in for the HP element
+    const double dt = 0.375;
+    FeedforwardConfig ffCfg {};
+    ffCfg.HPElementGain = 465.0;
+    ffCfg.boilerTempGain = -0.775;
+    ffCfg.boilerTempRef = 20.0;
+    ffCfg.boilerTemp = {85.0, 90.0};
+    ffCfg.vapourFraction = {0.0, 1.0};
+
+    double maxDeviation[2] {};
+    for (int useFeedforward = 0; useFeedforward < 2; useFeedforward++) {
+        Controller ctrl(1, 1024, 1, validConfig());
+        TEST_ASSERT_TRUE(ctrl.isConfigured());
+
+        ControllerTuning tuning {};
+        tuning.set_setpoint(78.6);
+        tuning.set_PGain(200.0);
+        tuning.set_IGain(2.0);
+        tuning.set_DGain(0.0);
+        tuning.set_LPFsampleFreq(1.0 / dt);
+        tuning.set_LPFcutoffFreq(0.5);
+        ControllerUT::setTuning(ctrl, tuning);
+        if (useFeedforward) {
+            ControllerUT::setFeedforward(ctrl, ffCfg);
+        }
+
+        ClosedLoopSim sim(PlantModelConfig {}, dt);
+        double deviation = 0.0;
+        const ClosedLoopSim::ControlLaw law = [&](double T, double dt) {
+            ControllerUT::setBoilerTemp(ctrl, sim.getPlant().getBoilerTemp());
+            ControllerUT::doControl(ctrl, T, dt);
+            deviation = std::max(deviation, std::fabs(T - tuning.setpoint()));
+            return ControllerUT::getCurrentOutput(ctrl) / Pump::PUMP_MAX_SPEED;
+        };
+
+        ControllerUT::setElementDuty(ctrl, 0.0, 1.0);
+        sim.run(law, 2 * 3600.0, tuning.setpoint(), 0.25);
+
+        deviation = 0.0;
+        for (double duty : {0.6, 1.0, 0.3}) {
+            ControllerUT::setElementDuty(ctrl, 0.0, duty);
+            sim.getPlant().setElementPower(duty);
+            const LoopMetrics metrics = sim.run(law, 1800.0, tuning.setpoint(), 0.25);
+            TEST_ASSERT_TRUE(metrics.isSettled());
+        }
+        maxDeviation[useFeedforward] = deviation;
+        printf("Max deviation %s feedforward: %.3f C\n", useFeedforward ? "with" : "without", deviation);
+    }
+
+    TEST_ASSERT_TRUE(maxDeviation[1] < 0.6 * maxDeviation[0]);
+}
+
 TEST_CASE("loadFromJSONValid", "[Controller]")
 {
     ControllerConfig testConfig {};
@@ -0,0 +1,215 @@
+#include "unity.h"
+#include "main/DS18B20Pipeline.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void includeDS18B20PipelineTests(void)
+{
+    // Dummy function to force discovery of unit tests by main test runner
+}
+
+// Mock bus. Drives the pipeline the same way PBOneWire does, on a simulated
+// clock, and records when each set of samples was produced
+class MockOneWireBus
+{
+    public:
+        MockOneWireBus(double conversionTime, double samplePeriod, int64_t busTime)
+            : pipeline(conversionTime, samplePeriod), _busTime(busTime) {}
+
+        // Returns true if a new sample was read at time t [us]
+        bool poll(int64_t t)
+        {
+            bool updated = false;
+            if (pipeline.update(t) == DS18B20Pipeline::Action::READ) {
+                pipeline.samplesRead();
+                updated = true;
+            }
+
+            // Bus transactions take a fixed time
+            if (pipeline.update(t) == DS18B20Pipeline::Action::START_CONVERSION) {
+                pipeline.conversionStarted(t + _busTime);
+                blockedTime.add(_busTime * 1e-6);
+            }
+
+            return updated;
+        }
+
+        DS18B20Pipeline pipeline;
+        RunningStats blockedTime {};
+
+    private:
+        int64_t _busTime = 0;       // [us]
+};
+
+TEST_CASE("Sequencing", "[DS18B20Pipeline]")
+{
+    DS18B20Pipeline pipeline(0.375, 0.0);
+    TEST_ASSERT_TRUE(pipeline.getState() == DS18B20Pipeline::State::IDLE);
+
+    // Idle pipeline starts a conversion
+    TEST_ASSERT_TRUE(pipeline.update(0) == DS18B20Pipeline::Action::START_CONVERSION);
+    pipeline.conversionStarted(0);
+    TEST_ASSERT_TRUE(pipeline.getState() == DS18B20Pipeline::State::CONVERTING);
+
+    // Nothing to do until the conversion time has elapsed
+    TEST_ASSERT_TRUE(pipeline.update(100000) == DS18B20Pipeline::Action::NONE);
+    TEST_ASSERT_TRUE(pipeline.update(374999) == DS18B20Pipeline::Action::NONE);
+    TEST_ASSERT_TRUE(pipeline.update(375000) == DS18B20Pipeline::Action::READ);
+
+    // Reading returns to idle, and with no sample period set the next 
+    // conversion is due immediately
+    pipeline.samplesRead();
+    TEST_ASSERT_TRUE(pipeline.getState() == DS18B20Pipeline::State::IDLE);
+    TEST_ASSERT_TRUE(pipeline.update(375000) == DS18B20Pipeline::Action::START_CONVERSION);
+
+    // Aborted conversion is restarted on the next update
+    pipeline.conversionStarted(400000);
+    pipeline.abort();
+    TEST_ASSERT_TRUE(pipeline.update(400000) == DS18B20Pipeline::Action::START_CONVERSION);
+}
+
+TEST_CASE("SteadySampleRate", "[DS18B20Pipeline]")
+{
+    // 11 bit conversions polled from a 62.5 ms task with up to 2 ms of
+    // scheduling jitter. Samples should be produced at the first tick after
+    // each conversion completes
+    MockOneWireBus bus(0.375, 0.0, 3000);
+    const int64_t dt = 62500;
+    const int64_t jitter[] = {0, 1500, -800, 2000, -2000, 300, 0, -1200};
+
+    int nSamples = 0;
+    for (int64_t i = 0; i < 1600; i++) {
+        const int64_t t = 1000000 + i * dt + jitter[i % 8];
+        if (bus.poll(t)) {
+            nSamples++;
+        }
+    }
+
+    // 100 s of polling yields a sample every 7 ticks
+    const RunningStats& interval = bus.pipeline.getSampleIntervalStats();
+    TEST_ASSERT_INT_WITHIN(1, 1600 / 7, nSamples);
+    TEST_ASSERT_EQUAL(nSamples - 1, interval.count());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-3, 7 * 0.0625, interval.mean());
+
+    // Jitter is bounded by scheduling jitter, not by conversion time
+    TEST_ASSERT_TRUE(interval.max() - interval.min() <= 0.0081);
+    TEST_ASSERT_TRUE(interval.stdDev() < 0.004);
+
+    // Caller is only blocked for bus transactions
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.003, bus.blockedTime.max());
+}
+
+TEST_CASE("NeverReadsEarly", "[DS18B20Pipeline]")
+{
+    // Polled much faster than the sensors convert, samples are never read
+    // before the conversion has finished
+    MockOneWireBus bus(0.75, 0.0, 0);
+    for (int64_t t = 0; t < 10000000; t += 1000) {
+        if (bus.pipeline.getState() == DS18B20Pipeline::State::CONVERTING) {
+            const bool ready = (t - bus.pipeline.getConversionStartTime()) >= 750000;
+            const bool read = bus.poll(t);
+            TEST_ASSERT_EQUAL(ready, read);
+        } else {
+            bus.poll(t);
+        }
+    }
+
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 0.75, bus.pipeline.getSampleIntervalStats().mean());
+}
+
+TEST_CASE("SamplePeriod", "[DS18B20Pipeline]")
+{
+    // Sample period can't be faster than the conversion time
+    {
+        DS18B20Pipeline pipeline(0.75, 0.1);
+        TEST_ASSERT_EQUAL_DOUBLE(0.75, pipeline.getSamplePeriod());
+    }
+
+    // 9 bit sensor sampled every 2 s is idle between samples
+    MockOneWireBus bus(0.09375, 2.0, 0);
+    int nSamples = 0;
+    for (int64_t t = 0; t < 20000000; t += 62500) {
+        if (bus.poll(t)) {
+            nSamples++;
+        }
+
+        // Converting for only a small fraction of the time
+        if (bus.pipeline.getState() == DS18B20Pipeline::State::CONVERTING) {
+            TEST_ASSERT_TRUE((t - bus.pipeline.getConversionStartTime()) < 93750);
+        }
+    }
+
+    TEST_ASSERT_INT_WITHIN(1, 10, nSamples);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 2.0, bus.pipeline.getSampleIntervalStats().mean());
+}
+
+TEST_CASE("OverlappingConversions", "[DS18B20Pipeline]")
+{
+    // A fast low resolution sensor keeps sampling while a slow high
+    // resolution sensor converts. Neither waits on the other
+    MockOneWireBus head(0.75, 0.0, 0);
+    MockOneWireBus radiator(0.09375, 0.0, 0);
+
+    int nHead = 0;
+    int nRadiator = 0;
+    for (int64_t t = 0; t < 15000000; t += 31250) {
+        nHead += head.poll(t) ? 1 : 0;
+        nRadiator += radiator.poll(t) ? 1 : 0;
+    }
+
+    TEST_ASSERT_INT_WITHIN(1, 20, nHead);
+    TEST_ASSERT_INT_WITHIN(2, 160, nRadiator);
+}
+
+TEST_CASE("AdaptiveResolution", "[DS18B20Pipeline]")
+{
+    DS18B20SamplingConfig cfg {};
+    cfg.resolution = DS18B20_RESOLUTION_12_BIT;
+    cfg.samplePeriod = 1.0;
+    cfg.adaptive = true;
+    cfg.lowResolution = DS18B20_RESOLUTION_9_BIT;
+    cfg.adaptiveBand = 2.0;
+
+    // Non adaptive sensors never change
+    {
+        DS18B20SamplingConfig fixed = cfg;
+        fixed.adaptive = false;
+        AdaptiveResolution res(fixed);
+        TEST_ASSERT_FALSE(res.update(20.0, 78.0));
+        TEST_ASSERT_EQUAL(DS18B20_RESOLUTION_12_BIT, res.getResolution());
+    }
+
+    AdaptiveResolution res(cfg);
+    TEST_ASSERT_EQUAL(DS18B20_RESOLUTION_12_BIT, res.getResolution());
+
+    // Heat-up drops to fast low resolution sampling
+    TEST_ASSERT_TRUE(res.update(20.0, 78.0));
+    TEST_ASSERT_EQUAL(DS18B20_RESOLUTION_9_BIT, res.getResolution());
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, res.getSamplePeriod());
+
+    // Entering the band switches to high resolution
+    TEST_ASSERT_FALSE(res.update(75.5, 78.0));
+    TEST_ASSERT_TRUE(res.update(76.5, 78.0));
+    TEST_ASSERT_EQUAL(DS18B20_RESOLUTION_12_BIT, res.getResolution());
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, res.getSamplePeriod());
+
+    // Hysteresis holds high resolution just outside the band
+    TEST_ASSERT_FALSE(res.update(75.7, 78.0));
+    TEST_ASSERT_FALSE(res.update(80.4, 78.0));
+    TEST_ASSERT_TRUE(res.update(80.6, 78.0));
+    TEST_ASSERT_EQUAL(DS18B20_RESOLUTION_9_BIT, res.getResolution());
+}
+
+TEST_CASE("ConversionTime", "[DS18B20Pipeline]")
+{
+    TEST_ASSERT_EQUAL_DOUBLE(0.09375, DS18B20Pipeline::getConversionTime(DS18B20_RESOLUTION_9_BIT));
+    TEST_ASSERT_EQUAL_DOUBLE(0.1875, DS18B20Pipeline::getConversionTime(DS18B20_RESOLUTION_10_BIT));
+    TEST_ASSERT_EQUAL_DOUBLE(0.375, DS18B20Pipeline::getConversionTime(DS18B20_RESOLUTION_11_BIT));
+    TEST_ASSERT_EQUAL_DOUBLE(0.75, DS18B20Pipeline::getConversionTime(DS18B20_RESOLUTION_12_BIT));
+}
+
+#ifdef __cplusplus
+}
+#endif
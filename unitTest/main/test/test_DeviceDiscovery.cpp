@@ -0,0 +1,149 @@
+#include "unity.h"
+#include "main/DeviceDiscovery.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void includeDeviceDiscoveryTests(void)
+{
+    // Dummy function to force discovery of unit tests by main test runner
+}
+
+static DeviceDiscoveryConfig validConfig(void)
+{
+    DeviceDiscoveryConfig cfg {};
+    cfg.period = 5.0;
+    cfg.missedPasses = 2;
+
+    return cfg;
+}
+
+static OneWireBus_ROMCode makeROM(uint8_t serial)
+{
+    OneWireBus_ROMCode romCode {};
+    romCode.bytes[0] = 0x28;
+    romCode.bytes[1] = serial;
+    romCode.bytes[7] = 0xAA;
+
+    return romCode;
+}
+
+static void runPass(DeviceDiscovery& discovery, int64_t t, const DeviceVector& devices, std::vector<DiscoveryEvent>& events)
+{
+    events.clear();
+    TEST_ASSERT_TRUE(discovery.passDue(t));
+    discovery.beginPass(t);
+    for (const OneWireBus_ROMCode& romCode : devices) {
+        discovery.found(romCode);
+    }
+    discovery.endPass(events);
+}
+
+TEST_CASE("checkInputs", "[DeviceDiscovery]")
+{
+    // Valid config
+    {
+        DeviceDiscoveryConfig cfg = validConfig();
+        TEST_ASSERT_EQUAL(PBRet::SUCCESS, DeviceDiscovery::checkInputs(cfg));
+    }
+
+    // Invalid period
+    {
+        DeviceDiscoveryConfig cfg = validConfig();
+        cfg.period = 0.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, DeviceDiscovery::checkInputs(cfg));
+    }
+
+    // Invalid missed passes
+    {
+        DeviceDiscoveryConfig cfg = validConfig();
+        cfg.missedPasses = 0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, DeviceDiscovery::checkInputs(cfg));
+    }
+}
+
+TEST_CASE("passScheduling", "[DeviceDiscovery]")
+{
+    DeviceDiscovery discovery(validConfig(), 0);
+    TEST_ASSERT_TRUE(discovery.isConfigured());
+
+    // First pass is due straight away, the next one period after it started
+    TEST_ASSERT_TRUE(discovery.passDue(0));
+    discovery.beginPass(0);
+    TEST_ASSERT_FALSE(discovery.passDue(6000000));
+
+    std::vector<DiscoveryEvent> events {};
+    discovery.endPass(events);
+    TEST_ASSERT_TRUE(discovery.hasCompletedPass());
+    TEST_ASSERT_FALSE(discovery.passDue(4999999));
+    TEST_ASSERT_TRUE(discovery.passDue(5000000));
+
+    // Unconfigured discovery never runs
+    DeviceDiscovery disabled {};
+    TEST_ASSERT_FALSE(disabled.passDue(0));
+}
+
+TEST_CASE("addRemoveEvents", "[DeviceDiscovery]")
+{
+    DeviceDiscovery discovery(validConfig(), 1);
+    std::vector<DiscoveryEvent> events {};
+    const OneWireBus_ROMCode a = makeROM(1);
+    const OneWireBus_ROMCode b = makeROM(2);
+
+    // Devices found on the first pass are added
+    runPass(discovery, 0, {a, b}, events);
+    TEST_ASSERT_EQUAL(2, events.size());
+    for (const DiscoveryEvent& event : events) {
+        TEST_ASSERT_TRUE(event.type == DiscoveryEvent::Type::ADDED);
+        TEST_ASSERT_EQUAL(1, event.bus);
+    }
+    TEST_ASSERT_TRUE(discovery.isKnown(a));
+
+    // Known devices don't generate events
+    runPass(discovery, 5000000, {a, b}, events);
+    TEST_ASSERT_EQUAL(0, events.size());
+
+    // A device missing for a single pass is kept
+    runPass(discovery, 10000000, {a}, events);
+    TEST_ASSERT_EQUAL(0, events.size());
+    TEST_ASSERT_TRUE(discovery.isKnown(b));
+
+    // and removed once it has been missed for missedPasses
+    runPass(discovery, 15000000, {a}, events);
+    TEST_ASSERT_EQUAL(1, events.size());
+    TEST_ASSERT_TRUE(events[0].type == DiscoveryEvent::Type::REMOVED);
+    TEST_ASSERT_EQUAL_MEMORY(b.bytes, events[0].romCode.bytes, sizeof(b.bytes));
+    TEST_ASSERT_FALSE(discovery.isKnown(b));
+
+    // Plugging it back in adds it again
+    runPass(discovery, 20000000, {a, b}, events);
+    TEST_ASSERT_EQUAL(1, events.size());
+    TEST_ASSERT_TRUE(events[0].type == DiscoveryEvent::Type::ADDED);
+
+    DeviceVector known {};
+    discovery.getKnownDevices(known);
+    TEST_ASSERT_EQUAL(2, known.size());
+}
+
+TEST_CASE("abortPass", "[DeviceDiscovery]")
+{
+    DeviceDiscovery discovery(validConfig(), 0);
+    std::vector<DiscoveryEvent> events {};
+    const OneWireBus_ROMCode a = makeROM(1);
+    runPass(discovery, 0, {a}, events);
+
+    // An aborted pass does not count as a miss
+    discovery.beginPass(5000000);
+    discovery.abortPass();
+    discovery.endPass(events);
+    TEST_ASSERT_FALSE(discovery.inPass());
+
+    runPass(discovery, 10000000, {}, events);
+    TEST_ASSERT_EQUAL(0, events.size());
+    TEST_ASSERT_TRUE(discovery.isKnown(a));
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,201 @@
+#include "unity.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include "main/ElementDriver.h"
+#include "testElementDriverConfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void includeElementDriverTests(void)
+{
+    // Dummy function to force discovery of unit tests by main test runner
+}
+
+static ElementDriverConfig validConfig(void)
+{
+    ElementDriverConfig cfg {};
+    cfg.slotFreq = 200.0;
+    cfg.mode = ModulationMode::SIGMA_DELTA;
+    cfg.timerGroup = TIMER_GROUP_1;
+    cfg.timerIdx = TIMER_0;
+
+    return cfg;
+}
+
+TEST_CASE("checkInputs", "[ElementDriver]")
+{
+    // Default configuration invalid
+    {
+        ElementDriverConfig cfg {};
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, ElementDriver::checkInputs(cfg));
+    }
+
+    // Valid config
+    {
+        ElementDriverConfig cfg = validConfig();
+        TEST_ASSERT_EQUAL(PBRet::SUCCESS, ElementDriver::checkInputs(cfg));
+    }
+
+    // Invalid slot frequency
+    {
+        ElementDriverConfig cfg = validConfig();
+        cfg.slotFreq = ElementDriverConfig::MAX_SLOT_FREQ + 1.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, ElementDriver::checkInputs(cfg));
+    }
+
+    // Invalid timer
+    {
+        ElementDriverConfig cfg = validConfig();
+        cfg.timerGroup = TIMER_GROUP_MAX;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, ElementDriver::checkInputs(cfg));
+    }
+
+    {
+        ElementDriverConfig cfg = validConfig();
+        cfg.timerIdx = TIMER_MAX;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, ElementDriver::checkInputs(cfg));
+    }
+
+    // Burst mode needs a window
+    {
+        ElementDriverConfig cfg = validConfig();
+        cfg.mode = ModulationMode::BURST;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, ElementDriver::checkInputs(cfg));
+        cfg.burstSlots = 50;
+        TEST_ASSERT_EQUAL(PBRet::SUCCESS, ElementDriver::checkInputs(cfg));
+    }
+}
+
+TEST_CASE("loadFromJSON", "[ElementDriver]")
+{
+    ElementDriverConfig testConfig {};
+    cJSON* root = cJSON_Parse(elementDriverTestConfig);
+    TEST_ASSERT_NOT_EQUAL(root, nullptr);
+
+    cJSON* cfg = cJSON_GetObjectItem(root, "validElementDriverConfig");
+    TEST_ASSERT_NOT_EQUAL(cfg, nullptr);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ElementDriver::loadFromJSON(testConfig, cfg));
+    TEST_ASSERT_EQUAL_DOUBLE(100.0, testConfig.slotFreq);
+    TEST_ASSERT_TRUE(testConfig.mode == ModulationMode::SIGMA_DELTA);
+    TEST_ASSERT_EQUAL(TIMER_GROUP_1, testConfig.timerGroup);
+    TEST_ASSERT_EQUAL(TIMER_0, testConfig.timerIdx);
+    TEST_ASSERT_EQUAL(GPIO_NUM_NC, testConfig.zeroCrossPin);
+
+    cfg = cJSON_GetObjectItem(root, "burstElementDriverConfig");
+    TEST_ASSERT_NOT_EQUAL(cfg, nullptr);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ElementDriver::loadFromJSON(testConfig, cfg));
+    TEST_ASSERT_TRUE(testConfig.mode == ModulationMode::BURST);
+    TEST_ASSERT_EQUAL(50, testConfig.burstSlots);
+    TEST_ASSERT_EQUAL(TIMER_1, testConfig.timerIdx);
+    TEST_ASSERT_EQUAL(GPIO_NUM_34, testConfig.zeroCrossPin);
+
+    // Burst mode without a window
+    cfg = cJSON_GetObjectItem(root, "invalidElementDriverConfig");
+    TEST_ASSERT_NOT_EQUAL(cfg, nullptr);
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, ElementDriver::loadFromJSON(testConfig, cfg));
+
+    cJSON_Delete(root);
+}
+
+// Edge timestamps are captured by reading the output back through its own
+// input buffer, so they measure the pin rather than the driver's intent
+static constexpr gpio_num_t TestPin = GPIO_NUM_25;
+static constexpr size_t MaxEdges = 128;
+static DRAM_ATTR int64_t edgeTimes[MaxEdges] {};
+static std::atomic<size_t> edgeCount {0};
+
+static void IRAM_ATTR edgeISR(void* arg)
+{
+    const size_t i = edgeCount.load();
+    if (i < MaxEdges) {
+        edgeTimes[i] = esp_timer_get_time();
+        edgeCount.store(i + 1);
+    }
+}
+
+// Spins without yielding until the deadline, starving every task below it
+static void loadTask(void* arg)
+{
+    const int64_t end = *static_cast<const int64_t*>(arg);
+    volatile double sink = 1.0;
+    while (esp_timer_get_time() < end) {
+        sink = sink * 1.0000001 + 1e-9;
+    }
+    vTaskDelete(nullptr);
+}
+
+// Waits for a run of edges and returns the worst deviation of any interval
+// from the slot period [us]
+static int64_t measureJitter(int64_t slotPeriod)
+{
+    vTaskDelay(pdMS_TO_TICKS(slotPeriod * (MaxEdges + 4) / 1000));
+    TEST_ASSERT_EQUAL(MaxEdges, edgeCount.load());
+
+    int64_t worst = 0;
+    for (size_t i = 1; i < MaxEdges; i++) {
+        worst = std::max(worst, std::abs(edgeTimes[i] - edgeTimes[i - 1] - slotPeriod));
+    }
+
+    return worst;
+}
+
+TEST_CASE("edgeTimingUnderLoad", "[ElementDriver]")
+{
+    static constexpr int64_t MaxJitter = 50;       // [us]
+
+    const gpio_config_t pinConf {
+        .pin_bit_mask = (1ULL << TestPin),
+        .mode = GPIO_MODE_INPUT_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_ANYEDGE
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, gpio_config(&pinConf));
+    const esp_err_t err = gpio_install_isr_service(0);
+    TEST_ASSERT_TRUE((err == ESP_OK) || (err == ESP_ERR_INVALID_STATE));
+    TEST_ASSERT_EQUAL(ESP_OK, gpio_isr_handler_add(TestPin, edgeISR, nullptr));
+
+    // Half duty sigma-delta toggles every slot, so every slot boundary is
+    // an edge
+    const ElementDriverConfig cfg = validConfig();
+    const int64_t slotPeriod = static_cast<int64_t>(1e6 / cfg.slotFreq);
+    ElementDriver driver {};
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, driver.setDuty(Element::LP, 0.5));
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, driver.start(cfg, {TestPin, GPIO_NUM_NC}));
+    TEST_ASSERT_TRUE(driver.isRunning());
+
+    edgeCount.store(0);
+    const int64_t idleJitter = measureJitter(slotPeriod);
+
+    // Saturate both cores with the highest priority tasks for longer than
+    // the measurement. Nothing task driven could switch the pin now. The
+    // test task matches their priority so it isn't preempted until both
+    // are running
+    const UBaseType_t testPriority = uxTaskPriorityGet(nullptr);
+    vTaskPrioritySet(nullptr, configMAX_PRIORITIES - 1);
+    const int64_t loadEnd = esp_timer_get_time() + slotPeriod * (MaxEdges + 8);
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreatePinnedToCore(loadTask, "load0", 2048, (void*) &loadEnd, configMAX_PRIORITIES - 1, nullptr, 0));
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreatePinnedToCore(loadTask, "load1", 2048, (void*) &loadEnd, configMAX_PRIORITIES - 1, nullptr, 1));
+    edgeCount.store(0);
+    const int64_t loadedJitter = measureJitter(slotPeriod);
+    vTaskPrioritySet(nullptr, testPriority);
+
+    printf("Edge jitter idle: %lld us, loaded: %lld us\n", idleJitter, loadedJitter);
+    TEST_ASSERT_TRUE(idleJitter <= MaxJitter);
+    TEST_ASSERT_TRUE(loadedJitter <= MaxJitter);
+
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, driver.stop());
+    TEST_ASSERT_FALSE(driver.isRunning());
+    TEST_ASSERT_EQUAL(0, gpio_get_level(TestPin));
+    gpio_isr_handler_remove(TestPin);
+    gpio_reset_pin(TestPin);
+}
+
+#ifdef __cplusplus
+}
+#endif
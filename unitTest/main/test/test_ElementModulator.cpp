@@ -0,0 +1,147 @@
+#include "unity.h"
+#include <cmath>
+#include "main/ElementModulator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void includeElementModulatorTests(void)
+{
+    // Dummy function to force discovery of unit tests by main test runner
+}
+
+static constexpr double slotFreq = 100.0;       // 50 Hz mains, a slot per half cycle [Hz]
+
+// Runs the modulator for a number of slots. Checks the on time never
+// strays from the ideal by more than maxError slots, and returns the
+// longest run of identical slots
+static size_t checkDuty(ElementModulator& modulator, double duty, size_t slots, double maxError)
+{
+    size_t onSlots = 0;
+    size_t run = 0;
+    size_t longestRun = 0;
+    bool last = false;
+    for (size_t i = 0; i < slots; i++) {
+        const bool on = modulator.step();
+        onSlots += on ? 1 : 0;
+        run = ((i > 0) && (on == last)) ? run + 1 : 1;
+        longestRun = std::max(longestRun, run);
+        last = on;
+
+        TEST_ASSERT_TRUE(std::abs(onSlots - duty * (i + 1)) <= maxError);
+    }
+
+    return longestRun;
+}
+
+TEST_CASE("setDuty", "[ElementModulator]")
+{
+    ElementModulator modulator {};
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, modulator.setDuty(0.37));
+    TEST_ASSERT_DOUBLE_WITHIN(1.0 / ElementModulator::DutyOne, 0.37, modulator.getDuty());
+
+    // Out of range duty is rejected and the last one kept
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, modulator.setDuty(1.1));
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, modulator.setDuty(-0.1));
+    TEST_ASSERT_DOUBLE_WITHIN(1.0 / ElementModulator::DutyOne, 0.37, modulator.getDuty());
+
+    // Off and full power are exact
+    modulator.setMode(ModulationMode::SIGMA_DELTA, 1);
+    modulator.setDuty(0.0);
+    for (int i = 0; i < 1000; i++) {
+        TEST_ASSERT_FALSE(modulator.step());
+    }
+    modulator.setDuty(1.0);
+    for (int i = 0; i < 1000; i++) {
+        TEST_ASSERT_TRUE(modulator.step());
+    }
+}
+
+TEST_CASE("sigmaDeltaAccuracy", "[ElementModulator]")
+{
+    // An hour at each duty. The on time is never more than a slot from
+    // ideal, and on and off slots are spread as evenly as they can be
+    const size_t slots = 3600 * slotFreq;
+    for (double duty : {0.001, 0.013, 0.1, 0.25, 1.0 / 3.0, 0.5, 0.618, 0.9, 0.999}) {
+        ElementModulator modulator {};
+        modulator.setMode(ModulationMode::SIGMA_DELTA, 1);
+        modulator.setDuty(duty);
+
+        const double quantised = modulator.getDuty();
+        const size_t longestRun = checkDuty(modulator, quantised, slots, 1.0);
+        const double evenRun = std::ceil(std::max(1.0 / duty, 1.0 / (1.0 - duty)));
+        TEST_ASSERT_TRUE(longestRun <= evenRun);
+
+        // Fixed point duty is within half a step of the request
+        TEST_ASSERT_TRUE(std::abs(quantised - duty) <= 0.5 / ElementModulator::DutyOne);
+    }
+}
+
+TEST_CASE("burstAccuracy", "[ElementModulator]")
+{
+    // Whole windows on then off. The energy left over is carried, so the
+    // error is bounded by a window and doesn't grow
+    const size_t slots = 3600 * slotFreq;
+    const uint32_t window = 50;
+    for (double duty : {0.001, 0.013, 0.1, 0.25, 1.0 / 3.0, 0.5, 0.618, 0.9, 0.999}) {
+        ElementModulator modulator {};
+        modulator.setMode(ModulationMode::BURST, window);
+        modulator.setDuty(duty);
+
+        checkDuty(modulator, modulator.getDuty(), slots, window);
+    }
+
+    // At most one on and one off run per window
+    ElementModulator modulator {};
+    modulator.setMode(ModulationMode::BURST, window);
+    modulator.setDuty(0.3);
+    size_t switches = 0;
+    bool last = false;
+    for (size_t i = 0; i < 100 * window; i++) {
+        const bool on = modulator.step();
+        switches += (on != last) ? 1 : 0;
+        last = on;
+    }
+    TEST_ASSERT_TRUE(switches <= 2 * 100);
+}
+
+TEST_CASE("dutyChange", "[ElementModulator]")
+{
+    // A new duty is tracked from the slot it is set, with the old
+    // modulation's error carried over rather than lost
+    ElementModulator modulator {};
+    modulator.setMode(ModulationMode::SIGMA_DELTA, 1);
+    double ideal = 0.0;
+    size_t onSlots = 0;
+    for (int change = 0; change < 100; change++) {
+        const double duty = 0.5 + 0.45 * std::sin(0.7 * change);
+        modulator.setDuty(duty);
+        for (int i = 0; i < 137; i++) {
+            onSlots += modulator.step() ? 1 : 0;
+            ideal += modulator.getDuty();
+            TEST_ASSERT_TRUE(std::abs(onSlots - ideal) <= 1.0);
+        }
+    }
+
+    // Resolution is finer than any PWM period. Duties a hundredth of a
+    // percent apart give measurably different energy
+    ElementModulator a {};
+    ElementModulator b {};
+    a.setMode(ModulationMode::SIGMA_DELTA, 1);
+    b.setMode(ModulationMode::SIGMA_DELTA, 1);
+    a.setDuty(0.5);
+    b.setDuty(0.5001);
+    size_t aSlots = 0;
+    size_t bSlots = 0;
+    for (int i = 0; i < 100000; i++) {
+        aSlots += a.step() ? 1 : 0;
+        bSlots += b.step() ? 1 : 0;
+    }
+    TEST_ASSERT_EQUAL(50000, aSlots);
+    TEST_ASSERT_EQUAL(50010, bSlots);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,107 @@
+#include "unity.h"
+#include "main/Feedforward.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void includeFeedforwardTests(void)
+{
+    // Dummy function to force discovery of unit tests by main test runner
+}
+
+static FeedforwardConfig validConfig(void)
+{
+    FeedforwardConfig cfg {};
+    cfg.LPElementGain = 150.0;
+    cfg.HPElementGain = 300.0;
+    cfg.boilerTempGain = -1.0;
+    cfg.boilerTempRef = 20.0;
+    cfg.boilerTemp = {85.0, 90.0};
+    cfg.vapourFraction = {0.0, 1.0};
+
+    return cfg;
+}
+
+TEST_CASE("checkInputs", "[Feedforward]")
+{
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, Feedforward::checkInputs(validConfig()));
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, Feedforward::checkInputs(FeedforwardConfig {}));
+
+    // Negative element gain
+    {
+        FeedforwardConfig cfg = validConfig();
+        cfg.HPElementGain = -1.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, Feedforward::checkInputs(cfg));
+        Feedforward ff(cfg);
+        TEST_ASSERT_FALSE(ff.isConfigured());
+    }
+
+    // Curve lengths differ
+    {
+        FeedforwardConfig cfg = validConfig();
+        cfg.vapourFraction.push_back(1.0);
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, Feedforward::checkInputs(cfg));
+    }
+
+    // Single point curve
+    {
+        FeedforwardConfig cfg = validConfig();
+        cfg.boilerTemp = {90.0};
+        cfg.vapourFraction = {1.0};
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, Feedforward::checkInputs(cfg));
+    }
+
+    // Fraction out of range
+    {
+        FeedforwardConfig cfg = validConfig();
+        cfg.vapourFraction[1] = 1.5;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, Feedforward::checkInputs(cfg));
+    }
+
+    // Temperatures not increasing
+    {
+        FeedforwardConfig cfg = validConfig();
+        cfg.boilerTemp[1] = 85.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, Feedforward::checkInputs(cfg));
+    }
+}
+
+TEST_CASE("compute", "[Feedforward]")
+{
+    // Unconfigured feedforward adds nothing
+    {
+        Feedforward ff {};
+        TEST_ASSERT_EQUAL_DOUBLE(0.0, ff.compute(1.0, 1.0, 95.0));
+    }
+
+    // Without a vapour curve the gains apply at all temperatures
+    {
+        FeedforwardConfig cfg = validConfig();
+        cfg.boilerTemp.clear();
+        cfg.vapourFraction.clear();
+        Feedforward ff(cfg);
+        TEST_ASSERT_TRUE(ff.isConfigured());
+        TEST_ASSERT_DOUBLE_WITHIN(1e-9, 150.0 * 0.5 + 300.0 - 70.0, ff.compute(0.5, 1.0, 90.0));
+        TEST_ASSERT_DOUBLE_WITHIN(1e-9, 300.0 - 30.0, ff.compute(0.0, 1.0, 50.0));
+    }
+
+    // Scaled along the vapour curve and held past its ends
+    {
+        Feedforward ff(validConfig());
+        TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, ff.compute(1.0, 1.0, 20.0));
+        TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, ff.compute(1.0, 1.0, 85.0));
+        TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.5 * (450.0 - 67.5), ff.compute(1.0, 1.0, 87.5));
+        TEST_ASSERT_DOUBLE_WITHIN(1e-9, 450.0 - 75.0, ff.compute(1.0, 1.0, 95.0));
+    }
+
+    // Never asks for negative pump speed
+    {
+        Feedforward ff(validConfig());
+        TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, ff.compute(0.0, 0.1, 95.0));
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,6 +1,8 @@
 #include "unity.h"
 #include "main/Flowmeter.h"
+#include "MockPulseCounter.h"
 #include "testFlowmeterConfig.h"
+#include <cmath>
 
 #ifdef __cplusplus
 extern "C" {
@@ -20,12 +22,6 @@ static FlowmeterConfig validConfig(void)
     return cfg;
 }
 
-class FlowmeterUT
-{
-    public:
-        static void setFreqCounter(Flowmeter& flow, uint16_t freqCount) { flow._freqCounter = freqCount; }
-};
-
 TEST_CASE("Constructor", "[Flowmeter]")
 {
     // Default object not configured
@@ -75,6 +71,61 @@ TEST_CASE("checkInputs", "[Flowmeter]")
         cfg.kFactor = -1;
         TEST_ASSERT_EQUAL(PBRet::FAILURE, Flowmeter::checkInputs(cfg));
     }
+
+    // Invalid PCNT unit
+    {
+        FlowmeterConfig cfg = validConfig();
+        cfg.pcntUnit = PCNT_UNIT_MAX;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, Flowmeter::checkInputs(cfg));
+    }
+
+    // Negative period mode rate
+    {
+        FlowmeterConfig cfg = validConfig();
+        cfg.periodModeRate = -1.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, Flowmeter::checkInputs(cfg));
+    }
+
+    // K-factor curve replaces kFactor
+    {
+        FlowmeterConfig cfg = validConfig();
+        cfg.kFactor = 0.0;
+        cfg.kFactorFrequency = {1.0, 10.0, 100.0};
+        cfg.kFactorCurve = {0.0030, 0.0026, 0.0025};
+        TEST_ASSERT_EQUAL(PBRet::SUCCESS, Flowmeter::checkInputs(cfg));
+    }
+
+    // K-factor curve with mismatched lengths
+    {
+        FlowmeterConfig cfg = validConfig();
+        cfg.kFactorFrequency = {1.0, 10.0, 100.0};
+        cfg.kFactorCurve = {0.0030, 0.0026};
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, Flowmeter::checkInputs(cfg));
+    }
+
+    // K-factor curve with a single point
+    {
+        FlowmeterConfig cfg = validConfig();
+        cfg.kFactorFrequency = {1.0};
+        cfg.kFactorCurve = {0.0030};
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, Flowmeter::checkInputs(cfg));
+    }
+
+    // K-factor curve frequencies not increasing
+    {
+        FlowmeterConfig cfg = validConfig();
+        cfg.kFactorFrequency = {1.0, 10.0, 10.0};
+        cfg.kFactorCurve = {0.0030, 0.0026, 0.0025};
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, Flowmeter::checkInputs(cfg));
+    }
+
+    // K-factor curve with invalid K
+    {
+        FlowmeterConfig cfg = validConfig();
+        cfg.kFactorFrequency = {1.0, 10.0};
+        cfg.kFactorCurve = {0.0030, 0.0};
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, Flowmeter::checkInputs(cfg));
+    }
 }
 
 TEST_CASE("loadFromJSONValid", "[Flowmeter]")
@@ -88,6 +139,28 @@ TEST_CASE("loadFromJSONValid", "[Flowmeter]")
     TEST_ASSERT_NOT_EQUAL(cfg, nullptr);
 
     TEST_ASSERT_EQUAL(PBRet::SUCCESS, Flowmeter::loadFromJSON(testConfig, cfg));
+    TEST_ASSERT_EQUAL_DOUBLE(0.0025, testConfig.kFactor);
+    TEST_ASSERT_EQUAL(0, testConfig.pcntUnit);
+    TEST_ASSERT_EQUAL_DOUBLE(10.0, testConfig.periodModeRate);
+
+    // PCNT unit is optional
+    cfg = cJSON_GetObjectItem(root, "ISRFlowmeterConfig");
+    TEST_ASSERT_NOT_EQUAL(cfg, nullptr);
+
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, Flowmeter::loadFromJSON(testConfig, cfg));
+    TEST_ASSERT_EQUAL(-1, testConfig.pcntUnit);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, testConfig.periodModeRate);
+    TEST_ASSERT_EQUAL(0, testConfig.kFactorCurve.size());
+
+    // K-factor curve replaces kFactor
+    cfg = cJSON_GetObjectItem(root, "curveFlowmeterConfig");
+    TEST_ASSERT_NOT_EQUAL(cfg, nullptr);
+
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, Flowmeter::loadFromJSON(testConfig, cfg));
+    TEST_ASSERT_EQUAL(3, testConfig.kFactorCurve.size());
+    TEST_ASSERT_EQUAL_DOUBLE(10.0, testConfig.kFactorFrequency[1]);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0026, testConfig.kFactorCurve[1]);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, Flowmeter::checkInputs(testConfig));
 }
 
 TEST_CASE("loadFromJSONInvalid", "[Flowmeter]")
@@ -101,12 +174,19 @@ TEST_CASE("loadFromJSONInvalid", "[Flowmeter]")
     TEST_ASSERT_NOT_EQUAL(cfg, nullptr);
 
     TEST_ASSERT_EQUAL(PBRet::FAILURE, Flowmeter::loadFromJSON(testConfig, cfg));
+
+    // Incomplete K-factor curve point
+    cfg = cJSON_GetObjectItem(root, "invalidCurveFlowmeterConfig");
+    TEST_ASSERT_NOT_EQUAL(cfg, nullptr);
+
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, Flowmeter::loadFromJSON(testConfig, cfg));
 }
 
 TEST_CASE("readMassFlowrate", "[Flowmeter]")
 {
     FlowmeterConfig cfg = validConfig();
-    Flowmeter flow(cfg);
+    MockPulseCounter* counter = new MockPulseCounter();
+    Flowmeter flow(cfg, std::unique_ptr<PulseCounter>(counter));
     TEST_ASSERT_TRUE(flow.isConfigured());
     double flowrate = 0.0;
 
@@ -114,17 +194,230 @@ TEST_CASE("readMassFlowrate", "[Flowmeter]")
     TEST_ASSERT_EQUAL(PBRet::FAILURE, flow.readMassFlowrate(-1, flowrate));
 
     // Valid flowmeter update
-    FlowmeterUT::setFreqCounter(flow, 1);
+    counter->addPulses(1);
     TEST_ASSERT_EQUAL(PBRet::SUCCESS, flow.readMassFlowrate(1e6, flowrate));
-    TEST_ASSERT_EQUAL(1.0, flowrate);
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, flow.getVolumetricFlowrate());
+    TEST_ASSERT_EQUAL_DOUBLE(flow.getDensity(), flowrate);
 
     // Check internal time is updated
-    FlowmeterUT::setFreqCounter(flow, 1);
+    counter->addPulses(1);
     TEST_ASSERT_EQUAL(PBRet::SUCCESS, flow.readMassFlowrate(2e6, flowrate));
-    TEST_ASSERT_EQUAL(1.0, flowrate);
+    TEST_ASSERT_EQUAL_DOUBLE(flow.getDensity(), flowrate);
+
+    // Flowrate belongs to the middle of the window
+    TEST_ASSERT_EQUAL(1500000, flow.getSampleTime());
 
     // Check internal flowrate is set
-    TEST_ASSERT_EQUAL(1.0, flow.getFlowrate());
+    TEST_ASSERT_EQUAL_DOUBLE(flow.getDensity(), flow.getFlowrate());
+}
+
+TEST_CASE("readMassFlowrateHighCount", "[Flowmeter]")
+{
+    // More pulses than the old 16 bit counter could hold in one window
+    FlowmeterConfig cfg = validConfig();
+    MockPulseCounter* counter = new MockPulseCounter();
+    Flowmeter flow(cfg, std::unique_ptr<PulseCounter>(counter));
+    double flowrate = 0.0;
+
+    counter->addPulses(100000);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, flow.readMassFlowrate(1e6, flowrate));
+    TEST_ASSERT_EQUAL_DOUBLE(100000.0, flow.getVolumetricFlowrate());
+}
+
+TEST_CASE("readMassFlowrateWrap", "[Flowmeter]")
+{
+    // Pulses are counted across the 32 bit counter wrapping
+    FlowmeterConfig cfg = validConfig();
+    MockPulseCounter* counter = new MockPulseCounter(UINT32_MAX - 9);
+    Flowmeter flow(cfg, std::unique_ptr<PulseCounter>(counter));
+    double flowrate = 0.0;
+
+    counter->addPulses(30);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, flow.readMassFlowrate(1e6, flowrate));
+    TEST_ASSERT_EQUAL_DOUBLE(30.0, flow.getVolumetricFlowrate());
+}
+
+TEST_CASE("densityCorrection", "[Flowmeter]")
+{
+    FlowmeterConfig cfg = validConfig();
+    MockPulseCounter* counter = new MockPulseCounter();
+    Flowmeter flow(cfg, std::unique_ptr<PulseCounter>(counter));
+    double flowrate = 0.0;
+
+    // Reference temperature until told otherwise
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 0.99821, flow.getDensity());
+
+    // Table points
+    flow.setFluidTemperature(60.0);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 0.98320, flow.getDensity());
+
+    // Between table points
+    flow.setFluidTemperature(62.5);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 0.981875, flow.getDensity());
+
+    // Out of range temperatures are clamped
+    flow.setFluidTemperature(120.0);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 0.95835, flow.getDensity());
+    flow.setFluidTemperature(-5.0);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 0.99984, flow.getDensity());
+
+    // Invalid temperatures are ignored
+    flow.setFluidTemperature(NAN);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 0.99984, flow.getDensity());
+
+    // Mass flow is volume flow times density
+    flow.setFluidTemperature(80.0);
+    counter->addPulses(10);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, flow.readMassFlowrate(1e6, flowrate));
+    TEST_ASSERT_EQUAL_DOUBLE(10.0, flow.getVolumetricFlowrate());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 10.0 * 0.97179, flowrate);
+}
+
+TEST_CASE("kFactorCurve", "[Flowmeter]")
+{
+    FlowmeterConfig cfg = validConfig();
+    cfg.kFactorFrequency = {1.0, 10.0, 100.0};
+    cfg.kFactorCurve = {0.0030, 0.0026, 0.0025};
+    MockPulseCounter* counter = new MockPulseCounter();
+    Flowmeter flow(cfg, std::unique_ptr<PulseCounter>(counter));
+    TEST_ASSERT_TRUE(flow.isConfigured());
+    double flowrate = 0.0;
+
+    // On a breakpoint
+    counter->addPulses(10);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, flow.readMassFlowrate(1e6, flowrate));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-12, 10.0 * 0.0026, flow.getVolumetricFlowrate());
+
+    // Between breakpoints
+    counter->addPulses(55);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, flow.readMassFlowrate(2e6, flowrate));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-12, 55.0 * 0.00255, flow.getVolumetricFlowrate());
+
+    // Above the curve uses the last K
+    counter->addPulses(200);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, flow.readMassFlowrate(3e6, flowrate));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-12, 200.0 * 0.0025, flow.getVolumetricFlowrate());
+
+    // Zero flow uses the first K
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, flow.readMassFlowrate(4e6, flowrate));
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, flow.getVolumetricFlowrate());
+}
+
+// Feed a pulse train at rate [Hz] into a flowmeter, reading it every
+// second. Returns the RMS error of the flowrate once settled
+static double pulseTrainError(Flowmeter& flow, MockPulseCounter& counter, double rate, double phase)
+{
+    const int64_t second = 1000000;
+    int pulse = 0;
+    double sumSq = 0.0;
+    int n = 0;
+    for (int64_t t = second; t <= 60 * second; t += second) {
+        int64_t pulseTime = static_cast<int64_t>((pulse + phase) * 1e6 / rate);
+        while (pulseTime <= t) {
+            counter.addPulse(pulseTime);
+            pulse++;
+            pulseTime = static_cast<int64_t>((pulse + phase) * 1e6 / rate);
+        }
+
+        double flowrate = 0.0;
+        TEST_ASSERT_EQUAL(PBRet::SUCCESS, flow.readMassFlowrate(t, flowrate));
+        flowrate = flow.getVolumetricFlowrate();
+        if (t > 5 * second) {
+            sumSq += (flowrate - rate) * (flowrate - rate);
+            n++;
+        }
+    }
+
+    return std::sqrt(sumSq / n);
+}
+
+TEST_CASE("periodModeResolution", "[Flowmeter]")
+{
+    // Low rates are badly quantised when counted over a one second window.
+    // Measuring pulse periods resolves them far more finely
+    const double rates[] = {0.7, 1.3, 2.6, 3.7, 6.1};
+    for (double rate : rates) {
+        FlowmeterConfig countCfg = validConfig();
+        MockPulseCounter* countCounter = new MockPulseCounter();
+        Flowmeter countFlow(countCfg, std::unique_ptr<PulseCounter>(countCounter));
+
+        FlowmeterConfig periodCfg = validConfig();
+        periodCfg.periodModeRate = 10.0;
+        MockPulseCounter* periodCounter = new MockPulseCounter();
+        Flowmeter periodFlow(periodCfg, std::unique_ptr<PulseCounter>(periodCounter));
+
+        const double countError = pulseTrainError(countFlow, *countCounter, rate, 0.37);
+        const double periodError = pulseTrainError(periodFlow, *periodCounter, rate, 0.37);
+        TEST_ASSERT_TRUE(periodFlow.getMode() == FlowmeterMode::PERIOD);
+        TEST_ASSERT_TRUE(periodError * 100.0 < countError);
+        printf("%.1f Hz: count RMS error %.4f Hz, period RMS error %.6f Hz\n", rate, countError, periodError);
+    }
+}
+
+TEST_CASE("periodModeSwitching", "[Flowmeter]")
+{
+    FlowmeterConfig cfg = validConfig();
+    cfg.periodModeRate = 10.0;
+    MockPulseCounter* counter = new MockPulseCounter();
+    Flowmeter flow(cfg, std::unique_ptr<PulseCounter>(counter));
+    double flowrate = 0.0;
+
+    // High rate is counted
+    counter->addPulses(50);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, flow.readMassFlowrate(1e6, flowrate));
+    TEST_ASSERT_TRUE(flow.getMode() == FlowmeterMode::COUNT);
+    TEST_ASSERT_FALSE(counter->isTimestamping());
+
+    // Dropping below the threshold enables edge times
+    counter->addPulses(5);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, flow.readMassFlowrate(2e6, flowrate));
+    TEST_ASSERT_TRUE(flow.getMode() == FlowmeterMode::PERIOD);
+    TEST_ASSERT_TRUE(counter->isTimestamping());
+
+    // Within the hysteresis band the mode holds
+    for (int64_t t = 2000000 + 83333; t <= 3000000; t += 83333) {
+        counter->addPulse(t);
+    }
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, flow.readMassFlowrate(3e6, flowrate));
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 12.0, flow.getVolumetricFlowrate());
+    TEST_ASSERT_TRUE(flow.getMode() == FlowmeterMode::PERIOD);
+
+    // More edges than the queue holds falls back to the count, which is
+    // high enough to switch back to counting
+    for (int64_t t = 3000000 + 20000; t <= 4000000; t += 20000) {
+        counter->addPulse(t);
+    }
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, flow.readMassFlowrate(4e6, flowrate));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 50.0, flow.getVolumetricFlowrate());
+    TEST_ASSERT_TRUE(flow.getMode() == FlowmeterMode::COUNT);
+    TEST_ASSERT_FALSE(counter->isTimestamping());
+}
+
+TEST_CASE("periodModeFlowStops", "[Flowmeter]")
+{
+    FlowmeterConfig cfg = validConfig();
+    cfg.periodModeRate = 10.0;
+    MockPulseCounter* counter = new MockPulseCounter();
+    Flowmeter flow(cfg, std::unique_ptr<PulseCounter>(counter));
+    double flowrate = 0.0;
+
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, flow.readMassFlowrate(1e6, flowrate));
+    TEST_ASSERT_TRUE(flow.getMode() == FlowmeterMode::PERIOD);
+
+    // 2 Hz, last edge at 2s
+    for (int64_t t = 1500000; t <= 2000000; t += 500000) {
+        counter->addPulse(t);
+    }
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, flow.readMassFlowrate(2e6, flowrate));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 2.0, flow.getVolumetricFlowrate());
+
+    // No more edges. The rate is bounded by the time since the last one
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, flow.readMassFlowrate(4e6, flowrate));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.5, flow.getVolumetricFlowrate());
+
+    // Long enough without an edge is zero flow
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, flow.readMassFlowrate(8e6, flowrate));
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, flowrate);
 }
 
 #ifdef __cplusplus
@@ -0,0 +1,122 @@
+#include "unity.h"
+#include "main/GainSchedule.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void includeGainScheduleTests(void)
+{
+    // Dummy function to force discovery of unit tests by main test runner
+}
+
+static GainScheduleConfig validConfig(void)
+{
+    GainScheduleConfig cfg {};
+    cfg.variable = ScheduleVariable::HEAD_TEMP;
+    cfg.points = {
+        {78.0, 300.0, 3.0, 0.0},
+        {80.0, 200.0, 2.0, 100.0},
+        {90.0, 100.0, 1.0, 0.0}
+    };
+
+    return cfg;
+}
+
+TEST_CASE("checkInputs", "[GainSchedule]")
+{
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, GainSchedule::checkInputs(validConfig()));
+
+    // Empty schedule is valid, but disables scheduling
+    {
+        GainScheduleConfig cfg {};
+        TEST_ASSERT_EQUAL(PBRet::SUCCESS, GainSchedule::checkInputs(cfg));
+        GainSchedule schedule(cfg);
+        TEST_ASSERT_FALSE(schedule.isConfigured());
+    }
+
+    // Points out of order
+    {
+        GainScheduleConfig cfg = validConfig();
+        cfg.points[1].x = 78.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, GainSchedule::checkInputs(cfg));
+    }
+
+    // Negative gain
+    {
+        GainScheduleConfig cfg = validConfig();
+        cfg.points[2].IGain = -1.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, GainSchedule::checkInputs(cfg));
+    }
+
+    // Too many points
+    {
+        GainScheduleConfig cfg {};
+        for (size_t i = 0; i < GainSchedule::MaxPoints + 1; i++) {
+            cfg.points.push_back({static_cast<double>(i), 1.0, 1.0, 1.0});
+        }
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, GainSchedule::checkInputs(cfg));
+        GainSchedule schedule(cfg);
+        TEST_ASSERT_FALSE(schedule.isConfigured());
+    }
+}
+
+TEST_CASE("evaluate", "[GainSchedule]")
+{
+    GainSchedule schedule(validConfig());
+    TEST_ASSERT_TRUE(schedule.isConfigured());
+    TEST_ASSERT_EQUAL(3, schedule.size());
+
+    // Held below the table
+    GainSchedulePoint gains = schedule.evaluate(20.0);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 300.0, gains.PGain);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 3.0, gains.IGain);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, gains.DGain);
+
+    // Interpolated, moving up the table
+    gains = schedule.evaluate(79.0);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 250.0, gains.PGain);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 2.5, gains.IGain);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 50.0, gains.DGain);
+
+    gains = schedule.evaluate(80.0);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 200.0, gains.PGain);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 100.0, gains.DGain);
+
+    gains = schedule.evaluate(87.5);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 125.0, gains.PGain);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 1.25, gains.IGain);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 25.0, gains.DGain);
+
+    // Held above the table
+    gains = schedule.evaluate(100.0);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 100.0, gains.PGain);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 1.0, gains.IGain);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, gains.DGain);
+
+    // Back down across two segments in one step
+    gains = schedule.evaluate(78.5);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 275.0, gains.PGain);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 2.75, gains.IGain);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 25.0, gains.DGain);
+}
+
+TEST_CASE("boilerABV", "[GainSchedule]")
+{
+    // Ends of the equilibrium table
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 0.0, GainSchedule::boilerABV(100.0));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 97.129, GainSchedule::boilerABV(78.174));
+
+    // Clamped outside it
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 0.0, GainSchedule::boilerABV(105.0));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 97.129, GainSchedule::boilerABV(20.0));
+
+    // A typical wash boils around 92 deg C at 10-11% ABV
+    const double ABV = GainSchedule::boilerABV(92.1);
+    TEST_ASSERT_TRUE(ABV > 8.0);
+    TEST_ASSERT_TRUE(ABV < 14.0);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,262 @@
+#include "unity.h"
+#include <cmath>
+#include <vector>
+#include "main/ModelPredictive.h"
+#include "esp_timer.h"
+#include "PlantModel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void includeModelPredictiveTests(void)
+{
+    // Dummy function to force discovery of unit tests by main test runner
+}
+
+static constexpr double dt = 1.0;
+static constexpr double outputMin = 50.0;
+static constexpr double outputMax = 1024.0;
+
+static MPCConfig validConfig(void)
+{
+    // Identified from pump steps on the plant model near the azeotrope
+    MPCConfig cfg {};
+    cfg.processGain = -0.025;
+    cfg.timeConstant = 55.0;
+    cfg.deadTime = 2.0;
+    cfg.predictionHorizon = 60;
+    cfg.controlHorizon = 4;
+    cfg.moveWeight = 1.0;
+
+    return cfg;
+}
+
+// The controller's own model, with an unmeasured constant disturbance on
+// the head temperature
+class FOPDTModel
+{
+    public:
+        FOPDTModel(const MPCConfig& cfg, double y0, double u0)
+            : _a(std::exp(-dt / cfg.timeConstant)), _b(cfg.processGain * (1.0 - std::exp(-dt / cfg.timeConstant))),
+              _delay(std::lround(cfg.deadTime / dt), u0), _y(y0), _offset(y0 - cfg.processGain * u0) {}
+
+        double step(double u, double disturbance)
+        {
+            _delay.insert(_delay.begin(), u);
+            const double uDelayed = _delay.back();
+            _delay.pop_back();
+            _y = _a * _y + (1.0 - _a) * _offset + _b * uDelayed + (1.0 - _a) * disturbance;
+            return _y;
+        }
+
+    private:
+        double _a = 0.0;
+        double _b = 0.0;
+        std::vector<double> _delay {};
+        double _y = 0.0;
+        double _offset = 0.0;
+};
+
+TEST_CASE("checkInputs", "[MPC]")
+{
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, ModelPredictiveController::checkInputs(validConfig(), dt));
+
+    // Empty horizon disables MPC
+    {
+        TEST_ASSERT_EQUAL(PBRet::SUCCESS, ModelPredictiveController::checkInputs(MPCConfig {}, dt));
+        ModelPredictiveController mpc(MPCConfig {}, dt, outputMin, outputMax);
+        TEST_ASSERT_FALSE(mpc.isConfigured());
+    }
+
+    // Zero process gain
+    {
+        MPCConfig cfg = validConfig();
+        cfg.processGain = 0.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, ModelPredictiveController::checkInputs(cfg, dt));
+        ModelPredictiveController mpc(cfg, dt, outputMin, outputMax);
+        TEST_ASSERT_FALSE(mpc.isConfigured());
+    }
+
+    // Non positive time constant
+    {
+        MPCConfig cfg = validConfig();
+        cfg.timeConstant = 0.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, ModelPredictiveController::checkInputs(cfg, dt));
+    }
+
+    // Negative dead time
+    {
+        MPCConfig cfg = validConfig();
+        cfg.deadTime = -1.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, ModelPredictiveController::checkInputs(cfg, dt));
+    }
+
+    // Dead time longer than the history kept
+    {
+        MPCConfig cfg = validConfig();
+        cfg.deadTime = (ModelPredictiveController::MaxDeadSteps + 1) * dt;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, ModelPredictiveController::checkInputs(cfg, dt));
+    }
+
+    // Prediction doesn't see past the dead time
+    {
+        MPCConfig cfg = validConfig();
+        cfg.predictionHorizon = 2;
+        cfg.controlHorizon = 1;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, ModelPredictiveController::checkInputs(cfg, dt));
+    }
+
+    // Control horizon out of range
+    {
+        MPCConfig cfg = validConfig();
+        cfg.controlHorizon = 0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, ModelPredictiveController::checkInputs(cfg, dt));
+        cfg.controlHorizon = ModelPredictiveController::MaxControlHorizon + 1;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, ModelPredictiveController::checkInputs(cfg, dt));
+    }
+
+    // Prediction horizon too long
+    {
+        MPCConfig cfg = validConfig();
+        cfg.predictionHorizon = ModelPredictiveController::MaxPredictionHorizon + 1;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, ModelPredictiveController::checkInputs(cfg, dt));
+    }
+
+    // Moves must cost something
+    {
+        MPCConfig cfg = validConfig();
+        cfg.moveWeight = 0.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, ModelPredictiveController::checkInputs(cfg, dt));
+    }
+}
+
+TEST_CASE("steadyState", "[MPC]")
+{
+    // At setpoint with a steady output, nothing moves
+    ModelPredictiveController mpc(validConfig(), dt, outputMin, outputMax);
+    TEST_ASSERT_TRUE(mpc.isConfigured());
+    TEST_ASSERT_EQUAL(2, mpc.getDeadSteps());
+
+    mpc.reset(400.0, 78.6);
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT_DOUBLE_WITHIN(1e-6, 400.0, mpc.update(78.6, 78.6));
+        TEST_ASSERT_EQUAL(0, mpc.getIterations());
+    }
+
+    // Head above setpoint asks for more reflux
+    TEST_ASSERT_TRUE(mpc.update(78.8, 78.6) > 400.0);
+}
+
+TEST_CASE("model", "[MPC]")
+{
+    // Against its own model the loop settles on a new setpoint and
+    // rejects a step disturbance without offset
+    const MPCConfig cfg = validConfig();
+    ModelPredictiveController mpc(cfg, dt, outputMin, outputMax);
+    FOPDTModel plant(cfg, 80.0, 400.0);
+    mpc.reset(400.0, 80.0);
+
+    double T = 80.0;
+    double u = 400.0;
+    for (int i = 0; i < 600; i++) {
+        u = mpc.update(T, 79.0);
+        T = plant.step(u, 0.0);
+    }
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 79.0, T);
+    TEST_ASSERT_DOUBLE_WITHIN(1.0, 400.0 + 1.0 / 0.025, u);
+
+    for (int i = 0; i < 900; i++) {
+        u = mpc.update(T, 79.0);
+        T = plant.step(u, 2.0);
+    }
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 79.0, T);
+    TEST_ASSERT_DOUBLE_WITHIN(1.0, 440.0 + 2.0 / 0.025, u);
+}
+
+TEST_CASE("constraints", "[MPC]")
+{
+    // A setpoint the pump can't reach holds the output at its limit, and
+    // control comes back off the limit without winding up
+    const MPCConfig cfg = validConfig();
+    ModelPredictiveController mpc(cfg, dt, outputMin, outputMax);
+    FOPDTModel plant(cfg, 80.0, 400.0);
+    mpc.reset(400.0, 80.0);
+
+    double T = 80.0;
+    double u = 400.0;
+    size_t maxIterations = 0;
+    for (int i = 0; i < 300; i++) {
+        u = mpc.update(T, 40.0);
+        T = plant.step(u, 0.0);
+        TEST_ASSERT_TRUE(u >= outputMin);
+        TEST_ASSERT_TRUE(u <= outputMax);
+        maxIterations = std::max(maxIterations, mpc.getIterations());
+    }
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, outputMax, u);
+    TEST_ASSERT_TRUE(maxIterations > 0);
+    TEST_ASSERT_TRUE(maxIterations <= ModelPredictiveController::MaxIterations);
+
+    for (int i = 0; i < 600; i++) {
+        u = mpc.update(T, 79.0);
+        T = plant.step(u, 0.0);
+    }
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 79.0, T);
+    TEST_ASSERT_EQUAL(0, mpc.getIterations());
+}
+
+TEST_CASE("plant", "[MPC]")
+{
+    // Hold the plant model at setpoint through the boiler warming up,
+    // taking over from a proportional loop that has left the head above it
+    const double setpoint = 78.6;
+    double output = 0.0;
+    ClosedLoopSim sim(PlantModelConfig {}, dt);
+    sim.run([&](double T, double) {
+        output = std::min(std::max(200.0 * (T - setpoint), 0.0), 1024.0);
+        return output / 1024.0;
+    }, 3600.0, setpoint, 0.25);
+
+    ModelPredictiveController mpc(validConfig(), dt, outputMin, outputMax);
+    mpc.reset(output, sim.getPlant().getHeadTemp());
+    const LoopMetrics metrics = sim.run([&](double T, double) {
+        return mpc.update(T, setpoint) / 1024.0;
+    }, 3600.0, setpoint, 0.25);
+
+    metrics.report("MPC");
+    TEST_ASSERT_TRUE(metrics.isSettled());
+    TEST_ASSERT_TRUE(metrics.getMeanAbsError() < 0.1);
+}
+
+TEST_CASE("benchmark", "[MPC]")
+{
+    // Per step CPU time at the largest problem size, tracking a
+    // disturbance that pushes moves onto the limits, and with the output
+    // held at its limit
+    MPCConfig cfg = validConfig();
+    cfg.deadTime = ModelPredictiveController::MaxDeadSteps * dt;
+    cfg.predictionHorizon = ModelPredictiveController::MaxPredictionHorizon;
+    cfg.controlHorizon = ModelPredictiveController::MaxControlHorizon;
+    ModelPredictiveController mpc(cfg, dt, outputMin, outputMax);
+    TEST_ASSERT_TRUE(mpc.isConfigured());
+
+    const int steps = 1000;
+    for (double setpoint : {78.6, 40.0}) {
+        mpc.reset(400.0, 78.6);
+        double sum = 0.0;
+        size_t maxIterations = 0;
+        const int64_t start = esp_timer_get_time();
+        for (int i = 0; i < steps; i++) {
+            sum += mpc.update(78.6 + 0.1 * std::sin(0.1 * i), setpoint);
+            maxIterations = std::max(maxIterations, mpc.getIterations());
+        }
+        const double stepTime = (esp_timer_get_time() - start) / static_cast<double>(steps);
+        printf("Setpoint %.1f: %.1f us per step, at most %d iterations\n", setpoint, stepTime, maxIterations);
+        TEST_ASSERT_TRUE(std::isfinite(sum));
+        TEST_ASSERT_TRUE(stepTime < 2000.0);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
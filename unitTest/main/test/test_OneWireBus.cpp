@@ -20,6 +20,16 @@ static PBOneWireConfig validConfig(void)
     return cfg;
 }
 
+static OneWireChannelConfig validBus(gpio_num_t pin, rmt_channel_t txChannel, rmt_channel_t rxChannel)
+{
+    OneWireChannelConfig cfg {};
+    cfg.pin = pin;
+    cfg.txChannel = txChannel;
+    cfg.rxChannel = rxChannel;
+
+    return cfg;
+}
+
 TEST_CASE("checkInputs", "[OneWireBus]")
 {
     // Default configuration invalid
@@ -47,6 +57,123 @@ TEST_CASE("checkInputs", "[OneWireBus]")
         cfg.tempSensorResolution = DS18B20_RESOLUTION_INVALID;
         TEST_ASSERT_EQUAL(PBRet::FAILURE, PBOneWire::checkInputs(cfg));
     }
+
+    // Invalid role resolution
+    {
+        PBOneWireConfig cfg = validConfig();
+        cfg.sensorSampling[DS18B20Role::HEAD_TEMP].resolution = DS18B20_RESOLUTION_INVALID;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, PBOneWire::checkInputs(cfg));
+    }
+
+    // Negative sample period
+    {
+        PBOneWireConfig cfg = validConfig();
+        cfg.sensorSampling[DS18B20Role::HEAD_TEMP].resolution = DS18B20_RESOLUTION_12_BIT;
+        cfg.sensorSampling[DS18B20Role::HEAD_TEMP].samplePeriod = -1.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, PBOneWire::checkInputs(cfg));
+    }
+
+    // Adaptive without low resolution
+    {
+        PBOneWireConfig cfg = validConfig();
+        cfg.sensorSampling[DS18B20Role::HEAD_TEMP].resolution = DS18B20_RESOLUTION_12_BIT;
+        cfg.sensorSampling[DS18B20Role::HEAD_TEMP].adaptive = true;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, PBOneWire::checkInputs(cfg));
+    }
+
+    // Valid buses. Default pin not required
+    {
+        PBOneWireConfig cfg = validConfig();
+        cfg.oneWirePin = static_cast<gpio_num_t>(-1);
+        cfg.buses = { validBus(GPIO_NUM_15, RMT_CHANNEL_1, RMT_CHANNEL_0), validBus(GPIO_NUM_4, RMT_CHANNEL_3, RMT_CHANNEL_2) };
+        TEST_ASSERT_EQUAL(PBRet::SUCCESS, PBOneWire::checkInputs(cfg));
+    }
+
+    // Bus with shared tx and rx channel
+    {
+        PBOneWireConfig cfg = validConfig();
+        cfg.buses = { validBus(GPIO_NUM_15, RMT_CHANNEL_1, RMT_CHANNEL_1) };
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, PBOneWire::checkInputs(cfg));
+    }
+
+    // Buses sharing an RMT channel
+    {
+        PBOneWireConfig cfg = validConfig();
+        cfg.buses = { validBus(GPIO_NUM_15, RMT_CHANNEL_1, RMT_CHANNEL_0), validBus(GPIO_NUM_4, RMT_CHANNEL_1, RMT_CHANNEL_2) };
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, PBOneWire::checkInputs(cfg));
+    }
+
+    // Buses sharing a GPIO
+    {
+        PBOneWireConfig cfg = validConfig();
+        cfg.buses = { validBus(GPIO_NUM_15, RMT_CHANNEL_1, RMT_CHANNEL_0), validBus(GPIO_NUM_15, RMT_CHANNEL_3, RMT_CHANNEL_2) };
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, PBOneWire::checkInputs(cfg));
+    }
+
+    // Discovery enabled without missed passes
+    {
+        PBOneWireConfig cfg = validConfig();
+        cfg.discovery.period = 5.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, PBOneWire::checkInputs(cfg));
+    }
+
+    // Health tracking enabled without error limits
+    {
+        PBOneWireConfig cfg = validConfig();
+        cfg.health.timeout = 5.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, PBOneWire::checkInputs(cfg));
+    }
+
+    // Role sampled slower than the sensor timeout
+    {
+        PBOneWireConfig cfg = validConfig();
+        cfg.health = { 5.0, 3, 5, 5.0, 0.0, 0.0, 5.0 };
+        TEST_ASSERT_EQUAL(PBRet::SUCCESS, PBOneWire::checkInputs(cfg));
+
+        cfg.sensorSampling[DS18B20Role::RADIATOR_TEMP].resolution = DS18B20_RESOLUTION_9_BIT;
+        cfg.sensorSampling[DS18B20Role::RADIATOR_TEMP].samplePeriod = 10.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, PBOneWire::checkInputs(cfg));
+    }
+}
+
+TEST_CASE("getBusConfigs", "[OneWireBus]")
+{
+    // No buses listed gives a single bus on the default pin
+    {
+        PBOneWireConfig cfg = validConfig();
+        std::vector<OneWireChannelConfig> buses = PBOneWire::getBusConfigs(cfg);
+        TEST_ASSERT_EQUAL(1, buses.size());
+        TEST_ASSERT_EQUAL(cfg.oneWirePin, buses[0].pin);
+        TEST_ASSERT_EQUAL(RMT_CHANNEL_1, buses[0].txChannel);
+        TEST_ASSERT_EQUAL(RMT_CHANNEL_0, buses[0].rxChannel);
+    }
+
+    // Listed buses are used as is
+    {
+        PBOneWireConfig cfg = validConfig();
+        cfg.buses = { validBus(GPIO_NUM_15, RMT_CHANNEL_1, RMT_CHANNEL_0), validBus(GPIO_NUM_4, RMT_CHANNEL_3, RMT_CHANNEL_2) };
+        std::vector<OneWireChannelConfig> buses = PBOneWire::getBusConfigs(cfg);
+        TEST_ASSERT_EQUAL(2, buses.size());
+        TEST_ASSERT_EQUAL(GPIO_NUM_4, buses[1].pin);
+    }
+}
+
+TEST_CASE("getSamplingConfig", "[OneWireBus]")
+{
+    PBOneWireConfig cfg = validConfig();
+    cfg.sensorSampling[DS18B20Role::HEAD_TEMP].resolution = DS18B20_RESOLUTION_9_BIT;
+    cfg.sensorSampling[DS18B20Role::HEAD_TEMP].samplePeriod = 2.0;
+
+    // Configured role
+    DS18B20SamplingConfig head = PBOneWire::getSamplingConfig(cfg, DS18B20Role::HEAD_TEMP);
+    TEST_ASSERT_EQUAL(DS18B20_RESOLUTION_9_BIT, head.resolution);
+    TEST_ASSERT_EQUAL_DOUBLE(2.0, head.samplePeriod);
+
+    // Unconfigured role uses the bus default
+    DS18B20SamplingConfig boiler = PBOneWire::getSamplingConfig(cfg, DS18B20Role::BOILER_TEMP);
+    TEST_ASSERT_EQUAL(DS18B20_RESOLUTION_12_BIT, boiler.resolution);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, boiler.samplePeriod);
+    TEST_ASSERT_FALSE(boiler.adaptive);
 }
 
 TEST_CASE("loadFromJSONValid", "[OneWireBus]")
@@ -60,6 +187,19 @@ TEST_CASE("loadFromJSONValid", "[OneWireBus]")
     TEST_ASSERT_NOT_EQUAL(cfg, nullptr);
 
     TEST_ASSERT_EQUAL(PBRet::SUCCESS, PBOneWire::loadFromJSON(testConfig, cfg));
+    TEST_ASSERT_EQUAL(2, testConfig.sensorSampling.size());
+    TEST_ASSERT_TRUE(testConfig.sensorSampling[DS18B20Role::HEAD_TEMP].adaptive);
+    TEST_ASSERT_EQUAL(DS18B20_RESOLUTION_10_BIT, testConfig.sensorSampling[DS18B20Role::HEAD_TEMP].lowResolution);
+    TEST_ASSERT_EQUAL(DS18B20_RESOLUTION_9_BIT, testConfig.sensorSampling[DS18B20Role::RADIATOR_TEMP].resolution);
+    TEST_ASSERT_EQUAL(2, testConfig.buses.size());
+    TEST_ASSERT_EQUAL(GPIO_NUM_4, testConfig.buses[1].pin);
+    TEST_ASSERT_EQUAL(RMT_CHANNEL_3, testConfig.buses[1].txChannel);
+    TEST_ASSERT_EQUAL(RMT_CHANNEL_2, testConfig.buses[1].rxChannel);
+    TEST_ASSERT_EQUAL_DOUBLE(5.0, testConfig.discovery.period);
+    TEST_ASSERT_EQUAL(3, testConfig.discovery.missedPasses);
+    TEST_ASSERT_EQUAL_DOUBLE(5.0, testConfig.health.timeout);
+    TEST_ASSERT_EQUAL(3, testConfig.health.maxConsecutiveErrors);
+    TEST_ASSERT_EQUAL_DOUBLE(600.0, testConfig.health.stuckTime);
 }
 
 TEST_CASE("loadFromJSONInvalid", "[OneWireBus]")
@@ -73,6 +213,24 @@ TEST_CASE("loadFromJSONInvalid", "[OneWireBus]")
     TEST_ASSERT_NOT_EQUAL(cfg, nullptr);
 
     TEST_ASSERT_EQUAL(PBRet::FAILURE, PBOneWire::loadFromJSON(testConfig, cfg));
+
+    // Sampling config missing required fields
+    cfg = cJSON_GetObjectItem(root, "InvalidSamplingConfig");
+    TEST_ASSERT_NOT_EQUAL(cfg, nullptr);
+
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, PBOneWire::loadFromJSON(testConfig, cfg));
+
+    // Bus missing RMT rx channel
+    cfg = cJSON_GetObjectItem(root, "InvalidBusConfig");
+    TEST_ASSERT_NOT_EQUAL(cfg, nullptr);
+
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, PBOneWire::loadFromJSON(testConfig, cfg));
+
+    // Health config missing required fields
+    cfg = cJSON_GetObjectItem(root, "InvalidHealthConfig");
+    TEST_ASSERT_NOT_EQUAL(cfg, nullptr);
+
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, PBOneWire::loadFromJSON(testConfig, cfg));
 }
 
 #ifdef __cplusplus
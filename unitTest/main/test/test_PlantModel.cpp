@@ -0,0 +1,149 @@
+#include "unity.h"
+#include <cmath>
+#include "PlantModel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void includePlantModelTests(void)
+{
+    // Dummy function to force discovery of unit tests by main test runner
+}
+
+TEST_CASE("checkInputs", "[PlantModel]")
+{
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, PlantModel::checkInputs(PlantModelConfig {}));
+
+    // No wash
+    {
+        PlantModelConfig cfg {};
+        cfg.washMass = 0.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, PlantModel::checkInputs(cfg));
+    }
+
+    // Pure ethanol
+    {
+        PlantModelConfig cfg {};
+        cfg.washAlcoholFraction = 1.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, PlantModel::checkInputs(cfg));
+    }
+
+    // Condenser more than perfect
+    {
+        PlantModelConfig cfg {};
+        cfg.condenserEffectiveness = 1.5;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, PlantModel::checkInputs(cfg));
+        PlantModel plant(cfg);
+        TEST_ASSERT_FALSE(plant.isConfigured());
+    }
+}
+
+TEST_CASE("warmUp", "[PlantModel]")
+{
+    PlantModelConfig cfg {};
+    cfg.boilerLossCoeff = 0.0;
+    PlantModel plant(cfg);
+    TEST_ASSERT_TRUE(plant.isConfigured());
+
+    // 10% wash boils at 92 C. Without losses the warm up time follows
+    // from the heat capacity
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 92.0, plant.getBoilingPoint());
+    const double heatCapacity = cfg.boilerHeatCapacity + cfg.washMass * PlantModel::WATER_HEAT_CAPACITY;
+    const double warmUp = heatCapacity * (92.0 - cfg.initialTemp) / cfg.elementPower;
+    plant.step(warmUp - 60.0);
+    TEST_ASSERT_TRUE(plant.getBoilerTemp() < 92.0);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, plant.getProductCollected());
+
+    // Boiling. Vapour reaches the head, nothing is condensed
+    plant.step(600.0);
+    TEST_ASSERT_DOUBLE_WITHIN(0.1, plant.getBoilingPoint(), plant.getBoilerTemp());
+    TEST_ASSERT_DOUBLE_WITHIN(0.5, plant.getBoilingPoint(), plant.getTrueHeadTemp());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, plant.getRefluxFraction());
+    TEST_ASSERT_TRUE(plant.getProductCollected() > 0.0);
+
+    // Heating stops. The head cools slowly
+    plant.setElementPower(0.0);
+    const double headTemp = plant.getTrueHeadTemp();
+    plant.step(600.0);
+    TEST_ASSERT_TRUE(plant.getTrueHeadTemp() < headTemp);
+    TEST_ASSERT_TRUE(plant.getTrueHeadTemp() > cfg.ambientTemp);
+}
+
+TEST_CASE("reflux", "[PlantModel]")
+{
+    PlantModel plant(PlantModelConfig {});
+    plant.step(3600.0);
+
+    // Full coolant flow condenses all the vapour. The head settles at the
+    // azeotrope and no product is drawn
+    plant.setPumpSpeed(1.0);
+    plant.step(1200.0);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 1.0, plant.getRefluxFraction());
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, PlantModel::AZEOTROPE_TEMP, plant.getTrueHeadTemp());
+    const double product = plant.getProductCollected();
+    plant.step(600.0);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, product, plant.getProductCollected());
+
+    // Partial reflux draws strong product and strips the wash
+    const double boilerFraction = plant.getBoilerAlcoholFraction();
+    plant.setPumpSpeed(0.3);
+    plant.step(1200.0);
+    TEST_ASSERT_TRUE(plant.getRefluxFraction() > 0.0);
+    TEST_ASSERT_TRUE(plant.getRefluxFraction() < 1.0);
+    TEST_ASSERT_TRUE(plant.getTrueHeadTemp() > PlantModel::AZEOTROPE_TEMP);
+    TEST_ASSERT_TRUE(plant.getProductCollected() > product);
+    TEST_ASSERT_TRUE(plant.getBoilerAlcoholFraction() < boilerFraction);
+}
+
+TEST_CASE("sensorResolution", "[PlantModel]")
+{
+    PlantModel plant(PlantModelConfig {});
+    plant.step(3000.0);
+
+    const double T = plant.getHeadTemp();
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, std::fmod(T, 0.0625));
+    TEST_ASSERT_DOUBLE_WITHIN(0.0625 / 2, plant.getTrueHeadTemp(), T);
+}
+
+TEST_CASE("metrics", "[PlantModel]")
+{
+    // Rise at 100 s, overshoot of 1 C, last outside the band at 194 s
+    LoopMetrics metrics(10.0, 0.1);
+    for (int t = 0; t <= 1000; t++) {
+        double T = 0.1 * t;
+        if ((t >= 100) && (t < 200)) {
+            T = 10.0 + 1.0 - std::fabs(t - 150) / 50.0;
+        } else if (t >= 200) {
+            T = 10.0;
+        }
+        metrics.add(t, T);
+    }
+
+    TEST_ASSERT_TRUE(metrics.isSettled());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 100.0, metrics.getRiseTime());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 94.0, metrics.getSettlingTime());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 1.0, metrics.getOvershoot());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, metrics.getUndershoot());
+    TEST_ASSERT_DOUBLE_WITHIN(1.0, 50.0, metrics.getIAE());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 900.0, metrics.getDuration());
+}
+
+TEST_CASE("closedLoop", "[PlantModel]")
+{
+    // Proportional control of the pump. The head holds above setpoint with
+    // an offset that grows as the wash is stripped
+    ClosedLoopSim sim(PlantModelConfig {}, 0.375);
+    const LoopMetrics metrics = sim.run([](double T, double) {
+        return 0.2 * (T - 78.6);
+    }, 2 * 3600.0, 78.6, 0.25);
+
+    TEST_ASSERT_TRUE(metrics.hasReachedSetpoint());
+    TEST_ASSERT_TRUE(sim.getPlant().getTrueHeadTemp() > 78.6);
+    TEST_ASSERT_TRUE(sim.getPlant().getTrueHeadTemp() < 78.6 + 2.0);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 2 * 3600.0, sim.getPlant().getTime());
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,139 @@
+#include "unity.h"
+#include <cmath>
+#include "main/PumpOutput.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void includePumpOutputTests(void)
+{
+    // Dummy function to force discovery of unit tests by main test runner
+}
+
+static constexpr uint32_t maxDuty = 1024;
+static constexpr int64_t period = 100000;        // Controller update period [us]
+
+TEST_CASE("writeCoalescing", "[PumpOutput]")
+{
+    PumpOutput output({maxDuty, 0.0, false});
+    PumpWrite write {};
+
+    // First change is written straight away
+    TEST_ASSERT_TRUE(output.update(300.0, 0, write));
+    TEST_ASSERT_EQUAL(300, write.duty);
+    TEST_ASSERT_EQUAL(0, write.fadeTime);
+
+    // Repeats and changes too small to reach another count aren't
+    for (int i = 1; i < 100; i++) {
+        TEST_ASSERT_FALSE(output.update(300.0 + 0.3 * std::sin(i), i * period, write));
+    }
+    TEST_ASSERT_EQUAL(300, output.getDuty());
+
+    // Speed is saturated before comparing
+    TEST_ASSERT_TRUE(output.update(5000.0, 100 * period, write));
+    TEST_ASSERT_EQUAL(maxDuty, write.duty);
+    TEST_ASSERT_FALSE(output.update(6000.0, 101 * period, write));
+    TEST_ASSERT_TRUE(output.update(-10.0, 102 * period, write));
+    TEST_ASSERT_EQUAL(0, write.duty);
+}
+
+TEST_CASE("slewLimit", "[PumpOutput]")
+{
+    // Each write is a hardware fade no faster than the slew rate, and
+    // finishes before the next update so none are skipped mid ramp
+    const double slewRate = 2000.0;
+    PumpOutput output({maxDuty, slewRate, false});
+    PumpWrite write {};
+
+    TEST_ASSERT_FALSE(output.update(0.0, 0, write));
+    uint32_t duty = 0;
+    int64_t t = 0;
+    int writes = 0;
+    while (duty < maxDuty) {
+        t += period;
+        TEST_ASSERT_TRUE(output.update(maxDuty, t, write));
+        TEST_ASSERT_TRUE(write.duty > duty);
+        TEST_ASSERT_TRUE(write.duty - duty <= slewRate * period * 1e-6);
+        TEST_ASSERT_TRUE(write.fadeTime * 1e3 >= (write.duty - duty) / slewRate * 1e6);
+        TEST_ASSERT_TRUE(write.fadeTime * 1000 < period);
+        duty = write.duty;
+        writes++;
+    }
+
+    // Whole ramp at close to the slew rate
+    TEST_ASSERT_TRUE(writes * period * 1e-6 <= maxDuty / (slewRate * PumpOutput::FadeFraction) + period * 1e-6);
+
+    // Nothing more to write once there
+    TEST_ASSERT_FALSE(output.update(maxDuty, t + period, write));
+
+    // Updates that arrive mid fade are skipped
+    TEST_ASSERT_TRUE(output.update(0.0, t + 2 * period, write));
+    TEST_ASSERT_TRUE(output.isFading(t + 2 * period + 1000));
+    TEST_ASSERT_FALSE(output.update(0.0, t + 2 * period + 1000, write));
+    TEST_ASSERT_EQUAL(maxDuty - 160, output.getDuty());
+}
+
+TEST_CASE("force", "[PumpOutput]")
+{
+    // Force skips the slew limit and any running fade
+    PumpOutput output({maxDuty, 100.0, false});
+    PumpWrite write {};
+
+    TEST_ASSERT_TRUE(output.update(500.0, 0, write));
+    TEST_ASSERT_TRUE(output.isFading(1000));
+    TEST_ASSERT_TRUE(output.force(maxDuty, 1000, write));
+    TEST_ASSERT_EQUAL(maxDuty, write.duty);
+    TEST_ASSERT_EQUAL(0, write.fadeTime);
+    TEST_ASSERT_FALSE(output.isFading(1000));
+    TEST_ASSERT_FALSE(output.force(maxDuty, 2000, write));
+}
+
+TEST_CASE("reset", "[PumpOutput]")
+{
+    // Carries on from a duty set by another writer
+    PumpOutput output({maxDuty, 100.0, false});
+    PumpWrite write {};
+
+    TEST_ASSERT_TRUE(output.update(500.0, 0, write));
+    output.reset(maxDuty);
+    TEST_ASSERT_EQUAL(maxDuty, output.getDuty());
+    TEST_ASSERT_FALSE(output.isFading(1000));
+    TEST_ASSERT_FALSE(output.force(maxDuty, 1000, write));
+
+    // Slew limited down from there
+    TEST_ASSERT_TRUE(output.update(0.0, period, write));
+    TEST_ASSERT_TRUE(output.getDuty() < maxDuty);
+    TEST_ASSERT_TRUE(output.getDuty() > 500);
+}
+
+TEST_CASE("dither", "[PumpOutput]")
+{
+    // Average duty resolves fractions of a count the hardware can't
+    for (double speed : {0.25, 100.1, 100.5, 511.9, 1023.3}) {
+        PumpOutput output({maxDuty, 0.0, true});
+        PumpWrite write {};
+        const int updates = 1000;
+        double total = 0.0;
+        for (int i = 0; i < updates; i++) {
+            output.update(speed, i * period, write);
+            TEST_ASSERT_TRUE(std::abs(static_cast<double> (output.getDuty()) - speed) < 1.0);
+            total += output.getDuty();
+        }
+        TEST_ASSERT_DOUBLE_WITHIN(1.0 / updates, speed, total / updates);
+    }
+
+    // Without dithering the fraction is lost
+    PumpOutput output({maxDuty, 0.0, false});
+    PumpWrite write {};
+    double total = 0.0;
+    for (int i = 0; i < 1000; i++) {
+        output.update(100.1, i * period, write);
+        total += output.getDuty();
+    }
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 100.0, total / 1000);
+}
+
+#ifdef __cplusplus
+}
+#endif
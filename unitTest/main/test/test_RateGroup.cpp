@@ -0,0 +1,71 @@
+#include "unity.h"
+#include "main/RateGroup.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void includeRateGroupTests(void)
+{
+    // Dummy function to force discovery of unit tests by main test runner
+}
+
+TEST_CASE("isDue", "[RateGroup]")
+{
+    // 0.5 s group driven by a 0.1 s loop runs every 5th tick
+    RateGroup group(0.5);
+    TEST_ASSERT_EQUAL_DOUBLE(0.5, group.getPeriod());
+
+    int nRuns = 0;
+    for (int64_t i = 0; i < 50; i++) {
+        if (group.isDue(i * 100000)) {
+            TEST_ASSERT_EQUAL(0, i % 5);
+            nRuns++;
+        }
+    }
+
+    TEST_ASSERT_EQUAL(10, nRuns);
+}
+
+TEST_CASE("isDueJitter", "[RateGroup]")
+{
+    // Late ticks don't shift the schedule
+    RateGroup group(1.0);
+    TEST_ASSERT_TRUE(group.isDue(0));
+    TEST_ASSERT_FALSE(group.isDue(900000));
+    TEST_ASSERT_TRUE(group.isDue(1200000));
+    TEST_ASSERT_FALSE(group.isDue(1900000));
+    TEST_ASSERT_TRUE(group.isDue(2000000));
+
+    // Falling several periods behind runs once then resyncs
+    TEST_ASSERT_TRUE(group.isDue(5500000));
+    TEST_ASSERT_FALSE(group.isDue(6000000));
+    TEST_ASSERT_TRUE(group.isDue(6500000));
+}
+
+TEST_CASE("deadbandFilter", "[RateGroup]")
+{
+    DeadbandFilter<2> filter(0.1, 1.0);
+
+    // First sample always published
+    TEST_ASSERT_TRUE(filter.shouldPublish(0, {20.0, 30.0}));
+
+    // Changes inside the deadband are suppressed
+    TEST_ASSERT_FALSE(filter.shouldPublish(100000, {20.05, 29.95}));
+
+    // Change in any channel triggers a publish
+    TEST_ASSERT_TRUE(filter.shouldPublish(200000, {20.0, 30.2}));
+
+    // Deadband is measured from the last published value, so slow drift
+    // is still reported
+    TEST_ASSERT_FALSE(filter.shouldPublish(300000, {20.06, 30.2}));
+    TEST_ASSERT_TRUE(filter.shouldPublish(400000, {20.12, 30.2}));
+
+    // Unchanged values are republished after maxInterval
+    TEST_ASSERT_FALSE(filter.shouldPublish(1300000, {20.12, 30.2}));
+    TEST_ASSERT_TRUE(filter.shouldPublish(1400000, {20.12, 30.2}));
+}
+
+#ifdef __cplusplus
+}
+#endif
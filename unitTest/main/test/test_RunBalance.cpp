@@ -0,0 +1,177 @@
+#include "unity.h"
+#include "main/RunBalance.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void includeRunBalanceTests(void)
+{
+    // Dummy function to force discovery of unit tests by main test runner
+}
+
+static RunBalanceConfig validConfig(void)
+{
+    RunBalanceConfig cfg {};
+    cfg.publishPeriod = 5.0;
+    cfg.checkpointPeriod = 60.0;
+    cfg.boilerChargeVolume = 25.0;
+    cfg.boilerChargeABV = 12.0;
+
+    return cfg;
+}
+
+TEST_CASE("Constructor", "[RunBalance]")
+{
+    // Default object not configured
+    {
+        RunBalanceEstimator balance {};
+        TEST_ASSERT_FALSE(balance.isConfigured());
+    }
+
+    // Valid params
+    {
+        RunBalanceEstimator balance(validConfig());
+        TEST_ASSERT_TRUE(balance.isConfigured());
+    }
+
+    // Invalid params
+    {
+        RunBalanceConfig cfg {};
+        RunBalanceEstimator balance(cfg);
+        TEST_ASSERT_FALSE(balance.isConfigured());
+    }
+}
+
+TEST_CASE("checkInputs", "[RunBalance]")
+{
+    // Valid config
+    {
+        RunBalanceConfig cfg = validConfig();
+        TEST_ASSERT_EQUAL(PBRet::SUCCESS, RunBalanceEstimator::checkInputs(cfg));
+    }
+
+    // Invalid publish period
+    {
+        RunBalanceConfig cfg = validConfig();
+        cfg.publishPeriod = 0.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, RunBalanceEstimator::checkInputs(cfg));
+    }
+
+    // Invalid checkpoint period
+    {
+        RunBalanceConfig cfg = validConfig();
+        cfg.checkpointPeriod = -1.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, RunBalanceEstimator::checkInputs(cfg));
+    }
+
+    // Invalid boiler ABV
+    {
+        RunBalanceConfig cfg = validConfig();
+        cfg.boilerChargeABV = 101.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, RunBalanceEstimator::checkInputs(cfg));
+    }
+}
+
+TEST_CASE("updateConstantFlow", "[RunBalance]")
+{
+    RunBalanceEstimator balance(validConfig());
+    TEST_ASSERT_TRUE(balance.isConfigured());
+
+    // 1 hour at 1 mL/s product, 3 mL/s reflux, 90% ABV, updated every 0.1875 s
+    const int64_t dt = 187500;
+    const int64_t nSteps = 3600 * 1000000LL / dt;
+    for (int64_t i = 0; i <= nSteps; i++) {
+        TEST_ASSERT_EQUAL(PBRet::SUCCESS, balance.update(i * dt, 3e-3, 1e-3, 90.0));
+    }
+
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 3.6, balance.getProductVolume());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 10.8, balance.getRefluxVolume());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 3.0, balance.getRefluxRatio());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 3.6 * 0.9 * 0.78945, balance.getEthanolMass());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 25.0 - 3.6, balance.getBoilerVolume());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, 3600.0, balance.getRunTime());
+}
+
+TEST_CASE("updateInvalid", "[RunBalance]")
+{
+    RunBalanceEstimator balance(validConfig());
+    TEST_ASSERT_TRUE(balance.isConfigured());
+
+    // Going back in time fails
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, balance.update(1000000, 1e-3, 1e-3, 90.0));
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, balance.update(0, 1e-3, 1e-3, 90.0));
+
+    // NaN input fails
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, balance.update(2000000, NAN, 1e-3, 90.0));
+
+    // Long gaps are not integrated
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, balance.update(60000000, 1e-3, 1e-3, 90.0));
+    TEST_ASSERT_EQUAL(0.0, balance.getProductVolume());
+}
+
+TEST_CASE("condensateFlowrate", "[RunBalance]")
+{
+    // Water condensed at its boiling point. 2.09 kW into the coolant
+    CondenserReading condenser {0.05, 1.0, 20.0, 30.0};
+    double flowrate = 0.0;
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, RunBalanceEstimator::condensateFlowrate(condenser, 0.0, 100.0, 100.0, flowrate));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 2.09 / 2257.0 / 0.99821, flowrate);
+
+    // 90% ABV distillate cooled to 30 deg C, with coolant density from the
+    // flowmeter
+    condenser.coolantDensity = 0.9957;
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, RunBalanceEstimator::condensateFlowrate(condenser, 90.0, 78.2, 30.0, flowrate));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-8, 2.23751e-3, flowrate);
+
+    // Coolant cooling through the condenser is no distillate
+    condenser.outletTemp = 19.5;
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, RunBalanceEstimator::condensateFlowrate(condenser, 90.0, 78.2, 30.0, flowrate));
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, flowrate);
+
+    // NaN input fails
+    condenser.outletTemp = NAN;
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, RunBalanceEstimator::condensateFlowrate(condenser, 90.0, 78.2, 30.0, flowrate));
+}
+
+TEST_CASE("checkpointRestore", "[RunBalance]")
+{
+    RunBalanceEstimator balance(validConfig());
+    TEST_ASSERT_TRUE(balance.isConfigured());
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, balance.update(0, 2e-3, 1e-3, 80.0));
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, balance.update(1000000, 2e-3, 1e-3, 80.0));
+
+    RunBalance checkpoint {};
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, balance.toMessage(checkpoint));
+
+    // Restored estimator resumes from checkpoint totals
+    RunBalanceEstimator restored(validConfig());
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, restored.restore(checkpoint));
+    TEST_ASSERT_EQUAL_DOUBLE(balance.getProductVolume(), restored.getProductVolume());
+    TEST_ASSERT_EQUAL_DOUBLE(balance.getRefluxVolume(), restored.getRefluxVolume());
+    TEST_ASSERT_EQUAL_DOUBLE(balance.getEthanolMass(), restored.getEthanolMass());
+
+    // First sample after restore does not integrate across the reboot
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, restored.update(0, 2e-3, 1e-3, 80.0));
+    TEST_ASSERT_EQUAL_DOUBLE(balance.getProductVolume(), restored.getProductVolume());
+
+    // Reset starts a new run
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, restored.reset());
+    TEST_ASSERT_EQUAL(0.0, restored.getProductVolume());
+}
+
+TEST_CASE("compensatedSum", "[RunBalance]")
+{
+    // Summing many small increments onto a large total
+    CompensatedSum sum {};
+    sum.reset(1e4);
+    for (int i = 0; i < 100000; i++) {
+        sum.add(1e-9);
+    }
+
+    TEST_ASSERT_DOUBLE_WITHIN(1e-11, 1e4 + 1e-4, sum.value());
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,270 @@
+#include "unity.h"
+#include <vector>
+#include "main/RunPhase.h"
+#include "PlantModel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void includeRunPhaseTests(void)
+{
+    // Dummy function to force discovery of unit tests by main test runner
+}
+
+static PhaseTransition transition(PhaseVariable variable, bool above, double threshold, double holdTime, RunPhase next)
+{
+    PhaseTransition t {};
+    t.variable = variable;
+    t.above = above;
+    t.threshold = threshold;
+    t.holdTime = holdTime;
+    t.next = next;
+
+    return t;
+}
+
+static RunPhaseConfig validConfig(void)
+{
+    RunPhaseConfig cfg {};
+
+    PhaseSettings warmUp {};
+    warmUp.phase = RunPhase::WARM_UP;
+    warmUp.integralEnabled = false;
+    warmUp.LPElementDuty = 1.0;
+    warmUp.HPElementDuty = 1.0;
+    warmUp.transitions = {transition(PhaseVariable::HEAD_TEMP, true, 70.0, 0.0, RunPhase::STABILISE)};
+    cfg.phases.push_back(warmUp);
+
+    PhaseSettings stabilise {};
+    stabilise.phase = RunPhase::STABILISE;
+    stabilise.setpoint = 78.6;
+    stabilise.rampRate = 0.1;
+    stabilise.transitions = {transition(PhaseVariable::TIME_IN_PHASE, true, 600.0, 0.0, RunPhase::HEARTS)};
+    cfg.phases.push_back(stabilise);
+
+    PhaseSettings hearts {};
+    hearts.phase = RunPhase::HEARTS;
+    hearts.transitions = {
+        transition(PhaseVariable::BOILER_TEMP, true, 95.0, 30.0, RunPhase::SHUTDOWN),
+        transition(PhaseVariable::VAPOUR_ABV, false, 80.0, 60.0, RunPhase::SHUTDOWN)
+    };
+    cfg.phases.push_back(hearts);
+
+    PhaseSettings shutdown {};
+    shutdown.phase = RunPhase::SHUTDOWN;
+    shutdown.LPElementDuty = 0.0;
+    shutdown.HPElementDuty = 0.0;
+    cfg.phases.push_back(shutdown);
+
+    return cfg;
+}
+
+TEST_CASE("checkInputs", "[RunPhase]")
+{
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, RunPhaseEngine::checkInputs(validConfig()));
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, RunPhaseEngine::checkInputs(RunPhaseConfig {}));
+
+    // Empty config is valid but doesn't configure
+    {
+        RunPhaseEngine engine(RunPhaseConfig {});
+        TEST_ASSERT_FALSE(engine.isConfigured());
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, engine.start(78.6));
+    }
+
+    // Phase listed twice
+    {
+        RunPhaseConfig cfg = validConfig();
+        cfg.phases.push_back(cfg.phases[0]);
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, RunPhaseEngine::checkInputs(cfg));
+        RunPhaseEngine engine(cfg);
+        TEST_ASSERT_FALSE(engine.isConfigured());
+    }
+
+    // Negative ramp rate
+    {
+        RunPhaseConfig cfg = validConfig();
+        cfg.phases[1].rampRate = -0.1;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, RunPhaseEngine::checkInputs(cfg));
+    }
+
+    // Element duty above 1
+    {
+        RunPhaseConfig cfg = validConfig();
+        cfg.phases[0].HPElementDuty = 1.5;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, RunPhaseEngine::checkInputs(cfg));
+    }
+
+    // Negative hold time
+    {
+        RunPhaseConfig cfg = validConfig();
+        cfg.phases[2].transitions[0].holdTime = -1.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, RunPhaseEngine::checkInputs(cfg));
+    }
+
+    // Transition to a phase that isn't configured
+    {
+        RunPhaseConfig cfg = validConfig();
+        cfg.phases[1].transitions[0].next = RunPhase::TAILS;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, RunPhaseEngine::checkInputs(cfg));
+    }
+
+    // Transition to itself
+    {
+        RunPhaseConfig cfg = validConfig();
+        cfg.phases[1].transitions[0].next = RunPhase::STABILISE;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, RunPhaseEngine::checkInputs(cfg));
+    }
+}
+
+TEST_CASE("transitions", "[RunPhase]")
+{
+    RunPhaseEngine engine(validConfig());
+    TEST_ASSERT_TRUE(engine.isConfigured());
+    TEST_ASSERT_FALSE(engine.isRunning());
+    TEST_ASSERT_TRUE(engine.isIntegralEnabled());
+
+    PhaseInputs inputs {};
+    inputs.setpoint = 78.6;
+    inputs.headTemp = 20.0;
+    inputs.boilerTemp = 20.0;
+
+    // Start reports the entry to the first phase once
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, engine.start(78.6));
+    TEST_ASSERT_TRUE(engine.update(inputs, 1.0));
+    TEST_ASSERT_FALSE(engine.update(inputs, 1.0));
+    TEST_ASSERT_EQUAL(RunPhase::WARM_UP, engine.getPhase());
+    TEST_ASSERT_FALSE(engine.isIntegralEnabled());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 2.0, engine.getTimeInPhase());
+
+    // No hold time. Leaves as soon as the head is hot
+    inputs.headTemp = 71.0;
+    TEST_ASSERT_TRUE(engine.update(inputs, 1.0));
+    TEST_ASSERT_EQUAL(RunPhase::STABILISE, engine.getPhase());
+    TEST_ASSERT_TRUE(engine.isIntegralEnabled());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, engine.getTimeInPhase());
+
+    // Leaves on time in phase
+    for (int i = 0; i < 600; i++) {
+        TEST_ASSERT_FALSE(engine.update(inputs, 1.0));
+    }
+    TEST_ASSERT_TRUE(engine.update(inputs, 1.0));
+    TEST_ASSERT_EQUAL(RunPhase::HEARTS, engine.getPhase());
+
+    // Unknown vapour ABV never meets a condition
+    for (int i = 0; i < 120; i++) {
+        TEST_ASSERT_FALSE(engine.update(inputs, 1.0));
+    }
+
+    // Hold timer restarts when the condition drops out
+    inputs.boilerTemp = 96.0;
+    for (int i = 0; i < 20; i++) {
+        TEST_ASSERT_FALSE(engine.update(inputs, 1.0));
+    }
+    inputs.boilerTemp = 94.0;
+    TEST_ASSERT_FALSE(engine.update(inputs, 1.0));
+    inputs.boilerTemp = 96.0;
+    for (int i = 0; i < 29; i++) {
+        TEST_ASSERT_FALSE(engine.update(inputs, 1.0));
+    }
+    TEST_ASSERT_TRUE(engine.update(inputs, 1.0));
+    TEST_ASSERT_EQUAL(RunPhase::SHUTDOWN, engine.getPhase());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, engine.getSettings().HPElementDuty);
+
+    // Shutdown has nowhere to go
+    for (int i = 0; i < 100; i++) {
+        TEST_ASSERT_FALSE(engine.update(inputs, 1.0));
+    }
+
+    engine.stop();
+    TEST_ASSERT_FALSE(engine.isRunning());
+    TEST_ASSERT_FALSE(engine.update(inputs, 1.0));
+}
+
+TEST_CASE("setpointRamp", "[RunPhase]")
+{
+    RunPhaseEngine engine(validConfig());
+    PhaseInputs inputs {};
+    inputs.setpoint = 80.0;
+
+    // Phases without a setpoint follow the tuning setpoint straight away
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, engine.start(75.0));
+    engine.update(inputs, 1.0);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 80.0, engine.getSetpoint());
+
+    // Ramps down to the stabilise setpoint at 0.1 deg C/s and holds it
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, engine.jumpTo(RunPhase::STABILISE));
+    engine.update(inputs, 1.0);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 79.9, engine.getSetpoint());
+    for (int i = 0; i < 9; i++) {
+        engine.update(inputs, 1.0);
+    }
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 79.0, engine.getSetpoint());
+    for (int i = 0; i < 10; i++) {
+        engine.update(inputs, 1.0);
+    }
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 78.6, engine.getSetpoint());
+
+    // Jumps report the new phase and reset its timers. Phases that aren't
+    // configured are rejected
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, engine.jumpTo(RunPhase::HEARTS));
+    TEST_ASSERT_TRUE(engine.update(inputs, 1.0));
+    TEST_ASSERT_EQUAL(RunPhase::HEARTS, engine.getPhase());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 1.0, engine.getTimeInPhase());
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, engine.jumpTo(RunPhase::TAILS));
+    TEST_ASSERT_EQUAL(RunPhase::HEARTS, engine.getPhase());
+
+    // Can't jump when stopped
+    engine.stop();
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, engine.jumpTo(RunPhase::WARM_UP));
+}
+
+TEST_CASE("plant", "[RunPhase]")
+{
+    // Drive the plant model through a whole run. The phase sets the
+    // elements and a proportional loop holds the head at the phase
+    // setpoint. The plant has no vapour ABV, so hearts ends on boiler
+    // temperature
+    RunPhaseConfig cfg = validConfig();
+    cfg.phases[2].transitions.pop_back();
+    RunPhaseEngine engine(cfg);
+
+    PlantModel plant(PlantModelConfig {});
+    const double dt = 1.0;
+    PhaseInputs inputs {};
+    inputs.setpoint = 78.6;
+    double power = 0.0;
+    std::vector<RunPhase> visited {};
+
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, engine.start(inputs.setpoint));
+    for (double t = 0.0; t < 6 * 3600.0; t += dt) {
+        inputs.headTemp = plant.getHeadTemp();
+        inputs.boilerTemp = plant.getBoilerTemp();
+        if (engine.update(inputs, dt)) {
+            const PhaseSettings& settings = engine.getSettings();
+            visited.push_back(settings.phase);
+            // Each element supplies half of the plant's power
+            if ((settings.LPElementDuty >= 0.0) && (settings.HPElementDuty >= 0.0)) {
+                power = 0.5 * (settings.LPElementDuty + settings.HPElementDuty);
+            }
+        }
+
+        if (engine.getPhase() == RunPhase::SHUTDOWN) {
+            break;
+        }
+
+        const double pump = std::min(std::max(200.0 * (inputs.headTemp - engine.getSetpoint()), 0.0), 1024.0);
+        plant.setElementPower(power);
+        plant.setPumpSpeed(pump / 1024.0);
+        plant.step(dt);
+    }
+
+    printf("Reached %s after %.0f s with %.2f kg of product, boiler %.1f\n", RunPhaseEngine::getPhaseName(engine.getPhase()), plant.getTime(), plant.getProductCollected(), plant.getBoilerTemp());
+    const std::vector<RunPhase> expected = {RunPhase::WARM_UP, RunPhase::STABILISE, RunPhase::HEARTS, RunPhase::SHUTDOWN};
+    TEST_ASSERT_TRUE(visited == expected);
+    TEST_ASSERT_TRUE(plant.getProductCollected() > 0.0);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,252 @@
+#include "unity.h"
+#include <algorithm>
+#include "main/SafetyMonitor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void includeSafetyMonitorTests(void)
+{
+    // Dummy function to force discovery of unit tests by main test runner
+}
+
+static constexpr int64_t second = 1000000;      // [us]
+
+static SafetyLimits validLimits(void)
+{
+    SafetyLimits cfg {};
+    cfg.sensorTimeout = 5.0;
+    cfg.maxHeadTemp = 102.0;
+    cfg.maxBoilerTemp = 105.0;
+    cfg.overTempTime = 2.0;
+    cfg.pumpCheckSpeed = 200.0;
+    cfg.minPumpFlow = 0.002;
+    cfg.pumpStallTime = 10.0;
+    cfg.coolingTemp = 60.0;
+    cfg.minCoolingFlow = 0.005;
+    cfg.coolingLossTime = 5.0;
+
+    return cfg;
+}
+
+// Every signal fresh at time t with the still running normally
+static SafetyInputs healthyInputs(int64_t t)
+{
+    SafetyInputs inputs {};
+    inputs.headTemp = 78.6;
+    inputs.headTempTime = t;
+    inputs.boilerTemp = 92.0;
+    inputs.boilerTempTime = t;
+    inputs.refluxFlow = 0.01;
+    inputs.productFlow = 0.003;
+    inputs.flowTime = t;
+    inputs.refluxPumpSpeed = 400.0;
+    inputs.productPumpSpeed = 50.0;
+    inputs.elementsOn = true;
+    inputs.outputsTime = t;
+
+    return inputs;
+}
+
+TEST_CASE("checkInputs", "[SafetyMonitor]")
+{
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, SafetyMonitor::checkInputs(validLimits()));
+
+    // Unconfigured monitor never trips
+    {
+        SafetyMonitor monitor(SafetyLimits {});
+        TEST_ASSERT_FALSE(monitor.isConfigured());
+        TEST_ASSERT_EQUAL(0, monitor.update(SafetyInputs {}, 100 * second));
+    }
+
+    // Zero sensor timeout
+    {
+        SafetyLimits cfg = validLimits();
+        cfg.sensorTimeout = 0.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, SafetyMonitor::checkInputs(cfg));
+    }
+
+    // Cooling threshold above the head limit
+    {
+        SafetyLimits cfg = validLimits();
+        cfg.coolingTemp = 110.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, SafetyMonitor::checkInputs(cfg));
+    }
+
+    // Pump check that would trip on pumps that are off
+    {
+        SafetyLimits cfg = validLimits();
+        cfg.pumpCheckSpeed = 0.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, SafetyMonitor::checkInputs(cfg));
+    }
+
+    // Negative persistence
+    {
+        SafetyLimits cfg = validLimits();
+        cfg.overTempTime = -1.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, SafetyMonitor::checkInputs(cfg));
+    }
+}
+
+TEST_CASE("healthy", "[SafetyMonitor]")
+{
+    SafetyMonitor monitor(validLimits());
+    TEST_ASSERT_TRUE(monitor.isConfigured());
+
+    for (int64_t t = 0; t < 60 * second; t += second / 20) {
+        TEST_ASSERT_EQUAL(0, monitor.update(healthyInputs(t), t));
+    }
+    TEST_ASSERT_FALSE(monitor.isTripped());
+
+    // Nothing has arrived and the elements are off. Not a fault
+    SafetyMonitor idle(validLimits());
+    TEST_ASSERT_EQUAL(0, idle.update(SafetyInputs {}, 60 * second));
+}
+
+TEST_CASE("stale", "[SafetyMonitor]")
+{
+    // Temperatures stop at 10 s and are stale the moment they are older
+    // than the timeout. The trip time is the expiry, not when it was seen
+    SafetyMonitor monitor(validLimits());
+    const int64_t lastTemp = 10 * second;
+    int64_t tripped = -1;
+    for (int64_t t = 0; t < 20 * second; t += second / 20) {
+        SafetyInputs inputs = healthyInputs(t);
+        inputs.headTempTime = std::min(t, lastTemp);
+        if ((monitor.update(inputs, t) != 0) && (tripped < 0)) {
+            tripped = t;
+        }
+    }
+    TEST_ASSERT_EQUAL(SafetyMonitor::mask(SafetyFault::TEMP_STALE), monitor.getLatched());
+    TEST_ASSERT_TRUE(tripped > lastTemp + 5 * second);
+    TEST_ASSERT_TRUE(tripped <= lastTemp + 5 * second + second / 20);
+    TEST_ASSERT_EQUAL(lastTemp + 5 * second, monitor.getTripTime());
+
+    // A signal that never arrived is a fault once the elements are on
+    SafetyMonitor missing(validLimits());
+    SafetyInputs inputs = healthyInputs(second);
+    inputs.flowTime = -1;
+    inputs.refluxFlow = NAN;
+    inputs.productFlow = NAN;
+    TEST_ASSERT_EQUAL(SafetyMonitor::mask(SafetyFault::FLOW_STALE), missing.update(inputs, second));
+    TEST_ASSERT_EQUAL(second, missing.getTripTime());
+
+    // The controller stopping is a fault
+    SafetyMonitor controller(validLimits());
+    inputs = healthyInputs(10 * second);
+    inputs.outputsTime = 2 * second;
+    TEST_ASSERT_EQUAL(SafetyMonitor::mask(SafetyFault::OUTPUTS_STALE), controller.update(inputs, 10 * second));
+    TEST_ASSERT_EQUAL(7 * second, controller.getTripTime());
+}
+
+TEST_CASE("overTemp", "[SafetyMonitor]")
+{
+    // Over temperature must persist. A single high reading doesn't trip
+    SafetyMonitor monitor(validLimits());
+    SafetyInputs inputs = healthyInputs(second);
+    inputs.boilerTemp = 106.0;
+    TEST_ASSERT_EQUAL(0, monitor.update(inputs, second));
+    TEST_ASSERT_EQUAL(SafetyMonitor::mask(SafetyFault::BOILER_OVER_TEMP), monitor.getActive());
+    TEST_ASSERT_EQUAL(0, monitor.update(healthyInputs(2 * second), 2 * second));
+    TEST_ASSERT_EQUAL(0, monitor.getActive());
+
+    // Persistence is counted from the first high sample
+    int64_t tripped = -1;
+    for (int64_t t = 10 * second; t < 20 * second; t += second / 20) {
+        inputs = healthyInputs(t);
+        inputs.headTemp = 103.0;
+        if ((monitor.update(inputs, t) != 0) && (tripped < 0)) {
+            tripped = t;
+        }
+    }
+    TEST_ASSERT_EQUAL(12 * second, tripped);
+    TEST_ASSERT_EQUAL(12 * second, monitor.getTripTime());
+    TEST_ASSERT_EQUAL(SafetyMonitor::mask(SafetyFault::HEAD_OVER_TEMP), monitor.getLatched());
+}
+
+TEST_CASE("flow", "[SafetyMonitor]")
+{
+    // Reflux pump driven with no flow, through spin up and beyond
+    SafetyMonitor monitor(validLimits());
+    int64_t tripped = -1;
+    for (int64_t t = 0; t < 20 * second; t += second / 20) {
+        SafetyInputs inputs = healthyInputs(t);
+        inputs.refluxFlow = 0.0;
+        inputs.productFlow = 0.006;
+        if ((monitor.update(inputs, t) != 0) && (tripped < 0)) {
+            tripped = t;
+        }
+    }
+    TEST_ASSERT_EQUAL(10 * second, tripped);
+    TEST_ASSERT_EQUAL(SafetyMonitor::mask(SafetyFault::REFLUX_PUMP_STALL), monitor.getLatched());
+
+    // Product pump at idle isn't checked
+    SafetyMonitor idle(validLimits());
+    for (int64_t t = 0; t < 20 * second; t += second / 20) {
+        SafetyInputs inputs = healthyInputs(t);
+        inputs.productFlow = 0.0;
+        TEST_ASSERT_EQUAL(0, idle.update(inputs, t));
+    }
+
+    // Both pumps off with vapour at the head and the elements on
+    SafetyMonitor cooling(validLimits());
+    tripped = -1;
+    for (int64_t t = 0; t < 20 * second; t += second / 20) {
+        SafetyInputs inputs = healthyInputs(t);
+        inputs.refluxPumpSpeed = 0.0;
+        inputs.productPumpSpeed = 0.0;
+        inputs.refluxFlow = 0.0;
+        inputs.productFlow = 0.0;
+        if ((cooling.update(inputs, t) != 0) && (tripped < 0)) {
+            tripped = t;
+        }
+    }
+    TEST_ASSERT_EQUAL(5 * second, tripped);
+    TEST_ASSERT_EQUAL(SafetyMonitor::mask(SafetyFault::COOLING_LOSS), cooling.getLatched());
+
+    // Warming up without coolant is fine
+    SafetyMonitor warmUp(validLimits());
+    for (int64_t t = 0; t < 20 * second; t += second / 20) {
+        SafetyInputs inputs = healthyInputs(t);
+        inputs.headTemp = 25.0;
+        inputs.refluxPumpSpeed = 0.0;
+        inputs.productPumpSpeed = 0.0;
+        inputs.refluxFlow = 0.0;
+        inputs.productFlow = 0.0;
+        TEST_ASSERT_EQUAL(0, warmUp.update(inputs, t));
+    }
+}
+
+TEST_CASE("reset", "[SafetyMonitor]")
+{
+    SafetyMonitor monitor(validLimits());
+    SafetyInputs inputs = healthyInputs(10 * second);
+    inputs.boilerTemp = 110.0;
+    monitor.update(inputs, 10 * second);
+    monitor.update(inputs, 13 * second);
+    TEST_ASSERT_TRUE(monitor.isTripped());
+
+    // Faults latch, and don't report again while latched
+    TEST_ASSERT_EQUAL(0, monitor.update(inputs, 14 * second));
+
+    // Reset is refused while the condition is present
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, monitor.reset());
+    TEST_ASSERT_TRUE(monitor.isTripped());
+
+    monitor.update(healthyInputs(15 * second), 15 * second);
+    TEST_ASSERT_TRUE(monitor.isTripped());
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, monitor.reset());
+    TEST_ASSERT_FALSE(monitor.isTripped());
+
+    // A new trip has its own trip time
+    inputs = healthyInputs(20 * second);
+    inputs.boilerTemp = 110.0;
+    monitor.update(inputs, 20 * second);
+    TEST_ASSERT_EQUAL(SafetyMonitor::mask(SafetyFault::BOILER_OVER_TEMP), monitor.update(inputs, 22 * second));
+    TEST_ASSERT_EQUAL(22 * second, monitor.getTripTime());
+}
+
+#ifdef __cplusplus
+}
+#endif
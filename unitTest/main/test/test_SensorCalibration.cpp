@@ -0,0 +1,101 @@
+#include "unity.h"
+#include "main/SensorCalibration.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void includeSensorCalibrationTests(void)
+{
+    // Dummy function to force discovery of unit tests by main test runner
+}
+
+TEST_CASE("identity", "[SensorCalibration]")
+{
+    SensorCalibration cal {};
+    TEST_ASSERT_TRUE(cal.isIdentity());
+    TEST_ASSERT_EQUAL_DOUBLE(78.3, cal.apply(78.3));
+}
+
+TEST_CASE("apply", "[SensorCalibration]")
+{
+    // T = 0.5 + 1.01 * raw - 1e-4 * raw^2
+    SensorCalibration cal({0.5, 1.01, -1e-4, 0.0}, 2);
+    TEST_ASSERT_EQUAL(2, cal.getOrder());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-12, 0.5 + 1.01 * 50.0 - 1e-4 * 2500.0, cal.apply(50.0));
+
+    // Terms above the order are dropped
+    SensorCalibration linear({0.5, 1.01, -1e-4, 0.0}, 1);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, linear.getCoefficients()[2]);
+}
+
+TEST_CASE("fitTwoPoint", "[SensorCalibration]")
+{
+    // Ice bath reads 0.4, boiling water reads 99.1
+    SensorCalibration cal {};
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, SensorCalibration::fitTwoPoint(0.4, 0.0, 99.1, 100.0, cal));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, cal.apply(0.4));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 100.0, cal.apply(99.1));
+
+    // Points too close together
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, SensorCalibration::fitTwoPoint(50.0, 50.0, 50.1, 50.2, cal));
+
+    // Invalid points
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, SensorCalibration::fitTwoPoint(NAN, 0.0, 99.1, 100.0, cal));
+}
+
+TEST_CASE("fitPolynomial", "[SensorCalibration]")
+{
+    // Points generated from a known cubic are recovered
+    const SensorCalibration truth({-0.3, 1.02, -2e-4, 1e-6}, 3);
+    std::vector<double> raw {};
+    std::vector<double> ref {};
+    for (double x = 0.0; x <= 100.0; x += 12.5) {
+        raw.push_back(x);
+        ref.push_back(truth.apply(x));
+    }
+
+    SensorCalibration cal {};
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, SensorCalibration::fitPolynomial(raw, ref, 3, cal));
+    for (size_t i = 0; i <= SensorCalibration::MaxOrder; i++) {
+        TEST_ASSERT_DOUBLE_WITHIN(1e-8, truth.getCoefficients()[i], cal.getCoefficients()[i]);
+    }
+
+    // Linear least squares through noisy points
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, SensorCalibration::fitPolynomial({0.0, 50.0, 100.0}, {0.1, 49.9, 100.1}, 1, cal));
+    TEST_ASSERT_DOUBLE_WITHIN(0.1, 50.0, cal.apply(50.0));
+
+    // Not enough points for the order
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, SensorCalibration::fitPolynomial({0.0, 100.0}, {0.0, 100.0}, 2, cal));
+
+    // Unsupported order
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, SensorCalibration::fitPolynomial(raw, ref, 4, cal));
+
+    // Repeated points don't determine a fit
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, SensorCalibration::fitPolynomial({20.0, 20.0, 20.0}, {20.1, 20.1, 20.1}, 1, cal));
+}
+
+TEST_CASE("store", "[SensorCalibration]")
+{
+    CalibrationStore store {};
+    OneWireBus_ROMCode a {};
+    a.bytes[0] = 0x28;
+    a.bytes[7] = 0x01;
+    OneWireBus_ROMCode b = a;
+    b.bytes[7] = 0x02;
+
+    SensorCalibration cal {};
+    TEST_ASSERT_FALSE(store.find(a, cal));
+
+    store.set(a, SensorCalibration({0.2, 1.0, 0.0, 0.0}, 1));
+    TEST_ASSERT_TRUE(store.find(a, cal));
+    TEST_ASSERT_EQUAL_DOUBLE(0.2, cal.getCoefficients()[0]);
+    TEST_ASSERT_FALSE(store.find(b, cal));
+
+    store.erase(a);
+    TEST_ASSERT_EQUAL(0, store.size());
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,205 @@
+#include "unity.h"
+#include "main/SensorFrame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void includeSensorFrameTests(void)
+{
+    // Dummy function to force discovery of unit tests by main test runner
+}
+
+static FrameAlignerConfig validConfig(void)
+{
+    FrameAlignerConfig cfg {};
+    cfg.maxSkew = 2.0;
+
+    return cfg;
+}
+
+TEST_CASE("checkInputs", "[FrameAligner]")
+{
+    // Default config invalid
+    {
+        FrameAlignerConfig cfg {};
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, FrameAligner::checkInputs(cfg));
+    }
+
+    // Valid config
+    {
+        FrameAlignerConfig cfg = validConfig();
+        TEST_ASSERT_EQUAL(PBRet::SUCCESS, FrameAligner::checkInputs(cfg));
+    }
+
+    // Negative skew
+    {
+        FrameAlignerConfig cfg = validConfig();
+        cfg.maxSkew = -1.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, FrameAligner::checkInputs(cfg));
+    }
+}
+
+TEST_CASE("align", "[FrameAligner]")
+{
+    FrameAligner aligner(validConfig());
+    TEST_ASSERT_TRUE(aligner.isConfigured());
+    SensorFrame frame {};
+
+    // Nothing to align yet
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, aligner.align(frame));
+
+    // Head temperature stamped at 1.0 s and 2.0 s, flow at 1.25 s and
+    // 1.75 s. The head is the reference, so sets the tick and the flow
+    // holds its last reading
+    aligner.addReading(SensorChannel::HEAD_TEMP, 78.0, 1000000);
+    aligner.addReading(SensorChannel::HEAD_TEMP, 80.0, 2000000);
+    aligner.addReading(SensorChannel::REFLUX_FLOW, 0.010, 1250000);
+    aligner.addReading(SensorChannel::REFLUX_FLOW, 0.020, 1750000);
+
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, aligner.align(frame));
+    TEST_ASSERT_EQUAL(2000000, frame.tick);
+    TEST_ASSERT_TRUE(frame[SensorChannel::HEAD_TEMP].valid);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 80.0, frame[SensorChannel::HEAD_TEMP].value);
+    TEST_ASSERT_EQUAL(2000000, frame[SensorChannel::HEAD_TEMP].timeStamp);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.020, frame[SensorChannel::REFLUX_FLOW].value);
+
+    // A channel ahead of the tick is interpolated back to it
+    aligner.addReading(SensorChannel::REFLUX_FLOW, 0.040, 2250000);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, aligner.align(frame));
+    TEST_ASSERT_EQUAL(2000000, frame.tick);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.030, frame[SensorChannel::REFLUX_FLOW].value);
+
+    // Channels without readings are invalid
+    TEST_ASSERT_FALSE(frame[SensorChannel::BOILER_TEMP].valid);
+
+    // Repeated readings are ignored
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, aligner.addReading(SensorChannel::HEAD_TEMP, 90.0, 2000000));
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, aligner.align(frame));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 80.0, frame[SensorChannel::HEAD_TEMP].value);
+
+    // Invalid readings are rejected
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, aligner.addReading(SensorChannel::HEAD_TEMP, NAN, 2100000));
+}
+
+TEST_CASE("alignStaleChannel", "[FrameAligner]")
+{
+    FrameAligner aligner(validConfig());
+    SensorFrame frame {};
+
+    aligner.addReading(SensorChannel::HEAD_TEMP, 78.0, 1000000);
+    aligner.addReading(SensorChannel::REFLUX_TEMP, 20.0, 1000000);
+    aligner.addReading(SensorChannel::HEAD_TEMP, 79.0, 2000000);
+    aligner.addReading(SensorChannel::REFLUX_TEMP, 21.0, 2000000);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, aligner.align(frame));
+    TEST_ASSERT_EQUAL(2000000, frame.tick);
+
+    // Reflux sensor stops. The tick doesn't wait for it, and it holds its
+    // last value until it is maxSkew behind
+    aligner.addReading(SensorChannel::HEAD_TEMP, 80.0, 3000000);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, aligner.align(frame));
+    TEST_ASSERT_EQUAL(3000000, frame.tick);
+    TEST_ASSERT_TRUE(frame[SensorChannel::REFLUX_TEMP].valid);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 21.0, frame[SensorChannel::REFLUX_TEMP].value);
+
+    aligner.addReading(SensorChannel::HEAD_TEMP, 81.0, 4500000);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, aligner.align(frame));
+    TEST_ASSERT_EQUAL(4500000, frame.tick);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 81.0, frame[SensorChannel::HEAD_TEMP].value);
+
+    // Stale channel holds its last value
+    TEST_ASSERT_FALSE(frame[SensorChannel::REFLUX_TEMP].valid);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 21.0, frame[SensorChannel::REFLUX_TEMP].value);
+
+    // It is valid again when it returns
+    aligner.addReading(SensorChannel::REFLUX_TEMP, 22.0, 4000000);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, aligner.align(frame));
+    TEST_ASSERT_EQUAL(4500000, frame.tick);
+    TEST_ASSERT_TRUE(frame[SensorChannel::REFLUX_TEMP].valid);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 22.0, frame[SensorChannel::REFLUX_TEMP].value);
+
+    // Head sensor stops. Once stale, the tick follows the newest reading
+    aligner.addReading(SensorChannel::REFLUX_TEMP, 23.0, 6000000);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, aligner.align(frame));
+    TEST_ASSERT_EQUAL(4500000, frame.tick);
+
+    aligner.addReading(SensorChannel::REFLUX_TEMP, 24.0, 7000000);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, aligner.align(frame));
+    TEST_ASSERT_EQUAL(7000000, frame.tick);
+    TEST_ASSERT_FALSE(frame[SensorChannel::HEAD_TEMP].valid);
+
+    // Ticks never go backwards when it returns
+    aligner.addReading(SensorChannel::HEAD_TEMP, 82.0, 6500000);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, aligner.align(frame));
+    TEST_ASSERT_EQUAL(7000000, frame.tick);
+    TEST_ASSERT_TRUE(frame[SensorChannel::HEAD_TEMP].valid);
+}
+
+TEST_CASE("alignShippedRates", "[FrameAligner]")
+{
+    // Head sampled every 0.75 s, boiler and radiator every 2.0 s and
+    // flows every 0.5 s, aligned at the SensorManager base rate. The tick
+    // must stay on the newest head sample rather than the slowest channel
+    FrameAligner aligner(validConfig());
+    SensorFrame frame {};
+
+    const int64_t dt = 62500;               // [us]
+    int64_t nextHead = 0;
+    int64_t nextSlow = 0;
+    int64_t nextFlow = 0;
+    int64_t newestHead = -1;
+    for (int64_t t = 0; t < 60000000; t += dt) {
+        if (t >= nextHead) {
+            aligner.addReading(SensorChannel::HEAD_TEMP, 78.0 + t * 1e-7, t);
+            newestHead = t;
+            nextHead += 750000;
+        }
+        if (t >= nextSlow) {
+            aligner.addReading(SensorChannel::BOILER_TEMP, 95.0, t);
+            aligner.addReading(SensorChannel::RADIATOR_TEMP, 30.0, t);
+            nextSlow += 2000000;
+        }
+        if (t >= nextFlow) {
+            aligner.addReading(SensorChannel::REFLUX_FLOW, 0.01, t - 250000);
+            nextFlow += 500000;
+        }
+
+        TEST_ASSERT_EQUAL(PBRet::SUCCESS, aligner.align(frame));
+        TEST_ASSERT_EQUAL(newestHead, frame.tick);
+        TEST_ASSERT_DOUBLE_WITHIN(1e-9, 78.0 + newestHead * 1e-7, frame[SensorChannel::HEAD_TEMP].value);
+        TEST_ASSERT_TRUE(frame[SensorChannel::BOILER_TEMP].valid);
+    }
+}
+
+TEST_CASE("timing", "[FrameAligner]")
+{
+    // Interval between readings and skew from the tick are measured per
+    // channel
+    FrameAligner aligner(validConfig());
+    SensorFrame frame {};
+
+    const int64_t jitter[] = {0, 20000, -20000, 0, 20000, -20000};
+    for (int i = 0; i < 6; i++) {
+        const int64_t t = (i + 1) * 500000;
+        aligner.addReading(SensorChannel::HEAD_TEMP, 78.0, t + jitter[i]);
+        aligner.addReading(SensorChannel::PRODUCT_FLOW, 0.01, t - 250000);
+        aligner.align(frame);
+    }
+
+    const RunningStats& flowInterval = aligner.getInterval(SensorChannel::PRODUCT_FLOW);
+    TEST_ASSERT_EQUAL(5, flowInterval.count());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.5, flowInterval.mean());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, flowInterval.stdDev());
+
+    const RunningStats& tempInterval = aligner.getInterval(SensorChannel::HEAD_TEMP);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 0.5, tempInterval.mean());
+    TEST_ASSERT_TRUE(tempInterval.stdDev() > 0.01);
+
+    // The head sets the tick, so the flow lags it by about 250 ms
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, aligner.getSkew(SensorChannel::HEAD_TEMP).max());
+    TEST_ASSERT_DOUBLE_WITHIN(0.03, -0.25, aligner.getSkew(SensorChannel::PRODUCT_FLOW).mean());
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,149 @@
+#include "unity.h"
+#include "main/SensorHealth.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void includeSensorHealthTests(void)
+{
+    // Dummy function to force discovery of unit tests by main test runner
+}
+
+static SensorHealthConfig validConfig(void)
+{
+    SensorHealthConfig cfg {};
+    cfg.timeout = 5.0;
+    cfg.maxConsecutiveErrors = 3;
+    cfg.recoveryReads = 2;
+    cfg.maxRate = 5.0;
+    cfg.stuckTime = 60.0;
+    cfg.stuckBand = 0.0;
+    cfg.publishPeriod = 5.0;
+
+    return cfg;
+}
+
+static constexpr int64_t Second = 1000000;
+
+TEST_CASE("checkInputs", "[SensorHealth]")
+{
+    // Default configuration invalid
+    {
+        SensorHealthConfig cfg {};
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, SensorHealthMonitor::checkInputs(cfg));
+    }
+
+    // Valid configuration
+    {
+        SensorHealthConfig cfg = validConfig();
+        TEST_ASSERT_EQUAL(PBRet::SUCCESS, SensorHealthMonitor::checkInputs(cfg));
+        TEST_ASSERT_TRUE(SensorHealthMonitor(cfg).isConfigured());
+    }
+
+    // Non positive max rate
+    {
+        SensorHealthConfig cfg = validConfig();
+        cfg.maxRate = 0.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, SensorHealthMonitor::checkInputs(cfg));
+    }
+
+    // Negative stuck time
+    {
+        SensorHealthConfig cfg = validConfig();
+        cfg.stuckTime = -1.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, SensorHealthMonitor::checkInputs(cfg));
+    }
+}
+
+TEST_CASE("errorsFailSensor", "[SensorHealth]")
+{
+    SensorHealthMonitor monitor(validConfig());
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, monitor.addSensor(0, 0));
+    TEST_ASSERT_TRUE(monitor.isHealthy(0));
+
+    // A single CRC error degrades the sensor but it is still used
+    bool changed = false;
+    monitor.reportError(0, SensorFault::CRC, changed);
+    TEST_ASSERT_TRUE(changed);
+    TEST_ASSERT_TRUE(monitor.isHealthy(0));
+    TEST_ASSERT_TRUE(monitor.getStats(0).status == SensorHealthStats::Status::DEGRADED);
+
+    // Enough errors in a row fail it
+    monitor.reportError(0, SensorFault::TIMEOUT, changed);
+    TEST_ASSERT_FALSE(changed);
+    monitor.reportError(0, SensorFault::CRC, changed);
+    TEST_ASSERT_TRUE(changed);
+    TEST_ASSERT_FALSE(monitor.isHealthy(0));
+    TEST_ASSERT_EQUAL(2, monitor.getStats(0).crcErrors);
+    TEST_ASSERT_EQUAL(1, monitor.getStats(0).timeouts);
+
+    // Readings from a failed sensor aren't used until it has recovered
+    TEST_ASSERT_FALSE(monitor.reportRead(0, 1 * Second, 78.0, changed));
+    TEST_ASSERT_TRUE(monitor.reportRead(0, 2 * Second, 78.1, changed));
+    TEST_ASSERT_TRUE(changed);
+    TEST_ASSERT_TRUE(monitor.isHealthy(0));
+}
+
+TEST_CASE("rateAnomaly", "[SensorHealth]")
+{
+    SensorHealthMonitor monitor(validConfig());
+    monitor.addSensor(1, 0);
+
+    bool changed = false;
+    TEST_ASSERT_TRUE(monitor.reportRead(1, 1 * Second, 78.0, changed));
+    TEST_ASSERT_TRUE(monitor.reportRead(1, 2 * Second, 79.0, changed));
+
+    // 85 deg C is the DS18B20 power on value. A jump to it is rejected
+    TEST_ASSERT_FALSE(monitor.reportRead(1, 3 * Second, 85.0, changed));
+    TEST_ASSERT_EQUAL(1, monitor.getStats(1).rateAnomalies);
+    TEST_ASSERT_TRUE(monitor.isHealthy(1));
+
+    // Rate is checked against the last good reading
+    TEST_ASSERT_TRUE(monitor.reportRead(1, 4 * Second, 79.5, changed));
+}
+
+TEST_CASE("stuckValue", "[SensorHealth]")
+{
+    SensorHealthMonitor monitor(validConfig());
+    monitor.addSensor(2, 0);
+
+    bool changed = false;
+    for (int64_t t = 1; t <= 60; t++) {
+        TEST_ASSERT_TRUE(monitor.reportRead(2, t * Second, 78.0, changed));
+    }
+
+    // Reading hasn't moved for longer than stuckTime
+    TEST_ASSERT_FALSE(monitor.reportRead(2, 62 * Second, 78.0, changed));
+    TEST_ASSERT_EQUAL(1, monitor.getStats(2).stuckEvents);
+
+    // A change clears it
+    TEST_ASSERT_TRUE(monitor.reportRead(2, 63 * Second, 78.1, changed));
+}
+
+TEST_CASE("timeout", "[SensorHealth]")
+{
+    SensorHealthMonitor monitor(validConfig());
+    monitor.addSensor(0, 0);
+    monitor.addSensor(3, 0);
+
+    bool changed = false;
+    monitor.reportRead(0, 4 * Second, 78.0, changed);
+
+    // Sensor 3 never produced a reading
+    std::array<bool, SensorHealthMonitor::MaxSensors> timedOut {};
+    monitor.update(6 * Second, timedOut);
+    TEST_ASSERT_FALSE(timedOut[0]);
+    TEST_ASSERT_TRUE(timedOut[3]);
+    TEST_ASSERT_TRUE(monitor.isHealthy(0));
+    TEST_ASSERT_FALSE(monitor.isHealthy(3));
+
+    // Unused sensors are never healthy
+    TEST_ASSERT_FALSE(timedOut[4]);
+    TEST_ASSERT_FALSE(monitor.isHealthy(4));
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, monitor.addSensor(SensorHealthMonitor::MaxSensors, 0));
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,6 +1,9 @@
 #include "unity.h"
 #include "main/SensorManager.h"
+#include "MockPulseCounter.h"
+#include "Generated/ControllerMessaging.h"
 #include "testSensorManagerConfig.h"
+#include <memory>
 
 #ifdef __cplusplus
 extern "C" {
@@ -15,16 +18,51 @@ static SensorManagerConfig validConfig(void)
 {
     SensorManagerConfig cfg {};
     cfg.dt = 0.1;
+    cfg.flowPeriod = 0.5;
+    cfg.broadcastPeriod = 1.0;
+    cfg.tempDeadband = 0.05;
+    cfg.flowDeadband = 1e-5;
+    cfg.maxPublishInterval = 0.5;
     cfg.oneWireConfig.oneWirePin = GPIO_NUM_0;
     cfg.oneWireConfig.tempSensorResolution = DS18B20_RESOLUTION_12_BIT;
     cfg.refluxFlowConfig.flowmeterPin = GPIO_NUM_0;
     cfg.refluxFlowConfig.kFactor = 1.0;
     cfg.productFlowConfig.flowmeterPin = GPIO_NUM_0;
     cfg.productFlowConfig.kFactor = 1.0;
+    cfg.runBalanceConfig.publishPeriod = 5.0;
+    cfg.runBalanceConfig.checkpointPeriod = 60.0;
+    cfg.runBalanceConfig.boilerChargeVolume = 25.0;
+    cfg.runBalanceConfig.boilerChargeABV = 12.0;
+    cfg.frameAlignerConfig.maxSkew = 2.0;
 
     return cfg;
 }
 
+class SensorManagerUT
+{
+    public:
+        static void setFlowmeters(SensorManager& sm, Flowmeter&& reflux, Flowmeter&& product)
+        {
+            sm._refluxFlowmeter = std::move(reflux);
+            sm._productFlowmeter = std::move(product);
+        }
+        static PBRet updateFlowrates(SensorManager& sm, int64_t t) { return sm._updateFlowrates(t); }
+        static void setTemperatures(SensorManager& sm, const TemperatureData& TData) { sm._Tdata = TData; }
+        static void setVapourConcentration(SensorManager& sm, double ABV) { sm._concData.set_vapourConcentration(ABV); }
+        static RunBalanceEstimator& getRunBalance(SensorManager& sm) { return sm._runBalance; }
+        static double getBusSetpoint(SensorManager& sm) { return sm._OWBus.getSetpoint(); }
+        static PBRet controllerTuningCB(SensorManager& sm, const ControllerTuning& tuning)
+        {
+            std::shared_ptr<PBMessageWrapper> msg = std::make_shared<PBMessageWrapper>(MessageServer::wrap(tuning, PBMessageType::ControllerTuning, MessageOrigin::Controller));
+            return sm._controllerTuningCB(msg);
+        }
+        static PBRet runPhaseStateCB(SensorManager& sm, const RunPhaseState& state)
+        {
+            std::shared_ptr<PBMessageWrapper> msg = std::make_shared<PBMessageWrapper>(MessageServer::wrap(state, PBMessageType::RunPhaseState, MessageOrigin::Controller));
+            return sm._runPhaseStateCB(msg);
+        }
+};
+
 TEST_CASE("checkInputs", "[SensorManager]")
 {
     // Default configuration invalid
@@ -46,6 +84,34 @@ TEST_CASE("checkInputs", "[SensorManager]")
         TEST_ASSERT_EQUAL(PBRet::FAILURE, SensorManager::checkInputs(cfg));
     }
 
+    // Flow period faster than base rate
+    {
+        SensorManagerConfig cfg = validConfig();
+        cfg.flowPeriod = 0.05;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, SensorManager::checkInputs(cfg));
+    }
+
+    // Broadcast period faster than base rate
+    {
+        SensorManagerConfig cfg = validConfig();
+        cfg.broadcastPeriod = 0.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, SensorManager::checkInputs(cfg));
+    }
+
+    // Negative deadband
+    {
+        SensorManagerConfig cfg = validConfig();
+        cfg.tempDeadband = -1.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, SensorManager::checkInputs(cfg));
+    }
+
+    // Invalid max publish interval
+    {
+        SensorManagerConfig cfg = validConfig();
+        cfg.maxPublishInterval = 0.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, SensorManager::checkInputs(cfg));
+    }
+
     // Invalid PBOneWire config
     {
         SensorManagerConfig cfg = validConfig();
@@ -66,6 +132,116 @@ TEST_CASE("checkInputs", "[SensorManager]")
         cfg.productFlowConfig.flowmeterPin = static_cast<gpio_num_t>(-1);
         TEST_ASSERT_EQUAL(PBRet::FAILURE, SensorManager::checkInputs(cfg));
     }
+
+    // Invalid run balance config
+    {
+        SensorManagerConfig cfg = validConfig();
+        cfg.runBalanceConfig.publishPeriod = 0.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, SensorManager::checkInputs(cfg));
+    }
+
+    // Invalid frame aligner config
+    {
+        SensorManagerConfig cfg = validConfig();
+        cfg.frameAlignerConfig.maxSkew = 0.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, SensorManager::checkInputs(cfg));
+    }
+}
+
+TEST_CASE("runBalanceVolumetric", "[SensorManager]")
+{
+    // Distillate comes from a heat balance on the volume of coolant
+    // measured, with the coolant density applied once
+    SensorManager sm(1, 4096, 1, validConfig());
+
+    TemperatureData TData {};
+    TData.set_headTemp(78.2);
+    TData.set_refluxCondensorTemp(30.0);
+    TData.set_prodCondensorTemp(25.0);
+    TData.set_radiatorTemp(20.0);
+    SensorManagerUT::setTemperatures(sm, TData);
+    SensorManagerUT::setVapourConcentration(sm, 90.0);
+
+    FlowmeterConfig flowCfg = validConfig().refluxFlowConfig;
+    flowCfg.kFactor = 1e-3;
+    MockPulseCounter* refluxCounter = new MockPulseCounter();
+    MockPulseCounter* productCounter = new MockPulseCounter();
+    Flowmeter reflux(flowCfg, std::unique_ptr<PulseCounter>(refluxCounter));
+    Flowmeter product(flowCfg, std::unique_ptr<PulseCounter>(productCounter));
+    reflux.setFluidTemperature(30.0);
+    product.setFluidTemperature(25.0);
+    const CondenserReading refluxCondenser {0.03, reflux.getDensity(), 20.0, 30.0};
+    const CondenserReading productCondenser {0.01, product.getDensity(), 20.0, 25.0};
+    SensorManagerUT::setFlowmeters(sm, std::move(reflux), std::move(product));
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, SensorManagerUT::getRunBalance(sm).reset());
+
+    // 30 mL/s reflux and 10 mL/s product over 0.5 s flow windows. The
+    // first window starts the integration
+    for (int64_t i = 1; i <= 20; i++) {
+        refluxCounter->addPulses(15);
+        productCounter->addPulses(5);
+        TEST_ASSERT_EQUAL(PBRet::SUCCESS, SensorManagerUT::updateFlowrates(sm, i * 500000));
+    }
+
+    double refluxFlowrate = 0.0;
+    double productFlowrate = 0.0;
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, RunBalanceEstimator::condensateFlowrate(refluxCondenser, 90.0, 78.2, 78.2, refluxFlowrate));
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, RunBalanceEstimator::condensateFlowrate(productCondenser, 90.0, 78.2, 25.0, productFlowrate));
+
+    const RunBalanceEstimator& balance = SensorManagerUT::getRunBalance(sm);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, refluxFlowrate * 9.5, balance.getRefluxVolume());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, productFlowrate * 9.5, balance.getProductVolume());
+}
+
+TEST_CASE("resolutionBandFollowsRunPhase", "[SensorManager]")
+{
+    // The adaptive resolution band is centred on the setpoint in use, which
+    // the run phase owns while a run is in progress
+    SensorManager sm(1, 4096, 1, validConfig());
+
+    DS18B20SamplingConfig sampling {};
+    sampling.resolution = DS18B20_RESOLUTION_12_BIT;
+    sampling.adaptive = true;
+    sampling.lowResolution = DS18B20_RESOLUTION_9_BIT;
+    sampling.adaptiveBand = 2.0;
+    AdaptiveResolution head(sampling);
+    const double headTemp = 65.0;
+
+    ControllerTuning tuning {};
+    tuning.set_setpoint(78.0);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, SensorManagerUT::controllerTuningCB(sm, tuning));
+    TEST_ASSERT_EQUAL_DOUBLE(78.0, SensorManagerUT::getBusSetpoint(sm));
+    head.update(headTemp, SensorManagerUT::getBusSetpoint(sm));
+    TEST_ASSERT_FALSE(head.isHighResolution());
+
+    // Run starts in a phase holding a lower setpoint
+    RunPhaseState state {};
+    state.set_running(true);
+    state.set_setpoint(65.0);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, SensorManagerUT::runPhaseStateCB(sm, state));
+    TEST_ASSERT_EQUAL_DOUBLE(65.0, SensorManagerUT::getBusSetpoint(sm));
+    head.update(headTemp, SensorManagerUT::getBusSetpoint(sm));
+    TEST_ASSERT_TRUE(head.isHighResolution());
+
+    // New tuning doesn't move the band during a run
+    tuning.set_setpoint(80.0);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, SensorManagerUT::controllerTuningCB(sm, tuning));
+    TEST_ASSERT_EQUAL_DOUBLE(65.0, SensorManagerUT::getBusSetpoint(sm));
+
+    // Next phase moves it
+    state.set_setpoint(78.2);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, SensorManagerUT::runPhaseStateCB(sm, state));
+    TEST_ASSERT_EQUAL_DOUBLE(78.2, SensorManagerUT::getBusSetpoint(sm));
+    head.update(headTemp, SensorManagerUT::getBusSetpoint(sm));
+    TEST_ASSERT_FALSE(head.isHighResolution());
+
+    // Back to the tuned setpoint once the run stops
+    state.set_running(false);
+    state.set_setpoint(80.0);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, SensorManagerUT::runPhaseStateCB(sm, state));
+    tuning.set_setpoint(79.0);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, SensorManagerUT::controllerTuningCB(sm, tuning));
+    TEST_ASSERT_EQUAL_DOUBLE(79.0, SensorManagerUT::getBusSetpoint(sm));
 }
 
 TEST_CASE("loadFromJSONValid", "[SensorManager]")
@@ -0,0 +1,126 @@
+#include "unity.h"
+#include <cstring>
+#include "main/SettingsCache.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void includeSettingsCacheTests(void)
+{
+    // Dummy function to force discovery of unit tests by main test runner
+}
+
+static constexpr double writeDelay = 5.0;       // [s]
+static constexpr int64_t second = 1000000;      // [us]
+
+TEST_CASE("crc32", "[SettingsCache]")
+{
+    // Standard check value
+    const char* check = "123456789";
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, SettingsCache::crc32(0, reinterpret_cast<const uint8_t*>(check), strlen(check)));
+
+    // Chaining gives the same result as a single pass
+    const uint32_t first = SettingsCache::crc32(0, reinterpret_cast<const uint8_t*>(check), 4);
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, SettingsCache::crc32(first, reinterpret_cast<const uint8_t*>(check) + 4, 5));
+}
+
+TEST_CASE("encodeDecode", "[SettingsCache]")
+{
+    const std::vector<uint8_t> value {1, 2, 3, 250};
+    SettingsRecord record = SettingsCache::encode("ctrlTuning", value);
+    TEST_ASSERT_EQUAL(value.size() + SettingsCache::CRCSize, record.data.size());
+
+    std::vector<uint8_t> decoded {};
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, SettingsCache::decode(record, decoded));
+    TEST_ASSERT_TRUE(decoded == value);
+
+    // Empty values are valid
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, SettingsCache::decode(SettingsCache::encode("empty", {}), decoded));
+    TEST_ASSERT_EQUAL(0, decoded.size());
+
+    // Any flipped bit is caught
+    for (size_t i = 0; i < record.data.size() * 8; i++) {
+        SettingsRecord corrupt = record;
+        corrupt.data[i / 8] ^= static_cast<uint8_t>(1 << (i % 8));
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, SettingsCache::decode(corrupt, decoded));
+    }
+
+    // Truncated records and records under the wrong key are rejected
+    SettingsRecord truncated = record;
+    truncated.data.resize(2);
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, SettingsCache::decode(truncated, decoded));
+
+    SettingsRecord renamed = record;
+    renamed.key = "gainSchedule";
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, SettingsCache::decode(renamed, decoded));
+}
+
+TEST_CASE("restore", "[SettingsCache]")
+{
+    SettingsCache cache(writeDelay);
+    const std::vector<uint8_t> value {7, 8, 9};
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, cache.restore(SettingsCache::encode("sensors", value)));
+
+    // Restored values are readable and clean
+    std::vector<uint8_t> read {};
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, cache.get("sensors", read));
+    TEST_ASSERT_TRUE(read == value);
+    TEST_ASSERT_FALSE(cache.isDirty());
+
+    // Corrupt records are dropped
+    SettingsRecord corrupt = SettingsCache::encode("runBalance", value);
+    corrupt.data[0] ^= 0xFF;
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, cache.restore(corrupt));
+    TEST_ASSERT_FALSE(cache.contains("runBalance"));
+    TEST_ASSERT_EQUAL(1, cache.size());
+}
+
+TEST_CASE("deferredWrite", "[SettingsCache]")
+{
+    SettingsCache cache(writeDelay);
+
+    // Keys must fit in NVS
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, cache.put("", {1}, 0));
+    TEST_ASSERT_EQUAL(PBRet::FAILURE, cache.put("aKeyThatIsTooLong", {1}, 0));
+
+    // A burst of changes is one write, writeDelay after the first
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT_EQUAL(PBRet::SUCCESS, cache.put("ctrlTuning", {static_cast<uint8_t>(i)}, i * second / 10));
+    }
+    TEST_ASSERT_TRUE(cache.isDirty());
+    TEST_ASSERT_EQUAL(0, cache.takeDue(4 * second, false).size());
+
+    std::vector<SettingsRecord> due = cache.takeDue(5 * second, false);
+    TEST_ASSERT_EQUAL(1, due.size());
+    std::vector<uint8_t> value {};
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, SettingsCache::decode(due[0], value));
+    TEST_ASSERT_EQUAL(9, value[0]);
+    TEST_ASSERT_FALSE(cache.isDirty());
+
+    // Unchanged values aren't written again
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, cache.put("ctrlTuning", {9}, 6 * second));
+    TEST_ASSERT_FALSE(cache.isDirty());
+
+    // A value that never stops changing is still written every writeDelay
+    int writes = 0;
+    for (int i = 0; i < 100; i++) {
+        const int64_t t = 10 * second + i * second / 2;
+        cache.put("runBalance", {static_cast<uint8_t>(i)}, t);
+        writes += cache.takeDue(t, false).size();
+    }
+    TEST_ASSERT_EQUAL(9, writes);
+
+    // Failed writes come back. Force takes everything dirty
+    cache.put("sensors", {1, 2}, 100 * second);
+    due = cache.takeDue(100 * second, true);
+    TEST_ASSERT_EQUAL(2, due.size());
+    TEST_ASSERT_FALSE(cache.isDirty());
+    cache.retry(due[1], 100 * second);
+    TEST_ASSERT_TRUE(cache.isDirty());
+    TEST_ASSERT_EQUAL(1, cache.takeDue(105 * second, false).size());
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <limits>
+#include <cmath>
 #include "unity.h"
 #include "main/Utilities.h"
 
@@ -232,6 +233,51 @@ TEST_CASE("CircularBufferEmpty", "[Utilities]")
     // TODO: Add tests
 }
 
+TEST_CASE("RunningStats", "[Utilities]")
+{
+    RunningStats stats {};
+    TEST_ASSERT_EQUAL(0, stats.count());
+    TEST_ASSERT_EQUAL(0.0, stats.stdDev());
+
+    const double vals[] = {2.0, 4.0, 4.0, 4.0, 5.0, 5.0, 7.0, 9.0};
+    for (double val : vals) {
+        stats.add(val);
+    }
+
+    TEST_ASSERT_EQUAL(8, stats.count());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-12, 5.0, stats.mean());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-12, std::sqrt(32.0 / 7.0), stats.stdDev());
+    TEST_ASSERT_EQUAL(2.0, stats.min());
+    TEST_ASSERT_EQUAL(9.0, stats.max());
+
+    stats.reset();
+    TEST_ASSERT_EQUAL(0, stats.count());
+    TEST_ASSERT_EQUAL(0.0, stats.mean());
+}
+
+TEST_CASE("Histogram", "[Utilities]")
+{
+    Histogram<4> hist(0.5);
+    TEST_ASSERT_EQUAL(0, hist.total());
+
+    const double vals[] = {0.0, 0.2, 0.5, 0.99, 1.2, 1.6, 100.0, -1.0};
+    for (double val : vals) {
+        hist.add(val);
+    }
+
+    // Negative values count in the first bin, large values in the last
+    TEST_ASSERT_EQUAL(8, hist.total());
+    TEST_ASSERT_EQUAL(3, hist.at(0));
+    TEST_ASSERT_EQUAL(2, hist.at(1));
+    TEST_ASSERT_EQUAL(1, hist.at(2));
+    TEST_ASSERT_EQUAL(2, hist.at(3));
+    TEST_ASSERT_EQUAL(0, hist.at(4));
+
+    hist.reset();
+    TEST_ASSERT_EQUAL(0, hist.total());
+    TEST_ASSERT_EQUAL(0, hist.at(3));
+}
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
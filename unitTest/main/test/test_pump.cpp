@@ -2,6 +2,8 @@
 #include "main/Pump.h"
 #include "testPumpConfig.h"
 #include "freertos/task.h"
+#include "esp_timer.h"
+#include "hal/gpio_ll.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -66,6 +68,9 @@ TEST_CASE("checkInputs", "[Pump]")
         PumpConfig cfg = validConfig();
         cfg.PWMChannel = static_cast<ledc_channel_t>(-1);
         TEST_ASSERT_EQUAL(PBRet::FAILURE, Pump::checkInputs(cfg));
+
+        cfg.PWMChannel = LEDC_CHANNEL_MAX;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, Pump::checkInputs(cfg));
     }
 
     // Invalid timer channe;
@@ -74,6 +79,51 @@ TEST_CASE("checkInputs", "[Pump]")
         cfg.timerChannel = static_cast<ledc_timer_t>(-1);
         TEST_ASSERT_EQUAL(PBRet::FAILURE, Pump::checkInputs(cfg));
     }
+
+    // Invalid slew rate
+    {
+        PumpConfig cfg = validConfig();
+        cfg.slewRate = -1.0;
+        TEST_ASSERT_EQUAL(PBRet::FAILURE, Pump::checkInputs(cfg));
+    }
+}
+
+TEST_CASE("holdAtFlushDuringFade", "[Pump]")
+{
+    // Safety override lands on flush speed over a running speed ramp
+    PumpConfig cfg(GPIO_NUM_23, LEDC_CHANNEL_2, LEDC_TIMER_0);
+    cfg.slewRate = 100.0;
+    Pump testPump(cfg);
+    TEST_ASSERT_TRUE(testPump.isConfigured());
+
+    // Start a long fade
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, testPump.updatePumpSpeed(0.0));
+    vTaskDelay(2000 / portTICK_PERIOD_MS);
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, testPump.updatePumpSpeed(Pump::PUMP_MAX_SPEED));
+
+    // Override doesn't wait on the fade
+    int64_t start = esp_timer_get_time();
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, Pump::holdAtFlush(cfg));
+    TEST_ASSERT_TRUE(esp_timer_get_time() - start < 1000);
+
+    // Pump can't write while held
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, testPump.forcePumpSpeed(Pump::PUMP_IDLE_SPEED));
+
+    // Pin stays at flush speed while the fade runs out underneath
+    gpio_ll_input_enable(&GPIO, cfg.pumpGPIO);
+    for (int i = 0; i < 200; i++) {
+        TEST_ASSERT_EQUAL(1, gpio_get_level(cfg.pumpGPIO));
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+    }
+
+    // Release doesn't wait either
+    start = esp_timer_get_time();
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, Pump::release(cfg));
+    TEST_ASSERT_TRUE(esp_timer_get_time() - start < 1000);
+
+    // Pump takes the pin back and carries on from flush speed
+    TEST_ASSERT_EQUAL(PBRet::SUCCESS, testPump.forcePumpSpeed(Pump::PUMP_IDLE_SPEED));
+    TEST_ASSERT_EQUAL(Pump::PUMP_IDLE_SPEED, ledc_get_duty(LEDC_HIGH_SPEED_MODE, cfg.PWMChannel));
 }
 
 // TEST_CASE("updatePumpSpeed", "[Pump]")
@@ -122,6 +172,8 @@ TEST_CASE("loadFromJSONValid", "[Pump]")
     TEST_ASSERT_NOT_EQUAL(cfg, nullptr);
 
     TEST_ASSERT_EQUAL(PBRet::SUCCESS, Pump::loadFromJSON(testConfig, cfg));
+    TEST_ASSERT_EQUAL_DOUBLE(2000.0, testConfig.slewRate);
+    TEST_ASSERT_TRUE(testConfig.dither);
 }
 
 TEST_CASE("loadFromJSONInvalid", "[Pump]")
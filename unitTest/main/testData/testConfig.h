@@ -5,6 +5,7 @@ static const char* testConfig = "{              \
     \"DistillerConfig\": {                      \
         \"ControllerConfig\": {                 \
             \"dt\": 0.2,                        \
+            \"timingPublishPeriod\": 5.0,       \
             \"GPIO_fan\": 21,                   \
             \"GPIO_element1\": 13,              \
             \"GPIO_element2\": 32,              \
@@ -7,6 +7,7 @@ static const char* ctrlConfig = "\
 {\
     \"ControllerConfigValid\": {\
         \"dt\": 0.2,\
+        \"timingPublishPeriod\": 5.0,\
         \"GPIO_fan\": 21,\
         \"GPIO_element1\": 13,\
         \"GPIO_element2\": 32,\
@@ -20,15 +21,75 @@ static const char* ctrlConfig = "\
             \"PWMChannel\": 1,\
             \"timerChannel\": 1\
         },\
-        \"slowPMWLPElement\": {\
-            \"PWMFreq\": 5\
+        \"elementDriver\": {\
+            \"slotFreq\": 100,\
+            \"mode\": \"sigmaDelta\",\
+            \"timerGroup\": 1,\
+            \"timerIndex\": 0\
         },\
-        \"slowPMWHPElement\": {\
-            \"PWMFreq\": 5\
+        \"controlBudget\": {\
+            \"budget\": 0.15,\
+            \"phaseBudgets\": {\
+                \"control\": 0.05,\
+                \"peripherals\": 0.05,\
+                \"pumps\": 0.05,\
+                \"broadcast\": 0.05\
+            },\
+            \"overrunAction\": \"skipBroadcast\",\
+            \"degradeCycles\": 3\
+        },\
+        \"autotune\": {\
+            \"relayAmplitude\": 150,\
+            \"hysteresis\": 0.1,\
+            \"cycles\": 3,\
+            \"tolerance\": 0.2,\
+            \"maxDuration\": 3600,\
+            \"maxDeviation\": 3.0,\
+            \"tuningRule\": \"tyreusLuyben\"\
+        },\
+        \"gainSchedule\": {\
+            \"variable\": \"headTemp\",\
+            \"points\": [\
+                {\"x\": 78.2, \"PGain\": 300, \"IGain\": 3.0, \"DGain\": 0},\
+                {\"x\": 80.0, \"PGain\": 200, \"IGain\": 2.0, \"DGain\": 0},\
+                {\"x\": 90.0, \"PGain\": 120, \"IGain\": 1.0, \"DGain\": 0}\
+            ]\
+        },\
+        \"feedforward\": {\
+            \"LPElementGain\": 155,\
+            \"HPElementGain\": 310,\
+            \"boilerTempGain\": -0.775,\
+            \"boilerTempRef\": 20,\
+            \"vapourCurve\": [\
+                {\"boilerTemp\": 85, \"fraction\": 0.0},\
+                {\"boilerTemp\": 90, \"fraction\": 1.0}\
+            ]\
+        },\
+        \"runPhases\": [\
+            {\"phase\": \"warmUp\", \"integral\": false, \"LPElementDuty\": 1, \"HPElementDuty\": 1, \"fan\": false, \"refluxPumpMode\": \"off\", \"productPumpMode\": \"off\",\
+             \"transitions\": [{\"variable\": \"headTemp\", \"above\": 50, \"next\": \"stabilise\"}]},\
+            {\"phase\": \"stabilise\", \"rampRate\": 0.05, \"fan\": true, \"refluxPumpMode\": \"active\",\
+             \"transitions\": [{\"variable\": \"timeInPhase\", \"above\": 1800, \"next\": \"heads\"}]},\
+            {\"phase\": \"heads\", \"productPumpMode\": \"manual\", \"productPumpSpeed\": 80,\
+             \"transitions\": [{\"variable\": \"productVolume\", \"above\": 0.25, \"next\": \"hearts\"}]},\
+            {\"phase\": \"hearts\", \"productPumpMode\": \"active\",\
+             \"transitions\": [{\"variable\": \"vapourABV\", \"below\": 85, \"hold\": 60, \"next\": \"tails\"}]},\
+            {\"phase\": \"tails\", \"setpoint\": 85, \"rampRate\": 0.01,\
+             \"transitions\": [{\"variable\": \"boilerTemp\", \"above\": 98, \"hold\": 30, \"next\": \"shutdown\"}]},\
+            {\"phase\": \"shutdown\", \"LPElementDuty\": 0, \"HPElementDuty\": 0, \"productPumpMode\": \"off\"}\
+        ],\
+        \"mpc\": {\
+            \"processGain\": -0.025,\
+            \"timeConstant\": 55,\
+            \"deadTime\": 2,\
+            \"predictionHorizon\": 60,\
+            \"controlHorizon\": 4,\
+            \"moveWeight\": 1.0\
         }\
     },\
     \"ControllerConfigInvalid\": {\
         \"dt\": 0.2,\
+        \"timingPublishPeriod\": 5.0,\
         \"GPIO_fan\": 21,\
         \"GPIO_element1\": 13,\
         \"RefluxPump\": {\
@@ -8,6 +8,7 @@ static const char* distillerManagerConfig = "\
     \"DistillerConfigValid\": {\
         \"ControllerConfig\": {\
             \"dt\": 0.2,\
+            \"timingPublishPeriod\": 5.0,\
             \"GPIO_fan\": 21,\
             \"GPIO_element1\": 13,\
             \"GPIO_element2\": 32,\
@@ -21,11 +22,31 @@ static const char* distillerManagerConfig = "\
                 \"PWMChannel\": 1,\
                 \"timerChannel\": 1\
             },\
-            \"slowPMWLPElement\": {\
-                \"PWMFreq\": 5\
+            \"elementDriver\": {\
+                \"slotFreq\": 100,\
+                \"mode\": \"sigmaDelta\",\
+                \"timerGroup\": 1,\
+                \"timerIndex\": 0\
             },\
-            \"slowPMWHPElement\": {\
-                \"PWMFreq\": 5\
+            \"controlBudget\": {\
+                \"budget\": 0.15,\
+                \"phaseBudgets\": {\
+                    \"control\": 0.05,\
+                    \"peripherals\": 0.05,\
+                    \"pumps\": 0.05,\
+                    \"broadcast\": 0.05\
+                },\
+                \"overrunAction\": \"skipBroadcast\",\
+                \"degradeCycles\": 3\
+            },\
+            \"autotune\": {\
+                \"relayAmplitude\": 150,\
+                \"hysteresis\": 0.1,\
+                \"cycles\": 3,\
+                \"tolerance\": 0.2,\
+                \"maxDuration\": 3600,\
+                \"maxDeviation\": 3.0,\
+                \"tuningRule\": \"tyreusLuyben\"\
             }\
         },\
         \"SensorManagerConfig\": {\
@@ -43,6 +64,26 @@ static const char* distillerManagerConfig = "\
                 \"kFactor\": 1\
             }\
         },\
+        \"SafetySupervisorConfig\": {\
+            \"period\": 0.05,\
+            \"reactionDeadline\": 0.1,\
+            \"statusPublishPeriod\": 5.0,\
+            \"limits\": {\
+                \"sensorTimeout\": 5.0,\
+                \"maxHeadTemp\": 102.0,\
+                \"maxBoilerTemp\": 105.0,\
+                \"overTempTime\": 2.0,\
+                \"pumpCheckSpeed\": 200,\
+                \"minPumpFlow\": 0.002,\
+                \"pumpStallTime\": 10.0,\
+                \"coolingTemp\": 60.0,\
+                \"minCoolingFlow\": 0.005,\
+                \"coolingLossTime\": 5.0\
+            }\
+        },\
+        \"SettingsStoreConfig\": {\
+            \"writeDelay\": 5.0\
+        },\
         \"WebserverConfig\": {\
             \"maxConnections\": 12,\
             \"maxBroadcastFreq\": 10\
@@ -52,6 +93,7 @@ static const char* distillerManagerConfig = "\
     \"DistillerConfigInvalid\": {\
         \"ControllerConfig\": {\
             \"dt\": 0.2,\
+            \"timingPublishPeriod\": 5.0,\
             \"GPIO_fan\": 21,\
             \"GPIO_element1\": 13,\
             \"GPIO_element2\": 32\
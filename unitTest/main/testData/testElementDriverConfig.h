@@ -0,0 +1,30 @@
+#ifndef TEST_ELEMENTDRIVERCONFIG_H
+#define TEST_ELEMENTDRIVERCONFIG_H
+
+// Unit test config for ElementDriver
+
+static const char* elementDriverTestConfig = "\
+{\
+    \"validElementDriverConfig\": {\
+      \"slotFreq\": 100,\
+      \"mode\": \"sigmaDelta\",\
+      \"timerGroup\": 1,\
+      \"timerIndex\": 0\
+    },\
+    \"burstElementDriverConfig\": {\
+      \"slotFreq\": 120,\
+      \"mode\": \"burst\",\
+      \"burstSlots\": 50,\
+      \"timerGroup\": 1,\
+      \"timerIndex\": 1,\
+      \"GPIO_zeroCross\": 34\
+    },\
+    \"invalidElementDriverConfig\": {\
+      \"slotFreq\": 100,\
+      \"mode\": \"burst\",\
+      \"timerGroup\": 1,\
+      \"timerIndex\": 0\
+    }\
+}";
+
+#endif // TEST_ELEMENTDRIVERCONFIG_H
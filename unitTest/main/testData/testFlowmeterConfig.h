@@ -6,11 +6,31 @@
 static const char* flowmeterTestConfig = "\
 {\
     \"validFlowmeterConfig\": {\
+      \"GPIO\": 35,\
+      \"kFactor\": 0.0025,\
+      \"PCNTUnit\": 0,\
+      \"periodModeRate\": 10.0\
+    },\
+    \"ISRFlowmeterConfig\": {\
       \"GPIO\": 35,\
       \"kFactor\": 1\
     },\
+    \"curveFlowmeterConfig\": {\
+      \"GPIO\": 35,\
+      \"kFactorCurve\": [\
+        {\"frequency\": 1.0, \"kFactor\": 0.0030},\
+        {\"frequency\": 10.0, \"kFactor\": 0.0026},\
+        {\"frequency\": 100.0, \"kFactor\": 0.0025}\
+      ]\
+    },\
     \"invalidFlowmeterConfig\": {\
       \"GPIO\": 34\
+    },\
+    \"invalidCurveFlowmeterConfig\": {\
+      \"GPIO\": 34,\
+      \"kFactorCurve\": [\
+        {\"frequency\": 1.0}\
+      ]\
     }\
 }";
 
@@ -7,7 +7,72 @@ static const char* OneWireBusConfig = "\
 {\
     \"ValidOneWireConfig\": {\
         \"GPIO_onewire\": 15,\
-        \"DS18B20Resolution\": 11\
+        \"DS18B20Resolution\": 11,\
+        \"sensorSampling\": {\
+            \"headTemp\": {\
+                \"resolution\": 12,\
+                \"samplePeriod\": 0.75,\
+                \"adaptive\": true,\
+                \"lowResolution\": 10,\
+                \"adaptiveBand\": 3.0\
+            },\
+            \"radiatorTemp\": {\
+                \"resolution\": 9,\
+                \"samplePeriod\": 2.0\
+            }\
+        },\
+        \"buses\": [\
+            {\
+                \"GPIO\": 15,\
+                \"RMTTxChannel\": 1,\
+                \"RMTRxChannel\": 0\
+            },\
+            {\
+                \"GPIO\": 4,\
+                \"RMTTxChannel\": 3,\
+                \"RMTRxChannel\": 2\
+            }\
+        ],\
+        \"discovery\": {\
+            \"period\": 5.0,\
+            \"missedPasses\": 3\
+        },\
+        \"health\": {\
+            \"timeout\": 5.0,\
+            \"maxConsecutiveErrors\": 3,\
+            \"recoveryReads\": 5,\
+            \"maxRate\": 5.0,\
+            \"stuckTime\": 600.0,\
+            \"stuckBand\": 0.0,\
+            \"publishPeriod\": 5.0\
+        }\
+    },\
+    \"InvalidSamplingConfig\": {\
+        \"GPIO_onewire\": 15,\
+        \"DS18B20Resolution\": 11,\
+        \"sensorSampling\": {\
+            \"headTemp\": {\
+                \"resolution\": 12,\
+                \"adaptive\": true\
+            }\
+        }\
+    },\
+    \"InvalidBusConfig\": {\
+        \"GPIO_onewire\": 15,\
+        \"DS18B20Resolution\": 11,\
+        \"buses\": [\
+            {\
+                \"GPIO\": 15,\
+                \"RMTTxChannel\": 1\
+            }\
+        ]\
+    },\
+    \"InvalidHealthConfig\": {\
+        \"GPIO_onewire\": 15,\
+        \"DS18B20Resolution\": 11,\
+        \"health\": {\
+            \"timeout\": 5.0\
+        }\
     },\
     \"InvalidOneWireConfig\": {\
         \"GPIO_onewire\": 15\
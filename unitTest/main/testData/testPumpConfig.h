@@ -8,7 +8,9 @@ static const char* pumpConfig = "\
     \"ValidPump\": {\
         \"GPIO\": 22,\
         \"PWMChannel\": 1,\
-        \"timerChannel\": 1\
+        \"timerChannel\": 1,\
+        \"slewRate\": 2000,\
+        \"dither\": true\
     },\
         \"InvalidPump\": {\
         \"GPIO\": 22,\
@@ -7,6 +7,11 @@ static const char* sensorManagerConfig = "\
 {\
   \"ValidSensorManagerConfig\": {\
     \"dt\": 0.2,\
+    \"flowPeriod\": 0.4,\
+    \"broadcastPeriod\": 1.0,\
+    \"tempDeadband\": 0.05,\
+    \"flowDeadband\": 1e-5,\
+    \"maxPublishInterval\": 0.5,\
     \"oneWireConfig\": {\
       \"GPIO_onewire\": 15,\
       \"DS18B20Resolution\": 11,\
@@ -20,6 +25,15 @@ static const char* sensorManagerConfig = "\
     \"productFlowmeterConfig\": {\
       \"GPIO\": 34,\
       \"kFactor\": 1\
+    },\
+    \"runBalanceConfig\": {\
+      \"publishPeriod\": 5,\
+      \"checkpointPeriod\": 60,\
+      \"boilerChargeVolume\": 25,\
+      \"boilerChargeABV\": 12\
+    },\
+    \"frameAlignerConfig\": {\
+      \"maxSkew\": 2.0\
     }\
   },\
   \"InvalidSensorManagerConfig\": {\
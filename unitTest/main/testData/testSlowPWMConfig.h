@@ -1,20 +0,0 @@
-#ifndef TEST_SLOWPWMCONFIG_H
-#define TEST_SLOWPWMCONFIG_H
-
-// Unit test config for SlowPWM
-
-static const char* slowPWMTestConfig = "\
-{\
-  \"validSlowPWM\": {\
-        \"PWMFreq\": 5\
-    },\
-    \"invalidSlowPWM\": {\
-        \"PWMFreqe\": 5\
-    }\
-}";
-
-#endif // TEST_SLOWPWMCONFIG_H
-
-
-
-
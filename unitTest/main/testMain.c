@@ -19,9 +19,27 @@ static void includeAllTests(void)
     includeControllerTests();
     includeDistillerManagerTests();
     includeFlowmeterTests();
-    includeSlowPWMTests();
     includeFilterTests();
     includeMessageServerTests();
+    includeRunBalanceTests();
+    includeRateGroupTests();
+    includeDS18B20PipelineTests();
+    includeDeviceDiscoveryTests();
+    includeSensorCalibrationTests();
+    includeSensorHealthTests();
+    includeSensorFrameTests();
+    includeControlLoopTests();
+    includePlantModelTests();
+    includeAutotunerTests();
+    includeGainScheduleTests();
+    includeFeedforwardTests();
+    includeRunPhaseTests();
+    includeModelPredictiveTests();
+    includeSafetyMonitorTests();
+    includeElementModulatorTests();
+    includeElementDriverTests();
+    includePumpOutputTests();
+    includeSettingsCacheTests();
 }
 
 void app_main(void)